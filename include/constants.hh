@@ -9,6 +9,10 @@ static constexpr auto REG_DEST = 0x2;
 
 using uint = unsigned int;
 
+// Guest page granularity, shared by the MMU and the per-page bits in Memory.
+static constexpr unsigned int guest_page_shift = 12;
+static constexpr std::size_t guest_page_size = std::size_t(1) << guest_page_shift;
+
 #define EAX (0)
 #define ECX (1)
 #define EDX (2)
@@ -1,19 +1,27 @@
 #pragma once
 
 #include "constants.hh"
+#include "cpuid.hh"
 #include "flags.hh"
 #include "memory.hh"
+#include "mmu.hh"
 #include "stack.hh"
 
 #include <cstddef>
 #include <cstdint>
 
 struct CPU_HALT {unsigned int x;};
+// #DE: DIV or IDIV by zero, or a quotient too wide for its register.
+struct DIVIDE_ERROR {};
+
+// Stack region reserved by CPU(mem_size), capped at the size of memory.
+static constexpr std::size_t default_stack_size = 64_kb;
 
 class CPU {
 public:
     Memory mem;
     Stack stack;
+    MMU mmu;
     Flags flags;
 
     std::uint16_t cs = 0, ss = 0, ds = 0, es = 0, fs = 0, gs = 0;
@@ -22,12 +30,22 @@ public:
 
     CPU(std::size_t mem_size=1_mb);
     CPU(std::size_t mem_size, std::size_t stack_size);
+    // Stack and MMU refer back into the CPU, so moves rebuild them around
+    // the moved memory. Copying is not supported.
+    CPU(CPU&& other) noexcept;
 
     // data access helper functions.
     std::uint32_t& regat(int index);
     std::uint16_t& segregat(int index);
+
+    std::uint16_t& sreg(Segment seg);
+
+    // Write a segment register and refresh its cached base and limit.
+    void load_segment(Segment seg, std::uint16_t selector);
 public:
 
+    // Registers, flags and MMU back to their power on state and every
+    // touched page of guest memory zeroed. The stack layout is kept.
     void reset();
 
     // BCD instructions.
@@ -54,6 +72,29 @@ public:
     std::uint16_t cmp16(std::uint16_t, std::uint16_t);
     std::uint32_t cmp32(std::uint32_t, std::uint32_t);
 
+    // Bit test and modify; the bit index is taken modulo the operand width.
+    void bt16(std::uint16_t, std::uint16_t);
+    void bt32(std::uint32_t, std::uint32_t);
+    std::uint16_t btc16(std::uint16_t, std::uint16_t);
+    std::uint32_t btc32(std::uint32_t, std::uint32_t);
+    std::uint16_t btr16(std::uint16_t, std::uint16_t);
+    std::uint32_t btr32(std::uint32_t, std::uint32_t);
+    std::uint16_t bts16(std::uint16_t, std::uint16_t);
+    std::uint32_t bts32(std::uint32_t, std::uint32_t);
+
+    // Bit scans and counts of the second operand. bsf and bsr return the
+    // first operand unchanged when the source is zero.
+    std::uint16_t bsf16(std::uint16_t, std::uint16_t);
+    std::uint32_t bsf32(std::uint32_t, std::uint32_t);
+    std::uint16_t bsr16(std::uint16_t, std::uint16_t);
+    std::uint32_t bsr32(std::uint32_t, std::uint32_t);
+    std::uint16_t lzcnt16(std::uint16_t, std::uint16_t);
+    std::uint32_t lzcnt32(std::uint32_t, std::uint32_t);
+    std::uint16_t popcnt16(std::uint16_t, std::uint16_t);
+    std::uint32_t popcnt32(std::uint32_t, std::uint32_t);
+    std::uint16_t tzcnt16(std::uint16_t, std::uint16_t);
+    std::uint32_t tzcnt32(std::uint32_t, std::uint32_t);
+
     // Data Conversion instructions.
     std::uint32_t bswap(std::uint32_t);
     void cbw();
@@ -93,13 +134,62 @@ public:
     std::uint16_t imul16(std::uint16_t, std::uint16_t);
     std::uint32_t imul32(std::uint32_t, std::uint32_t);
 
+    // One operand forms, returning the double width product. CF and OF say
+    // whether its upper half is significant.
+    std::uint16_t imul8_s(std::uint8_t, std::uint8_t);
     std::uint32_t imul16_s(std::uint16_t, std::uint16_t);
     std::uint64_t imul32_s(std::uint32_t, std::uint32_t);
+    std::uint16_t mul8(std::uint8_t, std::uint8_t);
+    std::uint32_t mul16(std::uint16_t, std::uint16_t);
+    std::uint64_t mul32(std::uint32_t, std::uint32_t);
+
+    // Divide a double width dividend, returning the remainder in the upper
+    // half and the quotient in the lower as AH:AL, DX:AX and EDX:EAX hold
+    // them. Throw DIVIDE_ERROR rather than truncate.
+    std::uint16_t div8(std::uint16_t, std::uint8_t);
+    std::uint32_t div16(std::uint32_t, std::uint16_t);
+    std::uint64_t div32(std::uint64_t, std::uint32_t);
+    std::uint16_t idiv8(std::uint16_t, std::uint8_t);
+    std::uint32_t idiv16(std::uint32_t, std::uint16_t);
+    std::uint64_t idiv32(std::uint64_t, std::uint32_t);
+
+    std::uint8_t neg8(std::uint8_t);
+    std::uint16_t neg16(std::uint16_t);
+    std::uint32_t neg32(std::uint32_t);
+    std::uint8_t not8(std::uint8_t);
+    std::uint16_t not16(std::uint16_t);
+    std::uint32_t not32(std::uint32_t);
 
-    std::uint16_t sar16(std::uint16_t, std::uint16_t=1);
-    std::uint32_t sar32(std::uint32_t, std::uint32_t=1);
+    // Shifts and rotates take the raw count; it is masked to five bits as
+    // on a 386, and a masked count of zero leaves the flags alone.
+    std::uint8_t rcl8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t rcl16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t rcl32(std::uint32_t, std::uint8_t=1);
+    std::uint8_t rcr8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t rcr16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t rcr32(std::uint32_t, std::uint8_t=1);
+    std::uint8_t rol8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t rol16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t rol32(std::uint32_t, std::uint8_t=1);
+    std::uint8_t ror8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t ror16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t ror32(std::uint32_t, std::uint8_t=1);
+    std::uint8_t sar8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t sar16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t sar32(std::uint32_t, std::uint8_t=1);
     std::uint16_t sar16_u(std::uint16_t);
     std::uint32_t sar32_u(std::uint32_t);
+    std::uint8_t shl8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t shl16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t shl32(std::uint32_t, std::uint8_t=1);
+    std::uint8_t shr8(std::uint8_t, std::uint8_t=1);
+    std::uint16_t shr16(std::uint16_t, std::uint8_t=1);
+    std::uint32_t shr32(std::uint32_t, std::uint8_t=1);
+    // Double precision shifts of the first operand, filling from the second.
+    std::uint16_t shld16(std::uint16_t, std::uint16_t, std::uint8_t);
+    std::uint32_t shld32(std::uint32_t, std::uint32_t, std::uint8_t);
+    std::uint16_t shrd16(std::uint16_t, std::uint16_t, std::uint8_t);
+    std::uint32_t shrd32(std::uint32_t, std::uint32_t, std::uint8_t);
 
     void hlt();
 
@@ -134,13 +224,18 @@ public:
     // I don't know how to categorise this fucker.
     void salc();
 
+    // Fill EAX, EBX, ECX and EDX from model for the leaf in EAX and
+    // subleaf in ECX.
+    void cpuid(const CpuidModel& model);
     void rdtsc();
 
     void test8(std::uint8_t, std::uint8_t);
+    void test16(std::uint16_t, std::uint16_t);
+    void test32(std::uint32_t, std::uint32_t);
 
     void xchg(std::uint32_t&);
 
-    void xlat();
+    void xlat(Segment seg=Segment::DS);
 public:
 // LCOV_EXCL_START
     friend std::ostream& operator<<(std::ostream& os, const CPU& cpu) {
@@ -0,0 +1,52 @@
+#ifndef CPUID_HH
+#define CPUID_HH
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// What CPUID tells the guest. Guest libraries pick their memcpy, string and
+// maths routines from these bits, so the default reports exactly what the
+// executor implements and nothing more. A model can still be narrowed to
+// steer a guest onto its generic paths, or widened for testing.
+struct CpuidModel {
+    // Leaf 1 EDX.
+    static constexpr std::uint32_t FPU = 1u << 0;
+    static constexpr std::uint32_t TSC = 1u << 4;
+    static constexpr std::uint32_t CMOV = 1u << 15;
+    static constexpr std::uint32_t MMX = 1u << 23;
+    static constexpr std::uint32_t SSE = 1u << 25;
+    static constexpr std::uint32_t SSE2 = 1u << 26;
+
+    // Leaf 1 ECX.
+    static constexpr std::uint32_t SSE4_2 = 1u << 20;
+    static constexpr std::uint32_t POPCNT = 1u << 23;
+
+    // Leaf 0x80000001 ECX.
+    static constexpr std::uint32_t LZCNT = 1u << 5;
+
+    // Twelve characters, returned in EBX, EDX and ECX of leaf 0.
+    std::string vendor = "GenuineIntel";
+    // Up to 48 characters, returned by leaves 0x80000002 to 0x80000004.
+    std::string brand = "pix86";
+    std::uint8_t family = 6;
+    std::uint8_t model = 0;
+    std::uint8_t stepping = 0;
+    std::uint32_t features_edx = 0;
+    std::uint32_t features_ecx = 0;
+    std::uint32_t extended_features_ecx = 0;
+
+    // The features this build of the executor implements.
+    static CpuidModel implemented();
+    // implemented() plus SSE, SSE2 and SSE4.2, the only way a guest that
+    // checks CPUID reaches the packed SSE2 and PCMPxSTRx paths. The scalar
+    // forms, conversions and MXCSR loads are still missing and stop the
+    // guest as unhandled opcodes.
+    static CpuidModel with_simd();
+
+    // EAX, EBX, ECX and EDX for a leaf. Leaves past the last one reported
+    // read as zero.
+    std::array<std::uint32_t, 4> query(std::uint32_t leaf, std::uint32_t subleaf = 0) const;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "cpu.hh"
 #include "memory.hh"
+#include "mmu.hh"
 #include "util.hh"
 #include "generic_reference.hh"
 
@@ -28,6 +29,16 @@ struct isRegDest {
 template <std::uint8_t Opcode>
 static constexpr bool isRegDest_v = isRegDest<Opcode>::value;
 
+// Whether the rm operand is stored to. cmp only reads it, whichever way round
+// the operands are encoded.
+template <std::uint8_t Opcode>
+struct isRmWritten {
+    static constexpr bool value = !isRegDest_v<Opcode> && Opcode != 0x38 && Opcode != 0x39;
+};
+
+template <std::uint8_t Opcode>
+static constexpr bool isRmWritten_v = isRmWritten<Opcode>::value;
+
 std::tuple<unsigned int, unsigned int, unsigned int> split_modregrm(std::uint8_t);
 std::tuple<unsigned int, unsigned int, unsigned int> split_sib(std::uint8_t);
 
@@ -140,14 +151,43 @@ struct StructuredOperands {
     }
 };
 
+// Offset of a memory rm operand within its segment.
+inline std::uint32_t effective_address(const std::uint32_t (&R)[8], const Operands& op) {
+    std::uint32_t address = op.rm.displacement;
+    if (op.rm.reg_field) {
+        // Implies that there is no SIB bollockery.
+        address += R[op.rm.reg];
+    } else {
+        // Here there be the cursed SIB bollockery.
+        if (op.rm.has_base) {
+            address += R[op.rm.base];
+        }
+        // Neither a bare disp32 nor a SIB index of 100 has an index.
+        if (op.rm.has_index) {
+            address += op.rm.scale*R[op.rm.index];
+        }
+    }
+    return address;
+}
+
+// Segment a memory rm operand uses when there is no override prefix.
+inline Segment default_segment(const Operands& op) {
+    const bool stack_based = (op.rm.reg_field && (op.rm.reg == ESP || op.rm.reg == EBP))
+        || (op.rm.has_base && (op.rm.base == ESP || op.rm.base == EBP));
+    return stack_based ? Segment::SS : Segment::DS;
+}
+
 // Fuck's sake, somehow I knew that there would be excessive template twattery somewhere
 // in this fucking codebase!
 // Like genuinely in an earlier attempt at this fucking ridiculous undertaking which I am
 // nowhere near experienced to do, I wrote the entirety of the modregrm decoding code using
 // templates which went as about as well as invading the Soviet fucking Union and still
 // being there in the fucking winter.
+//
+// host is the already translated location of a memory rm operand and is
+// ignored when rm names a register.
 template <typename I>
-StructuredOperands<I> structure_operands(std::uint32_t (&R)[8], Memory& mem, const Operands& op) {
+StructuredOperands<I> structure_operands(std::uint32_t (&R)[8], std::uint8_t* host, const Operands& op) {
     StructuredOperands<I> so;
 
     if constexpr (std::is_same_v<I, std::uint8_t>) {      
@@ -163,18 +203,7 @@ StructuredOperands<I> structure_operands(std::uint32_t (&R)[8], Memory& mem, con
     }
     if (op.rm.is_ptr) {
         so.is_rm_ptr = true;
-        std::uint32_t address = op.rm.displacement;
-        if (op.rm.reg_field) {
-            // Implies that there is no SIB bollockery.
-            address += R[op.rm.reg];
-        } else {
-            // Here there be the cursed SIB bollockery.
-            if (op.rm.has_base) {
-                address += R[op.rm.base];
-            }
-            address += op.rm.scale*R[op.rm.index];
-        }
-        so.rm.m = GenericMemoryReference<I>(&mem[address]);
+        so.rm.m = GenericMemoryReference<I>(host);
     } else {
         // Implies direct register access.
         so.is_rm_ptr = false;
@@ -195,23 +224,17 @@ StructuredOperands<I> structure_operands(std::uint32_t (&R)[8], Memory& mem, con
 }
 
 template <typename I>
-StructuredUnaryOperands<I> structure_unary_operands(std::uint32_t (&R)[8], Memory& mem, const Operands& op) {
+StructuredOperands<I> structure_operands(std::uint32_t (&R)[8], Memory& mem, const Operands& op) {
+    return structure_operands<I>(R, op.rm.is_ptr ? mem.ptr(effective_address(R, op), sizeof(I)) : nullptr, op);
+}
+
+template <typename I>
+StructuredUnaryOperands<I> structure_unary_operands(std::uint32_t (&R)[8], std::uint8_t* host, const Operands& op) {
     StructuredUnaryOperands<I> so;
 
     if (op.rm.is_ptr) {
         so.is_rm_ptr = true;
-        std::uint32_t address = op.rm.displacement;
-        if (op.rm.reg_field) {
-            // Implies that there is no SIB bollockery.
-            address += R[op.rm.reg];
-        } else {
-            // Here there be the cursed SIB bollockery.
-            if (op.rm.has_base) {
-                address += R[op.rm.base];
-            }
-            address += op.rm.scale*R[op.rm.index];
-        }
-        so.rm.m = GenericMemoryReference<I>(&mem[address]);
+        so.rm.m = GenericMemoryReference<I>(host);
     } else {
         // Implies direct register access.
         so.is_rm_ptr = false;
@@ -230,4 +253,9 @@ StructuredUnaryOperands<I> structure_unary_operands(std::uint32_t (&R)[8], Memor
     return so;
 }
 
+template <typename I>
+StructuredUnaryOperands<I> structure_unary_operands(std::uint32_t (&R)[8], Memory& mem, const Operands& op) {
+    return structure_unary_operands<I>(R, op.rm.is_ptr ? mem.ptr(effective_address(R, op), sizeof(I)) : nullptr, op);
+}
+
 #endif
\ No newline at end of file
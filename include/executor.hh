@@ -5,12 +5,15 @@
 #include "decoder.hh"
 #include "fpu.hh"
 #include "opcode.hh"
+#include "sse.hh"
 
 #include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <span>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include <iostream>
 
@@ -87,15 +90,153 @@ struct Holder {
     };
 */
 
+// Why execute() handed control back to the caller.
+enum class ExitReason {
+    CYCLES,     // the requested number of instructions retired
+    WATCHPOINT, // an instruction stored into a watched range, see cpu.mmu.watch_hit
+    SYSCALL     // int 0x80 with pc past it, for the caller to service and resume
+};
+
+// String instruction repeat prefix. REPE is also the plain REP of MOVS, STOS
+// and LODS, which share its F3 encoding.
+enum class RepPrefix {
+    NONE,
+    REPE,
+    REPNE
+};
+
+class Executor;
+
+// Native stand in for a guest function, called with the guest stack as the
+// function would see it (return address at [esp]) and returning what goes
+// in EAX.
+using Hook = std::uint32_t(*)(Executor&);
+
 class Executor {
+private:
+    std::unordered_map<address_t, Hook> hooks_;
+
+    bool run_hook();
+    // Retire the remaining iterations of the counted loop [head, end) in one
+    // native operation when it matches a known idiom, leaving pc at end.
+    bool run_loop_idiom(address_t head, address_t end, bool is_cycles, unsigned int& cycles);
+    // Host view of the DS relative range [offset, offset + length), or nullptr
+    // when any of it is out of bounds or, for stores, overlaps [head, end).
+    std::uint8_t* idiom_range(address_t offset, std::uint64_t length, address_t head, address_t end, bool store);
+    // Host view of seg:[offset, offset + length) for bulk operations, or
+    // nullptr unless all of it is in bounds and the MMU lets access through
+    // to it directly.
+    std::uint8_t* bulk_range(Segment seg, address_t offset, std::uint64_t length, std::uint8_t access);
+
+    // MOVS, STOS and LODS with element type I. Under REP a DF=0 run whose
+    // ranges are in bounds is done with one memmove or fill, anything else
+    // an element at a time through the MMU.
+    template <typename I> void execute_movs();
+    template <typename I> void execute_stos();
+    template <typename I> void execute_lods();
+
+    // Run the 0F opcode as SSE or SSE2, or return false when it is not one
+    // this executor implements. 66 doubles as the mandatory prefix of the
+    // SSE2 forms and F3 as that of movdqu and movq.
+    bool execute_sse(std::uint8_t opcode);
+
+    // 66 0F 3A 60-63: PCMPESTRM, PCMPESTRI, PCMPISTRM and PCMPISTRI.
+    void execute_string_compare(std::uint8_t opcode);
+
+    // Run the unprefixed 0F opcode as MMX, or return false when it is not
+    // one. The registers are the significands of the x87 ones in fpu.
+    bool execute_mmx(std::uint8_t opcode);
+    // mm op= mm/m64.
+    void execute_mmx_binary(void (*op)(Mmx&, const Mmx&), Opcode);
+    // 0F 71/72/73: the shifts of mm by imm8, or false for a memory operand
+    // or a reg field with no MMX shift.
+    bool execute_mmx_shift_imm(std::uint8_t opcode);
+    // 0F 6E/6F/7E/7F: movd and movq to and from an MMX register.
+    void execute_mmx_move(std::uint8_t opcode);
+
+    // Host bytes of a width byte memory operand. The aligned forms raise #GP
+    // on an address that is not 16 byte aligned.
+    std::uint8_t* xmm_operand_host(const Operands&, std::uint8_t access, std::size_t width, bool aligned);
+
+    // xmm op= xmm/m128.
+    void execute_sse_binary(void (SSE::*op)(Xmm&, const Xmm&), Opcode);
+    // movups/movaps/movdqu/movdqa and friends, in either direction.
+    void execute_sse_move(bool store, bool aligned, Opcode);
+    // 66 0F 6E/7E, F3 0F 7E and 66 0F D6.
+    void execute_movd_movq(std::uint8_t opcode);
+
+    // Where a shift or rotate takes its count from.
+    enum class ShiftCount {IMM8, ONE, CL};
+
+    // Read the count, moving next past an immediate.
+    std::uint8_t shift_count(ShiftCount, unsigned long int& next);
+
+    // The C0/C1 and D0-D3 groups on an rm of type I.
+    template <typename I> void execute_shift_group(ShiftCount);
+
+    // SHLD (left) or SHRD of rm, filling from reg.
+    void execute_double_shift(bool left, ShiftCount);
+
+    // BT (op 0), BTS, BTR or BTC of rm, with the bit offset in reg or in an
+    // imm8 after the modrm bytes.
+    template <typename I> void execute_bit_test(unsigned int op, bool is_immediate);
+
+    void execute_bit_test(const unsigned int op, const bool is_immediate = false) {
+        if (is_16_bit_mode) {
+            execute_bit_test<std::uint16_t>(op, is_immediate);
+        } else {
+            execute_bit_test<std::uint32_t>(op, is_immediate);
+        }
+    }
+
+    // The F6 and F7 group on an rm of type I: test, not, neg, and the
+    // widening mul, imul, div and idiv on the accumulator.
+    template <typename I> void execute_unary_group();
+
+    // SCAS and CMPS with element type I. REPE and REPNE byte runs with DF=0
+    // are searched a guest page at a time by the kernels in
+    // string_kernels.hh, everything else an element at a time.
+    template <typename I> void execute_scas();
+    template <typename I> void execute_cmps();
+    // Host view of seg:offset through the MMU and, in length, how many of
+    // the next count bytes follow it before a page or segment boundary.
+    const std::uint8_t* string_chunk(Segment seg, address_t offset, std::uint32_t count, std::size_t& length);
+    // Whether the flags of the last compare end a REPE or REPNE run.
+    bool rep_done() const {
+        return rep_prefix == RepPrefix::REPE ? !cpu.flags.zero : cpu.flags.zero;
+    }
 public:
     CPU cpu{1024};
     FPU fpu;
     unsigned long int pc = 0;
     bool is_16_bit_mode = false;
+    std::optional<Segment> segment_override;
+    RepPrefix rep_prefix = RepPrefix::NONE;
+    SSE sse;
+    // What CPUID reports. Configuration rather than state, so reset keeps it.
+    CpuidModel cpuid_model = CpuidModel::implemented();
 
     void reset_prefixes() {
         is_16_bit_mode = false;
+        segment_override.reset();
+        rep_prefix = RepPrefix::NONE;
+    }
+
+    Segment data_segment(const Operands& op) const {
+        return segment_override.value_or(default_segment(op));
+    }
+
+    // Host location of a memory rm operand after segmentation and paging, or
+    // nullptr when rm names a register.
+    std::uint8_t* operand_host(const Operands& op, const std::uint8_t access, const std::size_t width) {
+        if (!op.rm.is_ptr) {
+            return nullptr;
+        }
+        return cpu.mmu.translate(data_segment(op), effective_address(cpu.R, op), access, width);
+    }
+
+    std::size_t operand_width() const {
+        return is_16_bit_mode ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
     }
 
     template <std::uint8_t Opcode>
@@ -103,7 +244,8 @@ public:
         std::uint8_t mrr = cpu.mem[pc + 1];
         const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, true);
         {
-            auto so = structure_operands<std::uint8_t>(cpu.R, cpu.mem, ops);
+            auto* host = operand_host(ops, isRmWritten_v<Opcode> ? MMU::WRITE : MMU::READ, sizeof(std::uint8_t));
+            auto so = structure_operands<std::uint8_t>(cpu.R, host, ops);
             binary_operation<std::uint8_t>(so, cpu, op, isRegDest_v<Opcode>);
         }
         pc += skip;
@@ -116,11 +258,12 @@ public:
         
         std::uint8_t mrr = cpu.mem[pc + 1];
         const auto [op, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+        auto* host = operand_host(op, isRmWritten_v<Opcode> ? MMU::WRITE : MMU::READ, operand_width());
         if (is_16_bit_mode) {
-            auto so = structure_operands<std::uint16_t>(cpu.R, cpu.mem, op);
+            auto so = structure_operands<std::uint16_t>(cpu.R, host, op);
             binary_operation<std::uint16_t>(so, cpu, op16, isRegDest_v<Opcode>);
         } else {
-            auto so = structure_operands<std::uint32_t>(cpu.R, cpu.mem, op);
+            auto so = structure_operands<std::uint32_t>(cpu.R, host, op);
             binary_operation<std::uint32_t>(so, cpu, op32, isRegDest_v<Opcode>);
         }
         pc += skip;
@@ -163,15 +306,46 @@ public:
     Executor(std::span<const std::uint8_t> code,
              const std::size_t mem_size = 1_mb,
              const std::size_t stack_size = 1_mb,
-             const unsigned long int start = 0) : cpu(mem_size, stack_size) fpu(cpu.flags) {
+             const unsigned long int start = 0) : cpu(mem_size, stack_size), fpu(cpu.flags) {
+        load(code, start);
+    }
+
+    Executor(Executor&& other) noexcept
+        : hooks_(std::move(other.hooks_)), cpu(std::move(other.cpu)), fpu(cpu.flags, other.fpu), pc(other.pc),
+          is_16_bit_mode(other.is_16_bit_mode), segment_override(other.segment_override),
+          rep_prefix(other.rep_prefix), sse(other.sse), cpuid_model(std::move(other.cpuid_model)) {}
+
+    // Copy code into guest memory at start and point pc at it.
+    void load(std::span<const std::uint8_t> code, const unsigned long int start = 0) {
         if (start > cpu.mem.size() || (start + code.size()) > cpu.mem.size())
             throw std::domain_error("Invalid constructor arguments for constructor Executor");
         std::copy(code.begin(), code.end(), cpu.mem.begin() + start);
         pc = start;
     }
 
-    void execute(bool, bool, unsigned int = 0, unsigned int start = 0);
-    void run_single_cycle(bool=false);
+    // Return to the state of a freshly constructed Executor with no code.
+    void reset() {
+        cpu.reset();
+        fpu.reset();
+        sse.reset();
+        pc = 0;
+        reset_prefixes();
+        hooks_.clear();
+    }
+
+    // Run hook in place of the guest function at entry, then return to the
+    // caller as a near ret would. Only pages holding an entry are looked up,
+    // so executors without hooks never touch the table.
+    void add_hook(address_t entry, Hook hook);
+    void remove_hook(address_t entry);
+
+    // The index'th 32 bit cdecl argument of a hooked function.
+    std::uint32_t cdecl_arg(const std::size_t index) const {
+        return mread<std::uint32_t>(cpu.mem.checked_ptr(cpu.R[ESP] + 4 * (index + 1), sizeof(std::uint32_t)));
+    }
+
+    ExitReason execute(bool, bool, unsigned int = 0, unsigned int start = 0);
+    ExitReason run_single_cycle(bool=false);
 };
 
 using CPU_op8_t = std::uint8_t(CPU::*)(std::uint8_t, std::uint8_t);
@@ -0,0 +1,35 @@
+#ifndef EXECUTOR_POOL_HH
+#define EXECUTOR_POOL_HH
+
+#include "constants.hh"
+#include "executor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Recycles Executors for batch runs of many small programs. Returned
+// executors are reset rather than destroyed, so the next acquire skips the
+// guest memory mapping and only pays for zeroing the pages the previous
+// program touched.
+class ExecutorPool {
+private:
+    std::vector<Executor> free_;
+    std::size_t mem_size_;
+    std::size_t stack_size_;
+public:
+    ExecutorPool(std::size_t count = 0, std::size_t mem_size = 1_mb, std::size_t stack_size = 1_mb);
+
+    // An executor with code loaded at start, taken from the pool when one is
+    // available and freshly constructed otherwise.
+    Executor acquire(std::span<const std::uint8_t> code, unsigned long int start = 0);
+
+    // Reset ex and keep it for a later acquire. Executors whose memory or
+    // stack size differs from the pool's are dropped.
+    void release(Executor&& ex);
+
+    std::size_t available() const noexcept {return free_.size();}
+};
+
+#endif
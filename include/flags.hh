@@ -54,9 +54,9 @@ public:
                         std::uint32_t,
                         std::uint32_t);
     
-    void set_imul_s_flags(std::uint32_t,
-                          std::uint32_t,
-                          std::uint32_t);
+    // CF and OF of a widening multiply: whether the upper half of the
+    // product carries anything the lower half does not.
+    void set_mul_flags(bool);
 
     void set_inc_flags(std::uint32_t,
                        std::uint32_t);
@@ -65,13 +65,16 @@ public:
                       std::uint32_t,
                       std::uint32_t);
 
+    void set_rotate_flags(bool,
+                          bool);
+
     void set_sbb_flags(std::uint32_t,
                        std::uint32_t,
                        std::uint32_t);
 
-    void set_sar_flags(std::uint32_t,
-                       std::uint32_t,
-                       std::uint32_t);
+    void set_shift_flags(std::uint32_t,
+                         bool,
+                         bool);
 
     void set_sub_flags(std::uint32_t,
                        std::uint32_t,
@@ -2,30 +2,103 @@
 #define FPU_HH
 
 #include "flags.hh"
+#include "mmx.hh"
 #include "types.hh"
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <tuple>
+#include <type_traits>
 
 class FPU_Registers {
 private:
     std::array<long double, 8> data_;
+    // Holds the stack instead of data_ while is_double_.
+    std::array<double, 8> fast_;
     std::array<unsigned int, 8> tags_;
+    bool is_double_ = false;
+
+    // Slot of ST(index). The stack grows upward through the slots, so slot
+    // i is physical register 7 - i.
+    std::size_t slot(const index_t index) const {
+        return (top_ - 1 - index) % 8;
+    }
 public:
+    // Pushes less pops, modulo 8: the architectural TOP is (8 - top_) % 8.
+    // 0 and 8 both mean TOP = 0, which is an empty stack or, with every
+    // register tagged valid as MMX code leaves it, a full one.
     unsigned int top_ = 0;
     void push(const long double);
+    void push(const double);
     void pop();
-    long double& st(const index_t);
+
+    // ST(index) in the storage F the stack is currently held in.
+    template <typename F = long double>
+    F& st(const index_t index) {
+        if constexpr (std::is_same_v<F, double>) {
+            return fast_[slot(index)];
+        } else {
+            static_assert(std::is_same_v<F, long double>);
+            return data_[slot(index)];
+        }
+    }
+
+    // ST(index) read from whichever storage holds it.
+    long double value(const index_t) const;
     unsigned int& tag(const index_t);
+
+    bool is_double() const {return is_double_;}
+    // Move all eight registers into double or back into long double
+    // storage. Going to double rounds away anything past 53 bits.
+    void use_double(bool);
+
+    // MMX register index, which is the significand of physical register
+    // index. Writing one sets that register's exponent bits to all ones.
+    Mmx mm(index_t) const;
+    void set_mm(index_t, const Mmx&);
+    // Every MMX instruction but EMMS marks all eight registers valid and
+    // sets TOP to 0.
+    void enter_mmx();
+    // EMMS, marking all eight registers empty.
+    void empty();
 };
 
 class FPU {
 public:
     FPU_Registers V;
+
+    // Precision control, bits 8 and 9 of the control word.
+    enum class Precision : std::uint8_t {
+        SINGLE = 0,
+        DOUBLE = 2,
+        EXTENDED = 3,
+    };
+
+    static constexpr std::uint16_t DEFAULT_CONTROL = 0x037F;
 private:
     unsigned int c3 = 0, c2 = 0, c1 = 0, c0 = 0;
-    int rc = 0;
+    std::uint16_t control_ = DEFAULT_CONTROL;
+    bool double_mode_ = false;
     Flags& flags;
+
+    // Whether the stack is computed on as double: in double mode, while the
+    // guest has not asked for extended precision.
+    bool computes_in_double() const {
+        return double_mode_ && precision() != Precision::EXTENDED;
+    }
+
+    // Run op<double> or op<long double> on the stack, moving it into the
+    // matching storage first, with the host rounding as RC says.
+    template <typename Op>
+    void dispatch(const Op& op);
+    // A sum, difference, product, quotient or root rounded to PC.
+    template <typename F>
+    F to_precision(F) const;
+    template <typename F>
+    void compare(F, F);
+    // ST(0) = ST(i), for the FCMOVs.
+    void fsti_from(unsigned int);
 public:
 
     auto c_vals() const {
@@ -34,6 +107,28 @@ public:
 
     FPU(Flags& flags_) : flags(flags_) {}
 
+    // Take over other's state while reporting to a different Flags, for when
+    // the owning CPU has been moved.
+    FPU(Flags& flags_, const FPU& other)
+        : V(other.V), c3(other.c3), c2(other.c2), c1(other.c1), c0(other.c0), control_(other.control_),
+          double_mode_(other.double_mode_), flags(flags_) {}
+
+    void reset();
+
+    // FLDCW and FNSTCW. Of the control word only PC and RC change results;
+    // exceptions stay masked whatever it says.
+    std::uint16_t control() const {return control_;}
+    void set_control(std::uint16_t);
+    Precision precision() const {return Precision((control_ >> 8) & 3);}
+    // The RC field as a <cfenv> rounding direction.
+    int rounding() const;
+
+    // Opt in to keeping the stack in double and computing with the host's
+    // SSE2 rather than x87, which rounds every result to at most 53 bits.
+    // Guests that ask for extended precision still get the 80 bit stack.
+    void set_double_mode(bool);
+    bool double_mode() const {return double_mode_;}
+
     void f2xm1();
     void fabs();
     void fadd(unsigned int);
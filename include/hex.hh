@@ -0,0 +1,38 @@
+#ifndef HEX_HH
+#define HEX_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The whitespace separated hex program format: each token is one or two hex
+// digits with an optional 0x prefix, and '#' or ';' start a comment running
+// to the end of the line. Malformed tokens throw std::domain_error giving
+// their offset in the text.
+
+// Parse text into out and return the number of bytes written. Throws
+// std::domain_error if out is too small.
+std::size_t parse_hex(std::string_view text, std::span<std::uint8_t> out);
+
+std::vector<std::uint8_t> parse_hex(std::string_view text);
+
+// A whole file mapped read only, for parsing without copying it first.
+class MappedFile {
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::string_view view() const noexcept {return {data_, size_};}
+};
+
+std::vector<std::uint8_t> read_hex_file(const std::string& path);
+
+#endif
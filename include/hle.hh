@@ -0,0 +1,18 @@
+#ifndef HLE_HH
+#define HLE_HH
+
+#include "executor.hh"
+
+#include <cstdint>
+
+// Native versions of hot libc routines for Executor::add_hook. Each follows
+// the cdecl signature of the C function it replaces and reaches guest
+// memory a page at a time through the MMU, so its loads and stores fault,
+// hit watchpoints and bump code page generations as the guest's own would.
+// Out of range pointers throw MEMORY_FAULT.
+std::uint32_t hle_memcpy(Executor& ex);
+std::uint32_t hle_memset(Executor& ex);
+std::uint32_t hle_strlen(Executor& ex);
+std::uint32_t hle_strcmp(Executor& ex);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HOST_CPU_HH
+#define HOST_CPU_HH
+
+// The instruction set tiers host kernels are built for, each a superset of
+// the one before it.
+enum class HostIsa {
+    SCALAR,
+    SSE2,
+    SSE4_2,
+    AVX2,
+};
+
+// What the machine running the emulator can execute, as opposed to
+// CpuidModel, which is what the guest is told. Probed once, on first use,
+// so that kernels can be bound to the best variant before any guest runs.
+struct HostCpu {
+    bool sse2 = false;
+    bool sse4_2 = false;
+    bool avx2 = false;
+
+    static const HostCpu& get();
+
+    bool supports(HostIsa isa) const;
+    // The highest tier the host supports.
+    HostIsa best() const;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef LOADER_HH
+#define LOADER_HH
+
+#include "constants.hh"
+#include "executor.hh"
+#include "types.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Map a raw binary image into guest memory at load_address and point pc at
+// it. Page aligned load addresses are mapped MAP_PRIVATE straight from the
+// file, so the image shares the page cache and is only copied page by page
+// as the guest writes to it. Other addresses fall back to reading the file.
+// The MMU is left in flat protected mode. Returns the size of the image.
+std::size_t load_flat_binary(Executor& ex, const std::string& path, address_t load_address = 0);
+
+// Parse a hex text program (see hex.hh) straight from the mapped file into
+// guest memory at load_address and point pc at it. Returns the number of
+// bytes loaded.
+std::size_t load_hex_program(Executor& ex, const std::string& path, address_t load_address = 0);
+
+// Guest memory needed to run a flat image of the given size loaded at
+// load_address, leaving room above it for the stack.
+std::size_t flat_binary_memory_size(std::size_t image_size, address_t load_address);
+
+struct ElfSegment {
+    address_t vaddr;
+    std::size_t memsz;
+    std::size_t filesz;
+    std::size_t offset;
+    // Memory::PAGE_READ, PAGE_WRITE and PAGE_EXEC.
+    std::uint8_t perms;
+};
+
+// What loading needs from a statically linked ELF32 i386 executable.
+struct Elf32Image {
+    std::string path;
+    address_t entry = 0;
+    // Guest address of the program headers, zero if they are not loaded.
+    address_t phdr = 0;
+    std::size_t phnum = 0;
+    std::vector<ElfSegment> segments;
+
+    // First address past the highest segment, page aligned: the initial
+    // program break.
+    address_t end() const;
+};
+
+// Read and validate the headers of an ELF32 i386 executable. Throws
+// std::domain_error for anything else.
+Elf32Image read_elf32(const std::string& path);
+
+// Guest memory needed to load image with stack_size bytes above it.
+std::size_t elf32_memory_size(const Elf32Image& image, std::size_t stack_size = 8_mb);
+
+// Map the PT_LOAD segments of image into guest memory and set their page
+// permissions, then build the initial stack the kernel would: argc, argv,
+// envp and the auxiliary vector, with the strings above them. The file part
+// of each segment is mapped MAP_PRIVATE and faulted in on first touch, and
+// bss needs nothing as guest memory is already zero. pc ends up at the
+// entry point, with the MMU in flat protected mode.
+void load_elf32(Executor& ex, const Elf32Image& image, const std::vector<std::string>& argv,
+                const std::vector<std::string>& envp = {});
+
+#endif
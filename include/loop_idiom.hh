@@ -0,0 +1,31 @@
+#ifndef LOOP_IDIOM_HH
+#define LOOP_IDIOM_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+// Counted loops the executor can retire in one go. Every shape is a loop body
+// closed by dec ecx; jnz back to its head, so ECX is the number of iterations
+// left whenever that jnz is taken.
+enum class LoopIdiom {
+    SPIN,   // dec ecx; jnz
+    FILL8,  // mov [edi], al; inc edi; dec ecx; jnz
+    FILL32, // mov [edi], eax; add edi, 4; dec ecx; jnz
+    COPY8,  // mov al, [esi]; mov [edi], al; inc esi; inc edi; dec ecx; jnz
+    SUM8    // add al, [esi]; inc esi; dec ecx; jnz
+};
+
+struct LoopShape {
+    LoopIdiom idiom;
+    // Instructions retired by one trip around the loop, the jnz included.
+    std::size_t instructions;
+};
+
+// Match the bytes from a loop head up to and including its closing jnz
+// against the known shapes. Bodies are compared byte for byte, so any prefix,
+// other register or other addressing mode is left to the interpreter.
+std::optional<LoopShape> match_loop_idiom(std::span<const std::uint8_t> body);
+
+#endif
@@ -1,47 +1,228 @@
 #ifndef MEMORY_HH
 #define MEMORY_HH
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
+#include "constants.hh"
 #include "types.hh"
 
-class Memory {
+struct MEMORY_FAULT : std::domain_error {
+    std::size_t address;
+    MEMORY_FAULT(std::size_t address_, std::size_t size);
+};
+
+// Access policies decide what an index means before Memory touches its
+// buffer. map returns the offset to use for an access of width bytes.
+//
+// The unchecked policies never branch. Their buffers sit at the start of a
+// reservation spanning the whole 32 bit guest address space, so any index
+// past the end lands on an inaccessible page and faults on the host.
+struct UncheckedAccess {
+    static constexpr bool reserve_address_space = true;
+
+    static std::size_t map(std::size_t index, [[maybe_unused]] std::size_t width,
+                           [[maybe_unused]] std::size_t size) noexcept {
+        return index;
+    }
+};
+
+// Truncates to 32 bits so that sums formed in wider host integers wrap the
+// way guest address arithmetic does.
+struct WrapAccess {
+    static constexpr bool reserve_address_space = true;
+
+    static std::size_t map(std::size_t index, [[maybe_unused]] std::size_t width,
+                           [[maybe_unused]] std::size_t size) noexcept {
+        return address_t(index);
+    }
+};
+
+struct CheckedAccess {
+    static constexpr bool reserve_address_space = false;
+
+    static std::size_t map(std::size_t index, std::size_t width, std::size_t size) {
+        if (index > size || width > size - index) {
+            throw MEMORY_FAULT(index, size);
+        }
+        return index;
+    }
+};
+
+// Guest memory is a single anonymous mapping bracketed by inaccessible guard
+// pages, so running off either end of the buffer faults on the host rather
+// than scribbling over the heap. Fresh mappings are already zero filled.
+template <typename Policy>
+class BasicMemory {
 private:
     std::uint8_t* data_ = nullptr;
     std::size_t size_ = 0;
+    std::vector<std::uint8_t> page_flags_;
+    std::vector<std::uint32_t> generations_;
 public:
-    Memory();
-    Memory(const std::size_t size);
-    ~Memory();
-    
-    std::uint8_t& operator[](const address_t index);
-    const std::uint8_t& operator[](const address_t index) const;
+    // Per guest page bits. PAGE_WATCHED is only consulted on slow paths such
+    // as TLB fills; the permission bits start out all set and are tested on
+    // instruction fetch and folded into TLB entries.
+    static constexpr std::uint8_t PAGE_WATCHED = 1;
+    static constexpr std::uint8_t PAGE_READ = 2;
+    static constexpr std::uint8_t PAGE_WRITE = 4;
+    static constexpr std::uint8_t PAGE_EXEC = 8;
+    static constexpr std::uint8_t PAGE_RWX = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
+    // Something has cached a decode of this page; stores bump its generation.
+    static constexpr std::uint8_t PAGE_CODE = 16;
+    // An Executor hook entry point lies in this page.
+    static constexpr std::uint8_t PAGE_HOOK = 32;
+
+    BasicMemory();
+    BasicMemory(const std::size_t size);
+    BasicMemory(const BasicMemory& other);
+    // Moves hand over the mapping itself, so pointers into it stay valid.
+    BasicMemory(BasicMemory&& other) noexcept;
+    ~BasicMemory();
+
+    // Pointer to width bytes at index, after the policy has had its say.
+    std::uint8_t* ptr(const std::size_t index, const std::size_t width = 1) {
+        return data_ + Policy::map(index, width, size_);
+    }
+
+    const std::uint8_t* ptr(const std::size_t index, const std::size_t width = 1) const {
+        return data_ + Policy::map(index, width, size_);
+    }
+
+    // As ptr but always bounds checked, whatever the policy.
+    std::uint8_t* checked_ptr(const std::size_t index, const std::size_t width = 1) {
+        return data_ + CheckedAccess::map(index, width, size_);
+    }
+
+    const std::uint8_t* checked_ptr(const std::size_t index, const std::size_t width = 1) const {
+        return data_ + CheckedAccess::map(index, width, size_);
+    }
+
+    std::uint8_t& operator[](const address_t index) {
+        return *ptr(index);
+    }
+
+    const std::uint8_t& operator[](const address_t index) const {
+        return *ptr(index);
+    }
+
+    std::uint8_t& at(const address_t index) {
+        return *checked_ptr(index);
+    }
 
-    std::uint8_t& at(const address_t index);
-    const std::uint8_t& at(const address_t index) const;
+    const std::uint8_t& at(const address_t index) const {
+        return *checked_ptr(index);
+    }
 
     operator bool() const noexcept;
     std::size_t size() const noexcept;
-    std::uint8_t* data() noexcept;
-    std::uint8_t* begin() noexcept;
-    std::uint8_t* end() noexcept;
-
-    Memory& operator=(const Memory& other) {
-        if (this != &other) {
-            std::uint8_t* ptr = new std::uint8_t[size_];
-            std::copy(other.data_, other.data_ + size_, ptr);
-            delete[] data_;
-            data_ = ptr;
-            size_ = other.size_;
+
+    std::uint8_t* data() noexcept {return data_;}
+    const std::uint8_t* data() const noexcept {return data_;}
+    std::uint8_t* begin() noexcept {return data_;}
+    std::uint8_t* end() noexcept {return data_ + size_;}
+
+    std::uint8_t page_flags(const address_t address) const {
+        return page_flags_[address >> guest_page_shift];
+    }
+
+    void set_page_flags(const address_t address, const std::uint8_t flags) {
+        page_flags_[address >> guest_page_shift] |= flags;
+    }
+
+    void clear_page_flags(const address_t address, const std::uint8_t flags) {
+        page_flags_[address >> guest_page_shift] &= std::uint8_t(~flags);
+    }
+
+    bool any_page_flags(const std::uint8_t flags) const {
+        return std::any_of(page_flags_.begin(), page_flags_.end(), [flags](std::uint8_t f) {return f & flags;});
+    }
+
+    bool all_page_flags(const std::uint8_t flags) const {
+        return std::all_of(page_flags_.begin(), page_flags_.end(), [flags](std::uint8_t f) {return (f & flags) == flags;});
+    }
+
+    // Replace the R/W/X bits of every page overlapping [address, address +
+    // length). While an MMU is attached go through MMU::protect instead, so
+    // that its TLB sees the change.
+    void set_page_perms(address_t address, std::size_t length, std::uint8_t perms);
+
+    // Write generation of the page holding address. A decode cached along
+    // with the generations of the pages it read is still valid while they
+    // all match.
+    std::uint32_t page_generation(const address_t address) const {
+        return generations_[address >> guest_page_shift];
+    }
+
+    // Flag the pages overlapping [address, address + length) as holding
+    // cached code. While an MMU is attached go through MMU::mark_code.
+    void mark_code(address_t address, std::size_t length);
+
+    // Called by store paths for width bytes at address. Costs one bit test
+    // unless a touched page holds cached code.
+    void note_write(const std::size_t address, const std::size_t width) noexcept {
+        // The last byte of an empty write would wrap below address.
+        if (!width) {
+            return;
         }
-        return *this;
+        const std::size_t first = address >> guest_page_shift;
+        const std::size_t last = (address + width - 1) >> guest_page_shift;
+        for (std::size_t page = first; page <= last && page < page_flags_.size(); ++page) {
+            if (page_flags_[page] & PAGE_CODE) {
+                ++generations_[page];
+            }
+        }
+    }
+
+    // Flags of the page holding address, or none at all past the end of
+    // memory. For the fetch path, which tests several bits at once.
+    std::uint8_t fetch_flags(const std::size_t address) const noexcept {
+        const std::size_t page = address >> guest_page_shift;
+        return page < page_flags_.size() ? page_flags_[page] : 0;
+    }
+
+    // False past the end of memory as well as on pages without PAGE_EXEC.
+    bool can_execute(const std::size_t address) const noexcept {
+        const std::size_t page = address >> guest_page_shift;
+        return page < page_flags_.size() && (page_flags_[page] & PAGE_EXEC);
     }
 
+    // Host page granularity of the mapping, which the calls below work in.
+    static std::size_t page_size() noexcept;
+
+    // Offsets of the host pages in the buffer that have been faulted in.
+    std::vector<std::size_t> touched_pages() const;
+
+    // Map length bytes of the file open as fd, from file_offset on, into the
+    // buffer at address with MAP_PRIVATE. Pages come from the page cache and
+    // are only copied when the guest first stores to them. address and
+    // file_offset must be host page aligned.
+    void map_file(int fd, std::size_t file_offset, address_t address, std::size_t length);
+
+    // Hand the pages in [offset, offset + length) back to the host. They read
+    // as zero afterwards and are faulted in afresh on the next store. Throws
+    // std::system_error if the host refuses, e.g. for an unaligned offset.
+    void discard_pages(std::size_t offset, std::size_t length);
+
+    // Let the host merge identical pages of this buffer with those of other
+    // mergeable mappings, copying them apart again on write. False when the
+    // host does not support it.
+    bool advise_mergeable();
+
+    // Hand every page back to the host, file mappings included, so the
+    // buffer reads as zero, and reset all page flags. Lets a buffer be
+    // recycled without a memset of its full size.
+    void zero_dirty_pages();
+
+    BasicMemory& operator=(const BasicMemory& other);
+    BasicMemory& operator=(BasicMemory&& other) noexcept;
 
 // LCOV_EXCL_START
-    friend std::ostream& operator<<(std::ostream& os, const Memory& mem) {
+    friend std::ostream& operator<<(std::ostream& os, const BasicMemory& mem) {
         os << "{Memory: ";
         for (std::size_t i = 0; i < mem.size_; ++i) {
             os << int(mem.data_[i]) << ' ';
@@ -52,4 +233,16 @@ public:
 // LCOV_EXCL_STOP
 };
 
-#endif
\ No newline at end of file
+extern template class BasicMemory<UncheckedAccess>;
+extern template class BasicMemory<WrapAccess>;
+extern template class BasicMemory<CheckedAccess>;
+
+// Validation builds check every guest access; release builds lean on the
+// guard pages instead.
+#ifdef PIX86_CHECKED_MEMORY
+using Memory = BasicMemory<CheckedAccess>;
+#else
+using Memory = BasicMemory<UncheckedAccess>;
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef MMU_HH
+#define MMU_HH
+
+#include "memory.hh"
+#include "types.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Architectural segment register encoding, as used by the reg field of
+// mov Sreg and by segment override prefixes.
+enum class Segment : unsigned int {ES, CS, SS, DS, FS, GS};
+
+struct GP_FAULT {unsigned int selector;};
+struct PAGE_FAULT {address_t address; std::uint32_t error_code;};
+
+// Translates segment:offset pairs to host pointers into guest memory.
+//
+// Each segment register keeps a cached base and limit which is only refreshed
+// when the register is reloaded, and linear addresses are mapped through a
+// direct mapped TLB of host page pointers when paging is enabled. With paging
+// off the linear address indexes guest memory directly.
+//
+// Write watchpoints piggyback on the TLB: once any are set every access goes
+// through it, and pages flagged PAGE_WATCHED in Memory are never cached with
+// write permission, so only stores to those pages reach the range check.
+// Watchpoints are on guest physical addresses and do not see push/pop.
+// Page permissions from protect and stores to code pages from mark_code are
+// handled through TLB entries the same way.
+class MMU {
+public:
+    static constexpr std::uint8_t READ = 1;
+    static constexpr std::uint8_t WRITE = 2;
+
+    // Page fault error code for fetching from a page without PAGE_EXEC.
+    static constexpr std::uint32_t FETCH_FAULT = 0x11;
+
+    static constexpr unsigned int page_shift = guest_page_shift;
+    static constexpr address_t page_mask = (1u << page_shift) - 1;
+    static constexpr std::size_t tlb_entries = 256;
+
+    static constexpr std::uint32_t CR0_PE = 1u;
+    static constexpr std::uint32_t CR0_PG = 1u << 31;
+
+    struct SegmentCache {
+        address_t base = 0;
+        address_t limit = 0xFFFFFFFF;
+    };
+
+    struct TLBEntry {
+        address_t page = invalid_page;
+        std::uint8_t* host = nullptr;
+        std::uint8_t perms = 0;
+    };
+
+    struct DescriptorTable {
+        address_t base = 0;
+        std::uint16_t limit = 0;
+    };
+
+    struct Watchpoint {
+        address_t address;
+        std::size_t length;
+    };
+
+    struct WatchHit {
+        address_t address;
+        std::size_t width;
+    };
+
+private:
+    // Never a valid page number as linear pages only span 20 bits.
+    static constexpr address_t invalid_page = 0xFFFFFFFF;
+
+    Memory* mem_;
+    std::array<SegmentCache, 6> segments_{};
+    std::array<TLBEntry, tlb_entries> tlb_{};
+    std::uint32_t cr0_ = 0;
+    std::uint32_t cr3_ = 0;
+    bool paging_ = false;
+    // True when linear addresses index guest memory with nothing in between.
+    bool direct_ = true;
+    // Set while any page lacks read or write permission.
+    bool restricted_ = false;
+    // Set once any page has been flagged PAGE_CODE through mark_code.
+    bool code_pages_ = false;
+    // Set by enter_flat_mode: every selector loads the flat segment.
+    bool flat_selectors_ = false;
+    std::vector<Watchpoint> watchpoints_;
+
+    std::uint8_t* tlb_fill(address_t linear, std::uint8_t access, std::size_t width);
+    // Check and cache the single page holding [linear, linear + width).
+    std::uint8_t* fill_page(address_t linear, std::uint8_t access, std::size_t width);
+    // Page walk for linear, returning the physical frame and its permissions.
+    address_t walk(address_t linear, std::uint8_t access, std::uint8_t& perms);
+    void check_watchpoints(address_t physical, std::size_t width);
+    void update_direct() noexcept;
+
+    // Whether a page with these flags can take access without the TLB: it
+    // grants the access and nothing on it needs to see the access. Watched
+    // and code pages only trap stores, so loads from them still qualify.
+    static bool page_allows(const std::uint8_t flags, const std::uint8_t access) noexcept {
+        static_assert(Memory::PAGE_READ == READ << 1 && Memory::PAGE_WRITE == WRITE << 1);
+        const auto need = std::uint8_t(access << 1);
+        const std::uint8_t traps = (access & WRITE) ? Memory::PAGE_WATCHED | Memory::PAGE_CODE : 0;
+        return (flags & (need | traps)) == need;
+    }
+    std::uint32_t walk_read(address_t physical) const;
+    void walk_write(address_t physical, std::uint32_t value);
+
+public:
+    DescriptorTable gdtr;
+
+    // First watched store since it was last cleared.
+    std::optional<WatchHit> watch_hit;
+
+    MMU(Memory& mem) : mem_(&mem) {}
+
+    // Point at mem after the Memory this MMU was built on has been moved into
+    // it. Cached host pointers survive as the buffer itself does not move.
+    void rebind(Memory& mem) noexcept {mem_ = &mem;}
+
+    // Back to the power on state: real mode, no paging and no watchpoints.
+    void reset();
+
+    std::uint32_t cr0() const noexcept {return cr0_;}
+    std::uint32_t cr3() const noexcept {return cr3_;}
+    bool paging() const noexcept {return paging_;}
+    // No paging, watchpoints, permissions or code pages: every linear address
+    // is its own offset into guest memory.
+    bool direct() const noexcept {return direct_;}
+    // Whether [linear, linear + length) can be accessed straight through
+    // memory. Without paging that holds for ranges of pages that allow the
+    // access, so a few protected pages do not send every access the long way.
+    bool direct_range(address_t linear, std::uint64_t length, std::uint8_t access) const noexcept;
+
+    // Writing CR0 hands segmentation back to the guest's own descriptor
+    // tables, or to real mode when PE is clear.
+    void write_cr0(std::uint32_t value);
+    void write_cr3(std::uint32_t value);
+
+    // Protected mode as a user process sees it: PE set and every selector,
+    // whatever its index, loading base 0 and a 4 GiB limit without a GDT.
+    // For loaders of 32 bit flat programs, which may load segment registers
+    // with the selectors their OS would have set up.
+    void enter_flat_mode();
+
+    void flush_tlb() noexcept;
+    void invlpg(address_t linear) noexcept;
+
+    // Set the R/W/X bits of the pages overlapping [address, address + length).
+    // Loads and stores check R and W through the TLB; fetch checks X itself.
+    void protect(address_t address, std::size_t length, std::uint8_t perms);
+
+    // Flag pages as holding cached code. Like watched pages they are never
+    // cached in the TLB with write permission, so every store to them comes
+    // through tlb_fill and bumps the page's write generation.
+    void mark_code(address_t address, std::size_t length);
+
+    void add_watchpoint(address_t address, std::size_t length);
+    void remove_watchpoint(address_t address, std::size_t length);
+
+    // Refresh the cached base and limit after a segment register is written.
+    void load_segment(Segment seg, std::uint16_t selector);
+
+    const SegmentCache& segment(Segment seg) const noexcept {
+        return segments_[static_cast<unsigned int>(seg)];
+    }
+
+    std::uint8_t* translate_linear(const address_t linear, const std::uint8_t access, const std::size_t width = 1) {
+        if (direct_) {
+            return mem_->ptr(linear, width);
+        }
+        // Without paging only the page flags stand between linear addresses
+        // and memory, so most pages can skip the TLB altogether.
+        if (!paging_ && page_allows(mem_->fetch_flags(linear), access) && (linear & page_mask) + width <= guest_page_size) {
+            return mem_->ptr(linear, width);
+        }
+        const address_t page = linear >> page_shift;
+        const auto& entry = tlb_[page % tlb_entries];
+        if (entry.page == page && (entry.perms & access) == access && (linear & page_mask) + width <= guest_page_size) {
+            return entry.host + (linear & page_mask);
+        }
+        return tlb_fill(linear, access, width);
+    }
+
+    std::uint8_t* translate(const Segment seg, const address_t offset, const std::uint8_t access, const std::size_t width = 1) {
+        const auto& cache = segments_[static_cast<unsigned int>(seg)];
+        if (std::uint64_t(offset) + width - 1 > cache.limit) {
+            throw GP_FAULT{0};
+        }
+        return translate_linear(cache.base + offset, access, width);
+    }
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef MMX_HH
+#define MMX_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// One 64 bit MMX register, viewed as lanes of any width.
+class Mmx {
+private:
+    union {
+        std::uint64_t u64[1];
+        std::uint32_t u32[2];
+        std::uint16_t u16[4];
+        std::uint8_t u8[8];
+    } data_{};
+
+public:
+    template <typename I>
+    [[nodiscard]] I& access(std::size_t index) {
+        if constexpr (std::is_same_v<I, std::uint8_t>) {
+            return data_.u8[index];
+        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
+            return data_.u16[index];
+        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
+            return data_.u32[index];
+        } else {
+            static_assert(std::is_same_v<I, std::uint64_t>);
+            return data_.u64[index];
+        }
+    }
+
+    template <typename I>
+    [[nodiscard]] constexpr const I& access(std::size_t index) const {
+        if constexpr (std::is_same_v<I, std::uint8_t>) {
+            return data_.u8[index];
+        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
+            return data_.u16[index];
+        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
+            return data_.u32[index];
+        } else {
+            static_assert(std::is_same_v<I, std::uint64_t>);
+            return data_.u64[index];
+        }
+    }
+
+    template <typename I>
+    static constexpr std::size_t elements = 8 / sizeof(I);
+
+    std::uint8_t* bytes() {return data_.u8;}
+    const std::uint8_t* bytes() const {return data_.u8;}
+
+    void load(const std::uint8_t* src) {std::memcpy(data_.u8, src, sizeof(data_));}
+    void store(std::uint8_t* dest) const {std::memcpy(dest, data_.u8, sizeof(data_));}
+
+    bool operator==(const Mmx& other) const {
+        return data_.u64[0] == other.data_.u64[0];
+    }
+};
+
+// The MMX operations. The registers themselves live in the x87 register
+// file, see FPU_Registers::mm.
+class MMX {
+public:
+    // Packed integer arithmetic, wrapping.
+    static void paddb(Mmx&, const Mmx&);
+    static void paddw(Mmx&, const Mmx&);
+    static void paddd(Mmx&, const Mmx&);
+    static void psubb(Mmx&, const Mmx&);
+    static void psubw(Mmx&, const Mmx&);
+    static void psubd(Mmx&, const Mmx&);
+
+    // Saturating to the signed or the unsigned range of the lane.
+    static void paddsb(Mmx&, const Mmx&);
+    static void paddsw(Mmx&, const Mmx&);
+    static void paddusb(Mmx&, const Mmx&);
+    static void paddusw(Mmx&, const Mmx&);
+    static void psubsb(Mmx&, const Mmx&);
+    static void psubsw(Mmx&, const Mmx&);
+    static void psubusb(Mmx&, const Mmx&);
+    static void psubusw(Mmx&, const Mmx&);
+
+    // Signed word products: the low and high halves, and the sums of
+    // adjacent pairs.
+    static void pmullw(Mmx&, const Mmx&);
+    static void pmulhw(Mmx&, const Mmx&);
+    static void pmaddwd(Mmx&, const Mmx&);
+
+    static void pand(Mmx&, const Mmx&);
+    static void pandn(Mmx&, const Mmx&);
+    static void por(Mmx&, const Mmx&);
+    static void pxor(Mmx&, const Mmx&);
+
+    static void pcmpeqb(Mmx&, const Mmx&);
+    static void pcmpeqw(Mmx&, const Mmx&);
+    static void pcmpeqd(Mmx&, const Mmx&);
+    // Signed greater than.
+    static void pcmpgtb(Mmx&, const Mmx&);
+    static void pcmpgtw(Mmx&, const Mmx&);
+    static void pcmpgtd(Mmx&, const Mmx&);
+
+    // Shift every lane by the whole 64 bit count. Counts past the lane
+    // width leave zero, or the sign for the arithmetic shifts.
+    static void psllw(Mmx&, const Mmx&);
+    static void pslld(Mmx&, const Mmx&);
+    static void psllq(Mmx&, const Mmx&);
+    static void psrlw(Mmx&, const Mmx&);
+    static void psrld(Mmx&, const Mmx&);
+    static void psrlq(Mmx&, const Mmx&);
+    static void psraw(Mmx&, const Mmx&);
+    static void psrad(Mmx&, const Mmx&);
+
+    // Narrow the lanes of dest, then those of src, with saturation.
+    static void packsswb(Mmx&, const Mmx&);
+    static void packssdw(Mmx&, const Mmx&);
+    static void packuswb(Mmx&, const Mmx&);
+
+    // Interleave the low or the high halves of both operands.
+    static void punpcklbw(Mmx&, const Mmx&);
+    static void punpcklwd(Mmx&, const Mmx&);
+    static void punpckldq(Mmx&, const Mmx&);
+    static void punpckhbw(Mmx&, const Mmx&);
+    static void punpckhwd(Mmx&, const Mmx&);
+    static void punpckhdq(Mmx&, const Mmx&);
+};
+
+#endif
@@ -20,6 +20,13 @@ enum class Opcode {
     AND8,
     AND16_32,
 
+    BSF,
+    BSR,
+    BT,
+    BTC,
+    BTR,
+    BTS,
+
     CBW,
     CDQ,
 
@@ -36,6 +43,11 @@ enum class Opcode {
     CMP8,
     CMP16_32,
 
+    CMPS8,
+    CMPS16_32,
+
+    CPUID,
+
     CWD,
     CWDE,
 
@@ -45,16 +57,49 @@ enum class Opcode {
     DEC16,
     DEC32,
 
+    DIV8,
+    DIV16_32,
+
     HLT,
 
+    IDIV8,
+    IDIV16_32,
+    IMUL8,
+    IMUL16_32,
+
     INC16,
     INC32,
+    INT,
+
+    INVLPG,
 
     LAHF,
+    LGDT,
+
+    LZCNT,
+
+    LODS8,
+    LODS16_32,
+
+    MOV_CR,
+    MOV_SREG,
+
+    MOVS8,
+    MOVS16_32,
+
+    MUL8,
+    MUL16_32,
+
+    NEG8,
+    NEG16_32,
+    NOT8,
+    NOT16_32,
 
     OR8,
     OR16_32,
 
+    POPCNT,
+
     POPA,
     POPAD,
 
@@ -73,23 +118,144 @@ enum class Opcode {
     POP_SS,
     PUSH_SS,
 
+    RCL8,
+    RCL16_32,
+    RCR8,
+    RCR16_32,
+    ROL8,
+    ROL16_32,
+    ROR8,
+    ROR16_32,
+
     SAHF,
     SALC,
 
+    SAR8,
+    SAR16_32,
+
     SBB8,
     SBB16_32,
 
+    SCAS8,
+    SCAS16_32,
+
+    SHL8,
+    SHL16_32,
+    SHLD,
+    SHR8,
+    SHR16_32,
+    SHRD,
+
     STC,
     STD,
 
+    STOS8,
+    STOS16_32,
+
     SUB8,
     SUB16_32,
 
+    TEST8,
+    TEST16_32,
+
+    TZCNT,
+
     XCHG,
     XLAT,
 
     XOR8,
-    XOR16_32
+    XOR16_32,
+
+    // x87 control.
+    FLDCW,
+    FNSTCW,
+    FWAIT,
+
+    // SSE and SSE2.
+    ADDPD,
+    ADDPS,
+    ANDNPD,
+    ANDNPS,
+    ANDPD,
+    ANDPS,
+    DIVPD,
+    DIVPS,
+    FENCE,
+    MOVAPD,
+    MOVAPS,
+    MOVD,
+    MOVDQA,
+    MOVDQU,
+    MOVQ,
+    MOVUPD,
+    MOVUPS,
+    MULPD,
+    MULPS,
+    NOP,
+    ORPD,
+    ORPS,
+    PADDB,
+    PADDD,
+    PADDQ,
+    PADDW,
+    PAND,
+    PANDN,
+    PCMPEQB,
+    PCMPEQD,
+    PCMPEQW,
+    PCMPESTRI,
+    PCMPESTRM,
+    PCMPISTRI,
+    PCMPISTRM,
+    PMINUB,
+    PMOVMSKB,
+    POR,
+    PREFETCH,
+    PSHUFD,
+    PSUBB,
+    PSUBD,
+    PSUBQ,
+    PSUBW,
+    PUNPCKLBW,
+    PUNPCKLDQ,
+    PUNPCKLQDQ,
+    PUNPCKLWD,
+    PXOR,
+    SUBPD,
+    SUBPS,
+    XORPD,
+    XORPS,
+
+    // MMX, where the mnemonic is not shared with SSE2.
+    EMMS,
+    PACKSSDW,
+    PACKSSWB,
+    PACKUSWB,
+    PADDSB,
+    PADDSW,
+    PADDUSB,
+    PADDUSW,
+    PCMPGTB,
+    PCMPGTD,
+    PCMPGTW,
+    PMADDWD,
+    PMULHW,
+    PMULLW,
+    PSLLD,
+    PSLLQ,
+    PSLLW,
+    PSRAD,
+    PSRAW,
+    PSRLD,
+    PSRLQ,
+    PSRLW,
+    PSUBSB,
+    PSUBSW,
+    PSUBUSB,
+    PSUBUSW,
+    PUNPCKHBW,
+    PUNPCKHDQ,
+    PUNPCKHWD,
 
     ENUM_END
 };
@@ -0,0 +1,57 @@
+#ifndef PAGE_DEDUP_HH
+#define PAGE_DEDUP_HH
+
+#include "memory.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Deduplicates guest pages across many resident Memory instances, such as
+// idle snapshots kept around for reuse.
+//
+// Pages that are entirely zero are handed back to the host, which maps them
+// onto its shared zero page until the guest next stores to them. Every other
+// page is left to the host's same page merging, which the buffers are opted
+// into on add: it shares identical pages read only and copies them apart on
+// the first write, so guests never see the sharing. scan() hashes the touched
+// pages to report what that merging could save, should the host run it.
+//
+// Registered Memory must stay at the same address until it is removed.
+class PageDeduplicator {
+public:
+    struct Stats {
+        std::size_t pages_scanned = 0;
+        // Pages released back to the host because they only held zeros.
+        std::size_t zero_pages = 0;
+        // Pages whose contents match an earlier page in the scan.
+        std::size_t duplicate_pages = 0;
+        // Whether every buffer accepted MADV_MERGEABLE. The host may still
+        // not be running its merging at all.
+        bool host_merging = true;
+
+        // Memory actually handed back by this scan.
+        std::size_t bytes_saved() const noexcept {
+            return zero_pages * Memory::page_size();
+        }
+
+        // What the host's merging could share on top of that, if it runs.
+        std::size_t potential_bytes_saved() const noexcept {
+            return host_merging ? duplicate_pages * Memory::page_size() : 0;
+        }
+    };
+
+private:
+    std::vector<Memory*> memories_;
+    bool host_merging_ = true;
+
+public:
+    void add(Memory& mem);
+    void remove(Memory& mem);
+
+    std::size_t size() const noexcept {return memories_.size();}
+
+    Stats scan();
+};
+
+#endif
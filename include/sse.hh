@@ -0,0 +1,164 @@
+#ifndef SSE_HH
+#define SSE_HH
+
+#include "host_cpu.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// One 128 bit XMM register, viewed as lanes of any width.
+class alignas(16) Xmm {
+private:
+    union {
+        std::uint64_t u64[2];
+        std::uint32_t u32[4];
+        std::uint16_t u16[8];
+        std::uint8_t u8[16];
+        double f64[2];
+        float f32[4];
+    } data_{};
+
+public:
+    template <typename I>
+    [[nodiscard]] I& access(std::size_t index) {
+        if constexpr (std::is_same_v<I, std::uint8_t>) {
+            return data_.u8[index];
+        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
+            return data_.u16[index];
+        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
+            return data_.u32[index];
+        } else if constexpr (std::is_same_v<I, std::uint64_t>) {
+            return data_.u64[index];
+        } else if constexpr (std::is_same_v<I, float>) {
+            return data_.f32[index];
+        } else {
+            static_assert(std::is_same_v<I, double>);
+            return data_.f64[index];
+        }
+    }
+
+    template <typename I>
+    [[nodiscard]] constexpr const I& access(std::size_t index) const {
+        if constexpr (std::is_same_v<I, std::uint8_t>) {
+            return data_.u8[index];
+        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
+            return data_.u16[index];
+        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
+            return data_.u32[index];
+        } else if constexpr (std::is_same_v<I, std::uint64_t>) {
+            return data_.u64[index];
+        } else if constexpr (std::is_same_v<I, float>) {
+            return data_.f32[index];
+        } else {
+            static_assert(std::is_same_v<I, double>);
+            return data_.f64[index];
+        }
+    }
+
+    template <typename I>
+    static constexpr std::size_t elements = 16 / sizeof(I);
+
+    // The register as 16 bytes, aligned for host vector loads.
+    std::uint8_t* bytes() {return data_.u8;}
+    const std::uint8_t* bytes() const {return data_.u8;}
+
+    void load(const std::uint8_t* src) {std::memcpy(data_.u8, src, sizeof(data_));}
+    void store(std::uint8_t* dest) const {std::memcpy(dest, data_.u8, sizeof(data_));}
+
+    bool operator==(const Xmm& other) const {
+        return std::memcmp(data_.u8, other.data_.u8, sizeof(data_)) == 0;
+    }
+};
+
+// The XMM register file and the SSE/SSE2 operations on it. Each operation
+// works on whole registers with the host's own SSE2, keeping lane loops for
+// hosts without it.
+class SSE {
+public:
+    Xmm reg[8];
+
+    void reset();
+
+    // Packed integer arithmetic, wrapping.
+    void paddb(Xmm&, const Xmm&);
+    void paddw(Xmm&, const Xmm&);
+    void paddd(Xmm&, const Xmm&);
+    void paddq(Xmm&, const Xmm&);
+    void psubb(Xmm&, const Xmm&);
+    void psubw(Xmm&, const Xmm&);
+    void psubd(Xmm&, const Xmm&);
+    void psubq(Xmm&, const Xmm&);
+    void pminub(Xmm&, const Xmm&);
+
+    // Bitwise, shared by the integer and the ps/pd forms.
+    void pand(Xmm&, const Xmm&);
+    void pandn(Xmm&, const Xmm&);
+    void por(Xmm&, const Xmm&);
+    void pxor(Xmm&, const Xmm&);
+
+    // All ones in each lane that compares equal.
+    void pcmpeqb(Xmm&, const Xmm&);
+    void pcmpeqw(Xmm&, const Xmm&);
+    void pcmpeqd(Xmm&, const Xmm&);
+
+    // Interleave the low halves of both operands.
+    void punpcklbw(Xmm&, const Xmm&);
+    void punpcklwd(Xmm&, const Xmm&);
+    void punpckldq(Xmm&, const Xmm&);
+    void punpcklqdq(Xmm&, const Xmm&);
+
+    // Packed float arithmetic, rounding to nearest as the default MXCSR does.
+    void addps(Xmm&, const Xmm&);
+    void addpd(Xmm&, const Xmm&);
+    void subps(Xmm&, const Xmm&);
+    void subpd(Xmm&, const Xmm&);
+    void mulps(Xmm&, const Xmm&);
+    void mulpd(Xmm&, const Xmm&);
+    void divps(Xmm&, const Xmm&);
+    void divpd(Xmm&, const Xmm&);
+
+    // The top bit of each byte of src, gathered into the low 16 bits.
+    std::uint32_t pmovmskb(const Xmm& src) const;
+    // Dword i of dest is dword (order >> 2i) & 3 of src.
+    void pshufd(Xmm& dest, const Xmm& src, std::uint8_t order);
+
+    // What PCMPESTRI, PCMPESTRM, PCMPISTRI and PCMPISTRM share: the
+    // comparison of the elements of a against those of b under control,
+    // before the I forms turn it into an index and the M forms into a mask.
+    struct StringMatch {
+        // IntRes2, a bit per element.
+        std::uint16_t result = 0;
+        bool carry = false;
+        bool zero = false;
+        bool sign = false;
+        bool overflow = false;
+    };
+
+    // The explicit lengths are EAX and EDX, taken as signed and saturated.
+    StringMatch pcmpestr(const Xmm& a, std::int32_t length_a, const Xmm& b, std::int32_t length_b,
+                         std::uint8_t control) const;
+    // Implicit lengths end at the first zero element.
+    StringMatch pcmpistr(const Xmm& a, const Xmm& b, std::uint8_t control) const;
+    // The I forms' ECX: the lowest set element, or with control bit 6 the
+    // highest, or the element count when none is set.
+    static std::uint32_t string_index(const StringMatch& match, std::uint8_t control);
+    // The M forms' XMM0: the bits zero extended, or with control bit 6 each
+    // bit widened to its element.
+    static Xmm string_mask(const StringMatch& match, std::uint8_t control);
+};
+
+// IntRes2 of the PCMPxSTRx comparisons, either from the host's own
+// instructions or computed element by element. SSE binds the best table
+// the host supports at startup.
+struct StringCompareKernels {
+    std::uint16_t (*explicit_length)(const Xmm& a, std::int32_t length_a, const Xmm& b, std::int32_t length_b,
+                                     std::uint8_t control);
+    std::uint16_t (*implicit_length)(const Xmm& a, const Xmm& b, std::uint8_t control);
+};
+
+// The table built for isa, which only the hosts supporting it may call.
+const StringCompareKernels& string_compare_kernels(HostIsa isa);
+
+#endif
@@ -8,12 +8,20 @@
 #include <cstddef>
 #include <cstdint>
 
+// #SS: a push that would carry ESP from the stack region below its limit.
+struct STACK_FAULT {address_t esp;};
+
+// A view of the stack region of guest memory. The stack lives in the same
+// address space as code and data, so [esp] operands and push/pop agree, and
+// each access is a plain load or store relative to ESP. Overflow is caught
+// here, at limit, so every byte of guest memory stays addressable.
 class Stack {
 private:
-    Memory mem_;
+    Memory& mem_;
     std::uint32_t& esp_;
+    address_t limit_;
 public:
-    Stack(std::size_t size, std::uint32_t& esp) : mem_(size), esp_(esp) {}
+    Stack(Memory& mem, std::uint32_t& esp, const address_t limit = 0) : mem_(mem), esp_(esp), limit_(limit) {}
 
     const std::uint8_t* mem_access(const address_t address) const {
         return &mem_[address];
@@ -23,18 +31,29 @@ public:
         return esp_;
     }
 
+    // Lowest address of the stack region.
+    address_t limit() const {
+        return limit_;
+    }
+
     template <typename I>
-    I pop() noexcept {
-        auto tmp = mread<I>(&mem_[esp_]);
+    I pop() {
+        auto tmp = mread<I>(mem_.ptr(esp_, sizeof(I)));
         esp_ += sizeof(I);
         return tmp;
     }
 
     template <typename I>
     void push(const I value) {
-        esp_ -= sizeof(I);
-        mwrite<I>(&mem_[esp_], value);
+        const auto top = std::uint32_t(esp_ - sizeof(I));
+        if (esp_ >= limit_ && top < limit_) {
+            throw STACK_FAULT{esp_};
+        }
+        // Fault before ESP moves, so a failed push leaves it unchanged.
+        mwrite<I>(mem_.ptr(top, sizeof(I)), value);
+        esp_ = top;
+        mem_.note_write(esp_, sizeof(I));
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,34 @@
+#ifndef STRING_KERNELS_HH
+#define STRING_KERNELS_HH
+
+#include "host_cpu.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+// Host search and compare loops behind REPE/REPNE SCASB and CMPSB. Each
+// returns the index of the first element that ends the search, or n when
+// none in [0, n) does, and never reads past the n'th byte.
+
+// First byte of p equal to value (REPNE SCASB).
+std::size_t find_byte(const std::uint8_t* p, std::size_t n, std::uint8_t value);
+// First byte of p not equal to value (REPE SCASB).
+std::size_t find_other_byte(const std::uint8_t* p, std::size_t n, std::uint8_t value);
+// First index where a and b differ (REPE CMPSB).
+std::size_t find_mismatch(const std::uint8_t* a, const std::uint8_t* b, std::size_t n);
+// First index where a and b agree (REPNE CMPSB).
+std::size_t find_match(const std::uint8_t* a, const std::uint8_t* b, std::size_t n);
+
+// One build of the vectorised searches. The free functions above call
+// through the table bound at startup for the best tier the host supports.
+struct StringKernels {
+    std::size_t (*find_other_byte)(const std::uint8_t*, std::size_t, std::uint8_t);
+    std::size_t (*find_mismatch)(const std::uint8_t*, const std::uint8_t*, std::size_t);
+    std::size_t (*find_match)(const std::uint8_t*, const std::uint8_t*, std::size_t);
+};
+
+// The table built for isa, which only the hosts supporting it may call.
+// Builds without x86 kernels fall back to the scalar table.
+const StringKernels& string_kernels(HostIsa isa);
+
+#endif
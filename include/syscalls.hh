@@ -0,0 +1,79 @@
+#ifndef SYSCALLS_HH
+#define SYSCALLS_HH
+
+#include "executor.hh"
+#include "types.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+// Services Linux i386 int 0x80 syscalls on the host, for use with
+// ExitReason::SYSCALL:
+//
+//     while (ex.execute(false, false) == ExitReason::SYSCALL) {
+//         sys.handle(ex);
+//         if (sys.exited()) break;
+//     }
+//
+// Arguments come in EBX, ECX, EDX, ESI, EDI and EBP and the result, or a
+// negated errno, goes back in EAX. Guest file descriptors are host ones.
+// Buffers for read and write are handed to readv/writev as iovecs pointing
+// straight into guest memory, one per run of host contiguous pages, so no
+// data is copied on the way.
+//
+// brk grows up from the initial program break and anonymous or file mmaps
+// are carved downwards from mmap_top; both live in guest memory that is
+// already reserved, so only page permissions and contents change.
+class LinuxSyscalls {
+public:
+    // i386 syscall numbers.
+    static constexpr std::uint32_t SYS_EXIT = 1;
+    static constexpr std::uint32_t SYS_READ = 3;
+    static constexpr std::uint32_t SYS_WRITE = 4;
+    static constexpr std::uint32_t SYS_OPEN = 5;
+    static constexpr std::uint32_t SYS_CLOSE = 6;
+    static constexpr std::uint32_t SYS_BRK = 45;
+    static constexpr std::uint32_t SYS_MMAP = 90;
+    static constexpr std::uint32_t SYS_FSTAT = 108;
+    static constexpr std::uint32_t SYS_MMAP2 = 192;
+    static constexpr std::uint32_t SYS_FSTAT64 = 197;
+    static constexpr std::uint32_t SYS_EXIT_GROUP = 252;
+    static constexpr std::uint32_t SYS_CLOCK_GETTIME = 265;
+    static constexpr std::uint32_t SYS_CLOCK_GETTIME64 = 403;
+
+private:
+    address_t initial_brk_;
+    address_t brk_;
+    address_t mmap_top_;
+    bool exited_ = false;
+    int exit_status_ = 0;
+
+    // Host iovecs covering length bytes of guest memory at address.
+    std::vector<iovec> guest_iov(Executor& ex, address_t address, std::size_t length, std::uint8_t access);
+    std::string guest_string(Executor& ex, address_t address);
+
+    std::int32_t sys_rw(Executor& ex, bool write);
+    std::int32_t sys_open(Executor& ex);
+    std::int32_t sys_brk(Executor& ex);
+    std::int32_t sys_mmap(Executor& ex, address_t addr, std::uint32_t length, std::uint32_t prot,
+                          std::uint32_t flags, int fd, std::size_t offset);
+    std::int32_t sys_fstat(Executor& ex, bool stat64);
+    std::int32_t sys_clock_gettime(Executor& ex, bool time64);
+
+public:
+    LinuxSyscalls(address_t program_break, address_t mmap_top)
+        : initial_brk_(program_break), brk_(program_break), mmap_top_(mmap_top) {}
+
+    // Carry out the syscall ex stopped on and write its result to EAX.
+    void handle(Executor& ex);
+
+    bool exited() const noexcept {return exited_;}
+    int exit_status() const noexcept {return exit_status_;}
+    address_t program_break() const noexcept {return brk_;}
+};
+
+#endif
@@ -3,17 +3,43 @@
 #include "util.hh"
 
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
 #include <stdexcept>
+#include <utility>
 
-CPU::CPU(std::size_t mem_size) : mem(mem_size), stack(1_mb, R[ESP]) {
-    R[ESP] = 1_mb - 1;
+CPU::CPU(std::size_t mem_size) : CPU(mem_size, std::min(mem_size, default_stack_size)) {}
+
+CPU::CPU(std::size_t mem_size, std::size_t stack_size)
+    : mem(mem_size), stack(mem, R[ESP], address_t(mem_size - std::min(stack_size, mem_size))), mmu(mem) {
+    if (stack_size > mem_size)
+        throw std::domain_error("Invalid constructor arguments for constructor CPU");
+    // The stack occupies the top stack_size bytes of guest memory and grows
+    // down towards its limit, where Stack raises STACK_FAULT.
+    R[ESP] = mem_size - 1;
+}
+
+CPU::CPU(CPU&& other) noexcept
+    : mem(std::move(other.mem)), stack(mem, R[ESP], other.stack.limit()), mmu(std::move(other.mmu)), flags(other.flags),
+      cs(other.cs), ss(other.ss), ds(other.ds), es(other.es), fs(other.fs), gs(other.gs),
+      cycle_counter(other.cycle_counter) {
+    std::copy(std::begin(other.R), std::end(other.R), std::begin(R));
+    mmu.rebind(mem);
 }
 
-CPU::CPU(std::size_t mem_size, std::size_t stack_size) : mem(mem_size), stack(stack_size, R[ESP]) {
-    R[ESP] = stack_size - 1;
+void CPU::reset() {
+    mem.zero_dirty_pages();
+    mmu.reset();
+    flags = Flags{};
+    cs = ss = ds = es = fs = gs = 0;
+    cycle_counter = 0;
+    std::fill(std::begin(R), std::end(R), 0u);
+    R[ESP] = std::uint32_t(mem.size() - 1);
 }
 
 // data access helper functions.
@@ -37,6 +63,22 @@ std::uint16_t& CPU::segregat(int index) {
     }
 }
 
+std::uint16_t& CPU::sreg(Segment seg) {
+    switch (seg) {
+        case Segment::ES: return es;
+        case Segment::CS: return cs;
+        case Segment::SS: return ss;
+        case Segment::DS: return ds;
+        case Segment::FS: return fs;
+        default: return gs;
+    }
+}
+
+void CPU::load_segment(Segment seg, std::uint16_t selector) {
+    mmu.load_segment(seg, selector);
+    sreg(seg) = selector;
+}
+
 void CPU::aaa() {
     if((get_low_byte(R[EAX]) & 0xF) > 9 || flags.adjust) {
         set_low_word(R[EAX], get_low_word(R[EAX]) + 0x106);
@@ -144,6 +186,115 @@ std::uint32_t CPU::arpl32(std::uint32_t lhs, [[maybe_unused]] std::uint32_t rhs)
     return lhs;
 }
 
+namespace {
+
+template <typename I>
+I bit_mask(const I bit) {
+    return static_cast<I>(I(1) << (bit % std::numeric_limits<I>::digits));
+}
+
+}
+
+void CPU::bt16(std::uint16_t lhs, std::uint16_t rhs) {
+    flags.carry = lhs & bit_mask(rhs);
+}
+
+void CPU::bt32(std::uint32_t lhs, std::uint32_t rhs) {
+    flags.carry = lhs & bit_mask(rhs);
+}
+
+std::uint16_t CPU::btc16(std::uint16_t lhs, std::uint16_t rhs) {
+    bt16(lhs, rhs);
+    return lhs ^ bit_mask(rhs);
+}
+
+std::uint32_t CPU::btc32(std::uint32_t lhs, std::uint32_t rhs) {
+    bt32(lhs, rhs);
+    return lhs ^ bit_mask(rhs);
+}
+
+std::uint16_t CPU::btr16(std::uint16_t lhs, std::uint16_t rhs) {
+    bt16(lhs, rhs);
+    return lhs & std::uint16_t(~bit_mask(rhs));
+}
+
+std::uint32_t CPU::btr32(std::uint32_t lhs, std::uint32_t rhs) {
+    bt32(lhs, rhs);
+    return lhs & ~bit_mask(rhs);
+}
+
+std::uint16_t CPU::bts16(std::uint16_t lhs, std::uint16_t rhs) {
+    bt16(lhs, rhs);
+    return lhs | bit_mask(rhs);
+}
+
+std::uint32_t CPU::bts32(std::uint32_t lhs, std::uint32_t rhs) {
+    bt32(lhs, rhs);
+    return lhs | bit_mask(rhs);
+}
+
+std::uint16_t CPU::bsf16(std::uint16_t lhs, std::uint16_t rhs) {
+    flags.zero = rhs == 0;
+    return rhs ? std::uint16_t(std::countr_zero(rhs)) : lhs;
+}
+
+std::uint32_t CPU::bsf32(std::uint32_t lhs, std::uint32_t rhs) {
+    flags.zero = rhs == 0;
+    return rhs ? std::uint32_t(std::countr_zero(rhs)) : lhs;
+}
+
+std::uint16_t CPU::bsr16(std::uint16_t lhs, std::uint16_t rhs) {
+    flags.zero = rhs == 0;
+    return rhs ? std::uint16_t(15 - std::countl_zero(rhs)) : lhs;
+}
+
+std::uint32_t CPU::bsr32(std::uint32_t lhs, std::uint32_t rhs) {
+    flags.zero = rhs == 0;
+    return rhs ? std::uint32_t(31 - std::countl_zero(rhs)) : lhs;
+}
+
+// lzcnt and tzcnt are the zero-safe forms: a zero source counts the whole
+// width and sets CF instead.
+std::uint16_t CPU::lzcnt16([[maybe_unused]] std::uint16_t lhs, std::uint16_t rhs) {
+    const auto tmp = std::uint16_t(std::countl_zero(rhs));
+    flags.carry = rhs == 0;
+    flags.zero = tmp == 0;
+    return tmp;
+}
+
+std::uint32_t CPU::lzcnt32([[maybe_unused]] std::uint32_t lhs, std::uint32_t rhs) {
+    const auto tmp = std::uint32_t(std::countl_zero(rhs));
+    flags.carry = rhs == 0;
+    flags.zero = tmp == 0;
+    return tmp;
+}
+
+std::uint16_t CPU::popcnt16([[maybe_unused]] std::uint16_t lhs, std::uint16_t rhs) {
+    flags.zero = rhs == 0;
+    flags.carry = flags.overflow = flags.sign = flags.adjust = flags.parity = false;
+    return std::uint16_t(std::popcount(rhs));
+}
+
+std::uint32_t CPU::popcnt32([[maybe_unused]] std::uint32_t lhs, std::uint32_t rhs) {
+    flags.zero = rhs == 0;
+    flags.carry = flags.overflow = flags.sign = flags.adjust = flags.parity = false;
+    return std::uint32_t(std::popcount(rhs));
+}
+
+std::uint16_t CPU::tzcnt16([[maybe_unused]] std::uint16_t lhs, std::uint16_t rhs) {
+    const auto tmp = std::uint16_t(std::countr_zero(rhs));
+    flags.carry = rhs == 0;
+    flags.zero = tmp == 0;
+    return tmp;
+}
+
+std::uint32_t CPU::tzcnt32([[maybe_unused]] std::uint32_t lhs, std::uint32_t rhs) {
+    const auto tmp = std::uint32_t(std::countr_zero(rhs));
+    flags.carry = rhs == 0;
+    flags.zero = tmp == 0;
+    return tmp;
+}
+
 std::uint32_t CPU::bswap(std::uint32_t reg) {
     return byteswap(reg);
 }
@@ -250,6 +401,68 @@ std::uint32_t CPU::dec32(std::uint32_t lhs) {
     return tmp;
 }
 
+namespace {
+
+// Unsigned division of a double width dividend by a divisor of type I. The
+// host divides at the dividend's width, which for 32 bit operands is 64 bit.
+template <typename I, typename W>
+W divide(const W dividend, const I divisor) {
+    if (divisor == 0) {
+        throw DIVIDE_ERROR{};
+    }
+    const W quotient = dividend / divisor;
+    if (quotient > std::numeric_limits<I>::max()) {
+        throw DIVIDE_ERROR{};
+    }
+    const W remainder = dividend % divisor;
+    return W(remainder << (8 * sizeof(I))) | quotient;
+}
+
+// Signed division, truncating towards zero as IDIV does.
+template <typename I, typename W>
+W signed_divide(const W dividend_bits, const I divisor_bits) {
+    using SI = std::make_signed_t<I>;
+    using SW = std::make_signed_t<W>;
+    const auto dividend = static_cast<SW>(dividend_bits);
+    const auto divisor = static_cast<SI>(divisor_bits);
+    // The second test is the one quotient the host cannot represent either.
+    if (divisor == 0 || (divisor == -1 && dividend == std::numeric_limits<SW>::min())) {
+        throw DIVIDE_ERROR{};
+    }
+    const SW quotient = dividend / divisor;
+    if (quotient < std::numeric_limits<SI>::min() || quotient > std::numeric_limits<SI>::max()) {
+        throw DIVIDE_ERROR{};
+    }
+    const SW remainder = dividend % divisor;
+    return W(W(static_cast<I>(remainder)) << (8 * sizeof(I))) | static_cast<I>(quotient);
+}
+
+}
+
+std::uint16_t CPU::div8(std::uint16_t dividend, std::uint8_t divisor) {
+    return divide(dividend, divisor);
+}
+
+std::uint32_t CPU::div16(std::uint32_t dividend, std::uint16_t divisor) {
+    return divide(dividend, divisor);
+}
+
+std::uint64_t CPU::div32(std::uint64_t dividend, std::uint32_t divisor) {
+    return divide(dividend, divisor);
+}
+
+std::uint16_t CPU::idiv8(std::uint16_t dividend, std::uint8_t divisor) {
+    return signed_divide(dividend, divisor);
+}
+
+std::uint32_t CPU::idiv16(std::uint32_t dividend, std::uint16_t divisor) {
+    return signed_divide(dividend, divisor);
+}
+
+std::uint64_t CPU::idiv32(std::uint64_t dividend, std::uint32_t divisor) {
+    return signed_divide(dividend, divisor);
+}
+
 void CPU::hlt() {
     throw CPU_HALT{R[EAX]};
 }
@@ -267,21 +480,29 @@ std::uint16_t CPU::imul16(std::uint16_t lhs, std::uint16_t rhs) {
 }
 
 std::uint32_t CPU::imul32(std::uint32_t lhs, std::uint32_t rhs) {
-    std::int32_t tmp = static_cast<std::int32_t>(lhs) * static_cast<std::int32_t>(rhs);
-    flags.set_imul_flags(lhs, rhs, static_cast<std::uint32_t>(tmp));
-    return static_cast<std::uint32_t>(tmp);
+    // Widened first, as a signed 32 bit product may overflow.
+    const std::int64_t full = std::int64_t(static_cast<std::int32_t>(lhs)) * static_cast<std::int32_t>(rhs);
+    const auto tmp = static_cast<std::uint32_t>(full);
+    flags.set_imul_flags(lhs, rhs, tmp);
+    return tmp;
+}
+
+std::uint16_t CPU::imul8_s(std::uint8_t lhs, std::uint8_t rhs) {
+    const std::int16_t tmp = static_cast<std::int16_t>(static_cast<std::int8_t>(lhs) * static_cast<std::int8_t>(rhs));
+    flags.set_mul_flags(tmp != static_cast<std::int8_t>(tmp));
+    return static_cast<std::uint16_t>(tmp);
 }
 
 std::uint32_t CPU::imul16_s(std::uint16_t lhs, std::uint16_t rhs) {
-    std::uint32_t tmp = lhs * rhs;
-    flags.set_imul_s_flags(sext(lhs), sext(rhs), sext(tmp));
-    return tmp;
+    const std::int32_t tmp = static_cast<std::int16_t>(lhs) * static_cast<std::int16_t>(rhs);
+    flags.set_mul_flags(tmp != static_cast<std::int16_t>(tmp));
+    return static_cast<std::uint32_t>(tmp);
 }
 
 std::uint64_t CPU::imul32_s(std::uint32_t lhs, std::uint32_t rhs) {
-    std::uint64_t tmp = lhs * rhs;
-    flags.set_imul_s_flags(lhs, rhs, tmp);
-    return tmp;
+    const std::int64_t tmp = std::int64_t(static_cast<std::int32_t>(lhs)) * static_cast<std::int32_t>(rhs);
+    flags.set_mul_flags(tmp != static_cast<std::int32_t>(tmp));
+    return static_cast<std::uint64_t>(tmp);
 }
 
 std::uint8_t CPU::inc8(std::uint8_t lhs) {
@@ -359,6 +580,54 @@ std::uint32_t CPU::cmovnc32(const std::uint32_t lhs, const std::uint32_t rhs) {
 }
 
 
+std::uint16_t CPU::mul8(std::uint8_t lhs, std::uint8_t rhs) {
+    const std::uint16_t tmp = static_cast<std::uint16_t>(lhs * rhs);
+    flags.set_mul_flags(tmp >> 8);
+    return tmp;
+}
+
+std::uint32_t CPU::mul16(std::uint16_t lhs, std::uint16_t rhs) {
+    const std::uint32_t tmp = std::uint32_t(lhs) * rhs;
+    flags.set_mul_flags(tmp >> 16);
+    return tmp;
+}
+
+std::uint64_t CPU::mul32(std::uint32_t lhs, std::uint32_t rhs) {
+    const std::uint64_t tmp = std::uint64_t(lhs) * rhs;
+    flags.set_mul_flags(tmp >> 32);
+    return tmp;
+}
+
+std::uint8_t CPU::neg8(std::uint8_t lhs) {
+    const auto tmp = static_cast<std::uint8_t>(-lhs);
+    flags.set_sub_flags(0, sext(lhs), sext(tmp));
+    return tmp;
+}
+
+std::uint16_t CPU::neg16(std::uint16_t lhs) {
+    const auto tmp = static_cast<std::uint16_t>(-lhs);
+    flags.set_sub_flags(0, sext(lhs), sext(tmp));
+    return tmp;
+}
+
+std::uint32_t CPU::neg32(std::uint32_t lhs) {
+    const std::uint32_t tmp = -lhs;
+    flags.set_sub_flags(0, lhs, tmp);
+    return tmp;
+}
+
+std::uint8_t CPU::not8(std::uint8_t lhs) {
+    return static_cast<std::uint8_t>(~lhs);
+}
+
+std::uint16_t CPU::not16(std::uint16_t lhs) {
+    return static_cast<std::uint16_t>(~lhs);
+}
+
+std::uint32_t CPU::not32(std::uint32_t lhs) {
+    return ~lhs;
+}
+
 std::uint8_t CPU::or8(std::uint8_t lhs, std::uint8_t rhs) {
     std::uint8_t tmp = lhs | rhs;
     flags.set_or_flags(sext(lhs), sext(rhs), sext(tmp));
@@ -459,18 +728,183 @@ void CPU::salc() {
     set_low_byte(R[EAX], flags.carry ? 0xFF : 0);
 }
 
-std::uint16_t CPU::sar16(std::uint16_t lhs, std::uint16_t rhs) {
-    const auto bm = signbit(lhs) ? sar_bitmask(rhs) : 0;
-    std::uint16_t tmp = bm | (lhs >> rhs);
-    flags.set_sar_flags(sext(lhs), sext(rhs), sext(tmp));
-    return std::uint16_t(tmp);
+namespace {
+
+// Every width masks its shift and rotate counts to five bits.
+constexpr unsigned int shift_count_mask = 0x1F;
+
+template <typename I>
+constexpr unsigned int bits_v = std::numeric_limits<I>::digits;
+
+// A shifted operand and the carry and overflow it produced.
+template <typename I>
+struct Shifted {
+    I value;
+    bool carry;
+    bool overflow;
+};
+
+// The shifts widen to 64 bits so that any masked count, including ones past
+// the width of an 8 or 16 bit operand, is a defined host shift.
+template <typename I>
+Shifted<I> shift_left(const I value, const unsigned int count) {
+    const std::uint64_t wide = std::uint64_t(value) << count;
+    const auto result = static_cast<I>(wide);
+    const bool carry = (wide >> bits_v<I>) & 1;
+    return {result, carry, signbit(result) != carry};
 }
 
-std::uint32_t CPU::sar32(std::uint32_t lhs, std::uint32_t rhs) {
-    const auto bm = signbit(lhs) ? sar_bitmask(rhs) : 0;
-    std::uint32_t tmp = bm | (lhs >> rhs);
-    flags.set_sar_flags(lhs, rhs, tmp);
-    return tmp;
+template <typename I>
+Shifted<I> shift_right(const I value, const unsigned int count) {
+    const std::uint64_t wide = value;
+    return {static_cast<I>(wide >> count), bool((wide >> (count - 1)) & 1), signbit(value)};
+}
+
+template <typename I>
+Shifted<I> shift_arithmetic_right(const I value, const unsigned int count) {
+    const std::int64_t wide = static_cast<std::make_signed_t<I>>(value);
+    return {static_cast<I>(wide >> count), bool((wide >> (count - 1)) & 1), false};
+}
+
+template <typename I>
+Shifted<I> shift_double_left(const I dest, const I src, const unsigned int count) {
+    const std::uint64_t wide = std::uint64_t(dest) << bits_v<I> | src;
+    const auto result = static_cast<I>(wide << count >> bits_v<I>);
+    return {result, bool((wide >> (2 * bits_v<I> - count)) & 1), signbit(result) != signbit(dest)};
+}
+
+template <typename I>
+Shifted<I> shift_double_right(const I dest, const I src, const unsigned int count) {
+    const std::uint64_t wide = std::uint64_t(src) << bits_v<I> | dest;
+    const auto result = static_cast<I>(wide >> count);
+    return {result, bool((wide >> (count - 1)) & 1), signbit(result) != signbit(dest)};
+}
+
+template <typename I>
+Shifted<I> rotate_left(const I value, const unsigned int count) {
+    const I result = std::rotl(value, int(count));
+    const bool carry = result & 1;
+    return {result, carry, signbit(result) != carry};
+}
+
+template <typename I>
+Shifted<I> rotate_right(const I value, const unsigned int count) {
+    const I result = std::rotr(value, int(count));
+    const bool carry = signbit(result);
+    return {result, carry, carry != bool((result >> (bits_v<I> - 2)) & 1)};
+}
+
+// RCL and RCR rotate the operand and CF together as one value a bit wider
+// than the operand.
+template <typename I>
+Shifted<I> rotate_carry_left(const I value, const bool carry_in, const unsigned int count) {
+    constexpr unsigned int width = bits_v<I> + 1;
+    const unsigned int n = count % width;
+    const std::uint64_t wide = std::uint64_t(carry_in) << bits_v<I> | value;
+    const std::uint64_t rotated = (wide << n | wide >> (width - n)) & ((std::uint64_t(1) << width) - 1);
+    const auto result = static_cast<I>(rotated);
+    const bool carry = rotated >> bits_v<I>;
+    return {result, carry, signbit(result) != carry};
+}
+
+template <typename I>
+Shifted<I> rotate_carry_right(const I value, const bool carry_in, const unsigned int count) {
+    constexpr unsigned int width = bits_v<I> + 1;
+    const unsigned int n = count % width;
+    const std::uint64_t wide = std::uint64_t(carry_in) << bits_v<I> | value;
+    const std::uint64_t rotated = (wide >> n | wide << (width - n)) & ((std::uint64_t(1) << width) - 1);
+    const auto result = static_cast<I>(rotated);
+    return {result, bool(rotated >> bits_v<I>), signbit(result) != bool((result >> (bits_v<I> - 2)) & 1)};
+}
+
+template <typename I, typename Op>
+I shift(Flags& flags, const I value, const std::uint8_t count, Op op) {
+    const unsigned int n = count & shift_count_mask;
+    if (n == 0) {
+        return value;
+    }
+    const Shifted<I> r = op(value, n);
+    flags.set_shift_flags(sext(r.value), r.carry, r.overflow);
+    return r.value;
+}
+
+template <typename I, typename Op>
+I rotate(Flags& flags, const I value, const std::uint8_t count, Op op) {
+    const unsigned int n = count & shift_count_mask;
+    if (n == 0) {
+        return value;
+    }
+    const Shifted<I> r = op(value, n);
+    flags.set_rotate_flags(r.carry, r.overflow);
+    return r.value;
+}
+
+}
+
+std::uint8_t CPU::rcl8(std::uint8_t lhs, std::uint8_t count) {
+    const bool carry = flags.carry;
+    return rotate(flags, lhs, count, [carry](auto v, auto n) {return rotate_carry_left(v, carry, n);});
+}
+
+std::uint16_t CPU::rcl16(std::uint16_t lhs, std::uint8_t count) {
+    const bool carry = flags.carry;
+    return rotate(flags, lhs, count, [carry](auto v, auto n) {return rotate_carry_left(v, carry, n);});
+}
+
+std::uint32_t CPU::rcl32(std::uint32_t lhs, std::uint8_t count) {
+    const bool carry = flags.carry;
+    return rotate(flags, lhs, count, [carry](auto v, auto n) {return rotate_carry_left(v, carry, n);});
+}
+
+std::uint8_t CPU::rcr8(std::uint8_t lhs, std::uint8_t count) {
+    const bool carry = flags.carry;
+    return rotate(flags, lhs, count, [carry](auto v, auto n) {return rotate_carry_right(v, carry, n);});
+}
+
+std::uint16_t CPU::rcr16(std::uint16_t lhs, std::uint8_t count) {
+    const bool carry = flags.carry;
+    return rotate(flags, lhs, count, [carry](auto v, auto n) {return rotate_carry_right(v, carry, n);});
+}
+
+std::uint32_t CPU::rcr32(std::uint32_t lhs, std::uint8_t count) {
+    const bool carry = flags.carry;
+    return rotate(flags, lhs, count, [carry](auto v, auto n) {return rotate_carry_right(v, carry, n);});
+}
+
+std::uint8_t CPU::rol8(std::uint8_t lhs, std::uint8_t count) {
+    return rotate(flags, lhs, count, rotate_left<std::uint8_t>);
+}
+
+std::uint16_t CPU::rol16(std::uint16_t lhs, std::uint8_t count) {
+    return rotate(flags, lhs, count, rotate_left<std::uint16_t>);
+}
+
+std::uint32_t CPU::rol32(std::uint32_t lhs, std::uint8_t count) {
+    return rotate(flags, lhs, count, rotate_left<std::uint32_t>);
+}
+
+std::uint8_t CPU::ror8(std::uint8_t lhs, std::uint8_t count) {
+    return rotate(flags, lhs, count, rotate_right<std::uint8_t>);
+}
+
+std::uint16_t CPU::ror16(std::uint16_t lhs, std::uint8_t count) {
+    return rotate(flags, lhs, count, rotate_right<std::uint16_t>);
+}
+
+std::uint32_t CPU::ror32(std::uint32_t lhs, std::uint8_t count) {
+    return rotate(flags, lhs, count, rotate_right<std::uint32_t>);
+}
+
+std::uint8_t CPU::sar8(std::uint8_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_arithmetic_right<std::uint8_t>);
+}
+
+std::uint16_t CPU::sar16(std::uint16_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_arithmetic_right<std::uint16_t>);
+}
+
+std::uint32_t CPU::sar32(std::uint32_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_arithmetic_right<std::uint32_t>);
 }
 
 std::uint16_t CPU::sar16_u(std::uint16_t lhs) {
@@ -481,6 +915,46 @@ std::uint32_t CPU::sar32_u(std::uint32_t lhs) {
     return sar32(lhs, 1);
 }
 
+std::uint8_t CPU::shl8(std::uint8_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_left<std::uint8_t>);
+}
+
+std::uint16_t CPU::shl16(std::uint16_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_left<std::uint16_t>);
+}
+
+std::uint32_t CPU::shl32(std::uint32_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_left<std::uint32_t>);
+}
+
+std::uint8_t CPU::shr8(std::uint8_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_right<std::uint8_t>);
+}
+
+std::uint16_t CPU::shr16(std::uint16_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_right<std::uint16_t>);
+}
+
+std::uint32_t CPU::shr32(std::uint32_t lhs, std::uint8_t count) {
+    return shift(flags, lhs, count, shift_right<std::uint32_t>);
+}
+
+std::uint16_t CPU::shld16(std::uint16_t lhs, std::uint16_t rhs, std::uint8_t count) {
+    return shift(flags, lhs, count, [rhs](auto v, auto n) {return shift_double_left(v, rhs, n);});
+}
+
+std::uint32_t CPU::shld32(std::uint32_t lhs, std::uint32_t rhs, std::uint8_t count) {
+    return shift(flags, lhs, count, [rhs](auto v, auto n) {return shift_double_left(v, rhs, n);});
+}
+
+std::uint16_t CPU::shrd16(std::uint16_t lhs, std::uint16_t rhs, std::uint8_t count) {
+    return shift(flags, lhs, count, [rhs](auto v, auto n) {return shift_double_right(v, rhs, n);});
+}
+
+std::uint32_t CPU::shrd32(std::uint32_t lhs, std::uint32_t rhs, std::uint8_t count) {
+    return shift(flags, lhs, count, [rhs](auto v, auto n) {return shift_double_right(v, rhs, n);});
+}
+
 std::uint8_t CPU::sbb8(std::uint8_t lhs, std::uint8_t rhs) {
     std::uint8_t tmp = lhs - rhs - flags.carry;
     flags.set_sbb_flags(sext(lhs), sext(rhs), sext(tmp));
@@ -544,6 +1018,14 @@ void CPU::std() {
 }
 
 // LCOV_EXCL_START
+void CPU::cpuid(const CpuidModel& model) {
+    const auto [eax, ebx, ecx, edx] = model.query(R[EAX], R[ECX]);
+    R[EAX] = eax;
+    R[EBX] = ebx;
+    R[ECX] = ecx;
+    R[EDX] = edx;
+}
+
 void CPU::rdtsc() {
     R[EDX] = high_dword(cycle_counter);
     R[EAX] = low_dword(cycle_counter);
@@ -558,10 +1040,26 @@ void CPU::test8(std::uint8_t lhs, std::uint8_t rhs) {
     flags.carry = flags.overflow = false;
 }
 
+void CPU::test16(std::uint16_t lhs, std::uint16_t rhs) {
+    std::uint16_t tmp = lhs & rhs;
+    flags.zero = tmp == 0;
+    flags.sign = signbit(tmp);
+    flags.parity = parity(tmp & 0xFF);
+    flags.carry = flags.overflow = false;
+}
+
+void CPU::test32(std::uint32_t lhs, std::uint32_t rhs) {
+    std::uint32_t tmp = lhs & rhs;
+    flags.zero = tmp == 0;
+    flags.sign = signbit(tmp);
+    flags.parity = parity(tmp & 0xFF);
+    flags.carry = flags.overflow = false;
+}
+
 void CPU::xchg(std::uint32_t& reg) {
     std::swap(R[EAX], reg);
 }
 
-void CPU::xlat() {
-    set_low_byte(R[EAX], mem[get_low_byte(R[EAX]) + R[EBX]]);
+void CPU::xlat(Segment seg) {
+    set_low_byte(R[EAX], *mmu.translate(seg, get_low_byte(R[EAX]) + R[EBX], MMU::READ));
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "cpuid.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace {
+
+constexpr std::uint32_t max_basic_leaf = 1;
+constexpr std::uint32_t max_extended_leaf = 0x80000004;
+
+// Four characters of s from at, little endian and zero padded.
+std::uint32_t pack(const std::string& s, const std::size_t at) {
+    std::uint32_t rv = 0;
+    for (std::size_t i = 0; i < 4 && at + i < s.size(); ++i) {
+        rv |= std::uint32_t(static_cast<unsigned char>(s[at + i])) << (8 * i);
+    }
+    return rv;
+}
+
+}
+
+CpuidModel CpuidModel::implemented() {
+    CpuidModel m;
+    // SSE and SSE2 stay off until the scalar and F2 forms, the conversions
+    // and LDMXCSR/STMXCSR run as well as the packed integer and move forms.
+    // SSE4.2 implies them and SSSE3 and SSE4.1 too, so PCMPxSTRx goes
+    // unadvertised with them. Until then only guests that ignore CPUID, or
+    // run under with_simd(), reach either path.
+    m.features_edx = FPU | TSC | CMOV | MMX;
+    m.features_ecx = POPCNT;
+    m.extended_features_ecx = LZCNT;
+    return m;
+}
+
+CpuidModel CpuidModel::with_simd() {
+    CpuidModel m = implemented();
+    m.features_edx |= SSE | SSE2;
+    m.features_ecx |= SSE4_2;
+    return m;
+}
+
+std::array<std::uint32_t, 4> CpuidModel::query(const std::uint32_t leaf, [[maybe_unused]] const std::uint32_t subleaf) const {
+    switch (leaf) {
+        case 0:
+            return {max_basic_leaf, pack(vendor, 0), pack(vendor, 8), pack(vendor, 4)};
+
+        case 1: {
+            // Family 15 and up spill into the extended family field.
+            const std::uint32_t base_family = std::min<std::uint32_t>(family, 0xF);
+            const std::uint32_t signature = std::uint32_t(stepping & 0xF)
+                | std::uint32_t(model & 0xF) << 4
+                | base_family << 8
+                | std::uint32_t(model >> 4) << 16
+                | (family - base_family) << 20;
+            return {signature, 0, features_ecx, features_edx};
+        }
+
+        case 0x80000000:
+            return {max_extended_leaf, 0, 0, 0};
+
+        case 0x80000001:
+            return {0, 0, extended_features_ecx, 0};
+
+        case 0x80000002 ... 0x80000004: {
+            const std::size_t at = (leaf - 0x80000002) * 16;
+            return {pack(brand, at), pack(brand, at + 4), pack(brand, at + 8), pack(brand, at + 12)};
+        }
+
+        default:
+            return {0, 0, 0, 0};
+    }
+}
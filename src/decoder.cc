@@ -49,13 +49,13 @@ std::tuple<Operands, unsigned int> decode_modregrm(std::uint8_t mrr, Memory& mem
                     op.rm.scale = 1 << scale;
                     op.rm.has_scale = true;
                     op.rm.index = index;
-                    op.rm.has_index = true;
+                    op.rm.has_index = index != 4;
                     skip += sizeof(std::uint32_t);
                 } else {
                     op.rm.scale = 1 << scale;
                     op.rm.has_scale = true;
                     op.rm.index = index;
-                    op.rm.has_index = true;
+                    op.rm.has_index = index != 4;
                     op.rm.base = base;
                     op.rm.has_base = true;
                 }
@@ -64,7 +64,7 @@ std::tuple<Operands, unsigned int> decode_modregrm(std::uint8_t mrr, Memory& mem
                 op.rm.scale = 1 << scale;
                 op.rm.has_scale = true;
                 op.rm.index = index;
-                op.rm.has_index = true;
+                op.rm.has_index = index != 4;
                 op.rm.base = base;
                 op.rm.has_base = true;
 
@@ -74,7 +74,7 @@ std::tuple<Operands, unsigned int> decode_modregrm(std::uint8_t mrr, Memory& mem
                 op.rm.scale = 1 << scale;
                 op.rm.has_scale = true;
                 op.rm.index = index;
-                op.rm.has_index = true;
+                op.rm.has_index = index != 4;
                 op.rm.base = base;
                 op.rm.has_base = true;
                 skip += sizeof(std::uint32_t);
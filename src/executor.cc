@@ -1,8 +1,13 @@
 #include "constants.hh"
 #include "executor.hh"
 #include "fpu.hh"
+#include "loop_idiom.hh"
+#include "string_kernels.hh"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <span>
 #include <sstream>
 #include <stdexcept>
@@ -43,7 +48,7 @@ CPU_op8_t get_regencoded_op_8bit(const unsigned int reg) {
 void Executor::execute_binary_immediate_regencoded_operation_8bit() {
     const std::uint8_t mrr = cpu.mem[pc + 1];
     const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, true, true);
-    auto so = structure_unary_operands<std::uint8_t>(cpu.R, cpu.mem, ops);
+    auto so = structure_unary_operands<std::uint8_t>(cpu.R, operand_host(ops, ops.reg == 7 ? MMU::READ : MMU::WRITE, sizeof(std::uint8_t)), ops);
     pc += skip;
     const std::uint8_t imm8 = mread<std::uint8_t>(&cpu.mem[pc]);
     auto op = get_regencoded_op_8bit(ops.reg);
@@ -87,8 +92,9 @@ void Executor::execute_binary_immediate_regencoded_operation_16_32bit() {
     std::uint8_t mrr = cpu.mem[pc + 1];
     const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
     pc += skip;
+    auto* host = operand_host(ops, ops.reg == 7 ? MMU::READ : MMU::WRITE, operand_width());
     if (is_16_bit_mode) {
-        auto so = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
+        auto so = structure_unary_operands<std::uint16_t>(cpu.R, host, ops);
         std::uint16_t imm16 = mread<std::uint16_t>(&cpu.mem[pc]);
         auto op = get_regencoded_op_16bit(ops.reg);
         if (so.is_rm_ptr) {
@@ -98,7 +104,7 @@ void Executor::execute_binary_immediate_regencoded_operation_16_32bit() {
         }
         pc += sizeof(std::uint16_t);
     } else {
-        auto so = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
+        auto so = structure_unary_operands<std::uint32_t>(cpu.R, host, ops);
         std::uint32_t imm32 = mread<std::uint32_t>(&cpu.mem[pc]);
         auto op = get_regencoded_op_32bit(ops.reg);
         if (so.is_rm_ptr) {
@@ -111,12 +117,1024 @@ void Executor::execute_binary_immediate_regencoded_operation_16_32bit() {
     reset_prefixes();
 }
 
-void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned int cycles, unsigned int start) {
-    
+void Executor::add_hook(address_t entry, Hook hook) {
+    cpu.mem.checked_ptr(entry);
+    hooks_[entry] = hook;
+    cpu.mem.set_page_flags(entry, Memory::PAGE_HOOK);
+}
+
+void Executor::remove_hook(address_t entry) {
+    if (!hooks_.erase(entry)) {
+        return;
+    }
+    const address_t page = entry >> guest_page_shift;
+    const bool shared = std::any_of(hooks_.begin(), hooks_.end(), [page](const auto& h) {
+        return (h.first >> guest_page_shift) == page;
+    });
+    if (!shared) {
+        cpu.mem.clear_page_flags(entry, Memory::PAGE_HOOK);
+    }
+}
+
+bool Executor::run_hook() {
+    const auto it = hooks_.find(address_t(pc));
+    if (it == hooks_.end()) {
+        return false;
+    }
+    cpu.R[EAX] = it->second(*this);
+    // Back to the caller as the guest function's ret would have taken us.
+    pc = cpu.pop32();
+    reset_prefixes();
+    return true;
+}
+
+std::uint8_t* Executor::bulk_range(const Segment seg, const address_t offset, const std::uint64_t length, const std::uint8_t access) {
+    const auto& cache = cpu.mmu.segment(seg);
+    if (offset + length - 1 > cache.limit) {
+        return nullptr;
+    }
+    const std::uint64_t linear = std::uint64_t(cache.base) + offset;
+    if (linear + length > cpu.mem.size() || !cpu.mmu.direct_range(address_t(linear), length, access)) {
+        return nullptr;
+    }
+    return cpu.mem.ptr(std::size_t(linear), std::size_t(length));
+}
+
+std::uint8_t* Executor::idiom_range(const address_t offset, const std::uint64_t length, const address_t head, const address_t end, const bool store) {
+    auto* host = bulk_range(Segment::DS, offset, length, store ? MMU::WRITE : MMU::READ);
+    // A store over the loop's own code would change what the next trip runs.
+    if (host && store && host < cpu.mem.begin() + end && cpu.mem.begin() + head < host + length) {
+        return nullptr;
+    }
+    return host;
+}
+
+const std::uint8_t* Executor::string_chunk(const Segment seg, const address_t offset, const std::uint32_t count, std::size_t& length) {
+    // Faults, permissions and limits for the first byte come from translate.
+    const std::uint8_t* host = cpu.mmu.translate(seg, offset, MMU::READ);
+    const auto& cache = cpu.mmu.segment(seg);
+    const address_t linear = cache.base + offset;
+    // Whatever the MMU did, the chunk must not run past the end of memory,
+    // which need not be a whole number of pages.
+    const std::uint64_t n = std::min<std::uint64_t>({count, guest_page_size - (linear & (guest_page_size - 1)),
+                                                     std::uint64_t(cache.limit) - offset + 1,
+                                                     std::uint64_t(cpu.mem.data() + cpu.mem.size() - host)});
+    length = std::size_t(n);
+    return host;
+}
+
+namespace {
+
+// The accumulator register as an I.
+template <typename I>
+void set_accumulator(std::uint32_t& eax, const I value) {
+    if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+        set_low_byte(eax, value);
+    } else if constexpr (sizeof(I) == sizeof(std::uint16_t)) {
+        set_low_word(eax, value);
+    } else {
+        eax = value;
+    }
+}
+
+// Flags of cmp lhs, rhs at the width of I.
+template <typename I>
+void compare(CPU& cpu, const I lhs, const I rhs) {
+    if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+        cpu.cmp8(lhs, rhs);
+    } else if constexpr (sizeof(I) == sizeof(std::uint16_t)) {
+        cpu.cmp16(lhs, rhs);
+    } else {
+        cpu.cmp32(lhs, rhs);
+    }
+}
+
+}
+
+namespace {
+
+// Per width CPU operations of the F6 and F7 group.
+template <typename I>
+struct UnaryGroup;
+
+template <>
+struct UnaryGroup<std::uint8_t> {
+    using Wide = std::uint16_t;
+    static constexpr auto test = &CPU::test8;
+    static constexpr auto not_ = &CPU::not8;
+    static constexpr auto neg = &CPU::neg8;
+    static constexpr auto mul = &CPU::mul8;
+    static constexpr auto imul = &CPU::imul8_s;
+    static constexpr auto div = &CPU::div8;
+    static constexpr auto idiv = &CPU::idiv8;
+};
+
+template <>
+struct UnaryGroup<std::uint16_t> {
+    using Wide = std::uint32_t;
+    static constexpr auto test = &CPU::test16;
+    static constexpr auto not_ = &CPU::not16;
+    static constexpr auto neg = &CPU::neg16;
+    static constexpr auto mul = &CPU::mul16;
+    static constexpr auto imul = &CPU::imul16_s;
+    static constexpr auto div = &CPU::div16;
+    static constexpr auto idiv = &CPU::idiv16;
+};
+
+template <>
+struct UnaryGroup<std::uint32_t> {
+    using Wide = std::uint64_t;
+    static constexpr auto test = &CPU::test32;
+    static constexpr auto not_ = &CPU::not32;
+    static constexpr auto neg = &CPU::neg32;
+    static constexpr auto mul = &CPU::mul32;
+    static constexpr auto imul = &CPU::imul32_s;
+    static constexpr auto div = &CPU::div32;
+    static constexpr auto idiv = &CPU::idiv32;
+};
+
+// AX, DX:AX or EDX:EAX for operands of type I.
+template <typename I>
+typename UnaryGroup<I>::Wide wide_accumulator(const CPU& cpu) {
+    if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+        return get_low_word(cpu.R[EAX]);
+    } else if constexpr (sizeof(I) == sizeof(std::uint16_t)) {
+        return std::uint32_t(get_low_word(cpu.R[EDX])) << 16 | get_low_word(cpu.R[EAX]);
+    } else {
+        return std::uint64_t(cpu.R[EDX]) << 32 | cpu.R[EAX];
+    }
+}
+
+template <typename I>
+void set_wide_accumulator(CPU& cpu, const typename UnaryGroup<I>::Wide value) {
+    if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+        set_low_word(cpu.R[EAX], value);
+    } else if constexpr (sizeof(I) == sizeof(std::uint16_t)) {
+        set_low_word(cpu.R[EAX], get_low_word(value));
+        set_low_word(cpu.R[EDX], get_high_word(value));
+    } else {
+        cpu.R[EAX] = low_dword(value);
+        cpu.R[EDX] = high_dword(value);
+    }
+}
+
+}
+
+namespace {
+
+// Per width CPU operations of the C0/C1 and D0-D3 groups, indexed by reg.
+// reg 6 is an undocumented alias of shl.
+template <typename I>
+struct ShiftGroup;
+
+template <>
+struct ShiftGroup<std::uint8_t> {
+    static constexpr std::uint8_t(CPU::*ops[8])(std::uint8_t, std::uint8_t) = {
+        &CPU::rol8, &CPU::ror8, &CPU::rcl8, &CPU::rcr8, &CPU::shl8, &CPU::shr8, &CPU::shl8, &CPU::sar8};
+};
+
+template <>
+struct ShiftGroup<std::uint16_t> {
+    static constexpr std::uint16_t(CPU::*ops[8])(std::uint16_t, std::uint8_t) = {
+        &CPU::rol16, &CPU::ror16, &CPU::rcl16, &CPU::rcr16, &CPU::shl16, &CPU::shr16, &CPU::shl16, &CPU::sar16};
+};
+
+template <>
+struct ShiftGroup<std::uint32_t> {
+    static constexpr std::uint32_t(CPU::*ops[8])(std::uint32_t, std::uint8_t) = {
+        &CPU::rol32, &CPU::ror32, &CPU::rcl32, &CPU::rcr32, &CPU::shl32, &CPU::shr32, &CPU::shl32, &CPU::sar32};
+};
+
+constexpr Opcode shift_group_ops8[8] = {
+    Opcode::ROL8, Opcode::ROR8, Opcode::RCL8, Opcode::RCR8, Opcode::SHL8, Opcode::SHR8, Opcode::SHL8, Opcode::SAR8};
+
+constexpr Opcode shift_group_ops16_32[8] = {
+    Opcode::ROL16_32, Opcode::ROR16_32, Opcode::RCL16_32, Opcode::RCR16_32,
+    Opcode::SHL16_32, Opcode::SHR16_32, Opcode::SHL16_32, Opcode::SAR16_32};
+
+}
+
+namespace {
+
+// Per width CPU operations of BT, BTS, BTR and BTC, in the order of the reg
+// field of 0F BA less four.
+template <typename I>
+struct BitTestGroup;
+
+template <>
+struct BitTestGroup<std::uint16_t> {
+    static constexpr auto bt = &CPU::bt16;
+    static constexpr std::uint16_t(CPU::*modify[4])(std::uint16_t, std::uint16_t) = {
+        nullptr, &CPU::bts16, &CPU::btr16, &CPU::btc16};
+};
+
+template <>
+struct BitTestGroup<std::uint32_t> {
+    static constexpr auto bt = &CPU::bt32;
+    static constexpr std::uint32_t(CPU::*modify[4])(std::uint32_t, std::uint32_t) = {
+        nullptr, &CPU::bts32, &CPU::btr32, &CPU::btc32};
+};
+
+constexpr Opcode bit_test_ops[4] = {Opcode::BT, Opcode::BTS, Opcode::BTR, Opcode::BTC};
+
+}
+
+template <typename I>
+void Executor::execute_bit_test(const unsigned int op, const bool is_immediate) {
+    using SI = std::make_signed_t<I>;
+    constexpr unsigned int bits = std::numeric_limits<I>::digits;
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false, is_immediate);
+    unsigned long int next = pc + skip;
+    // An immediate offset wraps within the operand, a register offset is
+    // signed and may name any bit of memory around it.
+    const std::int32_t offset = is_immediate ? std::int32_t(cpu.mem[next++] & (bits - 1))
+                                             : std::int32_t(static_cast<SI>(cpu.R[ops.reg]));
+    std::uint8_t* host = nullptr;
+    if (ops.rm.is_ptr) {
+        // Whole operands below or above rm, rounding towards minus infinity.
+        constexpr unsigned int log2_bits = bits == 16 ? 4 : 5;
+        const auto displacement = static_cast<std::uint32_t>(offset >> log2_bits) * sizeof(I);
+        const auto address = static_cast<std::uint32_t>(effective_address(cpu.R, ops) + displacement);
+        host = cpu.mmu.translate(data_segment(ops), address, op == 0 ? MMU::READ : MMU::WRITE, sizeof(I));
+    }
+    auto suop = structure_unary_operands<I>(cpu.R, host, ops);
+    I& rm = suop;
+    const auto bit = static_cast<I>(static_cast<unsigned int>(offset) % bits);
+    if (op == 0) {
+        (cpu.*BitTestGroup<I>::bt)(rm, bit);
+    } else {
+        rm = (cpu.*BitTestGroup<I>::modify[op])(rm, bit);
+    }
+    last_op = bit_test_ops[op];
+    pc = next;
+    reset_prefixes();
+}
+
+std::uint8_t* Executor::xmm_operand_host(const Operands& ops, const std::uint8_t access, const std::size_t width,
+                                         const bool aligned) {
+    const Segment seg = data_segment(ops);
+    const address_t offset = effective_address(cpu.R, ops);
+    if (aligned && ((cpu.mmu.segment(seg).base + offset) & (sizeof(Xmm) - 1))) {
+        throw GP_FAULT{0};
+    }
+    return cpu.mmu.translate(seg, offset, access, width);
+}
+
+void Executor::execute_sse_binary(void (SSE::*op)(Xmm&, const Xmm&), const Opcode opcode) {
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+    Xmm& dest = sse.reg[ops.reg];
+    if (ops.rm.is_ptr) {
+        // Legacy encoded packed arithmetic wants its m128 aligned.
+        Xmm src;
+        src.load(xmm_operand_host(ops, MMU::READ, sizeof(Xmm), true));
+        (sse.*op)(dest, src);
+    } else {
+        (sse.*op)(dest, sse.reg[ops.rm.reg]);
+    }
+    last_op = opcode;
+    pc += skip;
+}
+
+void Executor::execute_sse_move(const bool store, const bool aligned, const Opcode opcode) {
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+    Xmm& reg = sse.reg[ops.reg];
+    if (!ops.rm.is_ptr) {
+        if (store) {
+            sse.reg[ops.rm.reg] = reg;
+        } else {
+            reg = sse.reg[ops.rm.reg];
+        }
+    } else if (store) {
+        reg.store(xmm_operand_host(ops, MMU::WRITE, sizeof(Xmm), aligned));
+    } else {
+        reg.load(xmm_operand_host(ops, MMU::READ, sizeof(Xmm), aligned));
+    }
+    last_op = opcode;
+    pc += skip;
+}
+
+void Executor::execute_movd_movq(const std::uint8_t opcode) {
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+    Xmm& reg = sse.reg[ops.reg];
+    if (opcode == 0x6E) {
+        // movd xmm, r/m32 clears the rest of the register.
+        const std::uint32_t value = ops.rm.is_ptr
+            ? mread<std::uint32_t>(xmm_operand_host(ops, MMU::READ, sizeof(std::uint32_t), false))
+            : cpu.R[ops.rm.reg];
+        reg = Xmm{};
+        reg.access<std::uint32_t>(0) = value;
+        last_op = Opcode::MOVD;
+    } else if (opcode == 0x7E && rep_prefix != RepPrefix::REPE) {
+        // movd r/m32, xmm
+        const std::uint32_t value = reg.access<std::uint32_t>(0);
+        if (ops.rm.is_ptr) {
+            mwrite(xmm_operand_host(ops, MMU::WRITE, sizeof(std::uint32_t), false), value);
+        } else {
+            cpu.R[ops.rm.reg] = value;
+        }
+        last_op = Opcode::MOVD;
+    } else if (opcode == 0x7E) {
+        // movq xmm, xmm/m64 clears the upper quadword.
+        const std::uint64_t value = ops.rm.is_ptr
+            ? mread<std::uint64_t>(xmm_operand_host(ops, MMU::READ, sizeof(std::uint64_t), false))
+            : sse.reg[ops.rm.reg].access<std::uint64_t>(0);
+        reg = Xmm{};
+        reg.access<std::uint64_t>(0) = value;
+        last_op = Opcode::MOVQ;
+    } else {
+        // movq xmm/m64, xmm, which clears the upper quadword of a register.
+        const std::uint64_t value = reg.access<std::uint64_t>(0);
+        if (ops.rm.is_ptr) {
+            mwrite(xmm_operand_host(ops, MMU::WRITE, sizeof(std::uint64_t), false), value);
+        } else {
+            sse.reg[ops.rm.reg] = Xmm{};
+            sse.reg[ops.rm.reg].access<std::uint64_t>(0) = value;
+        }
+        last_op = Opcode::MOVQ;
+    }
+    pc += skip;
+}
+
+void Executor::execute_mmx_binary(void (*op)(Mmx&, const Mmx&), const Opcode opcode) {
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+    Mmx src;
+    if (ops.rm.is_ptr) {
+        src.load(operand_host(ops, MMU::READ, sizeof(Mmx)));
+    } else {
+        src = fpu.V.mm(ops.rm.reg);
+    }
+    Mmx dest = fpu.V.mm(ops.reg);
+    op(dest, src);
+    fpu.V.set_mm(ops.reg, dest);
+    fpu.V.enter_mmx();
+    last_op = opcode;
+    pc += skip;
+}
+
+void Executor::execute_mmx_move(const std::uint8_t opcode) {
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+    switch (opcode) {
+        case 0x6E: {
+            // movd mm, r/m32 clears the upper dword.
+            Mmx value;
+            value.access<std::uint32_t>(0) = ops.rm.is_ptr
+                ? mread<std::uint32_t>(operand_host(ops, MMU::READ, sizeof(std::uint32_t)))
+                : cpu.R[ops.rm.reg];
+            fpu.V.set_mm(ops.reg, value);
+            last_op = Opcode::MOVD;
+        } break;
+        case 0x6F: {
+            Mmx value;
+            if (ops.rm.is_ptr) {
+                value.load(operand_host(ops, MMU::READ, sizeof(Mmx)));
+            } else {
+                value = fpu.V.mm(ops.rm.reg);
+            }
+            fpu.V.set_mm(ops.reg, value);
+            last_op = Opcode::MOVQ;
+        } break;
+        case 0x7E: {
+            const std::uint32_t value = fpu.V.mm(ops.reg).access<std::uint32_t>(0);
+            if (ops.rm.is_ptr) {
+                mwrite(operand_host(ops, MMU::WRITE, sizeof(std::uint32_t)), value);
+            } else {
+                cpu.R[ops.rm.reg] = value;
+            }
+            last_op = Opcode::MOVD;
+        } break;
+        default: {
+            const Mmx value = fpu.V.mm(ops.reg);
+            if (ops.rm.is_ptr) {
+                value.store(operand_host(ops, MMU::WRITE, sizeof(Mmx)));
+            } else {
+                fpu.V.set_mm(ops.rm.reg, value);
+            }
+            last_op = Opcode::MOVQ;
+        } break;
+    }
+    fpu.V.enter_mmx();
+    pc += skip;
+}
+
+bool Executor::execute_mmx_shift_imm(const std::uint8_t opcode) {
+    using Shift = void (*)(Mmx&, const Mmx&);
+    struct Form {
+        Shift op;
+        Opcode name;
+    };
+    // Indexed by the reg field, /2 psrl, /4 psra and /6 psll, then by the
+    // lane width. There is no quadword arithmetic shift.
+    static constexpr std::array<std::array<Form, 3>, 3> forms = {{
+        {{{&MMX::psrlw, Opcode::PSRLW}, {&MMX::psrld, Opcode::PSRLD}, {&MMX::psrlq, Opcode::PSRLQ}}},
+        {{{&MMX::psraw, Opcode::PSRAW}, {&MMX::psrad, Opcode::PSRAD}, {nullptr, Opcode::ENUM_END}}},
+        {{{&MMX::psllw, Opcode::PSLLW}, {&MMX::pslld, Opcode::PSLLD}, {&MMX::psllq, Opcode::PSLLQ}}},
+    }};
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const unsigned int group = (mrr >> 3) & 7u;
+    if (mrr < 0xC0 || group < 2 || group % 2 != 0) {
+        return false;
+    }
+    const Form& form = forms.at(group / 2 - 1).at(opcode - 0x71u);
+    if (form.op == nullptr) {
+        return false;
+    }
+    Mmx count;
+    count.access<std::uint64_t>(0) = cpu.mem[pc + 2];
+    const unsigned int reg = mrr & 7u;
+    Mmx value = fpu.V.mm(reg);
+    form.op(value, count);
+    fpu.V.set_mm(reg, value);
+    fpu.V.enter_mmx();
+    last_op = form.name;
+    pc += 3;
+    return true;
+}
+
+bool Executor::execute_mmx(const std::uint8_t opcode) {
+    switch (opcode) {
+        case 0x60: execute_mmx_binary(&MMX::punpcklbw, Opcode::PUNPCKLBW); break;
+        case 0x61: execute_mmx_binary(&MMX::punpcklwd, Opcode::PUNPCKLWD); break;
+        case 0x62: execute_mmx_binary(&MMX::punpckldq, Opcode::PUNPCKLDQ); break;
+        case 0x63: execute_mmx_binary(&MMX::packsswb, Opcode::PACKSSWB); break;
+        case 0x67: execute_mmx_binary(&MMX::packuswb, Opcode::PACKUSWB); break;
+        case 0x68: execute_mmx_binary(&MMX::punpckhbw, Opcode::PUNPCKHBW); break;
+        case 0x69: execute_mmx_binary(&MMX::punpckhwd, Opcode::PUNPCKHWD); break;
+        case 0x6A: execute_mmx_binary(&MMX::punpckhdq, Opcode::PUNPCKHDQ); break;
+        case 0x64: execute_mmx_binary(&MMX::pcmpgtb, Opcode::PCMPGTB); break;
+        case 0x65: execute_mmx_binary(&MMX::pcmpgtw, Opcode::PCMPGTW); break;
+        case 0x66: execute_mmx_binary(&MMX::pcmpgtd, Opcode::PCMPGTD); break;
+        case 0x6B: execute_mmx_binary(&MMX::packssdw, Opcode::PACKSSDW); break;
+        case 0x6E:
+        case 0x6F:
+        case 0x7E:
+        case 0x7F: execute_mmx_move(opcode); break;
+        case 0x71:
+        case 0x72:
+        case 0x73: return execute_mmx_shift_imm(opcode);
+        case 0x74: execute_mmx_binary(&MMX::pcmpeqb, Opcode::PCMPEQB); break;
+        case 0x75: execute_mmx_binary(&MMX::pcmpeqw, Opcode::PCMPEQW); break;
+        case 0x76: execute_mmx_binary(&MMX::pcmpeqd, Opcode::PCMPEQD); break;
+
+        case 0x77: {
+            fpu.V.empty();
+            last_op = Opcode::EMMS;
+            ++pc;
+        } break;
+
+        case 0xD1: execute_mmx_binary(&MMX::psrlw, Opcode::PSRLW); break;
+        case 0xD2: execute_mmx_binary(&MMX::psrld, Opcode::PSRLD); break;
+        case 0xD3: execute_mmx_binary(&MMX::psrlq, Opcode::PSRLQ); break;
+        case 0xD5: execute_mmx_binary(&MMX::pmullw, Opcode::PMULLW); break;
+        case 0xD8: execute_mmx_binary(&MMX::psubusb, Opcode::PSUBUSB); break;
+        case 0xD9: execute_mmx_binary(&MMX::psubusw, Opcode::PSUBUSW); break;
+        case 0xDB: execute_mmx_binary(&MMX::pand, Opcode::PAND); break;
+        case 0xDC: execute_mmx_binary(&MMX::paddusb, Opcode::PADDUSB); break;
+        case 0xDD: execute_mmx_binary(&MMX::paddusw, Opcode::PADDUSW); break;
+        case 0xDF: execute_mmx_binary(&MMX::pandn, Opcode::PANDN); break;
+        case 0xE1: execute_mmx_binary(&MMX::psraw, Opcode::PSRAW); break;
+        case 0xE2: execute_mmx_binary(&MMX::psrad, Opcode::PSRAD); break;
+        case 0xE5: execute_mmx_binary(&MMX::pmulhw, Opcode::PMULHW); break;
+        case 0xE8: execute_mmx_binary(&MMX::psubsb, Opcode::PSUBSB); break;
+        case 0xE9: execute_mmx_binary(&MMX::psubsw, Opcode::PSUBSW); break;
+        case 0xEB: execute_mmx_binary(&MMX::por, Opcode::POR); break;
+        case 0xEC: execute_mmx_binary(&MMX::paddsb, Opcode::PADDSB); break;
+        case 0xED: execute_mmx_binary(&MMX::paddsw, Opcode::PADDSW); break;
+        case 0xEF: execute_mmx_binary(&MMX::pxor, Opcode::PXOR); break;
+        case 0xF1: execute_mmx_binary(&MMX::psllw, Opcode::PSLLW); break;
+        case 0xF2: execute_mmx_binary(&MMX::pslld, Opcode::PSLLD); break;
+        case 0xF3: execute_mmx_binary(&MMX::psllq, Opcode::PSLLQ); break;
+        case 0xF5: execute_mmx_binary(&MMX::pmaddwd, Opcode::PMADDWD); break;
+        case 0xF8: execute_mmx_binary(&MMX::psubb, Opcode::PSUBB); break;
+        case 0xF9: execute_mmx_binary(&MMX::psubw, Opcode::PSUBW); break;
+        case 0xFA: execute_mmx_binary(&MMX::psubd, Opcode::PSUBD); break;
+        case 0xFC: execute_mmx_binary(&MMX::paddb, Opcode::PADDB); break;
+        case 0xFD: execute_mmx_binary(&MMX::paddw, Opcode::PADDW); break;
+        case 0xFE: execute_mmx_binary(&MMX::paddd, Opcode::PADDD); break;
+        default: return false;
+    }
+    return true;
+}
+
+void Executor::execute_string_compare(const std::uint8_t opcode) {
+    // pc is on the 3A escape, so the third opcode byte leads the modrm.
+    const auto [ops, skip] = decode_modregrm(cpu.mem[pc + 2], cpu.mem, pc + 1, false);
+    Xmm src;
+    if (ops.rm.is_ptr) {
+        src.load(xmm_operand_host(ops, MMU::READ, sizeof(Xmm), false));
+    } else {
+        src = sse.reg[ops.rm.reg];
+    }
+    const std::uint8_t control = cpu.mem[pc + 1 + skip];
+    const bool is_explicit = opcode < 0x62;
+    const bool is_index = opcode & 1;
+    const SSE::StringMatch match = is_explicit
+        ? sse.pcmpestr(sse.reg[ops.reg], std::int32_t(cpu.R[EAX]), src, std::int32_t(cpu.R[EDX]), control)
+        : sse.pcmpistr(sse.reg[ops.reg], src, control);
+    if (is_index) {
+        cpu.R[ECX] = SSE::string_index(match, control);
+    } else {
+        sse.reg[0] = SSE::string_mask(match, control);
+    }
+    cpu.flags.carry = match.carry;
+    cpu.flags.zero = match.zero;
+    cpu.flags.sign = match.sign;
+    cpu.flags.overflow = match.overflow;
+    cpu.flags.adjust = false;
+    cpu.flags.parity = false;
+    last_op = is_explicit ? (is_index ? Opcode::PCMPESTRI : Opcode::PCMPESTRM)
+                          : (is_index ? Opcode::PCMPISTRI : Opcode::PCMPISTRM);
+    pc += 1 + skip + 1;
+}
+
+bool Executor::execute_sse(const std::uint8_t opcode) {
+    const bool has_66 = is_16_bit_mode;
+    const bool has_f3 = rep_prefix == RepPrefix::REPE;
+    // F3 only selects movdqu and movq here; the scalar ss and sd forms are
+    // not implemented.
+    if (rep_prefix == RepPrefix::REPNE || (has_f3 && opcode != 0x6F && opcode != 0x7E && opcode != 0x7F)) {
+        return false;
+    }
+    switch (opcode) {
+        case 0x10: execute_sse_move(false, false, has_66 ? Opcode::MOVUPD : Opcode::MOVUPS); break;
+        case 0x11: execute_sse_move(true, false, has_66 ? Opcode::MOVUPD : Opcode::MOVUPS); break;
+        case 0x28: execute_sse_move(false, true, has_66 ? Opcode::MOVAPD : Opcode::MOVAPS); break;
+        case 0x29: execute_sse_move(true, true, has_66 ? Opcode::MOVAPD : Opcode::MOVAPS); break;
+
+        // Hints: prefetch and the multi-byte nop compilers pad with.
+        case 0x18:
+        case 0x1F: {
+            const auto [ops, skip] = decode_modregrm(cpu.mem[pc + 1], cpu.mem, pc, false);
+            last_op = opcode == 0x18 ? Opcode::PREFETCH : Opcode::NOP;
+            pc += skip;
+        } break;
+
+        case 0x54: execute_sse_binary(&SSE::pand, has_66 ? Opcode::ANDPD : Opcode::ANDPS); break;
+        case 0x55: execute_sse_binary(&SSE::pandn, has_66 ? Opcode::ANDNPD : Opcode::ANDNPS); break;
+        case 0x56: execute_sse_binary(&SSE::por, has_66 ? Opcode::ORPD : Opcode::ORPS); break;
+        case 0x57: execute_sse_binary(&SSE::pxor, has_66 ? Opcode::XORPD : Opcode::XORPS); break;
+        case 0x58: has_66 ? execute_sse_binary(&SSE::addpd, Opcode::ADDPD) : execute_sse_binary(&SSE::addps, Opcode::ADDPS); break;
+        case 0x59: has_66 ? execute_sse_binary(&SSE::mulpd, Opcode::MULPD) : execute_sse_binary(&SSE::mulps, Opcode::MULPS); break;
+        case 0x5C: has_66 ? execute_sse_binary(&SSE::subpd, Opcode::SUBPD) : execute_sse_binary(&SSE::subps, Opcode::SUBPS); break;
+        case 0x5E: has_66 ? execute_sse_binary(&SSE::divpd, Opcode::DIVPD) : execute_sse_binary(&SSE::divps, Opcode::DIVPS); break;
+
+        case 0x3A: {
+            // Of the three byte space only the SSE4.2 string compares.
+            if (!has_66 || cpu.mem[pc + 1] < 0x60 || cpu.mem[pc + 1] > 0x63) {
+                return false;
+            }
+            execute_string_compare(cpu.mem[pc + 1]);
+        } break;
+
+        case 0xAE: {
+            // lfence, mfence and sfence order nothing for a single guest
+            // thread; the memory forms are fxsave and friends.
+            const std::uint8_t mrr = cpu.mem[pc + 1];
+            if (has_66 || mrr < 0xE8) {
+                return false;
+            }
+            last_op = Opcode::FENCE;
+            pc += 2;
+        } break;
+
+        default: {
+            // Without 66 the rest of the space is MMX.
+            if (!has_66 && !has_f3) {
+                if (!execute_mmx(opcode)) {
+                    return false;
+                }
+                break;
+            }
+            switch (opcode) {
+                case 0x60: execute_sse_binary(&SSE::punpcklbw, Opcode::PUNPCKLBW); break;
+                case 0x61: execute_sse_binary(&SSE::punpcklwd, Opcode::PUNPCKLWD); break;
+                case 0x62: execute_sse_binary(&SSE::punpckldq, Opcode::PUNPCKLDQ); break;
+                case 0x6C: execute_sse_binary(&SSE::punpcklqdq, Opcode::PUNPCKLQDQ); break;
+                case 0x6E: execute_movd_movq(opcode); break;
+                case 0x6F: execute_sse_move(false, !has_f3, has_f3 ? Opcode::MOVDQU : Opcode::MOVDQA); break;
+
+                case 0x70: {
+                    const std::uint8_t mrr = cpu.mem[pc + 1];
+                    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+                    Xmm src;
+                    if (ops.rm.is_ptr) {
+                        src.load(xmm_operand_host(ops, MMU::READ, sizeof(Xmm), true));
+                    } else {
+                        src = sse.reg[ops.rm.reg];
+                    }
+                    sse.pshufd(sse.reg[ops.reg], src, cpu.mem[pc + skip]);
+                    last_op = Opcode::PSHUFD;
+                    pc += skip + 1;
+                } break;
+
+                case 0x74: execute_sse_binary(&SSE::pcmpeqb, Opcode::PCMPEQB); break;
+                case 0x75: execute_sse_binary(&SSE::pcmpeqw, Opcode::PCMPEQW); break;
+                case 0x76: execute_sse_binary(&SSE::pcmpeqd, Opcode::PCMPEQD); break;
+                case 0x7E: execute_movd_movq(opcode); break;
+                case 0x7F: execute_sse_move(true, !has_f3, has_f3 ? Opcode::MOVDQU : Opcode::MOVDQA); break;
+                case 0xD4: execute_sse_binary(&SSE::paddq, Opcode::PADDQ); break;
+                case 0xD6: execute_movd_movq(opcode); break;
+
+                case 0xD7: {
+                    const std::uint8_t mrr = cpu.mem[pc + 1];
+                    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+                    if (ops.rm.is_ptr) {
+                        return false;
+                    }
+                    cpu.R[ops.reg] = sse.pmovmskb(sse.reg[ops.rm.reg]);
+                    last_op = Opcode::PMOVMSKB;
+                    pc += skip;
+                } break;
+
+                case 0xDA: execute_sse_binary(&SSE::pminub, Opcode::PMINUB); break;
+                case 0xDB: execute_sse_binary(&SSE::pand, Opcode::PAND); break;
+                case 0xDF: execute_sse_binary(&SSE::pandn, Opcode::PANDN); break;
+                case 0xEB: execute_sse_binary(&SSE::por, Opcode::POR); break;
+                case 0xEF: execute_sse_binary(&SSE::pxor, Opcode::PXOR); break;
+                case 0xF8: execute_sse_binary(&SSE::psubb, Opcode::PSUBB); break;
+                case 0xF9: execute_sse_binary(&SSE::psubw, Opcode::PSUBW); break;
+                case 0xFA: execute_sse_binary(&SSE::psubd, Opcode::PSUBD); break;
+                case 0xFB: execute_sse_binary(&SSE::psubq, Opcode::PSUBQ); break;
+                case 0xFC: execute_sse_binary(&SSE::paddb, Opcode::PADDB); break;
+                case 0xFD: execute_sse_binary(&SSE::paddw, Opcode::PADDW); break;
+                case 0xFE: execute_sse_binary(&SSE::paddd, Opcode::PADDD); break;
+                default: return false;
+            }
+        } break;
+    }
+    reset_prefixes();
+    return true;
+}
+
+std::uint8_t Executor::shift_count(const ShiftCount source, unsigned long int& next) {
+    if (source == ShiftCount::IMM8) {
+        return cpu.mem[next++];
+    }
+    return source == ShiftCount::ONE ? 1 : get_low_byte(cpu.R[ECX]);
+}
+
+template <typename I>
+void Executor::execute_shift_group(const ShiftCount source) {
+    constexpr bool is_8bit = sizeof(I) == sizeof(std::uint8_t);
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, is_8bit, true);
+    auto suop = structure_unary_operands<I>(cpu.R, operand_host(ops, MMU::WRITE, sizeof(I)), ops);
+    I& rm = suop;
+    unsigned long int next = pc + skip;
+    const std::uint8_t count = shift_count(source, next);
+    rm = (cpu.*ShiftGroup<I>::ops[ops.reg])(rm, count);
+    last_op = is_8bit ? shift_group_ops8[ops.reg] : shift_group_ops16_32[ops.reg];
+    pc = next;
+    reset_prefixes();
+}
+
+void Executor::execute_double_shift(const bool left, const ShiftCount source) {
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+    auto* host = operand_host(ops, MMU::WRITE, operand_width());
+    unsigned long int next = pc + skip;
+    const std::uint8_t count = shift_count(source, next);
+    if (is_16_bit_mode) {
+        auto so = structure_operands<std::uint16_t>(cpu.R, host, ops);
+        auto& dest = so.is_rm_ptr ? so.rm_m_access() : so.rm_r_access();
+        dest = left ? cpu.shld16(dest, so.reg_access(), count) : cpu.shrd16(dest, so.reg_access(), count);
+    } else {
+        auto so = structure_operands<std::uint32_t>(cpu.R, host, ops);
+        auto& dest = so.is_rm_ptr ? so.rm_m_access() : so.rm_r_access();
+        dest = left ? cpu.shld32(dest, so.reg_access(), count) : cpu.shrd32(dest, so.reg_access(), count);
+    }
+    last_op = left ? Opcode::SHLD : Opcode::SHRD;
+    pc = next;
+    reset_prefixes();
+}
+
+template <typename I>
+void Executor::execute_unary_group() {
+    using Ops = UnaryGroup<I>;
+    constexpr bool is_8bit = sizeof(I) == sizeof(std::uint8_t);
+    const std::uint8_t mrr = cpu.mem[pc + 1];
+    const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, is_8bit, true);
+    // Only not and neg store to rm.
+    const std::uint8_t access = ops.reg == 2 || ops.reg == 3 ? MMU::WRITE : MMU::READ;
+    auto suop = structure_unary_operands<I>(cpu.R, operand_host(ops, access, sizeof(I)), ops);
+    I& rm = suop;
+    // pc only moves once the instruction has completed, so a #DE leaves it
+    // on the faulting div.
+    unsigned long int next = pc + skip;
+    switch (ops.reg) {
+        case 0:
+        case 1: {
+            (cpu.*Ops::test)(rm, mread<I>(&cpu.mem[next]));
+            next += sizeof(I);
+            last_op = is_8bit ? Opcode::TEST8 : Opcode::TEST16_32;
+        } break;
+
+        case 2: {
+            rm = (cpu.*Ops::not_)(rm);
+            last_op = is_8bit ? Opcode::NOT8 : Opcode::NOT16_32;
+        } break;
+
+        case 3: {
+            rm = (cpu.*Ops::neg)(rm);
+            last_op = is_8bit ? Opcode::NEG8 : Opcode::NEG16_32;
+        } break;
+
+        case 4: {
+            set_wide_accumulator<I>(cpu, (cpu.*Ops::mul)(I(cpu.R[EAX]), rm));
+            last_op = is_8bit ? Opcode::MUL8 : Opcode::MUL16_32;
+        } break;
+
+        case 5: {
+            set_wide_accumulator<I>(cpu, (cpu.*Ops::imul)(I(cpu.R[EAX]), rm));
+            last_op = is_8bit ? Opcode::IMUL8 : Opcode::IMUL16_32;
+        } break;
+
+        case 6: {
+            set_wide_accumulator<I>(cpu, (cpu.*Ops::div)(wide_accumulator<I>(cpu), rm));
+            last_op = is_8bit ? Opcode::DIV8 : Opcode::DIV16_32;
+        } break;
+
+        case 7: {
+            set_wide_accumulator<I>(cpu, (cpu.*Ops::idiv)(wide_accumulator<I>(cpu), rm));
+            last_op = is_8bit ? Opcode::IDIV8 : Opcode::IDIV16_32;
+        } break;
+    }
+    pc = next;
+    reset_prefixes();
+}
+
+template <typename I>
+void Executor::execute_movs() {
+    const Segment src_seg = segment_override.value_or(Segment::DS);
+    const bool rep = rep_prefix != RepPrefix::NONE;
+    std::uint32_t count = rep ? cpu.R[ECX] : 1;
+    if (rep && count && !cpu.flags.direction) {
+        const std::uint64_t length = std::uint64_t(count) * sizeof(I);
+        const auto* src = bulk_range(src_seg, cpu.R[ESI], length, MMU::READ);
+        auto* dest = bulk_range(Segment::ES, cpu.R[EDI], length, MMU::WRITE);
+        // Copying forwards onto a later overlapping destination repeats the
+        // source, which memmove would not.
+        if (src && dest && (dest <= src || dest >= src + length)) {
+            std::memmove(dest, src, length);
+            cpu.R[ESI] += std::uint32_t(length);
+            cpu.R[EDI] += std::uint32_t(length);
+            cpu.R[ECX] = 0;
+            return;
+        }
+    }
+    const std::uint32_t step = cpu.flags.direction ? std::uint32_t(-sizeof(I)) : sizeof(I);
+    for (; count; --count) {
+        const I value = mread<I>(cpu.mmu.translate(src_seg, cpu.R[ESI], MMU::READ, sizeof(I)));
+        mwrite<I>(cpu.mmu.translate(Segment::ES, cpu.R[EDI], MMU::WRITE, sizeof(I)), value);
+        cpu.R[ESI] += step;
+        cpu.R[EDI] += step;
+        if (rep) {
+            --cpu.R[ECX];
+        }
+    }
+}
+
+template <typename I>
+void Executor::execute_stos() {
+    const I value = I(cpu.R[EAX]);
+    const bool rep = rep_prefix != RepPrefix::NONE;
+    std::uint32_t count = rep ? cpu.R[ECX] : 1;
+    if (rep && count && !cpu.flags.direction) {
+        const std::uint64_t length = std::uint64_t(count) * sizeof(I);
+        if (auto* dest = bulk_range(Segment::ES, cpu.R[EDI], length, MMU::WRITE)) {
+            if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+                std::memset(dest, value, length);
+            } else {
+                // Double the filled prefix until it covers the range.
+                mwrite<I>(dest, value);
+                for (std::uint64_t filled = sizeof(I); filled < length; filled *= 2) {
+                    std::memcpy(dest + filled, dest, std::min(filled, length - filled));
+                }
+            }
+            cpu.R[EDI] += std::uint32_t(length);
+            cpu.R[ECX] = 0;
+            return;
+        }
+    }
+    const std::uint32_t step = cpu.flags.direction ? std::uint32_t(-sizeof(I)) : sizeof(I);
+    for (; count; --count) {
+        mwrite<I>(cpu.mmu.translate(Segment::ES, cpu.R[EDI], MMU::WRITE, sizeof(I)), value);
+        cpu.R[EDI] += step;
+        if (rep) {
+            --cpu.R[ECX];
+        }
+    }
+}
+
+template <typename I>
+void Executor::execute_scas() {
+    const I acc = I(cpu.R[EAX]);
+    const std::uint32_t step = cpu.flags.direction ? std::uint32_t(-sizeof(I)) : sizeof(I);
+    if (rep_prefix == RepPrefix::NONE) {
+        compare<I>(cpu, acc, mread<I>(cpu.mmu.translate(Segment::ES, cpu.R[EDI], MMU::READ, sizeof(I))));
+        cpu.R[EDI] += step;
+        return;
+    }
+    if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+        if (!cpu.flags.direction) {
+            while (cpu.R[ECX]) {
+                std::size_t chunk;
+                const auto* host = string_chunk(Segment::ES, cpu.R[EDI], cpu.R[ECX], chunk);
+                const std::size_t hit = rep_prefix == RepPrefix::REPNE ? find_byte(host, chunk, acc)
+                                                                       : find_other_byte(host, chunk, acc);
+                // Up to and including the element that ended the run.
+                const std::size_t done = std::min(hit + 1, chunk);
+                compare<I>(cpu, acc, host[done - 1]);
+                cpu.R[EDI] += std::uint32_t(done);
+                cpu.R[ECX] -= std::uint32_t(done);
+                if (hit < chunk) {
+                    break;
+                }
+            }
+            return;
+        }
+    }
+    while (cpu.R[ECX]) {
+        compare<I>(cpu, acc, mread<I>(cpu.mmu.translate(Segment::ES, cpu.R[EDI], MMU::READ, sizeof(I))));
+        cpu.R[EDI] += step;
+        --cpu.R[ECX];
+        if (rep_done()) {
+            break;
+        }
+    }
+}
+
+template <typename I>
+void Executor::execute_cmps() {
+    const Segment src_seg = segment_override.value_or(Segment::DS);
+    const std::uint32_t step = cpu.flags.direction ? std::uint32_t(-sizeof(I)) : sizeof(I);
+    const auto element = [&] {
+        const I src = mread<I>(cpu.mmu.translate(src_seg, cpu.R[ESI], MMU::READ, sizeof(I)));
+        const I dest = mread<I>(cpu.mmu.translate(Segment::ES, cpu.R[EDI], MMU::READ, sizeof(I)));
+        compare<I>(cpu, src, dest);
+        cpu.R[ESI] += step;
+        cpu.R[EDI] += step;
+    };
+    if (rep_prefix == RepPrefix::NONE) {
+        element();
+        return;
+    }
+    if constexpr (sizeof(I) == sizeof(std::uint8_t)) {
+        if (!cpu.flags.direction) {
+            while (cpu.R[ECX]) {
+                std::size_t src_chunk;
+                std::size_t dest_chunk;
+                const auto* src = string_chunk(src_seg, cpu.R[ESI], cpu.R[ECX], src_chunk);
+                const auto* dest = string_chunk(Segment::ES, cpu.R[EDI], cpu.R[ECX], dest_chunk);
+                const std::size_t chunk = std::min(src_chunk, dest_chunk);
+                const std::size_t hit = rep_prefix == RepPrefix::REPNE ? find_match(src, dest, chunk)
+                                                                       : find_mismatch(src, dest, chunk);
+                const std::size_t done = std::min(hit + 1, chunk);
+                compare<I>(cpu, src[done - 1], dest[done - 1]);
+                cpu.R[ESI] += std::uint32_t(done);
+                cpu.R[EDI] += std::uint32_t(done);
+                cpu.R[ECX] -= std::uint32_t(done);
+                if (hit < chunk) {
+                    break;
+                }
+            }
+            return;
+        }
+    }
+    while (cpu.R[ECX]) {
+        element();
+        --cpu.R[ECX];
+        if (rep_done()) {
+            break;
+        }
+    }
+}
+
+template <typename I>
+void Executor::execute_lods() {
+    const Segment src_seg = segment_override.value_or(Segment::DS);
+    const bool rep = rep_prefix != RepPrefix::NONE;
+    std::uint32_t count = rep ? cpu.R[ECX] : 1;
+    const std::uint32_t step = cpu.flags.direction ? std::uint32_t(-sizeof(I)) : sizeof(I);
+    for (; count; --count) {
+        set_accumulator<I>(cpu.R[EAX], mread<I>(cpu.mmu.translate(src_seg, cpu.R[ESI], MMU::READ, sizeof(I))));
+        cpu.R[ESI] += step;
+        if (rep) {
+            --cpu.R[ECX];
+        }
+    }
+}
+
+bool Executor::run_loop_idiom(const address_t head, const address_t end, const bool is_cycles, unsigned int& cycles) {
+    // Paging needs every access to go through translate, idiom_range checks
+    // page flags, and hooks or missing X need every fetch checked.
+    if (cpu.mmu.paging() || is_16_bit_mode || segment_override || end > cpu.mem.size()) {
+        return false;
+    }
+    if ((cpu.mem.fetch_flags(head) & (Memory::PAGE_EXEC | Memory::PAGE_HOOK)) != Memory::PAGE_EXEC ||
+        (cpu.mem.fetch_flags(end - 1) & (Memory::PAGE_EXEC | Memory::PAGE_HOOK)) != Memory::PAGE_EXEC) {
+        return false;
+    }
+    const auto shape = match_loop_idiom(std::span<const std::uint8_t>(&cpu.mem[head], end - head));
+    if (!shape) {
+        return false;
+    }
+    // The taken jnz follows dec ecx, so ECX is non zero and counts the trips
+    // still to run. The jnz itself is charged by the caller.
+    const std::uint32_t n = cpu.R[ECX];
+    const std::uint64_t retired = std::uint64_t(n) * shape->instructions;
+    if (is_cycles && retired >= cycles) {
+        return false;
+    }
+
+    // Each case leaves the flags as the last trip's instructions before dec
+    // ecx would have, by replaying them on that trip's operands.
+    switch (shape->idiom) {
+        case LoopIdiom::SPIN:
+            break;
+
+        case LoopIdiom::FILL8: {
+            auto* dest = idiom_range(cpu.R[EDI], n, head, end, true);
+            if (!dest) {
+                return false;
+            }
+            std::memset(dest, get_low_byte(cpu.R[EAX]), n);
+            cpu.R[EDI] = cpu.inc32(cpu.R[EDI] + n - 1);
+        } break;
+
+        case LoopIdiom::FILL32: {
+            auto* dest = idiom_range(cpu.R[EDI], std::uint64_t(n) * 4, head, end, true);
+            if (!dest) {
+                return false;
+            }
+            for (std::uint32_t i = 0; i < n; ++i) {
+                mwrite<std::uint32_t>(dest + 4 * std::size_t(i), cpu.R[EAX]);
+            }
+            cpu.R[EDI] = cpu.add32(cpu.R[EDI] + 4 * (n - 1), 4);
+        } break;
+
+        case LoopIdiom::COPY8: {
+            const std::uint32_t src_offset = cpu.R[ESI];
+            const std::uint32_t dest_offset = cpu.R[EDI];
+            auto* src = idiom_range(src_offset, n, head, end, false);
+            auto* dest = idiom_range(dest_offset, n, head, end, true);
+            // Copying forwards a byte at a time onto a later overlapping
+            // destination repeats the source, which memmove would not.
+            if (!src || !dest || (dest > src && dest < src + n)) {
+                return false;
+            }
+            std::memmove(dest, src, n);
+            set_low_byte(cpu.R[EAX], dest[n - 1]);
+            cpu.R[ESI] = cpu.inc32(src_offset + n - 1);
+            cpu.R[EDI] = cpu.inc32(dest_offset + n - 1);
+        } break;
+
+        case LoopIdiom::SUM8: {
+            const auto* src = idiom_range(cpu.R[ESI], n, head, end, false);
+            if (!src) {
+                return false;
+            }
+            std::uint8_t sum = get_low_byte(cpu.R[EAX]);
+            for (std::uint32_t i = 0; i + 1 < n; ++i) {
+                sum = std::uint8_t(sum + src[i]);
+            }
+            set_low_byte(cpu.R[EAX], cpu.add8(sum, src[n - 1]));
+            cpu.R[ESI] = cpu.inc32(cpu.R[ESI] + n - 1);
+        } break;
+    }
+    cpu.R[ECX] = cpu.dec32(1);
+    if (is_cycles) {
+        cycles -= static_cast<unsigned int>(retired);
+    }
+    pc = end;
+    return true;
+}
+
+ExitReason Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned int cycles, [[maybe_unused]] unsigned int start) {
+    cpu.mmu.watch_hit.reset();
     for (; !is_cycles || cycles > 0; ) {
         // std::cout << "Opcode address " << std::hex << std::size_t(&cpu.mem[pc]) << std::endl;
         // std::cout << "Opcode: " << std::hex << uint(cpu.mem[pc]) << ", Counter: " << pc << std::endl;
-        const std::uint8_t opcode = cpu.mem[pc]; 
+        // One test covers both a page without X and a page with hooks.
+        const std::uint8_t page = cpu.mem.fetch_flags(pc);
+        if ((page & (Memory::PAGE_EXEC | Memory::PAGE_HOOK)) != Memory::PAGE_EXEC) [[unlikely]] {
+            if (!(page & Memory::PAGE_EXEC)) {
+                throw PAGE_FAULT{address_t(pc), MMU::FETCH_FAULT};
+            }
+            if (run_hook()) {
+                if (is_cycles) {
+                    --cycles;
+                }
+                continue;
+            }
+        }
+        const std::uint8_t opcode = cpu.mem[pc];
+        bool is_prefix = false;
         switch (opcode) {
 
             case 0x0: {
@@ -156,7 +1174,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             } break;
 
             case 0x7: {
-                cpu.es = cpu.pop16();
+                cpu.load_segment(Segment::ES, cpu.pop16());
                 last_op = Opcode::POP_ES;
                 ++pc;
             } break;
@@ -201,6 +1219,67 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0xF: {
                 ++pc;
                 switch (std::uint8_t sOpcode = cpu.mem[pc]; sOpcode) {
+                    case 0x01: {
+                        const std::uint8_t mrr = cpu.mem[pc + 1];
+                        const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+                        if (!ops.rm.is_ptr) {
+                            std::stringstream ss;
+                            ss << "Unhandled Opcode: 0xF 0x1 " << std::hex << uint(mrr);
+                            throw std::logic_error(ss.str());
+                        }
+                        switch (ops.reg) {
+                            case 2: {
+                                const auto* host = operand_host(ops, MMU::READ, sizeof(std::uint16_t) + sizeof(std::uint32_t));
+                                cpu.mmu.gdtr.limit = mread<std::uint16_t>(host);
+                                cpu.mmu.gdtr.base = mread<std::uint32_t>(host + sizeof(std::uint16_t));
+                                last_op = Opcode::LGDT;
+                            } break;
+
+                            case 7: {
+                                const auto seg = data_segment(ops);
+                                cpu.mmu.invlpg(cpu.mmu.segment(seg).base + effective_address(cpu.R, ops));
+                                last_op = Opcode::INVLPG;
+                            } break;
+
+                            default: {
+                                std::stringstream ss;
+                                ss << "Unhandled Opcode: 0xF 0x1 /" << uint(ops.reg);
+                                throw std::logic_error(ss.str());
+                            } break;
+                        }
+                        pc += skip;
+                    } break;
+
+                    case 0x20: {
+                        const auto [mod, reg, rm] = split_modregrm(cpu.mem[pc + 1]);
+                        switch (reg) {
+                            case 0: cpu.R[rm] = cpu.mmu.cr0(); break;
+                            case 3: cpu.R[rm] = cpu.mmu.cr3(); break;
+                            default: {
+                                std::stringstream ss;
+                                ss << "Unhandled control register: cr" << uint(reg);
+                                throw std::logic_error(ss.str());
+                            } break;
+                        }
+                        last_op = Opcode::MOV_CR;
+                        pc += 2;
+                    } break;
+
+                    case 0x22: {
+                        const auto [mod, reg, rm] = split_modregrm(cpu.mem[pc + 1]);
+                        switch (reg) {
+                            case 0: cpu.mmu.write_cr0(cpu.R[rm]); break;
+                            case 3: cpu.mmu.write_cr3(cpu.R[rm]); break;
+                            default: {
+                                std::stringstream ss;
+                                ss << "Unhandled control register: cr" << uint(reg);
+                                throw std::logic_error(ss.str());
+                            } break;
+                        }
+                        last_op = Opcode::MOV_CR;
+                        pc += 2;
+                    } break;
+
                     case 0x31: {
                         cpu.rdtsc();
                     } break;
@@ -304,20 +1383,94 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                     } break;
 
                     case 0xA2: {
-                        // cpu.cpuid();
+                        cpu.cpuid(cpuid_model);
+                        last_op = Opcode::CPUID;
                         ++pc;
                     } break;
 
+                    case 0xA3: {
+                        execute_bit_test(0);
+                    } break;
+
+                    case 0xA4: {
+                        execute_double_shift(true, ShiftCount::IMM8);
+                    } break;
+
+                    case 0xA5: {
+                        execute_double_shift(true, ShiftCount::CL);
+                    } break;
+
                     case 0xA8: {
                         cpu.push16(cpu.gs);
                         last_op = Opcode::PUSH_GS;
                         ++pc;
                     } break;
 
+                    case 0xAB: {
+                        execute_bit_test(1);
+                    } break;
+
+                    case 0xAC: {
+                        execute_double_shift(false, ShiftCount::IMM8);
+                    } break;
+
+                    case 0xAD: {
+                        execute_double_shift(false, ShiftCount::CL);
+                    } break;
+
                     case 0xAF: {
                         execute_binary_operation_16_32_bit<REG_DEST>(&CPU::imul16, &CPU::imul32);
                     } break;
 
+                    case 0xB3: {
+                        execute_bit_test(2);
+                    } break;
+
+                    case 0xB8: {
+                        // Only F3 0F B8 is defined, as POPCNT.
+                        if (rep_prefix != RepPrefix::REPE) {
+                            throw std::logic_error("Unhandled Opcode: 0xF 0xB8");
+                        }
+                        execute_binary_operation_16_32_bit<REG_DEST>(&CPU::popcnt16, &CPU::popcnt32);
+                        last_op = Opcode::POPCNT;
+                    } break;
+
+                    case 0xBA: {
+                        const unsigned int reg = (cpu.mem[pc + 1] >> 3) & 0x7;
+                        if (reg < 4) {
+                            std::stringstream ss;
+                            ss << "Unhandled Opcode: 0xF 0xBA " << std::hex << reg;
+                            throw std::logic_error(ss.str());
+                        }
+                        execute_bit_test(reg - 4, true);
+                    } break;
+
+                    case 0xBB: {
+                        execute_bit_test(3);
+                    } break;
+
+                    // With F3 these are TZCNT and LZCNT, which older parts
+                    // decode as BSF and BSR.
+                    case 0xBC: {
+                        if (rep_prefix == RepPrefix::REPE) {
+                            execute_binary_operation_16_32_bit<REG_DEST>(&CPU::tzcnt16, &CPU::tzcnt32);
+                            last_op = Opcode::TZCNT;
+                        } else {
+                            execute_binary_operation_16_32_bit<REG_DEST>(&CPU::bsf16, &CPU::bsf32);
+                            last_op = Opcode::BSF;
+                        }
+                    } break;
+
+                    case 0xBD: {
+                        if (rep_prefix == RepPrefix::REPE) {
+                            execute_binary_operation_16_32_bit<REG_DEST>(&CPU::lzcnt16, &CPU::lzcnt32);
+                            last_op = Opcode::LZCNT;
+                        } else {
+                            execute_binary_operation_16_32_bit<REG_DEST>(&CPU::bsr16, &CPU::bsr32);
+                            last_op = Opcode::BSR;
+                        }
+                    } break;
+
                     case 0xC8 ... 0xCF: {
                         auto& reg = cpu.regat(sOpcode - 0xC8);
                         reg = cpu.bswap(reg);
@@ -325,6 +1478,9 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                     } break;
 
                     default: {
+                        if (execute_sse(sOpcode)) {
+                            break;
+                        }
                         std::stringstream ss;
                         ss << "Unhandled Opcode: 0xF " << std::hex << uint(sOpcode);
                         throw std::logic_error(ss.str()); 
@@ -370,7 +1526,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             } break;
 
             case 0x17: {
-                cpu.ss = cpu.pop16();
+                cpu.load_segment(Segment::SS, cpu.pop16());
                 last_op = Opcode::POP_SS;
                 ++pc;
             } break;
@@ -412,7 +1568,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             } break;
 
             case 0x1F: {
-                cpu.ds = cpu.pop16();
+                cpu.load_segment(Segment::DS, cpu.pop16());
                 last_op = Opcode::POP_DS;
                 ++pc;
             } break;
@@ -450,6 +1606,8 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             // LCOV_EXCL_START
             case 0x26: {
                 // ES segment override.
+                segment_override = Segment::ES;
+                is_prefix = true;
                 ++pc;
             } break;
             // LCOV_EXCL_STOP
@@ -493,6 +1651,8 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             // LCOV_EXCL_START
             case 0x2E: {
                 // CS segment override.
+                segment_override = Segment::CS;
+                is_prefix = true;
                 ++pc;
             } break;
             // LCOV_EXCL_STOP
@@ -536,6 +1696,8 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             // LCOV_EXCL_START
             case 0x36: {
                 // SS segment override.
+                segment_override = Segment::SS;
+                is_prefix = true;
                 ++pc;
             } break;
             // LCOV_EXCL_STOP
@@ -579,6 +1741,8 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             // LCOV_EXCL_START
             case 0x3E: {
                 // DS segment override.
+                segment_override = Segment::DS;
+                is_prefix = true;
                 ++pc;
             } break;
             // LCOV_EXCL_STOP
@@ -602,7 +1766,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             } break;
 
             case 0x48 ... 0x4F: {
-                std::uint32_t& reg = cpu.regat(opcode - 0x40);
+                std::uint32_t& reg = cpu.regat(opcode - 0x48);
                 if (is_16_bit_mode) {
                     set_low_word(reg, cpu.dec16(reg));
                     last_op = Opcode::DEC16;
@@ -670,33 +1834,31 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             // LCOV_EXCL_START
             case 0x64: {
                 // FS segment override.
+                segment_override = Segment::FS;
+                is_prefix = true;
                 ++pc;
             } break;
             // LCOV_EXCL_STOP
 
             case 0x65: {
                 // GS segment override.
+                segment_override = Segment::GS;
+                is_prefix = true;
                 ++pc;
             } break;
 
             case 0x66: {
-                if (cpu.mem[pc + 1] == 0xF) {
-                    switch (std::uint8_t sOpcode = cpu.mem[pc + 2]; sOpcode) {
-                        default: {
-                            std::stringstream ss;
-                            ss << "Unhandled Opcode: 0x66 0xF " << int(sOpcode);
-                        } break;
-                    }
-                } else {
-                    // Operand size override prefix.
-                    is_16_bit_mode = true;
-                    ++pc;
-                }
+                // Operand size override prefix, or the mandatory prefix of an
+                // SSE2 opcode, which execute_sse tells apart.
+                is_16_bit_mode = true;
+                is_prefix = true;
+                ++pc;
             } break;
 
             // LCOV_EXCL_START
             case 0x67: {
                 // Address size override prefix.
+                is_prefix = true;
                 ++pc;
             } break;
             // LCOV_EXCL_STOP
@@ -726,7 +1888,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x70: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.overflow) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -734,7 +1896,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x71: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (! cpu.flags.overflow) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -742,7 +1904,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x72: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.carry) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -750,7 +1912,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x73: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (! cpu.flags.carry) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -758,7 +1920,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x74: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.zero) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -766,7 +1928,11 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x75: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (! cpu.flags.zero) {
-                    pc += sext(rel8);
+                    // Only backward branches can close a counted loop.
+                    if (rel8 < 0 && run_loop_idiom(address_t(pc + 2 + sext(rel8)), address_t(pc + 2), is_cycles, cycles)) {
+                        break;
+                    }
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -774,7 +1940,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x76: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.carry || cpu.flags.zero) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -782,7 +1948,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x77: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (! cpu.flags.carry && ! cpu.flags.zero) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -790,7 +1956,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x78: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.sign) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -798,7 +1964,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x79: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (! cpu.flags.sign) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -806,7 +1972,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x7A: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.parity) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -814,7 +1980,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x7B: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (! cpu.flags.parity) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -822,7 +1988,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x7C: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.sign != cpu.flags.overflow) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -830,7 +1996,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x7D: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.sign == cpu.flags.overflow) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -838,7 +2004,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x7E: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (cpu.flags.zero || cpu.flags.sign != cpu.flags.overflow) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -846,7 +2012,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x7F: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]);
                 if (!cpu.flags.zero && cpu.flags.sign == cpu.flags.overflow) {
-                    pc += sext(rel8);
+                    pc = address_t(pc + sext(rel8));
                 }
                 pc += 2;
             } break;
@@ -859,13 +2025,41 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                 execute_binary_immediate_regencoded_operation_16_32bit();
             } break;
 
+            case 0x88: {
+                execute_binary_operation_8bit<0x88>(&CPU::mov8);
+            } break;
+
             case 0x89: {
                 execute_binary_operation_16_32_bit<0x89>(&CPU::mov16, &CPU::mov32);
             } break;
 
-            // case 0x8A: {
-            //     execute_binary_operation_8bit<0x8A>(&CPU::mov8);
-            // }
+            case 0x8C: {
+                const std::uint8_t mrr = cpu.mem[pc + 1];
+                const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+                if (ops.reg > 5) {
+                    throw std::logic_error("Invalid segment register in mov r/m16, Sreg.");
+                }
+                auto suop = structure_unary_operands<std::uint16_t>(cpu.R, operand_host(ops, MMU::WRITE, sizeof(std::uint16_t)), ops);
+                static_cast<std::uint16_t&>(suop) = cpu.sreg(Segment(ops.reg));
+                last_op = Opcode::MOV_SREG;
+                pc += skip;
+            } break;
+
+            case 0x8E: {
+                const std::uint8_t mrr = cpu.mem[pc + 1];
+                const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+                if (ops.reg > 5 || Segment(ops.reg) == Segment::CS) {
+                    throw std::logic_error("Invalid segment register in mov Sreg, r/m16.");
+                }
+                auto suop = structure_unary_operands<std::uint16_t>(cpu.R, operand_host(ops, MMU::READ, sizeof(std::uint16_t)), ops);
+                cpu.load_segment(Segment(ops.reg), static_cast<std::uint16_t&>(suop));
+                last_op = Opcode::MOV_SREG;
+                pc += skip;
+            } break;
+
+            case 0x8A: {
+                execute_binary_operation_8bit<0x8A>(&CPU::mov8);
+            } break;
 
             case 0x8B: {
                 execute_binary_operation_16_32_bit<0x8B>(&CPU::mov16, &CPU::mov32);
@@ -874,17 +2068,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0x8D: {
                 const std::uint8_t mrr = cpu.mem[pc + 1];
                 const auto [op, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
-                std::uint32_t address = op.rm.displacement;
-                if (op.rm.reg_field) {
-                    // Implies that there is no SIB bollockery.
-                    address += cpu.R[op.rm.reg];
-                } else {
-                    // Here there be the cursed SIB bollockery.
-                    if (op.rm.has_base) {
-                        address += cpu.R[op.rm.base];
-                    }
-                    address += op.rm.scale*cpu.R[op.rm.index];
-                }
+                const std::uint32_t address = effective_address(cpu.R, op);
                 if (is_16_bit_mode) {
                     auto reg = GenericRegisterReference<std::uint32_t, std::uint16_t>(&cpu.R[op.reg], get_low_word, grh_set_low_word);
                     static_cast<std::uint16_t&>(reg) = cpu.lea16(reg, address);
@@ -924,6 +2108,13 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                 ++pc;
             } break;
 
+            case 0x9B: {
+                // fwait: x87 exceptions are always masked, so there is
+                // nothing pending to deliver.
+                last_op = Opcode::FWAIT;
+                ++pc;
+            } break;
+
             case 0x9C: {
                 if (is_16_bit_mode) {
                     // cpu.pushf();
@@ -945,12 +2136,102 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                 ++pc;
             } break;
 
+            case 0xA4: {
+                execute_movs<std::uint8_t>();
+                last_op = Opcode::MOVS8;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xA5: {
+                if (is_16_bit_mode) {
+                    execute_movs<std::uint16_t>();
+                } else {
+                    execute_movs<std::uint32_t>();
+                }
+                last_op = Opcode::MOVS16_32;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xA6: {
+                execute_cmps<std::uint8_t>();
+                last_op = Opcode::CMPS8;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xA7: {
+                if (is_16_bit_mode) {
+                    execute_cmps<std::uint16_t>();
+                } else {
+                    execute_cmps<std::uint32_t>();
+                }
+                last_op = Opcode::CMPS16_32;
+                ++pc;
+                reset_prefixes();
+            } break;
+
             case 0xA8: {
                 std::uint8_t imm8 = mread<std::uint8_t>(&cpu.mem[pc + 1]);
                 cpu.test8(get_low_byte(cpu.R[EAX]), imm8);
                 pc += 2;
             } break;
 
+            case 0xAA: {
+                execute_stos<std::uint8_t>();
+                last_op = Opcode::STOS8;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xAB: {
+                if (is_16_bit_mode) {
+                    execute_stos<std::uint16_t>();
+                } else {
+                    execute_stos<std::uint32_t>();
+                }
+                last_op = Opcode::STOS16_32;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xAC: {
+                execute_lods<std::uint8_t>();
+                last_op = Opcode::LODS8;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xAD: {
+                if (is_16_bit_mode) {
+                    execute_lods<std::uint16_t>();
+                } else {
+                    execute_lods<std::uint32_t>();
+                }
+                last_op = Opcode::LODS16_32;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xAE: {
+                execute_scas<std::uint8_t>();
+                last_op = Opcode::SCAS8;
+                ++pc;
+                reset_prefixes();
+            } break;
+
+            case 0xAF: {
+                if (is_16_bit_mode) {
+                    execute_scas<std::uint16_t>();
+                } else {
+                    execute_scas<std::uint32_t>();
+                }
+                last_op = Opcode::SCAS16_32;
+                ++pc;
+                reset_prefixes();
+            } break;
+
             case 0xB0 ... 0xB3: {
                 std::uint8_t imm8 = cpu.mem[pc + 1];
                 auto& reg = cpu.regat(opcode - 0xB0);
@@ -978,100 +2259,54 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                 }
             } break;
 
-            case 0xC1: {
-                const std::uint8_t mrr = cpu.mem[pc + 1];
-                const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
-                pc += skip;
-                std::uint8_t imm8 = cpu.mem[pc];
-                ++pc;
+            case 0xC0: {
+                execute_shift_group<std::uint8_t>(ShiftCount::IMM8);
+            } break;
 
+            case 0xC1: {
                 if (is_16_bit_mode) {
-                    auto suop = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
-                    auto op = [&](unsigned int reg) {
-                        switch (reg) {
-                            case 7: return &CPU::sar16;
-                            default: {
-                                std::stringstream ss;
-                                ss << "Unhandled Opcode: 0xC1 " << std::hex << uint(reg);
-                                throw std::logic_error(ss.str());
-                            } break;
-                        }
-                    }(ops.reg);
-                    
-                    if (suop.is_rm_ptr) {
-                        static_cast<std::uint16_t&>(suop.rm.m) = (cpu.*op)(static_cast<std::uint16_t&>(suop.rm.m), sext<std::uint16_t>(imm8));
-                    } else {
-                        static_cast<std::uint16_t&>(suop.rm.r) = (cpu.*op)(static_cast<std::uint16_t&>(suop.rm.r), sext<std::uint16_t>(imm8));
-                    }
-
+                    execute_shift_group<std::uint16_t>(ShiftCount::IMM8);
                 } else {
-                    auto suop = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
-                    auto op = [&](unsigned int reg) {
-                        switch (reg) {
-                            case 7: return &CPU::sar32;
-
-                            default: {
-                                std::stringstream ss;
-                                ss << "Unhandled Opcode: 0xC1 " << std::hex << uint(reg);
-                                throw std::logic_error(ss.str());
-                            } break;
-                        }
-                    }(ops.reg);
+                    execute_shift_group<std::uint32_t>(ShiftCount::IMM8);
+                }
+            } break;
 
-                    if (suop.is_rm_ptr) {
-                        static_cast<std::uint32_t&>(suop.rm.m) = (cpu.*op)(static_cast<std::uint32_t&>(suop.rm.m), sext(imm8));
-                    } else {
-                        static_cast<std::uint32_t&>(suop.rm.r) = (cpu.*op)(static_cast<std::uint32_t&>(suop.rm.r), sext(imm8));
-                    }
+            case 0xCD: {
+                const std::uint8_t vector = cpu.mem[pc + 1];
+                if (vector != 0x80) {
+                    std::stringstream ss;
+                    ss << "Unhandled interrupt vector: " << std::hex << uint(vector);
+                    throw std::logic_error(ss.str());
                 }
+                last_op = Opcode::INT;
+                pc += 2;
+                // Straight out rather than through the checks after the
+                // switch, so the loop pays nothing for syscalls.
+                reset_prefixes();
+                return ExitReason::SYSCALL;
+            }
 
+            case 0xD0: {
+                execute_shift_group<std::uint8_t>(ShiftCount::ONE);
             } break;
 
             case 0xD1: {
-                const std::uint8_t mrr = cpu.mem[pc + 1];
-                const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
-                pc += skip;
-                
                 if (is_16_bit_mode) {
-                    auto suop = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
-                    auto op = [&](unsigned int reg) {
-                        switch (reg) {
-                            case 7: {
-                                return &CPU::sar16_u;
-                            } break;
-
-                            default: {
-                                std::stringstream ss;
-                                ss << "Unhandled Opcode: 0xC1 " << std::hex << uint(reg);
-                                throw std::logic_error(ss.str());
-                            } break;
-                        }
-                    }(ops.reg);
-                    if (suop.is_rm_ptr) {
-                        static_cast<std::uint16_t&>(suop.rm.m) = (cpu.*op)(static_cast<std::uint16_t&>(suop.rm.m));
-                    } else {
-                        static_cast<std::uint16_t&>(suop.rm.r) = (cpu.*op)(static_cast<std::uint16_t&>(suop.rm.r));
-                    }
+                    execute_shift_group<std::uint16_t>(ShiftCount::ONE);
                 } else {
-                    auto suop = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
-                    auto op = [&](unsigned int reg) {
-                        switch (reg) {
-                            case 7: {
-                                return &CPU::sar32_u;
-                            } break;
+                    execute_shift_group<std::uint32_t>(ShiftCount::ONE);
+                }
+            } break;
 
-                            default: {
-                                std::stringstream ss;
-                                ss << "Unhandled Opcode: 0xC1 " << std::hex << uint(reg);
-                                throw std::logic_error(ss.str());
-                            } break;
-                        }
-                    }(ops.reg);
-                    if (suop.is_rm_ptr) {
-                        static_cast<std::uint32_t&>(suop.rm.m) = (cpu.*op)(static_cast<std::uint32_t&>(suop.rm.m));
-                    } else {
-                        static_cast<std::uint32_t&>(suop.rm.r) = (cpu.*op)(static_cast<std::uint32_t&>(suop.rm.r));
-                    }
+            case 0xD2: {
+                execute_shift_group<std::uint8_t>(ShiftCount::CL);
+            } break;
+
+            case 0xD3: {
+                if (is_16_bit_mode) {
+                    execute_shift_group<std::uint16_t>(ShiftCount::CL);
+                } else {
+                    execute_shift_group<std::uint32_t>(ShiftCount::CL);
                 }
             } break;
 
@@ -1096,7 +2331,7 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             } break;
 
             case 0xD7: {
-                cpu.xlat();
+                cpu.xlat(segment_override.value_or(Segment::DS));
                 last_op = Opcode::XLAT;
                 ++pc;
             } break;
@@ -1157,15 +2392,29 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             case 0xD9: {
                 switch (std::uint8_t mrr = cpu.mem[pc + 1]; mrr) {
 
-                    // case 0x00 ... 0xBF: break;
+                    case 0x00 ... 0xBF: {
+                        const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
+                        if (ops.reg == 5) {
+                            fpu.set_control(mread<std::uint16_t>(operand_host(ops, MMU::READ, sizeof(std::uint16_t))));
+                            last_op = Opcode::FLDCW;
+                        } else if (ops.reg == 7) {
+                            mwrite(operand_host(ops, MMU::WRITE, sizeof(std::uint16_t)), fpu.control());
+                            last_op = Opcode::FNSTCW;
+                        } else {
+                            std::stringstream ss;
+                            ss << "Unhandled opcode: " << uint(opcode) << " with mod/reg/rm: " << uint(mrr);
+                            throw std::logic_error(ss.str());
+                        }
+                        pc += skip;
+                    } break;
 
                     case 0xC0 ... 0xC7: {
-                        fpu.fld(fpu.V.st(mrr - 0xC0));
+                        fpu.fld(unsigned(mrr - 0xC0));
                         pc += 2;
                     } break;
 
                     case 0xC8 ... 0xCF: {
-                        fpu.fxch(fpu.V.st(mrr - 0xC8));
+                        fpu.fxch(unsigned(mrr - 0xC8));
                         pc += 2;
                     } break;
 
@@ -1467,18 +2716,22 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
 
             case 0xEB: {
                 std::int8_t rel8 = mread<std::int8_t>(&cpu.mem[pc + 1]) + 2;
-                pc += sext(rel8);
+                pc = address_t(pc + sext(rel8));
             } break;
 
-            case 0xF3: {
-                if (cpu.mem[pc + 1] == 0xF) {
-                    switch (std::uint8_t sOpcode = cpu.mem[pc + 2]; sOpcode) {
+            case 0xF2: {
+                // Repne prefix.
+                rep_prefix = RepPrefix::REPNE;
+                is_prefix = true;
+                ++pc;
+            } break;
 
-                    }
-                } else {
-                    // Rep prefix.
-                    ++pc;
-                }
+            case 0xF3: {
+                // Rep prefix, or the mandatory prefix of an 0F opcode, which
+                // the 0F handler tells apart through rep_prefix.
+                rep_prefix = RepPrefix::REPE;
+                is_prefix = true;
+                ++pc;
             } break;
 
             case 0xF4: {
@@ -1498,109 +2751,16 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
                 ++pc;
             } break;
 
-            case 0xF7: {
-                const std::uint8_t mrr = cpu.mem[pc + 1];
-                const auto [ops, skip] = decode_modregrm(mrr, cpu.mem, pc, false);
-                pc += skip;
-                switch(ops.reg) {
-                    // case 0:
-                    // case 1: {
-                    //     if (is_16_bit_mode) {
-                    //         auto suop = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
-                    //         std::uint16_t imm16 = mread<std::uint16_t>(&cpu.mem[pc]);
-                    //         if (suop.is_rm_ptr) {
-                    //             static_cast<std::uint16_t&>(suop.rm.m) = cpu.test16(static_cast<std::uint16_t&>(suop.rm.m), imm16);
-                    //         } else {
-                    //             static_cast<std::uint16_t&>(suop.rm.r) = cpu.test16(static_cast<std::uint16_t&>(suop.rm.r), imm16);
-                    //         }
-                    //         pc += sizeof(std::uint16_t);
-                    //     } else {
-                    //         auto suop = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
-                    //         std::uint32_t imm32 = mread<std::uint32_t>(&cpu.mem[pc]);
-                    //         if (suop.is_rm_ptr) {
-                    //             static_cast<std::uint16_t&>(suop.rm.m) = cpu.test16(static_cast<std::uint16_t&>(suop.rm.m), imm16);
-                    //         } else {
-                    //             static_cast<std::uint16_t&>(suop.rm.r) = cpu.test16(static_cast<std::uint16_t&>(suop.rm.r), imm16);
-                    //         }
-                    //         pc += sizeof(std::uint32_t);
-                    //     }
-                    // } break;
-
-                    // case 2: {
-                    //     if (is_16_bit_mode) {
-                    //         auto suop = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
-                    //         if (suop.is_rm_ptr) {
-                    //             static_cast<std::uint16_t&>(suop.rm.m) = cpu.not16(static_cast<std::uint16_t&>(suop.rm.m));
-                    //         } else {
-                    //             static_cast<std::uint16_t&>(suop.rm.r) = cpu.not16(static_cast<std::uint16_t&>(suop.rm.r));
-                    //         }
-                    //     } else {
-                    //         auto suop = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
-                    //         if (suop.is_rm_ptr) {
-                    //             static_cast<std::uint32_t&>(suop.rm.m) = cpu.not32(static_cast<std::uint32_t&>(suop.rm.m));
-                    //         } else {
-                    //             static_cast<std::uint32_t&>(suop.rm.r) = cpu.not32(static_cast<std::uint32_t&>(suop.rm.r));
-                    //         }
-                    //     }
-                    // } break;
-
-                    // case 3: {
-                    //     if (is_16_bit_mode) {
-                    //         auto suop = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
-                    //         if (suop.is_rm_ptr) {
-                    //             static_cast<std::uint16_t&>(suop.rm.m) = cpu.neg16(static_cast<std::uint16_t&>(suop.rm.m));
-                    //         } else {
-                    //             static_cast<std::uint16_t&>(suop.rm.r) = cpu.neg16(static_cast<std::uint16_t&>(suop.rm.r));
-                    //         }
-                    //     } else {
-                    //         auto suop = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
-                    //         if (suop.is_rm_ptr) {
-                    //             static_cast<std::uint32_t&>(suop.rm.m) = cpu.neg32(static_cast<std::uint32_t&>(suop.rm.m));
-                    //         } else {
-                    //             static_cast<std::uint32_t&>(suop.rm.r) = cpu.neg32(static_cast<std::uint32_t&>(suop.rm.r));
-                    //         }
-                    //     }
-                    // } break;
-                    // case 4:
-
-                    case 5: {
-                        if (is_16_bit_mode) {
-                            auto suop = structure_unary_operands<std::uint16_t>(cpu.R, cpu.mem, ops);
-                            const auto src = [&](){
-                                if (suop.is_rm_ptr) {
-                                    return static_cast<std::uint16_t&>(suop.rm.m);
-                                } else {
-                                    return static_cast<std::uint16_t&>(suop.rm.r);
-                                }
-                            }();
-                            const std::uint32_t tmp = cpu.imul16_s(get_low_word(cpu.R[EAX]), src);
-                            set_low_word(cpu.R[EAX], get_low_word(tmp));
-                            set_low_word(cpu.R[EDX], get_high_word(tmp));
-                        } else {
-                            auto suop = structure_unary_operands<std::uint32_t>(cpu.R, cpu.mem, ops);
-                            const auto src = [&](){
-                                if (suop.is_rm_ptr) {
-                                    return static_cast<std::uint32_t&>(suop.rm.m);
-                                } else {
-                                    return static_cast<std::uint32_t&>(suop.rm.r);
-                                }
-                            }();
-                            const std::uint64_t tmp = cpu.imul32_s(cpu.R[EAX], src);
-                            cpu.R[EAX] = low_dword(tmp);
-                            cpu.R[EDX] = high_dword(tmp);
-                        }
-                    } break;
-
-                    // case 6:
-                    // case 7:
+            case 0xF6: {
+                execute_unary_group<std::uint8_t>();
+            } break;
 
-                    default: {
-                        std::stringstream ss;
-                        ss << "Unhandled Opcode: 0xF7 " << std::hex << uint(opcode);
-                        throw std::logic_error(ss.str());
-                    } break;
+            case 0xF7: {
+                if (is_16_bit_mode) {
+                    execute_unary_group<std::uint16_t>();
+                } else {
+                    execute_unary_group<std::uint32_t>();
                 }
-
             } break;
 
             case 0xF8: {
@@ -1634,6 +2794,11 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
             } break;
         }
 
+        if (!is_prefix) {
+            segment_override.reset();
+            rep_prefix = RepPrefix::NONE;
+        }
+
         // LCOV_EXCL_START
         if (visual_debug_mode) {
             std::cout << cpu << ' ' << pc << ' ' << std::hex << int(opcode) << '\n';
@@ -1645,9 +2810,15 @@ void Executor::execute(bool visual_debug_mode, const bool is_cycles, unsigned in
         if (is_cycles) {
             --cycles;
         }
+
+        // The store has already landed; stop after the instruction that made it.
+        if (cpu.mmu.watch_hit) {
+            return ExitReason::WATCHPOINT;
+        }
     }
+    return ExitReason::CYCLES;
 }
 
-void Executor::run_single_cycle(bool visual_debug) {
-    execute(visual_debug, true, 1);
+ExitReason Executor::run_single_cycle(bool visual_debug) {
+    return execute(visual_debug, true, 1);
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "executor_pool.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+ExecutorPool::ExecutorPool(std::size_t count, std::size_t mem_size, std::size_t stack_size)
+    : mem_size_(mem_size), stack_size_(stack_size) {
+    free_.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        free_.emplace_back(std::span<const std::uint8_t>{}, mem_size_, stack_size_);
+    }
+}
+
+Executor ExecutorPool::acquire(std::span<const std::uint8_t> code, unsigned long int start) {
+    if (free_.empty()) {
+        return Executor(code, mem_size_, stack_size_, start);
+    }
+    Executor ex(std::move(free_.back()));
+    free_.pop_back();
+    ex.load(code, start);
+    return ex;
+}
+
+void ExecutorPool::release(Executor&& ex) {
+    // reset keeps the stack layout, so it has to be this pool's as well.
+    if (ex.cpu.mem.size() != mem_size_ || ex.cpu.stack.limit() != mem_size_ - stack_size_) {
+        return;
+    }
+    ex.reset();
+    free_.push_back(std::move(ex));
+}
@@ -1,5 +1,7 @@
 #include "flags.hh"
 
+#include <bit>
+
 std::uint8_t Flags::get_flags8() const {
     std::uint8_t tmp = (sign << 7)
         | (zero << 6)
@@ -18,6 +20,66 @@ void Flags::set_flags8(std::uint8_t b) {
     carry = b & 1;
 }
 
+// Operands narrower than 32 bits arrive sign extended, so bit 31 is the sign
+// bit whatever the operand size. inc and dec leave carry alone.
+void Flags::set_inc_flags(const std::uint32_t lhs, const std::uint32_t rv) {
+    zero = rv == 0;
+    sign = rv >> 31;
+    parity = !(std::popcount(rv & 0xFF) & 1);
+    adjust = (lhs ^ rv) & 0x10;
+    overflow = !(lhs >> 31) && (rv >> 31);
+}
+
+void Flags::set_dec_flags(const std::uint32_t lhs, const std::uint32_t rv) {
+    zero = rv == 0;
+    sign = rv >> 31;
+    parity = !(std::popcount(rv & 0xFF) & 1);
+    adjust = (lhs ^ rv) & 0x10;
+    overflow = (lhs >> 31) && !(rv >> 31);
+}
+
+// Sign extension also keeps the unsigned order of narrower operands, so the
+// borrow out of their top bit is lhs < rhs on the extended values.
+void Flags::set_sub_flags(const std::uint32_t lhs, const std::uint32_t rhs, const std::uint32_t tmp) {
+    carry = lhs < rhs;
+    zero = tmp == 0;
+    sign = tmp >> 31;
+    parity = !(std::popcount(tmp & 0xFF) & 1);
+    adjust = (lhs ^ rhs ^ tmp) & 0x10;
+    overflow = ((lhs ^ rhs) & (lhs ^ tmp)) >> 31;
+}
+
+void Flags::set_cmp_flags(const std::uint32_t lhs, const std::uint32_t rhs, const std::uint32_t tmp) {
+    set_sub_flags(lhs, rhs, tmp);
+}
+
+// The truncated product overflowed when it differs from the full product of
+// the sign extended operands.
+void Flags::set_imul_flags(const std::uint32_t lhs, const std::uint32_t rhs, const std::uint32_t rv) {
+    const std::int64_t full = std::int64_t(std::int32_t(lhs)) * std::int32_t(rhs);
+    set_mul_flags(full != std::int32_t(rv));
+}
+
+void Flags::set_mul_flags(const bool significant) {
+    carry = overflow = significant;
+}
+
+// Carry and overflow come from the bits a shift moved out, which only the
+// caller knows; the rest follow the (sign extended) result as usual.
+void Flags::set_shift_flags(const std::uint32_t rv, const bool carry_out, const bool overflow_out) {
+    zero = rv == 0;
+    sign = rv >> 31;
+    parity = !(std::popcount(rv & 0xFF) & 1);
+    carry = carry_out;
+    overflow = overflow_out;
+}
+
+// Rotates leave the result flags alone.
+void Flags::set_rotate_flags(const bool carry_out, const bool overflow_out) {
+    carry = carry_out;
+    overflow = overflow_out;
+}
+
 // LCOV_EXCL_START
 void Flags::set_adc_flags([[maybe_unused]] std::uint32_t lhs,
                     [[maybe_unused]] std::uint32_t rhs,
@@ -31,40 +93,14 @@ void Flags::set_and_flags([[maybe_unused]] std::uint32_t lhs,
                     [[maybe_unused]] std::uint32_t rhs,
                     [[maybe_unused]] std::uint32_t rv) {}
 
-void Flags::set_cmp_flags([[maybe_unused]] std::uint32_t lhs,
-                    [[maybe_unused]] std::uint32_t rhs,
-                    [[maybe_unused]] std::uint32_t tmp) {}
-
-void Flags::set_dec_flags([[maybe_unused]] std::uint32_t lhs,
-                    [[maybe_unused]] std::uint32_t rv) {}
-
-void Flags::set_inc_flags([[maybe_unused]] std::uint32_t lhs,
-                    [[maybe_unused]] std::uint32_t rv) {}
-
-void Flags::set_imul_flags([[maybe_unused]] std::uint32_t lhs,
-                    [[maybe_unused]] std::uint32_t rhs,
-                    [[maybe_unused]] std::uint32_t rv) {}
-
-void Flags::set_imul_s_flags([[maybe_unused]] std::uint32_t lhs,
-                           [[maybe_unused]] std::uint32_t rhs,
-                           [[maybe_unused]] std::uint32_t rv) {}
-
 void Flags::set_or_flags([[maybe_unused]] std::uint32_t lhs,
                     [[maybe_unused]] std::uint32_t rhs,
                     [[maybe_unused]] std::uint32_t rv) {}
 
-void Flags::set_sar_flags([[maybe_unused]] std::uint32_t lhs,
-                    [[maybe_unused]] std::uint32_t rhs,
-                    [[maybe_unused]] std::uint32_t rv) {}
-
 void Flags::set_sbb_flags([[maybe_unused]] std::uint32_t lhs,
                     [[maybe_unused]] std::uint32_t rhs,
                     [[maybe_unused]] std::uint32_t tmp) {}
 
-void Flags::set_sub_flags([[maybe_unused]] std::uint32_t lhs,
-                    [[maybe_unused]] std::uint32_t rhs,
-                    [[maybe_unused]] std::uint32_t tmp) {}
-
 void Flags::set_xor_flags([[maybe_unused]] std::uint32_t lhs,
                     [[maybe_unused]] std::uint32_t rhs,
                     [[maybe_unused]] std::uint32_t tmp) {}
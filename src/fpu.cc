@@ -2,116 +2,263 @@
 #include "types.hh"
 
 #include <array>
+#include <cfenv>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <numbers>
+#include <utility>
 
 void FPU_Registers::push(const long double value) {
-    data_.at(top_) = value;
-    ++top_; 
+    top_ = top_ % 8 + 1;
+    if (is_double_) {
+        fast_[slot(0)] = double(value);
+    } else {
+        data_[slot(0)] = value;
+    }
+}
+
+void FPU_Registers::push(const double value) {
+    top_ = top_ % 8 + 1;
+    if (is_double_) {
+        fast_[slot(0)] = value;
+    } else {
+        data_[slot(0)] = value;
+    }
 }
 
 void FPU_Registers::pop() {
-    --top_;
+    top_ = (top_ + 7) % 8;
 }
 
-long double& FPU_Registers::st(const index_t index) {
-    return data_.at(top_-1 - index);
+long double FPU_Registers::value(const index_t index) const {
+    return is_double_ ? fast_[slot(index)] : data_[slot(index)];
 }
 
 unsigned int& FPU_Registers::tag(const index_t index) {
-    return tags_.at(top_-1 - index);
+    return tags_[slot(index)];
+}
+
+void FPU_Registers::use_double(const bool to_double) {
+    if (to_double == is_double_) {
+        return;
+    }
+    for (std::size_t i = 0; i < data_.size(); ++i) {
+        if (to_double) {
+            fast_[i] = double(data_[i]);
+        } else {
+            data_[i] = fast_[i];
+        }
+    }
+    is_double_ = to_double;
+}
+
+Mmx FPU_Registers::mm(const index_t index) const {
+    // In double storage, read the register as leaving it would widen it.
+    const long double reg = is_double_ ? fast_.at(7 - index) : data_.at(7 - index);
+    Mmx rv;
+    rv.load(reinterpret_cast<const std::uint8_t*>(&reg));
+    return rv;
+}
+
+void FPU_Registers::set_mm(const index_t index, const Mmx& value) {
+    // Out of double storage first, or leaving it later would write over
+    // this register.
+    use_double(false);
+    auto* reg = reinterpret_cast<std::uint8_t*>(&data_.at(7 - index));
+    value.store(reg);
+    if constexpr (std::numeric_limits<long double>::digits == 64) {
+        // The sign and exponent above the significand of the 80 bit format.
+        reg[8] = 0xFF;
+        reg[9] = 0xFF;
+    }
+}
+
+void FPU_Registers::enter_mmx() {
+    // The MMX registers alias the 80 bit ones, so the stack leaves double
+    // storage and goes back on the next x87 instruction.
+    use_double(false);
+    tags_.fill(0);
+    top_ = 0;
+}
+
+void FPU_Registers::empty() {
+    tags_.fill(3);
+}
+
+namespace {
+
+// Switches the host to the guest's rounding direction for one operation.
+// Round to nearest is the host's own default and costs nothing.
+class ScopedRounding {
+private:
+    int saved_ = FE_TONEAREST;
+public:
+    explicit ScopedRounding(const int direction) {
+        if (direction != FE_TONEAREST) {
+            saved_ = std::fegetround();
+            std::fesetround(direction);
+        }
+    }
+
+    ~ScopedRounding() {
+        if (saved_ != FE_TONEAREST || std::fegetround() != FE_TONEAREST) {
+            std::fesetround(saved_);
+        }
+    }
+
+    ScopedRounding(const ScopedRounding&) = delete;
+    ScopedRounding& operator=(const ScopedRounding&) = delete;
+};
+
+}
+
+template <typename Op>
+void FPU::dispatch(const Op& op) {
+    const ScopedRounding scoped(rounding());
+    if (computes_in_double()) {
+        V.use_double(true);
+        op.template operator()<double>();
+    } else {
+        V.use_double(false);
+        op.template operator()<long double>();
+    }
+}
+
+template <typename F>
+F FPU::to_precision(const F value) const {
+    switch (precision()) {
+        case Precision::SINGLE: return F(float(value));
+        case Precision::EXTENDED: return value;
+        default: {
+            if constexpr (std::is_same_v<F, long double>) {
+                return F(double(value));
+            } else {
+                return value;
+            }
+        }
+    }
 }
 
+template <typename F>
+void FPU::compare(const F lhs, const F rhs) {
+    if (lhs > rhs) {
+        c3 = c2 = c0 = 0;
+    } else if (lhs < rhs) {
+        c3 = c2 = 0;
+        c0 = 1;
+    } else if (lhs == rhs) {
+        c3 = 1;
+        c2 = c0 = 0;
+    } else {
+        c3 = c2 = c0 = 1;
+    }
+}
+
+void FPU::reset() {
+    V = FPU_Registers{};
+    c3 = c2 = c1 = c0 = 0;
+    control_ = DEFAULT_CONTROL;
+}
+
+void FPU::set_control(const std::uint16_t control) {
+    // The stack changes storage on the next arithmetic instruction, not
+    // here, so MMX values held across FLDCW survive.
+    control_ = control;
+}
+
+int FPU::rounding() const {
+    switch ((control_ >> 10) & 3) {
+        case 0: return FE_TONEAREST;
+        case 1: return FE_DOWNWARD;
+        case 2: return FE_UPWARD;
+        default: return FE_TOWARDZERO;
+    }
+}
+
+void FPU::set_double_mode(const bool on) {
+    double_mode_ = on;
+}
 
 void FPU::f2xm1() {
-    V.st(0) = std::exp2(V.st(0)) - 1;
+    dispatch([&]<typename F>() {V.st<F>(0) = std::exp2(V.st<F>(0)) - 1;});
 }
 
 void FPU::fabs() {
-    V.st(0) = std::abs(V.st(0));
+    dispatch([&]<typename F>() {V.st<F>(0) = std::abs(V.st<F>(0));});
 }
 
 void FPU::fadd(unsigned int i) {
-    V.st(0) += V.st(i);
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(V.st<F>(0) + V.st<F>(i));});
 }
 
 void FPU::fadd_r(unsigned int i) {
-    V.st(i) += V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(i) = to_precision(V.st<F>(i) + V.st<F>(0));});
 }
 
 void FPU::faddp(unsigned int i) {
-    V.st(i) += V.st(0);
+    fadd_r(i);
     V.pop();
 }
 
 void FPU::fchs() {
-    V.st(0) = -V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(0) = -V.st<F>(0);});
 }
 
 void FPU::fcmovb(unsigned int i) {
     if (flags.carry) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmovbe(unsigned int i) {
     if (flags.carry || flags.zero) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmove(unsigned int i) {
     if (flags.zero) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmovnb(unsigned int i) {
     if (! flags.carry) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmovnbe(unsigned int i) {
     if (!flags.carry && !flags.zero) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmovne(unsigned int i) {
     if (! flags.zero) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmovnu(unsigned int i) {
     if (! flags.parity) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcmovu(unsigned int i) {
     if (flags.parity) {
-        V.st(0) = V.st(i);
+        fsti_from(i);
     }
 }
 
 void FPU::fcom(const float80_t value) {
-    if (V.st(0) > value) {
-        c3 = c2 = c0 = 0;
-    } else if (V.st(0) < value) {
-        c3 = c2 = 0;
-        c0 = 1;
-    } else if (V.st(0) == value) {
-        c3 = 1;
-        c2 = c0 = 0;
-    } else {
-        c3 = c2 = c0 = 1;
-    }
+    compare(V.value(0), value);
 }
 
 void FPU::fcom(unsigned int i) {
-    fcom(V.st(i));
+    dispatch([&]<typename F>() {compare(V.st<F>(0), V.st<F>(i));});
 }
 
 void FPU::fcomp(unsigned int i) {
@@ -120,40 +267,37 @@ void FPU::fcomp(unsigned int i) {
 }
 
 void FPU::fcos() {
-    V.st(0) = std::cos(V.st(0));
+    dispatch([&]<typename F>() {V.st<F>(0) = std::cos(V.st<F>(0));});
 }
 
 void FPU::fdecstp() {
-    if (V.top_ == 0) {
-        V.top_ = 7;
-    } else {
-        --V.top_;
-    }
+    // TOP - 1, which is one more slot in use.
+    V.top_ = V.top_ % 8 + 1;
 }
 
 void FPU::fdiv(unsigned int i) {
-    V.st(0) /= V.st(i);
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(V.st<F>(0) / V.st<F>(i));});
 }
 
 void FPU::fdiv_r(unsigned int i) {
-    V.st(i) /= V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(i) = to_precision(V.st<F>(i) / V.st<F>(0));});
 }
 
 void FPU::fdivp(unsigned int i) {
-    V.st(i) /= V.st(0);
+    fdiv_r(i);
     V.pop();
 }
 
 void FPU::fdivr(unsigned int i) {
-    V.st(0) = V.st(i) / V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(V.st<F>(i) / V.st<F>(0));});
 }
 
 void FPU::fdivr_r(unsigned int i) {
-    V.st(i) = V.st(0) / V.st(i);
+    dispatch([&]<typename F>() {V.st<F>(i) = to_precision(V.st<F>(0) / V.st<F>(i));});
 }
 
 void FPU::fdivrp(unsigned int i) {
-    V.st(i) = V.st(0) / V.st(i);
+    fdivr_r(i);
     V.pop();
 }
 
@@ -162,59 +306,55 @@ void FPU::ffree(unsigned int i) {
 }
 
 void FPU::fincstp() {
-    if (V.top_ == 7) {
-        V.top_ = 0;
-    } else {
-        ++V.top_;
-    }
+    V.top_ = (V.top_ + 7) % 8;
 }
 
 void FPU::fld(const float80_t value) {
-    V.push(value);
+    dispatch([&]<typename F>() {V.push(F(value));});
 }
 
 void FPU::fld(unsigned int i) {
-    V.push(V.st(i));
+    dispatch([&]<typename F>() {V.push(V.st<F>(i));});
 }
 
 void FPU::fld1() {
-    V.push(1.0L);
+    fld(1.0L);
 }
 
 void FPU::fldl2e() {
-    V.push(std::log2(std::numbers::pi));
+    fld(float80_t(std::log2(std::numbers::pi)));
 }
 
 void FPU::fldl2t() {
-    V.push(std::log2(10.0L));
+    fld(std::log2(10.0L));
 }
 
 void FPU::fldlg2() {
-    V.push(std::log10(2.0L));
+    fld(std::log10(2.0L));
 }
 
 void FPU::fldln2() {
-    V.push(std::log(2.0L));
+    fld(std::log(2.0L));
 }
 
 void FPU::fldpi() {
-    V.push(std::numbers::pi);
+    fld(float80_t(std::numbers::pi));
 }
 
 void FPU::fldz() {
-    V.push(0.0L);
+    fld(0.0L);
 }
 
 void FPU::fmul(unsigned int i) {
-    V.st(0) *= V.st(i);
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(V.st<F>(0) * V.st<F>(i));});
 }
 
 void FPU::fmul_r(unsigned int i) {
-    V.st(i) *= V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(i) = to_precision(V.st<F>(i) * V.st<F>(0));});
 }
 
 void FPU::fmulp(unsigned int i) {
-    V.st(i) *= V.st(0);
+    fmul_r(i);
     V.pop();
 }
 
@@ -223,83 +363,93 @@ void FPU::fnop() {
 }
 
 void FPU::fpatan() {
-    V.st(1) = std::atan(V.st(1) / V.st(0));
+    dispatch([&]<typename F>() {V.st<F>(1) = std::atan(V.st<F>(1) / V.st<F>(0));});
     V.pop();
 }
 
 void FPU::fptan() {
-    V.st(0) = std::tan(V.st(0));
-    V.push(1.0L);
+    dispatch([&]<typename F>() {
+        V.st<F>(0) = std::tan(V.st<F>(0));
+        V.push(F(1));
+    });
 }
 
 void FPU::fprem() {
-    V.st(0) = std::fmod(V.st(0), V.st(1));
+    dispatch([&]<typename F>() {V.st<F>(0) = std::fmod(V.st<F>(0), V.st<F>(1));});
 }
 
 void FPU::fprem1() {
-    V.st(0) = std::fmod(V.st(0), V.st(1));
+    dispatch([&]<typename F>() {V.st<F>(0) = std::fmod(V.st<F>(0), V.st<F>(1));});
 }
 
 void FPU::frndint() {
-    V.st(0) = std::round(V.st(0));
+    // To an integer in the RC direction, which dispatch has the host use.
+    dispatch([&]<typename F>() {V.st<F>(0) = std::nearbyint(V.st<F>(0));});
 }
 
 void FPU::fscale() {
-    V.st(0) = V.st(0) * std::exp2(std::trunc(V.st(1)));
+    dispatch([&]<typename F>() {V.st<F>(0) = V.st<F>(0) * std::exp2(std::trunc(V.st<F>(1)));});
 }
 
 void FPU::fsin() {
-    V.st(0) = std::sin(V.st(0));
+    dispatch([&]<typename F>() {V.st<F>(0) = std::sin(V.st<F>(0));});
 }
 
 void FPU::fsincos() {
-    auto tmp = std::cos(V.st(0));
-    V.st(0) = std::sin(V.st(0));
-    V.push(tmp);
+    dispatch([&]<typename F>() {
+        const F tmp = std::cos(V.st<F>(0));
+        V.st<F>(0) = std::sin(V.st<F>(0));
+        V.push(tmp);
+    });
 }
 
 void FPU::fsqrt() {
-    V.st(0) = std::sqrt(V.st(0));
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(std::sqrt(V.st<F>(0)));});
 }
 
 void FPU::fsti(unsigned int i) {
-    V.st(i) = V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(i) = V.st<F>(0);});
+}
+
+void FPU::fsti_from(unsigned int i) {
+    dispatch([&]<typename F>() {V.st<F>(0) = V.st<F>(i);});
 }
 
 void FPU::fstp(unsigned int i) {
-    V.st(i) = V.st(0);
+    fsti(i);
     V.pop();
 }
 
 void FPU::fsub(unsigned int i) {
-    V.st(0) -= V.st(i);
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(V.st<F>(0) - V.st<F>(i));});
 }
 
 void FPU::fsub_r(unsigned int i) {
-    V.st(i) -= V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(i) = to_precision(V.st<F>(i) - V.st<F>(0));});
 }
 
 void FPU::fsubp(unsigned int i) {
-    V.st(i) -= V.st(0);
+    fsub_r(i);
     V.pop();
 }
 
 void FPU::fsubr(unsigned int i) {
-    V.st(0) = V.st(i) - V.st(0);
+    dispatch([&]<typename F>() {V.st<F>(0) = to_precision(V.st<F>(i) - V.st<F>(0));});
 }
 
 void FPU::fsubr_r(unsigned int i) {
-    V.st(i) = V.st(0) - V.st(i);
+    dispatch([&]<typename F>() {V.st<F>(i) = to_precision(V.st<F>(0) - V.st<F>(i));});
 }
 
 void FPU::fsubrp(unsigned int i) {
-    V.st(i) = V.st(0) - V.st(i);
+    fsubr_r(i);
     V.pop();
 }
 
 void FPU::fxam() {
-    c1 = std::signbit(V.st(0));
-    switch (std::fpclassify(V.st(0))) {
+    const long double value = V.value(0);
+    c1 = std::signbit(value);
+    switch (std::fpclassify(value)) {
         case FP_INFINITE: {
             c3 = 0;
             c2 = c0 = 1;
@@ -337,22 +487,24 @@ void FPU::fxam() {
 }
 
 void FPU::fxch(unsigned int i) {
-    std::swap(V.st(0), V.st(i));
+    dispatch([&]<typename F>() {std::swap(V.st<F>(0), V.st<F>(i));});
 }
 
 void FPU::fxtract() {
-    int exp;
-    long double mant = std::frexp(V.st(0), &exp);
-    V.st(0) = mant;
-    V.push(static_cast<long double>(exp));
+    dispatch([&]<typename F>() {
+        int exp;
+        const F mant = std::frexp(V.st<F>(0), &exp);
+        V.st<F>(0) = mant;
+        V.push(F(exp));
+    });
 }
 
 void FPU::fyl2x() {
-    V.st(1) = V.st(1) * std::log2(V.st(0));
+    dispatch([&]<typename F>() {V.st<F>(1) = V.st<F>(1) * std::log2(V.st<F>(0));});
     V.pop();
 }
 
 void FPU::fyl2xp1() {
-    V.st(1) = V.st(1) * std::log2(V.st(0) + 1.0L);
+    dispatch([&]<typename F>() {V.st<F>(1) = V.st<F>(1) * std::log2(V.st<F>(0) + F(1));});
     V.pop();
-}
\ No newline at end of file
+}
@@ -0,0 +1,110 @@
+#include "hex.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr bool is_space(const char c) noexcept {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+[[noreturn]] void bad_token(const std::size_t offset) {
+    throw std::domain_error("Malformed hex byte at offset " + std::to_string(offset));
+}
+
+}
+
+std::size_t parse_hex(const std::string_view text, const std::span<std::uint8_t> out) {
+    const char* const begin = text.data();
+    const char* const end = begin + text.size();
+    const char* p = begin;
+    std::size_t n = 0;
+    while (p != end) {
+        if (is_space(*p)) {
+            ++p;
+            continue;
+        }
+        if (*p == '#' || *p == ';') {
+            while (p != end && *p != '\n') {
+                ++p;
+            }
+            continue;
+        }
+
+        const char* const token = p;
+        if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+            p += 2;
+        }
+        std::uint8_t value;
+        const auto [next, ec] = std::from_chars(p, std::min(end, p + 2), value, 16);
+        // from_chars stops after two digits, so a third digit is caught here
+        // along with any other junk glued to the token.
+        if (ec != std::errc() || (next != end && !is_space(*next) && *next != '#' && *next != ';')) {
+            bad_token(std::size_t(token - begin));
+        }
+        if (n == out.size()) {
+            throw std::domain_error("Hex program does not fit in " + std::to_string(out.size()) + " bytes");
+        }
+        out[n++] = value;
+        p = next;
+    }
+    return n;
+}
+
+std::vector<std::uint8_t> parse_hex(const std::string_view text) {
+    // Every byte takes at least one digit and one separator.
+    std::vector<std::uint8_t> bytes(text.size() / 2 + 1);
+    bytes.resize(parse_hex(text, bytes));
+    return bytes;
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "fstat");
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_) {
+        void* base = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            const int err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "mmap");
+        }
+        madvise(base, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(base);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+std::vector<std::uint8_t> read_hex_file(const std::string& path) {
+    const MappedFile file(path);
+    return parse_hex(file.view());
+}
@@ -0,0 +1,118 @@
+#include "hle.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr address_t guest_page_mask = guest_page_size - 1;
+
+// Bytes from address to the end of its page.
+std::size_t page_left(const address_t address) {
+    return guest_page_size - (address & guest_page_mask);
+}
+
+// Host view of the DS relative [address, address + width), which must not
+// cross a page. Goes through the MMU like any guest access, so paging, the
+// R/W bits, watchpoints and code page generations all see it, and is kept
+// inside guest memory even in builds whose Memory does not check.
+std::uint8_t* guest_ptr(Executor& ex, const address_t address, const std::uint8_t access, const std::size_t width) {
+    std::uint8_t* host = ex.cpu.mmu.translate(Segment::DS, address, access, width);
+    const Memory& mem = ex.cpu.mem;
+    if (host < mem.data() || std::size_t(host - mem.data()) + width > mem.size()) {
+        throw MEMORY_FAULT(address, mem.size());
+    }
+    return host;
+}
+
+// Host view of the bytes from address up to the end of its page, cut short
+// at the segment limit or the end of guest memory, for scans that do not
+// know how far they will read. Only the first byte has to exist.
+const std::uint8_t* guest_chunk(Executor& ex, const address_t address, std::size_t& length) {
+    const std::uint8_t* host = guest_ptr(ex, address, MMU::READ, 1);
+    const auto& cache = ex.cpu.mmu.segment(Segment::DS);
+    const Memory& mem = ex.cpu.mem;
+    length = std::size_t(std::min<std::uint64_t>({page_left(address_t(cache.base + address)),
+                                                  std::uint64_t(cache.limit) - address + 1,
+                                                  std::uint64_t(mem.data() + mem.size() - host)}));
+    return host;
+}
+
+// Length of the NUL terminated guest string at address.
+std::size_t guest_strlen(Executor& ex, const address_t address) {
+    for (std::size_t n = 0;;) {
+        std::size_t chunk;
+        const auto* s = guest_chunk(ex, address_t(address + n), chunk);
+        if (const auto* end = static_cast<const std::uint8_t*>(std::memchr(s, 0, chunk))) {
+            return n + std::size_t(end - s);
+        }
+        n += chunk;
+    }
+}
+
+}
+
+std::uint32_t hle_memcpy(Executor& ex) {
+    const address_t dest = ex.cdecl_arg(0);
+    const address_t src = ex.cdecl_arg(1);
+    const std::size_t n = ex.cdecl_arg(2);
+    // memmove, as guests calling memcpy on overlapping buffers still expect
+    // what their libc happened to do rather than garbage. Page sized pieces
+    // are copied back to front when the destination overlaps a later part
+    // of the source.
+    const bool backwards = dest > src && dest < src + n;
+    for (std::size_t done = 0; done < n;) {
+        std::size_t at;
+        std::size_t chunk;
+        if (backwards) {
+            // The piece ending at end, back to the nearer page start.
+            const std::size_t end = n - done;
+            chunk = std::min({end, std::size_t((src + end - 1) & guest_page_mask) + 1,
+                              std::size_t((dest + end - 1) & guest_page_mask) + 1});
+            at = end - chunk;
+        } else {
+            at = done;
+            chunk = std::min({n - done, page_left(address_t(src + at)), page_left(address_t(dest + at))});
+        }
+        const auto* from = guest_ptr(ex, address_t(src + at), MMU::READ, chunk);
+        std::memmove(guest_ptr(ex, address_t(dest + at), MMU::WRITE, chunk), from, chunk);
+        done += chunk;
+    }
+    return dest;
+}
+
+std::uint32_t hle_memset(Executor& ex) {
+    const address_t dest = ex.cdecl_arg(0);
+    const auto c = std::uint8_t(ex.cdecl_arg(1));
+    const std::size_t n = ex.cdecl_arg(2);
+    for (std::size_t done = 0; done < n;) {
+        const std::size_t chunk = std::min(n - done, page_left(address_t(dest + done)));
+        std::memset(guest_ptr(ex, address_t(dest + done), MMU::WRITE, chunk), c, chunk);
+        done += chunk;
+    }
+    return dest;
+}
+
+std::uint32_t hle_strlen(Executor& ex) {
+    return std::uint32_t(guest_strlen(ex, ex.cdecl_arg(0)));
+}
+
+std::uint32_t hle_strcmp(Executor& ex) {
+    const address_t a = ex.cdecl_arg(0);
+    const address_t b = ex.cdecl_arg(1);
+    // Only as far as the shorter string reaches, plus its terminator.
+    const std::size_t n = std::min(guest_strlen(ex, a), guest_strlen(ex, b)) + 1;
+    for (std::size_t done = 0; done < n;) {
+        const auto at_a = address_t(a + done);
+        const auto at_b = address_t(b + done);
+        const std::size_t chunk = std::min({n - done, page_left(at_a), page_left(at_b)});
+        const int r = std::memcmp(guest_ptr(ex, at_a, MMU::READ, chunk), guest_ptr(ex, at_b, MMU::READ, chunk), chunk);
+        if (r) {
+            return std::uint32_t(r < 0 ? -1 : 1);
+        }
+        done += chunk;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "host_cpu.hh"
+
+#include <initializer_list>
+
+namespace {
+
+HostCpu probe() {
+    HostCpu host;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    host.sse2 = __builtin_cpu_supports("sse2");
+    host.sse4_2 = __builtin_cpu_supports("sse4.2");
+    host.avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return host;
+}
+
+}
+
+const HostCpu& HostCpu::get() {
+    static const HostCpu host = probe();
+    return host;
+}
+
+bool HostCpu::supports(const HostIsa isa) const {
+    switch (isa) {
+        case HostIsa::SCALAR: return true;
+        case HostIsa::SSE2: return sse2;
+        case HostIsa::SSE4_2: return sse2 && sse4_2;
+        case HostIsa::AVX2: return sse2 && sse4_2 && avx2;
+    }
+    return false;
+}
+
+HostIsa HostCpu::best() const {
+    for (const HostIsa isa : {HostIsa::AVX2, HostIsa::SSE4_2, HostIsa::SSE2}) {
+        if (supports(isa)) {
+            return isa;
+        }
+    }
+    return HostIsa::SCALAR;
+}
@@ -0,0 +1,273 @@
+#include "loader.hh"
+
+#include "constants.hh"
+#include "hex.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Closes the descriptor on every way out of the loader.
+class FileDescriptor {
+private:
+    int fd_;
+public:
+    FileDescriptor(const std::string& path) : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+    }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() {close(fd_);}
+
+    int get() const noexcept {return fd_;}
+
+    std::size_t size() const {
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fstat");
+        }
+        return static_cast<std::size_t>(st.st_size);
+    }
+};
+
+void read_exact(const int fd, std::uint8_t* dest, std::size_t length, std::size_t offset) {
+    while (length) {
+        const ssize_t n = pread(fd, dest, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::system_error(n < 0 ? errno : EIO, std::generic_category(), "pread");
+        }
+        dest += n;
+        offset += static_cast<std::size_t>(n);
+        length -= static_cast<std::size_t>(n);
+    }
+}
+
+constexpr std::size_t guest_page_mask = guest_page_size - 1;
+
+// One entry of the auxiliary vector handed to the program.
+struct AuxEntry {
+    std::uint32_t type;
+    std::uint32_t value;
+};
+
+// Copy a NUL terminated string below sp and return its guest address.
+address_t push_string(Memory& mem, address_t& sp, const std::string& s) {
+    sp -= address_t(s.size() + 1);
+    std::uint8_t* dest = mem.checked_ptr(sp, s.size() + 1);
+    std::copy(s.begin(), s.end(), dest);
+    dest[s.size()] = 0;
+    return sp;
+}
+
+}
+
+std::size_t flat_binary_memory_size(const std::size_t image_size, const address_t load_address) {
+    return std::max<std::size_t>(1_mb, load_address + image_size + 64_kb);
+}
+
+std::size_t load_hex_program(Executor& ex, const std::string& path, const address_t load_address) {
+    if (load_address > ex.cpu.mem.size()) {
+        throw std::domain_error("Load address outside guest memory");
+    }
+    const MappedFile file(path);
+    const std::size_t size = parse_hex(file.view(),
+        std::span(ex.cpu.mem.ptr(load_address, 0), ex.cpu.mem.size() - load_address));
+    ex.pc = load_address;
+    return size;
+}
+
+std::size_t load_flat_binary(Executor& ex, const std::string& path, const address_t load_address) {
+    const FileDescriptor file(path);
+    const std::size_t size = file.size();
+    if (load_address > ex.cpu.mem.size() || size > ex.cpu.mem.size() - load_address) {
+        throw std::domain_error("Image does not fit in guest memory: " + path);
+    }
+    if (load_address % Memory::page_size() == 0) {
+        ex.cpu.mem.map_file(file.get(), 0, load_address, size);
+    } else {
+        read_exact(file.get(), ex.cpu.mem.ptr(load_address, size), size, 0);
+    }
+    ex.cpu.mmu.enter_flat_mode();
+    ex.pc = load_address;
+    return size;
+}
+
+address_t Elf32Image::end() const {
+    address_t top = 0;
+    for (const auto& seg : segments) {
+        top = std::max(top, address_t(seg.vaddr + seg.memsz));
+    }
+    return address_t((top + guest_page_mask) & ~guest_page_mask);
+}
+
+Elf32Image read_elf32(const std::string& path) {
+    const FileDescriptor file(path);
+    const std::size_t size = file.size();
+
+    Elf32_Ehdr eh;
+    if (size < sizeof(eh)) {
+        throw std::domain_error("Not an ELF file: " + path);
+    }
+    read_exact(file.get(), reinterpret_cast<std::uint8_t*>(&eh), sizeof(eh), 0);
+    if (std::memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0) {
+        throw std::domain_error("Not an ELF file: " + path);
+    }
+    if (eh.e_ident[EI_CLASS] != ELFCLASS32 || eh.e_ident[EI_DATA] != ELFDATA2LSB
+        || eh.e_machine != EM_386 || eh.e_type != ET_EXEC) {
+        throw std::domain_error("Not a statically linked ELF32 i386 executable: " + path);
+    }
+    if (eh.e_phentsize != sizeof(Elf32_Phdr) || eh.e_phoff + std::size_t(eh.e_phnum) * sizeof(Elf32_Phdr) > size) {
+        throw std::domain_error("Corrupt program headers: " + path);
+    }
+
+    std::vector<Elf32_Phdr> phdrs(eh.e_phnum);
+    read_exact(file.get(), reinterpret_cast<std::uint8_t*>(phdrs.data()), phdrs.size() * sizeof(Elf32_Phdr), eh.e_phoff);
+
+    Elf32Image image;
+    image.path = path;
+    image.entry = eh.e_entry;
+    image.phnum = eh.e_phnum;
+    for (const auto& ph : phdrs) {
+        if (ph.p_type == PT_INTERP) {
+            throw std::domain_error("Dynamically linked executables are not supported: " + path);
+        }
+        if (ph.p_type == PT_PHDR) {
+            image.phdr = ph.p_vaddr;
+        }
+        if (ph.p_type != PT_LOAD || ph.p_memsz == 0) {
+            continue;
+        }
+        if (ph.p_filesz > ph.p_memsz || std::size_t(ph.p_offset) + ph.p_filesz > size) {
+            throw std::domain_error("Corrupt PT_LOAD segment: " + path);
+        }
+        const std::uint8_t perms = std::uint8_t(((ph.p_flags & PF_R) ? Memory::PAGE_READ : 0)
+            | ((ph.p_flags & PF_W) ? Memory::PAGE_WRITE : 0)
+            | ((ph.p_flags & PF_X) ? Memory::PAGE_EXEC : 0));
+        image.segments.push_back({ph.p_vaddr, ph.p_memsz, ph.p_filesz, ph.p_offset, perms});
+        // Without PT_PHDR, find the headers inside the segment that maps them.
+        if (!image.phdr && eh.e_phoff >= ph.p_offset && eh.e_phoff < ph.p_offset + ph.p_filesz) {
+            image.phdr = ph.p_vaddr + (eh.e_phoff - ph.p_offset);
+        }
+    }
+    if (image.segments.empty()) {
+        throw std::domain_error("No loadable segments: " + path);
+    }
+    return image;
+}
+
+std::size_t elf32_memory_size(const Elf32Image& image, const std::size_t stack_size) {
+    return std::size_t(image.end()) + stack_size;
+}
+
+void load_elf32(Executor& ex, const Elf32Image& image, const std::vector<std::string>& argv,
+                const std::vector<std::string>& envp) {
+    Memory& mem = ex.cpu.mem;
+    if (image.end() > mem.size() || image.end() < image.segments.front().vaddr) {
+        throw std::domain_error("Image does not fit in guest memory: " + image.path);
+    }
+
+    const FileDescriptor file(image.path);
+    const std::size_t host_page = Memory::page_size();
+    // Pages shared by two segments get the union of their permissions.
+    std::map<address_t, std::uint8_t> page_perms;
+    for (const auto& seg : image.segments) {
+        const std::size_t delta = seg.vaddr % host_page;
+        if (seg.filesz && delta == seg.offset % host_page) {
+            mem.map_file(file.get(), seg.offset - delta, address_t(seg.vaddr - delta), seg.filesz + delta);
+            // The rest of the last file page belongs to bss.
+            const std::size_t file_end = seg.vaddr + seg.filesz;
+            const std::size_t page_end = std::min((file_end + host_page - 1) & ~(host_page - 1), mem.size());
+            if (page_end > file_end) {
+                std::fill(mem.checked_ptr(file_end, page_end - file_end), mem.data() + page_end, std::uint8_t(0));
+            }
+        } else if (seg.filesz) {
+            read_exact(file.get(), mem.checked_ptr(seg.vaddr, seg.filesz), seg.filesz, seg.offset);
+        }
+        for (std::size_t page = seg.vaddr & ~guest_page_mask; page < seg.vaddr + seg.memsz; page += guest_page_size) {
+            page_perms[address_t(page)] |= seg.perms;
+        }
+    }
+    for (const auto& [page, perms] : page_perms) {
+        ex.cpu.mmu.protect(page, guest_page_size, perms);
+    }
+
+    // Strings first, at the very top of memory, then the vectors pointing
+    // at them, ending with sp 16 byte aligned on argc.
+    address_t sp = address_t(mem.size()) & ~address_t(15);
+    std::uint8_t random_bytes[16];
+    std::random_device rd;
+    for (auto& b : random_bytes) {
+        b = std::uint8_t(rd());
+    }
+    sp -= sizeof(random_bytes);
+    std::copy(std::begin(random_bytes), std::end(random_bytes), mem.checked_ptr(sp, sizeof(random_bytes)));
+    const address_t at_random = sp;
+    const address_t execfn = push_string(mem, sp, image.path);
+
+    std::vector<address_t> arg_ptrs, env_ptrs;
+    for (const auto& a : argv) {
+        arg_ptrs.push_back(push_string(mem, sp, a));
+    }
+    for (const auto& e : envp) {
+        env_ptrs.push_back(push_string(mem, sp, e));
+    }
+
+    const AuxEntry auxv[] = {
+        {AT_PHDR, image.phdr},
+        {AT_PHENT, sizeof(Elf32_Phdr)},
+        {AT_PHNUM, std::uint32_t(image.phnum)},
+        {AT_PAGESZ, std::uint32_t(guest_page_size)},
+        {AT_ENTRY, image.entry},
+        {AT_UID, 0}, {AT_EUID, 0}, {AT_GID, 0}, {AT_EGID, 0},
+        {AT_RANDOM, at_random},
+        {AT_EXECFN, execfn},
+        {AT_NULL, 0},
+    };
+    const std::size_t words = 1 + (arg_ptrs.size() + 1) + (env_ptrs.size() + 1) + 2 * std::size(auxv);
+    sp = address_t((sp - words * sizeof(std::uint32_t)) & ~std::size_t(15));
+
+    address_t at = sp;
+    const auto put = [&](std::uint32_t value) {
+        mwrite<std::uint32_t>(mem.checked_ptr(at, sizeof(value)), value);
+        at += sizeof(value);
+    };
+    put(std::uint32_t(arg_ptrs.size()));
+    for (const auto p : arg_ptrs) {
+        put(p);
+    }
+    put(0);
+    for (const auto p : env_ptrs) {
+        put(p);
+    }
+    put(0);
+    for (const auto& aux : auxv) {
+        put(aux.type);
+        put(aux.value);
+    }
+
+    ex.cpu.R[ESP] = sp;
+    // Linux runs i386 programs on flat segments whatever selectors they hold.
+    ex.cpu.mmu.enter_flat_mode();
+    ex.pc = image.entry;
+}
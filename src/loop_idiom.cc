@@ -0,0 +1,42 @@
+#include "loop_idiom.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace {
+
+constexpr std::uint8_t spin[] = {0x49, 0x75, 0xFD};
+constexpr std::uint8_t fill8[] = {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA};
+constexpr std::uint8_t fill32[] = {0x89, 0x07, 0x81, 0xC7, 0x04, 0x00, 0x00, 0x00, 0x49, 0x75, 0xF5};
+constexpr std::uint8_t copy8[] = {0x8A, 0x06, 0x88, 0x07, 0x46, 0x47, 0x49, 0x75, 0xF7};
+constexpr std::uint8_t sum8[] = {0x02, 0x06, 0x46, 0x49, 0x75, 0xFA};
+
+struct Pattern {
+    LoopShape shape;
+    std::span<const std::uint8_t> bytes;
+};
+
+// The rel8 of each closing jnz is part of the pattern, which pins the head to
+// the first byte of the body.
+constexpr std::array<Pattern, 5> patterns{{
+    {{LoopIdiom::SPIN, 2}, spin},
+    {{LoopIdiom::FILL8, 4}, fill8},
+    {{LoopIdiom::FILL32, 4}, fill32},
+    {{LoopIdiom::COPY8, 6}, copy8},
+    {{LoopIdiom::SUM8, 4}, sum8},
+}};
+
+}
+
+std::optional<LoopShape> match_loop_idiom(std::span<const std::uint8_t> body) {
+    for (const auto& pattern : patterns) {
+        if (std::equal(body.begin(), body.end(), pattern.bytes.begin(), pattern.bytes.end())) {
+            return pattern.shape;
+        }
+    }
+    return std::nullopt;
+}
@@ -1,52 +1,227 @@
 #include "memory.hh"
 
 #include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <new>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <utility>
 
-Memory::Memory() {}
+#include <sys/mman.h>
+#include <unistd.h>
 
-Memory::Memory(const std::size_t size) : data_(new std::uint8_t[size]), size_(size) {
-    std::fill(data_, data_ + size, 0);
+namespace {
+
+constexpr std::size_t guest_address_space = std::size_t(1) << 32;
+
+std::size_t host_page_size() {
+    static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+std::size_t page_round_up(const std::size_t n) {
+    const std::size_t page = host_page_size();
+    return (n + page - 1) & ~(page - 1);
 }
 
-Memory::~Memory() {delete[] data_;}
+// Total mapping length for a buffer of the given size, including the leading
+// and trailing guard pages.
+template <typename Policy>
+std::size_t mapping_size(const std::size_t size) {
+    const std::size_t body = Policy::reserve_address_space
+        ? std::max(page_round_up(size), guest_address_space)
+        : page_round_up(size);
+    return body + 2 * host_page_size();
+}
 
-std::uint8_t& Memory::operator[](const address_t index) {
-    return data_[index];
+std::string fault_message(std::size_t address, std::size_t size) {
+    std::stringstream ss;
+    ss << "Invalid access address of size: " << size << " and address: " << address << '\n';
+    return ss.str();
 }
 
-const std::uint8_t& Memory::operator[](const address_t index) const {
-    return data_[index];
 }
 
-std::uint8_t& Memory::at(const address_t index) {
-    if (index >= size_) {
-        std::stringstream ss;
-        ss << "Invalid access address of size: " << size_ << " and address: " << index << '\n';
-        throw std::domain_error(ss.str());
+MEMORY_FAULT::MEMORY_FAULT(std::size_t address_, std::size_t size)
+    : std::domain_error(fault_message(address_, size)), address(address_) {}
+
+template <typename Policy>
+BasicMemory<Policy>::BasicMemory() {}
+
+template <typename Policy>
+BasicMemory<Policy>::BasicMemory(const std::size_t size)
+    : size_(size), page_flags_((size + guest_page_size - 1) >> guest_page_shift, PAGE_RWX),
+      generations_(page_flags_.size(), 0) {
+    const std::size_t length = mapping_size<Policy>(size);
+    void* base = mmap(nullptr, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    data_ = static_cast<std::uint8_t*>(base) + host_page_size();
+    if (size && mprotect(data_, page_round_up(size), PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, length);
+        throw std::bad_alloc();
     }
-    return data_[index];
 }
 
-const std::uint8_t& Memory::at(const address_t index) const {
-    if (index >= size_) {
-        std::stringstream ss;
-        ss << "Invalid access address of size: " << size_ << " and address: " << index << '\n';
-        throw std::domain_error(ss.str());
+template <typename Policy>
+BasicMemory<Policy>::BasicMemory(const BasicMemory& other) : BasicMemory(other.size_) {
+    std::copy(other.data_, other.data_ + other.size_, data_);
+    page_flags_ = other.page_flags_;
+    generations_ = other.generations_;
+}
+
+template <typename Policy>
+BasicMemory<Policy>::BasicMemory(BasicMemory&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      page_flags_(std::move(other.page_flags_)),
+      generations_(std::move(other.generations_)) {}
+
+template <typename Policy>
+BasicMemory<Policy>::~BasicMemory() {
+    if (data_) {
+        munmap(data_ - host_page_size(), mapping_size<Policy>(size_));
     }
-    return data_[index];
 }
 
-Memory::operator bool() const noexcept {
+template <typename Policy>
+BasicMemory<Policy>::operator bool() const noexcept {
     return data_ != nullptr;
 }
 
-std::size_t Memory::size() const noexcept {return size_;}
-std::uint8_t* Memory::data() noexcept {return data_;}
+template <typename Policy>
+std::size_t BasicMemory<Policy>::size() const noexcept {return size_;}
 
-std::uint8_t* Memory::begin() noexcept {return data_;}
-std::uint8_t* Memory::end() noexcept {return data_ + size_;}
+template <typename Policy>
+void BasicMemory<Policy>::set_page_perms(const address_t address, const std::size_t length, const std::uint8_t perms) {
+    CheckedAccess::map(address, length, size_);
+    const std::size_t first = address >> guest_page_shift;
+    const std::size_t last = (address + length + guest_page_size - 1) >> guest_page_shift;
+    for (std::size_t page = first; page < last; ++page) {
+        page_flags_[page] = std::uint8_t((page_flags_[page] & ~PAGE_RWX) | (perms & PAGE_RWX));
+    }
+}
+
+template <typename Policy>
+void BasicMemory<Policy>::mark_code(const address_t address, const std::size_t length) {
+    CheckedAccess::map(address, length, size_);
+    const std::size_t first = address >> guest_page_shift;
+    const std::size_t last = (address + length + guest_page_size - 1) >> guest_page_shift;
+    for (std::size_t page = first; page < last; ++page) {
+        page_flags_[page] |= PAGE_CODE;
+    }
+}
+
+template <typename Policy>
+std::size_t BasicMemory<Policy>::page_size() noexcept {
+    return host_page_size();
+}
+
+template <typename Policy>
+std::vector<std::size_t> BasicMemory<Policy>::touched_pages() const {
+    const std::size_t page = host_page_size();
+    const std::size_t length = page_round_up(size_);
+    std::vector<std::size_t> pages;
+    if (!length) {
+        return pages;
+    }
+    std::vector<unsigned char> resident(length / page);
+    if (mincore(data_, length, resident.data()) != 0) {
+        // Without residency information every page has to be assumed touched.
+        std::fill(resident.begin(), resident.end(), 1);
+    }
+    for (std::size_t i = 0; i < resident.size(); ++i) {
+        if (resident[i] & 1) {
+            pages.push_back(i * page);
+        }
+    }
+    return pages;
+}
+
+template <typename Policy>
+void BasicMemory<Policy>::map_file(const int fd, const std::size_t file_offset, const address_t address,
+                                   const std::size_t length) {
+    const std::size_t page = host_page_size();
+    if ((address & (page - 1)) || (file_offset & (page - 1))) {
+        throw std::domain_error("File mappings must be page aligned");
+    }
+    CheckedAccess::map(address, length, size_);
+    if (!length) {
+        return;
+    }
+    void* target = data_ + address;
+    if (mmap(target, page_round_up(length), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+             static_cast<off_t>(file_offset)) == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+}
+
+template <typename Policy>
+void BasicMemory<Policy>::discard_pages(const std::size_t offset, const std::size_t length) {
+    CheckedAccess::map(offset, length, page_round_up(size_));
+    // Mapping fresh anonymous pages over the range rather than using
+    // MADV_DONTNEED, which would bring back file contents on file mappings.
+    if (length && mmap(data_ + offset, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                       -1, 0) == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+}
+
+template <typename Policy>
+bool BasicMemory<Policy>::advise_mergeable() {
+#ifdef MADV_MERGEABLE
+    const std::size_t length = page_round_up(size_);
+    return length && madvise(data_, length, MADV_MERGEABLE) == 0;
+#else
+    return false;
+#endif
+}
+
+template <typename Policy>
+void BasicMemory<Policy>::zero_dirty_pages() {
+    // Generations only ever move forward so that nothing cached before the
+    // reset can validate against the new contents.
+    for (std::size_t page = 0; page < page_flags_.size(); ++page) {
+        if (page_flags_[page] & PAGE_CODE) {
+            ++generations_[page];
+        }
+    }
+    std::fill(page_flags_.begin(), page_flags_.end(), PAGE_RWX);
+    // Replace the whole range rather than zeroing what mincore reports: a
+    // memset keeps touched pages resident and copies file backed ones, and
+    // a file page absent from the page cache would be missed entirely.
+    // Untouched pages cost nothing to replace.
+    discard_pages(0, page_round_up(size_));
+}
+
+template <typename Policy>
+BasicMemory<Policy>& BasicMemory<Policy>::operator=(BasicMemory&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(page_flags_, other.page_flags_);
+    std::swap(generations_, other.generations_);
+    return *this;
+}
+
+template <typename Policy>
+BasicMemory<Policy>& BasicMemory<Policy>::operator=(const BasicMemory& other) {
+    if (this != &other) {
+        BasicMemory tmp(other.size_);
+        std::copy(other.data_, other.data_ + other.size_, tmp.data_);
+        std::swap(data_, tmp.data_);
+        std::swap(size_, tmp.size_);
+        page_flags_ = other.page_flags_;
+        generations_ = other.generations_;
+    }
+    return *this;
+}
 
+template class BasicMemory<UncheckedAccess>;
+template class BasicMemory<WrapAccess>;
+template class BasicMemory<CheckedAccess>;
@@ -0,0 +1,283 @@
+#include "mmu.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+constexpr std::uint32_t PTE_P = 1u << 0;
+constexpr std::uint32_t PTE_RW = 1u << 1;
+constexpr std::uint32_t PTE_A = 1u << 5;
+constexpr std::uint32_t PTE_D = 1u << 6;
+
+constexpr std::uint32_t PF_P = 1u << 0;
+constexpr std::uint32_t PF_W = 1u << 1;
+
+}
+
+void MMU::write_cr0(std::uint32_t value) {
+    const bool paging = (value & CR0_PG) && (value & CR0_PE);
+    if (paging != paging_) {
+        flush_tlb();
+    }
+    cr0_ = value;
+    paging_ = paging;
+    flat_selectors_ = false;
+    update_direct();
+}
+
+void MMU::enter_flat_mode() {
+    write_cr0(cr0_ | CR0_PE);
+    flat_selectors_ = true;
+    segments_.fill(SegmentCache{});
+}
+
+void MMU::reset() {
+    if (!mem_->all_page_flags(Memory::PAGE_RWX)) {
+        mem_->set_page_perms(0, mem_->size(), Memory::PAGE_RWX);
+    }
+    for (const auto& wp : watchpoints_) {
+        for (std::size_t page = wp.address & ~page_mask; page < wp.address + wp.length; page += page_mask + 1) {
+            mem_->clear_page_flags(address_t(page), Memory::PAGE_WATCHED);
+        }
+    }
+    // Pages flagged as code keep trapping stores until Memory drops them.
+    const bool code_pages = code_pages_ && mem_->any_page_flags(Memory::PAGE_CODE);
+    *this = MMU(*mem_);
+    code_pages_ = code_pages;
+    update_direct();
+}
+
+void MMU::update_direct() noexcept {
+    direct_ = !paging_ && watchpoints_.empty() && !restricted_ && !code_pages_;
+}
+
+void MMU::protect(address_t address, std::size_t length, std::uint8_t perms) {
+    mem_->set_page_perms(address, length, perms);
+    // Recomputed, so a guest that protects and later unprotects its pages
+    // gets the direct path back. Fetch checks X itself.
+    restricted_ = !mem_->all_page_flags(Memory::PAGE_READ | Memory::PAGE_WRITE);
+    flush_tlb();
+    update_direct();
+}
+
+bool MMU::direct_range(address_t linear, std::uint64_t length, std::uint8_t access) const noexcept {
+    if (direct_) {
+        return true;
+    }
+    if (paging_) {
+        return false;
+    }
+    const std::uint64_t last = (linear + length - 1) >> page_shift;
+    for (std::uint64_t page = linear >> page_shift; page <= last; ++page) {
+        if (!page_allows(mem_->fetch_flags(std::size_t(page << page_shift)), access)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MMU::mark_code(address_t address, std::size_t length) {
+    mem_->mark_code(address, length);
+    code_pages_ = true;
+    flush_tlb();
+    update_direct();
+}
+
+void MMU::add_watchpoint(address_t address, std::size_t length) {
+    if (address + length > mem_->size()) {
+        throw MEMORY_FAULT(address + length, mem_->size());
+    }
+    watchpoints_.push_back({address, length});
+    for (std::size_t page = address & ~page_mask; page < address + length; page += page_mask + 1) {
+        mem_->set_page_flags(address_t(page), Memory::PAGE_WATCHED);
+    }
+    flush_tlb();
+    update_direct();
+}
+
+void MMU::remove_watchpoint(address_t address, std::size_t length) {
+    std::erase_if(watchpoints_, [&](const Watchpoint& wp) {
+        return wp.address == address && wp.length == length;
+    });
+    // Pages may be shared with other ranges, so clear and then re-mark.
+    for (std::size_t page = address & ~page_mask; page < address + length; page += page_mask + 1) {
+        mem_->clear_page_flags(address_t(page), Memory::PAGE_WATCHED);
+    }
+    for (const auto& wp : watchpoints_) {
+        for (std::size_t page = wp.address & ~page_mask; page < wp.address + wp.length; page += page_mask + 1) {
+            mem_->set_page_flags(address_t(page), Memory::PAGE_WATCHED);
+        }
+    }
+    flush_tlb();
+    update_direct();
+}
+
+void MMU::check_watchpoints(address_t physical, std::size_t width) {
+    if (watch_hit) {
+        return;
+    }
+    for (const auto& wp : watchpoints_) {
+        if (physical < wp.address + wp.length && wp.address < physical + width) {
+            watch_hit = WatchHit{physical, width};
+            return;
+        }
+    }
+}
+
+void MMU::write_cr3(std::uint32_t value) {
+    cr3_ = value;
+    flush_tlb();
+}
+
+void MMU::flush_tlb() noexcept {
+    tlb_.fill(TLBEntry{});
+}
+
+void MMU::invlpg(address_t linear) noexcept {
+    const address_t page = linear >> page_shift;
+    auto& entry = tlb_[page % tlb_entries];
+    if (entry.page == page) {
+        entry = TLBEntry{};
+    }
+}
+
+void MMU::load_segment(Segment seg, std::uint16_t selector) {
+    auto& cache = segments_[static_cast<unsigned int>(seg)];
+    if (flat_selectors_) {
+        cache = SegmentCache{};
+        return;
+    }
+    if (!(cr0_ & CR0_PE)) {
+        // Real mode only moves the base; the limit is left as it was.
+        cache.base = address_t(selector) << 4;
+        return;
+    }
+
+    const address_t index = selector & ~7u;
+    if (index == 0) {
+        // Null selector. Loading it is legal for the data segments.
+        if (seg == Segment::CS || seg == Segment::SS) {
+            throw GP_FAULT{selector};
+        }
+        cache = SegmentCache{0, 0};
+        return;
+    }
+    // Local descriptor tables are not modelled.
+    if ((selector & 4) || (index | 7u) > gdtr.limit) {
+        throw GP_FAULT{selector};
+    }
+
+    const std::uint32_t low = mread<std::uint32_t>(translate_linear(gdtr.base + index, READ));
+    const std::uint32_t high = mread<std::uint32_t>(translate_linear(gdtr.base + index + 4, READ));
+    if (!(high & (1u << 15))) {
+        throw GP_FAULT{selector};
+    }
+
+    address_t limit = (low & 0xFFFF) | (high & 0xF0000);
+    if (high & (1u << 23)) {
+        limit = (limit << page_shift) | page_mask;
+    }
+    cache.base = (low >> 16) | ((high & 0xFF) << 16) | (high & 0xFF000000);
+    cache.limit = limit;
+}
+
+// Table entries are always bounds checked so a bad table pointer raises
+// rather than reading past the end of guest memory.
+std::uint32_t MMU::walk_read(address_t physical) const {
+    return mread<std::uint32_t>(mem_->checked_ptr(physical, sizeof(std::uint32_t)));
+}
+
+void MMU::walk_write(address_t physical, std::uint32_t value) {
+    mwrite(mem_->checked_ptr(physical, sizeof(std::uint32_t)), value);
+}
+
+std::uint8_t* MMU::tlb_fill(address_t linear, std::uint8_t access, std::size_t width) {
+    const std::size_t head = std::min(width, guest_page_size - (linear & page_mask));
+    std::uint8_t* host = fill_page(linear, access, head);
+    if (head < width) {
+        // The tail lands on the next page, which must allow the access too.
+        // Callers get one pointer, so the two frames must also be adjacent.
+        const auto next = address_t(linear + head);
+        if (fill_page(next, access, width - head) != host + head) {
+            throw PAGE_FAULT{next, PF_P | ((access & WRITE) ? PF_W : 0)};
+        }
+    }
+    return host;
+}
+
+std::uint8_t* MMU::fill_page(address_t linear, std::uint8_t access, std::size_t width) {
+    address_t frame = linear & ~page_mask;
+    std::uint8_t perms = READ | WRITE;
+    if (paging_) {
+        frame = walk(linear, access, perms);
+    }
+
+    // Guest memory need not be a whole number of pages, so the entry only
+    // needs the start of the frame, but this access is bounded in full.
+    std::uint8_t* host = mem_->checked_ptr(frame);
+    mem_->checked_ptr(frame + (linear & page_mask), width);
+    const std::uint8_t flags = mem_->page_flags(frame);
+    if (!(flags & Memory::PAGE_READ)) {
+        perms &= std::uint8_t(~READ);
+    }
+    if (!(flags & Memory::PAGE_WRITE)) {
+        perms &= std::uint8_t(~WRITE);
+    }
+    if ((perms & access) != access) {
+        throw PAGE_FAULT{linear, PF_P | ((access & WRITE) ? PF_W : 0)};
+    }
+    if (flags & (Memory::PAGE_WATCHED | Memory::PAGE_CODE)) {
+        perms &= std::uint8_t(~WRITE);
+        if (access & WRITE) {
+            const address_t physical = frame + (linear & page_mask);
+            mem_->note_write(physical, width);
+            if (flags & Memory::PAGE_WATCHED) {
+                check_watchpoints(physical, width);
+            }
+        }
+    }
+
+    const address_t page = linear >> page_shift;
+    auto& entry = tlb_[page % tlb_entries];
+    entry.page = page;
+    entry.host = host;
+    entry.perms = perms;
+    return host + (linear & page_mask);
+}
+
+address_t MMU::walk(address_t linear, std::uint8_t access, std::uint8_t& perms) {
+    const address_t pde_address = (cr3_ & ~page_mask) + ((linear >> 22) << 2);
+    std::uint32_t pde = walk_read(pde_address);
+    if (!(pde & PTE_P)) {
+        throw PAGE_FAULT{linear, (access & WRITE) ? PF_W : 0};
+    }
+
+    const address_t pte_address = (pde & ~page_mask) + (((linear >> page_shift) & 0x3FF) << 2);
+    std::uint32_t pte = walk_read(pte_address);
+    if (!(pte & PTE_P)) {
+        throw PAGE_FAULT{linear, (access & WRITE) ? PF_W : 0};
+    }
+
+    const bool writable = (pde & PTE_RW) && (pte & PTE_RW);
+    if ((access & WRITE) && !writable) {
+        throw PAGE_FAULT{linear, PF_P | PF_W};
+    }
+
+    if (!(pde & PTE_A)) {
+        walk_write(pde_address, pde |= PTE_A);
+    }
+    // Only hand out write permission once the dirty bit is set, so the first
+    // store through a read filled entry comes back here to set it.
+    perms = READ;
+    const std::uint32_t update = PTE_A | ((access & WRITE) ? PTE_D : 0);
+    if ((pte & update) != update) {
+        walk_write(pte_address, pte |= update);
+    }
+    if (writable && (pte & PTE_D)) {
+        perms |= WRITE;
+    }
+
+    return pte & ~page_mask;
+}
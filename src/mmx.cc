@@ -1,66 +1,260 @@
+#include "mmx.hh"
+
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <limits>
-#include <type_traits>
-
-class Mmx {
-public:
-    union {
-        std::uint32_t u32[2];
-        std::uint16_t u16[4];
-        std::uint8_t u8[8];
-    } data_;
-
-    template <typename I>
-    [[nodiscard]] constexpr I& access(std::size_t index) {
-        if constexpr (std::is_same_v<I, std::uint8_t>) {
-            return data_.u8[index];
-        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
-            return data_.u16[index];
-        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
-            return data_.u32[index];
-        }
-    }
 
-    template <typename I>
-    [[nodiscard]] constexpr const auto& access(std::size_t index) const {
-        if constexpr (std::is_same_v<I, std::uint8_t>) {
-            return data_.u8[index];
-        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
-            return data_.u16[index];
-        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
-            return data_.u32[index];
-        }
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+#if defined(__SSE2__)
+// The host's own MMX instructions would clobber its x87 state, so the
+// operations run in the low half of an SSE2 register instead.
+__m128i load(const Mmx& m) {
+    return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(m.bytes()));
+}
+
+void store(Mmx& m, const __m128i v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(m.bytes()), v);
+}
+
+// dest's lanes in the low half and src's in the high half, for the packs.
+__m128i pair(const Mmx& lhs, const Mmx& rhs) {
+    return _mm_unpacklo_epi64(load(lhs), load(rhs));
+}
+
+// Interleaving the whole of both leaves the high halves' interleave on top.
+__m128i high_half(const __m128i v) {
+    return _mm_srli_si128(v, 8);
+}
+#else
+template <typename I, typename Func>
+void lanes(Mmx& lhs, const Mmx& rhs, Func func) {
+    for (std::size_t i = 0u; i < Mmx::elements<I>; ++i) {
+        lhs.access<I>(i) = static_cast<I>(func(lhs.access<I>(i), rhs.access<I>(i)));
     }
+}
 
-    template <typename I>
-    static constexpr std::size_t elements  = 16 / sizeof(I);
-};
+// value clamped to the range of S, stored in the unsigned lane type U.
+template <typename S, typename U>
+U saturate(const long long value) {
+    return U(S(std::clamp<long long>(value, std::numeric_limits<S>::min(), std::numeric_limits<S>::max())));
+}
+
+template <typename S, typename U>
+void add_saturate(Mmx& lhs, const Mmx& rhs) {
+    lanes<U>(lhs, rhs, [](U a, U b) {return saturate<S, U>(static_cast<long long>(S(a)) + S(b));});
+}
+
+template <typename S, typename U>
+void sub_saturate(Mmx& lhs, const Mmx& rhs) {
+    lanes<U>(lhs, rhs, [](U a, U b) {return saturate<S, U>(static_cast<long long>(S(a)) - S(b));});
+}
+
+template <typename I>
+I equal_mask(const I lhs, const I rhs) {
+    return lhs == rhs ? static_cast<I>(~I(0)) : I(0);
+}
+
+template <typename I>
+I greater_mask(const I lhs, const I rhs) {
+    using S = std::make_signed_t<I>;
+    return S(lhs) > S(rhs) ? static_cast<I>(~I(0)) : I(0);
+}
+
+template <typename I>
+constexpr std::uint64_t lane_bits = 8 * sizeof(I);
+
+template <typename I>
+void shift_left(Mmx& lhs, const Mmx& count) {
+    const std::uint64_t n = count.access<std::uint64_t>(0);
+    for (std::size_t i = 0u; i < Mmx::elements<I>; ++i) {
+        lhs.access<I>(i) = n >= lane_bits<I> ? I(0) : static_cast<I>(lhs.access<I>(i) << n);
+    }
+}
 
-class MMX {
-private:
-    Mmx mmx[8];
-public:
+template <typename I>
+void shift_right(Mmx& lhs, const Mmx& count) {
+    const std::uint64_t n = count.access<std::uint64_t>(0);
+    for (std::size_t i = 0u; i < Mmx::elements<I>; ++i) {
+        lhs.access<I>(i) = n >= lane_bits<I> ? I(0) : static_cast<I>(lhs.access<I>(i) >> n);
+    }
+}
 
-    template <typename I, typename Func>
-    void mmx_op(Mmx& lhs, const Mmx& rhs, Func func) {
-        for (std::size_t i = 0u; i < lhs.elements<I>; ++i) {
-            lhs.access<I>(i) = func(lhs.access<I>(i), rhs.access<I>(i));
-        } 
+template <typename I>
+void shift_right_arithmetic(Mmx& lhs, const Mmx& count) {
+    using S = std::make_signed_t<I>;
+    const std::uint64_t n = std::min(count.access<std::uint64_t>(0), lane_bits<I> - 1);
+    for (std::size_t i = 0u; i < Mmx::elements<I>; ++i) {
+        lhs.access<I>(i) = static_cast<I>(S(lhs.access<I>(i)) >> n);
     }
+}
 
-    void paddb(Mmx& lhs, const Mmx& rhs) {
-        mmx_op<std::uint8_t>(lhs, rhs, std::plus{});
+// Narrow the signed Wide lanes of lhs then rhs to S, stored as U.
+template <typename Wide, typename S, typename U>
+void pack(Mmx& lhs, const Mmx& rhs) {
+    using UWide = std::make_unsigned_t<Wide>;
+    Mmx tmp;
+    constexpr std::size_t n = Mmx::elements<UWide>;
+    for (std::size_t i = 0u; i < n; ++i) {
+        tmp.access<U>(i) = saturate<S, U>(Wide(lhs.access<UWide>(i)));
+        tmp.access<U>(n + i) = saturate<S, U>(Wide(rhs.access<UWide>(i)));
     }
+    lhs = tmp;
+}
 
-    void paddw(Mmx& lhs, const Mmx& rhs) {
-        mmx_op<std::uint16_t>(lhs, rhs, std::plus<std::uint16_t>{});
+template <typename I>
+void unpack(Mmx& lhs, const Mmx& rhs, const std::size_t from) {
+    Mmx tmp;
+    for (std::size_t i = 0u; i < Mmx::elements<I> / 2; ++i) {
+        tmp.access<I>(2 * i) = lhs.access<I>(from + i);
+        tmp.access<I>(2 * i + 1) = rhs.access<I>(from + i);
     }
+    lhs = tmp;
+}
+#endif
+
+}
+
+#if defined(__SSE2__)
+void MMX::paddb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_add_epi8(load(lhs), load(rhs)));}
+void MMX::paddw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_add_epi16(load(lhs), load(rhs)));}
+void MMX::paddd(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_add_epi32(load(lhs), load(rhs)));}
+void MMX::psubb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sub_epi8(load(lhs), load(rhs)));}
+void MMX::psubw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sub_epi16(load(lhs), load(rhs)));}
+void MMX::psubd(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sub_epi32(load(lhs), load(rhs)));}
+
+void MMX::paddsb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_adds_epi8(load(lhs), load(rhs)));}
+void MMX::paddsw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_adds_epi16(load(lhs), load(rhs)));}
+void MMX::paddusb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_adds_epu8(load(lhs), load(rhs)));}
+void MMX::paddusw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_adds_epu16(load(lhs), load(rhs)));}
+void MMX::psubsb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_subs_epi8(load(lhs), load(rhs)));}
+void MMX::psubsw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_subs_epi16(load(lhs), load(rhs)));}
+void MMX::psubusb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_subs_epu8(load(lhs), load(rhs)));}
+void MMX::psubusw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_subs_epu16(load(lhs), load(rhs)));}
+
+void MMX::pmullw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_mullo_epi16(load(lhs), load(rhs)));}
+void MMX::pmulhw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_mulhi_epi16(load(lhs), load(rhs)));}
+void MMX::pmaddwd(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_madd_epi16(load(lhs), load(rhs)));}
+
+void MMX::pand(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_and_si128(load(lhs), load(rhs)));}
+void MMX::pandn(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_andnot_si128(load(lhs), load(rhs)));}
+void MMX::por(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_or_si128(load(lhs), load(rhs)));}
+void MMX::pxor(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_xor_si128(load(lhs), load(rhs)));}
+
+void MMX::pcmpeqb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_cmpeq_epi8(load(lhs), load(rhs)));}
+void MMX::pcmpeqw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_cmpeq_epi16(load(lhs), load(rhs)));}
+void MMX::pcmpeqd(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_cmpeq_epi32(load(lhs), load(rhs)));}
+void MMX::pcmpgtb(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_cmpgt_epi8(load(lhs), load(rhs)));}
+void MMX::pcmpgtw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_cmpgt_epi16(load(lhs), load(rhs)));}
+void MMX::pcmpgtd(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_cmpgt_epi32(load(lhs), load(rhs)));}
 
-    void paddd(Mmx& lhs, const Mmx& rhs) {
-        mmx_op<std::uint32_t>(lhs, rhs, std::plus<std::uint32_t>{});
+// The SSE2 shifts take their count from the low quadword of a register,
+// just as the MMX ones do.
+void MMX::psllw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sll_epi16(load(lhs), load(rhs)));}
+void MMX::pslld(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sll_epi32(load(lhs), load(rhs)));}
+void MMX::psllq(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sll_epi64(load(lhs), load(rhs)));}
+void MMX::psrlw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_srl_epi16(load(lhs), load(rhs)));}
+void MMX::psrld(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_srl_epi32(load(lhs), load(rhs)));}
+void MMX::psrlq(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_srl_epi64(load(lhs), load(rhs)));}
+void MMX::psraw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sra_epi16(load(lhs), load(rhs)));}
+void MMX::psrad(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_sra_epi32(load(lhs), load(rhs)));}
+
+void MMX::packsswb(Mmx& lhs, const Mmx& rhs) {
+    const __m128i v = pair(lhs, rhs);
+    store(lhs, _mm_packs_epi16(v, v));
+}
+void MMX::packssdw(Mmx& lhs, const Mmx& rhs) {
+    const __m128i v = pair(lhs, rhs);
+    store(lhs, _mm_packs_epi32(v, v));
+}
+void MMX::packuswb(Mmx& lhs, const Mmx& rhs) {
+    const __m128i v = pair(lhs, rhs);
+    store(lhs, _mm_packus_epi16(v, v));
+}
+
+void MMX::punpcklbw(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_unpacklo_epi8(load(lhs), load(rhs)));}
+void MMX::punpcklwd(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_unpacklo_epi16(load(lhs), load(rhs)));}
+void MMX::punpckldq(Mmx& lhs, const Mmx& rhs) {store(lhs, _mm_unpacklo_epi32(load(lhs), load(rhs)));}
+void MMX::punpckhbw(Mmx& lhs, const Mmx& rhs) {store(lhs, high_half(_mm_unpacklo_epi8(load(lhs), load(rhs))));}
+void MMX::punpckhwd(Mmx& lhs, const Mmx& rhs) {store(lhs, high_half(_mm_unpacklo_epi16(load(lhs), load(rhs))));}
+void MMX::punpckhdq(Mmx& lhs, const Mmx& rhs) {store(lhs, high_half(_mm_unpacklo_epi32(load(lhs), load(rhs))));}
+#else
+void MMX::paddb(Mmx& lhs, const Mmx& rhs) {lanes<std::uint8_t>(lhs, rhs, std::plus<std::uint8_t>{});}
+void MMX::paddw(Mmx& lhs, const Mmx& rhs) {lanes<std::uint16_t>(lhs, rhs, std::plus<std::uint16_t>{});}
+void MMX::paddd(Mmx& lhs, const Mmx& rhs) {lanes<std::uint32_t>(lhs, rhs, std::plus<std::uint32_t>{});}
+void MMX::psubb(Mmx& lhs, const Mmx& rhs) {lanes<std::uint8_t>(lhs, rhs, std::minus<std::uint8_t>{});}
+void MMX::psubw(Mmx& lhs, const Mmx& rhs) {lanes<std::uint16_t>(lhs, rhs, std::minus<std::uint16_t>{});}
+void MMX::psubd(Mmx& lhs, const Mmx& rhs) {lanes<std::uint32_t>(lhs, rhs, std::minus<std::uint32_t>{});}
+
+void MMX::paddsb(Mmx& lhs, const Mmx& rhs) {add_saturate<std::int8_t, std::uint8_t>(lhs, rhs);}
+void MMX::paddsw(Mmx& lhs, const Mmx& rhs) {add_saturate<std::int16_t, std::uint16_t>(lhs, rhs);}
+void MMX::paddusb(Mmx& lhs, const Mmx& rhs) {add_saturate<std::uint8_t, std::uint8_t>(lhs, rhs);}
+void MMX::paddusw(Mmx& lhs, const Mmx& rhs) {add_saturate<std::uint16_t, std::uint16_t>(lhs, rhs);}
+void MMX::psubsb(Mmx& lhs, const Mmx& rhs) {sub_saturate<std::int8_t, std::uint8_t>(lhs, rhs);}
+void MMX::psubsw(Mmx& lhs, const Mmx& rhs) {sub_saturate<std::int16_t, std::uint16_t>(lhs, rhs);}
+void MMX::psubusb(Mmx& lhs, const Mmx& rhs) {sub_saturate<std::uint8_t, std::uint8_t>(lhs, rhs);}
+void MMX::psubusw(Mmx& lhs, const Mmx& rhs) {sub_saturate<std::uint16_t, std::uint16_t>(lhs, rhs);}
+
+void MMX::pmullw(Mmx& lhs, const Mmx& rhs) {
+    lanes<std::uint16_t>(lhs, rhs, [](std::uint16_t a, std::uint16_t b) {
+        return std::int32_t(std::int16_t(a)) * std::int16_t(b);
+    });
+}
+void MMX::pmulhw(Mmx& lhs, const Mmx& rhs) {
+    lanes<std::uint16_t>(lhs, rhs, [](std::uint16_t a, std::uint16_t b) {
+        return (std::int32_t(std::int16_t(a)) * std::int16_t(b)) >> 16;
+    });
+}
+void MMX::pmaddwd(Mmx& lhs, const Mmx& rhs) {
+    Mmx tmp;
+    for (std::size_t i = 0u; i < Mmx::elements<std::uint32_t>; ++i) {
+        const std::int64_t low = std::int32_t(std::int16_t(lhs.access<std::uint16_t>(2 * i)))
+            * std::int16_t(rhs.access<std::uint16_t>(2 * i));
+        const std::int64_t high = std::int32_t(std::int16_t(lhs.access<std::uint16_t>(2 * i + 1)))
+            * std::int16_t(rhs.access<std::uint16_t>(2 * i + 1));
+        // Only -32768 squared twice overflows, and wraps as the hardware does.
+        tmp.access<std::uint32_t>(i) = std::uint32_t(low + high);
     }
+    lhs = tmp;
+}
+
+void MMX::pand(Mmx& lhs, const Mmx& rhs) {lanes<std::uint64_t>(lhs, rhs, std::bit_and<std::uint64_t>{});}
+void MMX::pandn(Mmx& lhs, const Mmx& rhs) {
+    lanes<std::uint64_t>(lhs, rhs, [](std::uint64_t a, std::uint64_t b) {return ~a & b;});
+}
+void MMX::por(Mmx& lhs, const Mmx& rhs) {lanes<std::uint64_t>(lhs, rhs, std::bit_or<std::uint64_t>{});}
+void MMX::pxor(Mmx& lhs, const Mmx& rhs) {lanes<std::uint64_t>(lhs, rhs, std::bit_xor<std::uint64_t>{});}
+
+void MMX::pcmpeqb(Mmx& lhs, const Mmx& rhs) {lanes<std::uint8_t>(lhs, rhs, equal_mask<std::uint8_t>);}
+void MMX::pcmpeqw(Mmx& lhs, const Mmx& rhs) {lanes<std::uint16_t>(lhs, rhs, equal_mask<std::uint16_t>);}
+void MMX::pcmpeqd(Mmx& lhs, const Mmx& rhs) {lanes<std::uint32_t>(lhs, rhs, equal_mask<std::uint32_t>);}
+void MMX::pcmpgtb(Mmx& lhs, const Mmx& rhs) {lanes<std::uint8_t>(lhs, rhs, greater_mask<std::uint8_t>);}
+void MMX::pcmpgtw(Mmx& lhs, const Mmx& rhs) {lanes<std::uint16_t>(lhs, rhs, greater_mask<std::uint16_t>);}
+void MMX::pcmpgtd(Mmx& lhs, const Mmx& rhs) {lanes<std::uint32_t>(lhs, rhs, greater_mask<std::uint32_t>);}
+
+void MMX::psllw(Mmx& lhs, const Mmx& rhs) {shift_left<std::uint16_t>(lhs, rhs);}
+void MMX::pslld(Mmx& lhs, const Mmx& rhs) {shift_left<std::uint32_t>(lhs, rhs);}
+void MMX::psllq(Mmx& lhs, const Mmx& rhs) {shift_left<std::uint64_t>(lhs, rhs);}
+void MMX::psrlw(Mmx& lhs, const Mmx& rhs) {shift_right<std::uint16_t>(lhs, rhs);}
+void MMX::psrld(Mmx& lhs, const Mmx& rhs) {shift_right<std::uint32_t>(lhs, rhs);}
+void MMX::psrlq(Mmx& lhs, const Mmx& rhs) {shift_right<std::uint64_t>(lhs, rhs);}
+void MMX::psraw(Mmx& lhs, const Mmx& rhs) {shift_right_arithmetic<std::uint16_t>(lhs, rhs);}
+void MMX::psrad(Mmx& lhs, const Mmx& rhs) {shift_right_arithmetic<std::uint32_t>(lhs, rhs);}
 
+void MMX::packsswb(Mmx& lhs, const Mmx& rhs) {pack<std::int16_t, std::int8_t, std::uint8_t>(lhs, rhs);}
+void MMX::packssdw(Mmx& lhs, const Mmx& rhs) {pack<std::int32_t, std::int16_t, std::uint16_t>(lhs, rhs);}
+void MMX::packuswb(Mmx& lhs, const Mmx& rhs) {pack<std::int16_t, std::uint8_t, std::uint8_t>(lhs, rhs);}
 
-};
\ No newline at end of file
+void MMX::punpcklbw(Mmx& lhs, const Mmx& rhs) {unpack<std::uint8_t>(lhs, rhs, 0);}
+void MMX::punpcklwd(Mmx& lhs, const Mmx& rhs) {unpack<std::uint16_t>(lhs, rhs, 0);}
+void MMX::punpckldq(Mmx& lhs, const Mmx& rhs) {unpack<std::uint32_t>(lhs, rhs, 0);}
+void MMX::punpckhbw(Mmx& lhs, const Mmx& rhs) {unpack<std::uint8_t>(lhs, rhs, 4);}
+void MMX::punpckhwd(Mmx& lhs, const Mmx& rhs) {unpack<std::uint16_t>(lhs, rhs, 2);}
+void MMX::punpckhdq(Mmx& lhs, const Mmx& rhs) {unpack<std::uint32_t>(lhs, rhs, 1);}
+#endif
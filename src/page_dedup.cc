@@ -0,0 +1,70 @@
+#include "page_dedup.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// FNV-1a over the page in 64 bit words.
+std::uint64_t page_hash(const std::uint8_t* page, std::size_t length) {
+    std::uint64_t hash = 0xCBF29CE484222325;
+    for (std::size_t i = 0; i < length; i += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, page + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3;
+    }
+    return hash;
+}
+
+bool is_zero(const std::uint8_t* page, std::size_t length) {
+    return page[0] == 0 && std::memcmp(page, page + 1, length - 1) == 0;
+}
+
+}
+
+void PageDeduplicator::add(Memory& mem) {
+    if (std::find(memories_.begin(), memories_.end(), &mem) != memories_.end()) {
+        return;
+    }
+    memories_.push_back(&mem);
+    host_merging_ = mem.advise_mergeable() && host_merging_;
+}
+
+void PageDeduplicator::remove(Memory& mem) {
+    std::erase(memories_, &mem);
+}
+
+PageDeduplicator::Stats PageDeduplicator::scan() {
+    const std::size_t page = Memory::page_size();
+    Stats stats;
+    stats.host_merging = host_merging_;
+
+    // Hash to every distinct page seen with that hash, so collisions are
+    // settled by comparing contents.
+    std::unordered_map<std::uint64_t, std::vector<const std::uint8_t*>> seen;
+    for (auto* mem : memories_) {
+        for (const auto offset : mem->touched_pages()) {
+            const std::uint8_t* host = mem->data() + offset;
+            ++stats.pages_scanned;
+            if (is_zero(host, page)) {
+                mem->discard_pages(offset, page);
+                ++stats.zero_pages;
+                continue;
+            }
+            auto& bucket = seen[page_hash(host, page)];
+            const bool duplicate = std::any_of(bucket.begin(), bucket.end(), [&](const std::uint8_t* other) {
+                return std::memcmp(other, host, page) == 0;
+            });
+            if (duplicate) {
+                ++stats.duplicate_pages;
+            } else {
+                bucket.push_back(host);
+            }
+        }
+    }
+    return stats;
+}
@@ -1,31 +1,125 @@
 #include "executor.hh"
+#include "loader.hh"
+#include "syscalls.hh"
 
 #include <cstdint>
-#include <fstream>
+#include <cstdlib>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <sys/stat.h>
 #include <vector>
 #include <span>
+#include <string>
+#include <unistd.h>
+
+namespace {
 
 // LCOV_EXCL_START
-int main([[maybe_unused]] int argc, char** argv) {
-    std::ifstream reader(argv[1]);
-    std::vector<std::uint8_t> code;
-    uint c;
-    while (reader >> std::hex >> c) {
-        code.push_back(std::uint8_t(c));
+std::optional<Executor> load_hex(const char* path) {
+    Executor ex(std::span<const std::uint8_t>{});
+    if (load_hex_program(ex, path) == 0) {
+        return std::nullopt;
     }
+    return ex;
+}
+
+// pix86 --raw <image> [load address]
+Executor load_raw(const char* path, const char* address) {
+    const address_t load_address = address ? address_t(std::strtoul(address, nullptr, 0)) : 0;
+    struct stat st;
+    const std::size_t image_size = stat(path, &st) == 0 ? static_cast<std::size_t>(st.st_size) : 0;
+    const std::size_t mem_size = flat_binary_memory_size(image_size, load_address);
+    Executor ex(std::span<const std::uint8_t>{}, mem_size, mem_size);
+    load_flat_binary(ex, path, load_address);
+    return ex;
+}
+
+constexpr std::size_t elf_heap_size = 64_mb;
+constexpr std::size_t elf_stack_size = 8_mb;
 
-    if (code.empty()) {
-        return -1;
+// pix86 --elf <executable> [args...], run with the host environment. The
+// heap and mmap arena sits between the image and the stack.
+Executor load_elf(int argc, char** argv, std::optional<LinuxSyscalls>& sys) {
+    const auto image = read_elf32(argv[0]);
+    const std::size_t mem_size = elf32_memory_size(image, elf_stack_size) + elf_heap_size;
+    Executor ex(std::span<const std::uint8_t>{}, mem_size, elf_stack_size);
+    sys.emplace(image.end(), address_t(mem_size - elf_stack_size - guest_page_size));
+    std::vector<std::string> args(argv, argv + argc);
+    std::vector<std::string> env;
+    for (char** e = environ; *e; ++e) {
+        env.emplace_back(*e);
+    }
+    load_elf32(ex, image, args, env);
+    return ex;
+}
+// LCOV_EXCL_STOP
+
+}
+
+// LCOV_EXCL_START
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Call this program as: " << argv[0] << " <hex_file>\n"
+            << "                    or: " << argv[0] << " --raw <image> [load_address]\n"
+            << "                    or: " << argv[0] << " --elf <executable> [args...]\n";
+        return 1;
     }
 
-    Executor ex(std::span(code.data(), code.size()));
     try {
-        ex.execute(true, false);
+        const bool raw = std::string_view(argv[1]) == "--raw";
+        const bool elf = std::string_view(argv[1]) == "--elf";
+        if ((raw || elf) && argc < 3) {
+            std::cout << "Missing image path\n";
+            return 1;
+        }
+        std::optional<LinuxSyscalls> sys;
+        std::optional<Executor> ex = raw ? load_raw(argv[2], argc > 3 ? argv[3] : nullptr)
+            : elf ? load_elf(argc - 2, argv + 2, sys)
+            : load_hex(argv[1]);
+        if (!ex) {
+            return -1;
+        }
+        // Opt in to the faster double precision x87 stack, for guests
+        // that already set 53 bit precision themselves.
+        if (std::getenv("PIX86_DOUBLE_FPU")) {
+            ex->fpu.set_double_mode(true);
+        }
+        // Advertise the partial SSE support, for guests known to use only
+        // the packed forms and the string compares.
+        if (std::getenv("PIX86_SIMD")) {
+            ex->cpuid_model = CpuidModel::with_simd();
+        }
+        // Flat programs get syscalls too, just without a heap or mmap arena.
+        if (!sys) {
+            sys.emplace(address_t(ex->cpu.mem.size()), address_t(ex->cpu.mem.size()));
+        }
+        const bool visual_debug = !elf;
+        for (;;) {
+            const ExitReason reason = ex->execute(visual_debug, false);
+            if (reason == ExitReason::WATCHPOINT) {
+                std::cout << "Watchpoint hit at " << std::hex << ex->cpu.mmu.watch_hit->address << '\n';
+                break;
+            }
+            sys->handle(*ex);
+            if (sys->exited()) {
+                return sys->exit_status();
+            }
+        }
     } catch (const CPU_HALT& ch) {
         std::cout << ch.x << std::endl;
+    } catch (const PAGE_FAULT& pf) {
+        std::cout << "Page fault at " << std::hex << pf.address << '\n';
+    } catch (const GP_FAULT& gp) {
+        std::cout << "General protection fault, selector " << std::hex << gp.selector << '\n';
+    } catch (const DIVIDE_ERROR&) {
+        std::cout << "Divide error\n";
+    } catch (const STACK_FAULT& sf) {
+        std::cout << "Stack overflow, ESP " << std::hex << sf.esp << '\n';
     } catch (const std::logic_error& de) {
         std::cout << de.what() << '\n';
+    } catch (const std::runtime_error& re) {
+        std::cout << re.what() << '\n';
     }
 }
-// LCOV_EXCL_STOP
\ No newline at end of file
+// LCOV_EXCL_STOP
@@ -1,85 +1,375 @@
+#include "sse.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
-#include <type_traits>
 #include <functional>
+#include <utility>
 
-class Xmm {
-private:
-    union {
-        std::uint64_t u64[2];
-        std::uint32_t u32[4];
-        std::uint16_t u16[8];
-        std::uint8_t u8[16];
-        double f64[2];
-        float f32[4];
-    } data_;
-
-public:
-    template <typename I>
-    [[nodiscard]] I& access(std::size_t index) {
-        if constexpr (std::is_same_v<I, std::uint8_t>) {
-            return data_.u8[index];
-        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
-            return data_.u16[index];
-        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
-            return data_.u32[index];
-        } else if constexpr (std::is_same_v<I, float>) {
-            return data_.f32[index];
-        } else if constexpr (std::is_same_v<I, double>) {
-            return data_.f64[index];
-        } else {
-            throw -1;
-        }
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIX86_X86_KERNELS 1
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+#if defined(__SSE2__)
+__m128i load(const Xmm& x) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(x.bytes()));
+}
+
+void store(Xmm& x, const __m128i v) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(x.bytes()), v);
+}
+
+__m128 load_ps(const Xmm& x) {
+    return _mm_load_ps(&x.access<float>(0));
+}
+
+void store_ps(Xmm& x, const __m128 v) {
+    _mm_store_ps(&x.access<float>(0), v);
+}
+
+__m128d load_pd(const Xmm& x) {
+    return _mm_load_pd(&x.access<double>(0));
+}
+
+void store_pd(Xmm& x, const __m128d v) {
+    _mm_store_pd(&x.access<double>(0), v);
+}
+#else
+template <typename I, typename Func>
+void lanes(Xmm& lhs, const Xmm& rhs, Func func) {
+    for (std::size_t i = 0u; i < Xmm::elements<I>; ++i) {
+        lhs.access<I>(i) = static_cast<I>(func(lhs.access<I>(i), rhs.access<I>(i)));
     }
+}
 
-    template <typename I>
-    [[nodiscard]] constexpr const I& access(std::size_t index) const {
-        if constexpr (std::is_same_v<I, std::uint8_t>) {
-            return data_.u8[index];
-        } else if constexpr (std::is_same_v<I, std::uint16_t>) {
-            return data_.u16[index];
-        } else if constexpr (std::is_same_v<I, std::uint32_t>) {
-            return data_.u32[index];
-        } else if constexpr (std::is_same_v<I, float>) {
-            return data_.f32[index];
-        } else if constexpr (std::is_same_v<I, double>) {
-            return data_.f64[index];
-        } else {
-            throw -1;
-        }
+template <typename I>
+I equal_mask(const I lhs, const I rhs) {
+    return lhs == rhs ? static_cast<I>(~I(0)) : I(0);
+}
+
+template <typename I>
+void unpack_low(Xmm& lhs, const Xmm& rhs) {
+    Xmm tmp;
+    for (std::size_t i = 0u; i < Xmm::elements<I> / 2; ++i) {
+        tmp.access<I>(2 * i) = lhs.access<I>(i);
+        tmp.access<I>(2 * i + 1) = rhs.access<I>(i);
     }
+    lhs = tmp;
+}
+#endif
 
-    template <typename I>
-    static constexpr std::size_t elements  = 16 / sizeof(I);
-};
+}
 
-class SSE {
-public:
-    Xmm reg[8];
+void SSE::reset() {
+    for (auto& r : reg) {
+        r = Xmm{};
+    }
+}
 
-    template <typename I, typename Func>
-    void xmm_op(Xmm& lhs, const Xmm& rhs, Func func) {
-        for (std::size_t i = 0u; i < lhs.elements<I>; ++i) {
-            lhs.access<I>(i) = func(lhs.access<I>(i), rhs.access<I>(i));
-        }
+#if defined(__SSE2__)
+void SSE::paddb(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_add_epi8(load(lhs), load(rhs)));}
+void SSE::paddw(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_add_epi16(load(lhs), load(rhs)));}
+void SSE::paddd(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_add_epi32(load(lhs), load(rhs)));}
+void SSE::paddq(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_add_epi64(load(lhs), load(rhs)));}
+void SSE::psubb(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_sub_epi8(load(lhs), load(rhs)));}
+void SSE::psubw(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_sub_epi16(load(lhs), load(rhs)));}
+void SSE::psubd(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_sub_epi32(load(lhs), load(rhs)));}
+void SSE::psubq(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_sub_epi64(load(lhs), load(rhs)));}
+void SSE::pminub(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_min_epu8(load(lhs), load(rhs)));}
+
+void SSE::pand(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_and_si128(load(lhs), load(rhs)));}
+void SSE::pandn(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_andnot_si128(load(lhs), load(rhs)));}
+void SSE::por(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_or_si128(load(lhs), load(rhs)));}
+void SSE::pxor(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_xor_si128(load(lhs), load(rhs)));}
+
+void SSE::pcmpeqb(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_cmpeq_epi8(load(lhs), load(rhs)));}
+void SSE::pcmpeqw(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_cmpeq_epi16(load(lhs), load(rhs)));}
+void SSE::pcmpeqd(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_cmpeq_epi32(load(lhs), load(rhs)));}
+
+void SSE::punpcklbw(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_unpacklo_epi8(load(lhs), load(rhs)));}
+void SSE::punpcklwd(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_unpacklo_epi16(load(lhs), load(rhs)));}
+void SSE::punpckldq(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_unpacklo_epi32(load(lhs), load(rhs)));}
+void SSE::punpcklqdq(Xmm& lhs, const Xmm& rhs) {store(lhs, _mm_unpacklo_epi64(load(lhs), load(rhs)));}
+
+void SSE::addps(Xmm& lhs, const Xmm& rhs) {store_ps(lhs, _mm_add_ps(load_ps(lhs), load_ps(rhs)));}
+void SSE::addpd(Xmm& lhs, const Xmm& rhs) {store_pd(lhs, _mm_add_pd(load_pd(lhs), load_pd(rhs)));}
+void SSE::subps(Xmm& lhs, const Xmm& rhs) {store_ps(lhs, _mm_sub_ps(load_ps(lhs), load_ps(rhs)));}
+void SSE::subpd(Xmm& lhs, const Xmm& rhs) {store_pd(lhs, _mm_sub_pd(load_pd(lhs), load_pd(rhs)));}
+void SSE::mulps(Xmm& lhs, const Xmm& rhs) {store_ps(lhs, _mm_mul_ps(load_ps(lhs), load_ps(rhs)));}
+void SSE::mulpd(Xmm& lhs, const Xmm& rhs) {store_pd(lhs, _mm_mul_pd(load_pd(lhs), load_pd(rhs)));}
+void SSE::divps(Xmm& lhs, const Xmm& rhs) {store_ps(lhs, _mm_div_ps(load_ps(lhs), load_ps(rhs)));}
+void SSE::divpd(Xmm& lhs, const Xmm& rhs) {store_pd(lhs, _mm_div_pd(load_pd(lhs), load_pd(rhs)));}
+
+std::uint32_t SSE::pmovmskb(const Xmm& src) const {
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(load(src)));
+}
+#else
+void SSE::paddb(Xmm& lhs, const Xmm& rhs) {lanes<std::uint8_t>(lhs, rhs, std::plus<std::uint8_t>{});}
+void SSE::paddw(Xmm& lhs, const Xmm& rhs) {lanes<std::uint16_t>(lhs, rhs, std::plus<std::uint16_t>{});}
+void SSE::paddd(Xmm& lhs, const Xmm& rhs) {lanes<std::uint32_t>(lhs, rhs, std::plus<std::uint32_t>{});}
+void SSE::paddq(Xmm& lhs, const Xmm& rhs) {lanes<std::uint64_t>(lhs, rhs, std::plus<std::uint64_t>{});}
+void SSE::psubb(Xmm& lhs, const Xmm& rhs) {lanes<std::uint8_t>(lhs, rhs, std::minus<std::uint8_t>{});}
+void SSE::psubw(Xmm& lhs, const Xmm& rhs) {lanes<std::uint16_t>(lhs, rhs, std::minus<std::uint16_t>{});}
+void SSE::psubd(Xmm& lhs, const Xmm& rhs) {lanes<std::uint32_t>(lhs, rhs, std::minus<std::uint32_t>{});}
+void SSE::psubq(Xmm& lhs, const Xmm& rhs) {lanes<std::uint64_t>(lhs, rhs, std::minus<std::uint64_t>{});}
+void SSE::pminub(Xmm& lhs, const Xmm& rhs) {
+    lanes<std::uint8_t>(lhs, rhs, [](std::uint8_t a, std::uint8_t b) {return a < b ? a : b;});
+}
+
+void SSE::pand(Xmm& lhs, const Xmm& rhs) {lanes<std::uint64_t>(lhs, rhs, std::bit_and<std::uint64_t>{});}
+void SSE::pandn(Xmm& lhs, const Xmm& rhs) {
+    lanes<std::uint64_t>(lhs, rhs, [](std::uint64_t a, std::uint64_t b) {return ~a & b;});
+}
+void SSE::por(Xmm& lhs, const Xmm& rhs) {lanes<std::uint64_t>(lhs, rhs, std::bit_or<std::uint64_t>{});}
+void SSE::pxor(Xmm& lhs, const Xmm& rhs) {lanes<std::uint64_t>(lhs, rhs, std::bit_xor<std::uint64_t>{});}
+
+void SSE::pcmpeqb(Xmm& lhs, const Xmm& rhs) {lanes<std::uint8_t>(lhs, rhs, equal_mask<std::uint8_t>);}
+void SSE::pcmpeqw(Xmm& lhs, const Xmm& rhs) {lanes<std::uint16_t>(lhs, rhs, equal_mask<std::uint16_t>);}
+void SSE::pcmpeqd(Xmm& lhs, const Xmm& rhs) {lanes<std::uint32_t>(lhs, rhs, equal_mask<std::uint32_t>);}
+
+void SSE::punpcklbw(Xmm& lhs, const Xmm& rhs) {unpack_low<std::uint8_t>(lhs, rhs);}
+void SSE::punpcklwd(Xmm& lhs, const Xmm& rhs) {unpack_low<std::uint16_t>(lhs, rhs);}
+void SSE::punpckldq(Xmm& lhs, const Xmm& rhs) {unpack_low<std::uint32_t>(lhs, rhs);}
+void SSE::punpcklqdq(Xmm& lhs, const Xmm& rhs) {unpack_low<std::uint64_t>(lhs, rhs);}
+
+void SSE::addps(Xmm& lhs, const Xmm& rhs) {lanes<float>(lhs, rhs, std::plus<float>{});}
+void SSE::addpd(Xmm& lhs, const Xmm& rhs) {lanes<double>(lhs, rhs, std::plus<double>{});}
+void SSE::subps(Xmm& lhs, const Xmm& rhs) {lanes<float>(lhs, rhs, std::minus<float>{});}
+void SSE::subpd(Xmm& lhs, const Xmm& rhs) {lanes<double>(lhs, rhs, std::minus<double>{});}
+void SSE::mulps(Xmm& lhs, const Xmm& rhs) {lanes<float>(lhs, rhs, std::multiplies<float>{});}
+void SSE::mulpd(Xmm& lhs, const Xmm& rhs) {lanes<double>(lhs, rhs, std::multiplies<double>{});}
+void SSE::divps(Xmm& lhs, const Xmm& rhs) {lanes<float>(lhs, rhs, std::divides<float>{});}
+void SSE::divpd(Xmm& lhs, const Xmm& rhs) {lanes<double>(lhs, rhs, std::divides<double>{});}
+
+std::uint32_t SSE::pmovmskb(const Xmm& src) const {
+    std::uint32_t rv = 0;
+    for (std::size_t i = 0u; i < Xmm::elements<std::uint8_t>; ++i) {
+        rv |= std::uint32_t(src.access<std::uint8_t>(i) >> 7) << i;
     }
+    return rv;
+}
+#endif
 
-    void paddb(Xmm& lhs, const Xmm& rhs) {
-        xmm_op<std::uint8_t>(lhs, rhs, std::plus<std::uint8_t>{});
+// _mm_shuffle_epi32 only takes a constant order, and a runtime one costs
+// no more as four dword moves.
+void SSE::pshufd(Xmm& dest, const Xmm& src, const std::uint8_t order) {
+    Xmm tmp;
+    for (std::size_t i = 0u; i < 4; ++i) {
+        tmp.access<std::uint32_t>(i) = src.access<std::uint32_t>((order >> (2 * i)) & 3);
     }
+    dest = tmp;
+}
 
-    void paddw(Xmm& lhs, const Xmm& rhs) {
-        xmm_op<std::uint16_t>(lhs, rhs, std::plus<std::uint16_t>{});
+namespace {
+
+// PCMPxSTRx control bits 0 and 1 pick the element format; bit 0 is words.
+std::size_t string_elements(const std::uint8_t control) {
+    return control & 1 ? 8 : 16;
+}
+
+int string_element(const Xmm& x, const std::size_t i, const std::uint8_t control) {
+    switch (control & 3) {
+        case 0: return x.access<std::uint8_t>(i);
+        case 1: return x.access<std::uint16_t>(i);
+        case 2: return std::int8_t(x.access<std::uint8_t>(i));
+        default: return std::int16_t(x.access<std::uint16_t>(i));
     }
+}
+
+std::size_t explicit_length(const std::int32_t length, const std::size_t n) {
+    const std::int64_t magnitude = length < 0 ? -std::int64_t(length) : std::int64_t(length);
+    return std::size_t(std::min(magnitude, std::int64_t(n)));
+}
 
-    void paddd(Xmm& lhs, const Xmm& rhs) {
-        xmm_op<std::uint32_t>(lhs, rhs, std::plus<std::uint32_t>{});
+std::size_t implicit_length(const Xmm& x, const std::uint8_t control) {
+    const std::size_t n = string_elements(control);
+    for (std::size_t i = 0u; i < n; ++i) {
+        if (string_element(x, i, control) == 0) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Elements at and past a length are invalid, and each aggregation treats
+// comparisons against them as the SDM's override table says.
+std::uint16_t compare_strings(const Xmm& a, const std::size_t length_a, const Xmm& b, const std::size_t length_b,
+                              const std::uint8_t control) {
+    const std::size_t n = string_elements(control);
+    unsigned int result = 0;
+    for (std::size_t j = 0u; j < n; ++j) {
+        const int bj = string_element(b, j, control);
+        bool hit = false;
+        switch ((control >> 2) & 3) {
+            case 0: {
+                // Equal any.
+                for (std::size_t i = 0u; i < length_a && j < length_b; ++i) {
+                    hit = hit || string_element(a, i, control) == bj;
+                }
+            } break;
+            case 1: {
+                // Ranges, from pairs of a; an odd last element pairs with
+                // an invalid one and never matches.
+                for (std::size_t i = 0u; i + 1 < length_a && j < length_b; i += 2) {
+                    hit = hit || (string_element(a, i, control) <= bj && bj <= string_element(a, i + 1, control));
+                }
+            } break;
+            case 2: {
+                // Equal each, where two invalid elements are equal.
+                hit = j < length_a && j < length_b ? string_element(a, j, control) == bj
+                                                   : j >= length_a && j >= length_b;
+            } break;
+            default: {
+                // Equal ordered: a, up to its length, appears at b[j].
+                hit = true;
+                for (std::size_t i = 0u; i + j < n && i < length_a && hit; ++i) {
+                    hit = i + j < length_b && string_element(a, i, control) == string_element(b, i + j, control);
+                }
+            } break;
+        }
+        result |= unsigned(hit) << j;
     }
+    switch ((control >> 4) & 3) {
+        case 1: result ^= (1u << n) - 1; break;
+        case 3: result ^= (1u << length_b) - 1; break;
+        default: break;
+    }
+    return std::uint16_t(result);
+}
+
+std::uint16_t portable_explicit(const Xmm& a, const std::int32_t length_a, const Xmm& b, const std::int32_t length_b,
+                                const std::uint8_t control) {
+    const std::size_t n = string_elements(control);
+    return compare_strings(a, explicit_length(length_a, n), b, explicit_length(length_b, n), control);
+}
+
+std::uint16_t portable_implicit(const Xmm& a, const Xmm& b, const std::uint8_t control) {
+    return compare_strings(a, implicit_length(a, control), b, implicit_length(b, control), control);
+}
+
+constexpr StringCompareKernels portable_kernels = {portable_explicit, portable_implicit};
+
+#if PIX86_X86_KERNELS
+// The instructions take control as an immediate, so there is one host
+// function per value of the six bits that shape IntRes2. Bit 6 only picks
+// the output, which string_index and string_mask apply, and bit 7 is
+// reserved.
+constexpr std::size_t control_bits = 0x3F;
+
+using HostExplicit = std::uint16_t (*)(const Xmm&, std::int32_t, const Xmm&, std::int32_t);
+using HostImplicit = std::uint16_t (*)(const Xmm&, const Xmm&);
+
+template <int control>
+__attribute__((target("sse4.2")))
+std::uint16_t host_explicit(const Xmm& a, const std::int32_t length_a, const Xmm& b, const std::int32_t length_b) {
+    const __m128i va = _mm_load_si128(reinterpret_cast<const __m128i*>(a.bytes()));
+    const __m128i vb = _mm_load_si128(reinterpret_cast<const __m128i*>(b.bytes()));
+    return std::uint16_t(_mm_cvtsi128_si32(_mm_cmpestrm(va, length_a, vb, length_b, control)));
+}
+
+template <int control>
+__attribute__((target("sse4.2")))
+std::uint16_t host_implicit(const Xmm& a, const Xmm& b) {
+    const __m128i va = _mm_load_si128(reinterpret_cast<const __m128i*>(a.bytes()));
+    const __m128i vb = _mm_load_si128(reinterpret_cast<const __m128i*>(b.bytes()));
+    return std::uint16_t(_mm_cvtsi128_si32(_mm_cmpistrm(va, vb, control)));
+}
+
+template <std::size_t... control>
+constexpr std::array<HostExplicit, control_bits + 1> host_explicit_table(std::index_sequence<control...>) {
+    return {host_explicit<int(control)>...};
+}
 
-    void paddq(Xmm& lhs, const Xmm& rhs) {
-        xmm_op<std::uint64_t>(lhs, rhs, std::plus<std::uint64_t>{});
+template <std::size_t... control>
+constexpr std::array<HostImplicit, control_bits + 1> host_implicit_table(std::index_sequence<control...>) {
+    return {host_implicit<int(control)>...};
+}
+
+constexpr auto host_explicit_kernels = host_explicit_table(std::make_index_sequence<control_bits + 1>{});
+constexpr auto host_implicit_kernels = host_implicit_table(std::make_index_sequence<control_bits + 1>{});
+
+std::uint16_t sse42_explicit(const Xmm& a, const std::int32_t length_a, const Xmm& b, const std::int32_t length_b,
+                             const std::uint8_t control) {
+    return host_explicit_kernels[control & control_bits](a, length_a, b, length_b);
+}
+
+std::uint16_t sse42_implicit(const Xmm& a, const Xmm& b, const std::uint8_t control) {
+    return host_implicit_kernels[control & control_bits](a, b);
+}
+
+constexpr StringCompareKernels sse42_kernels = {sse42_explicit, sse42_implicit};
+#endif
+
+const StringCompareKernels& bound = string_compare_kernels(HostCpu::get().best());
+
+// CF, OF and the result are common to both forms; ZF and SF say whether b
+// and a end before the register does.
+SSE::StringMatch string_match(const std::uint16_t result, const std::size_t length_a, const std::size_t length_b,
+                              const std::uint8_t control) {
+    const std::size_t n = string_elements(control);
+    SSE::StringMatch match;
+    match.result = result;
+    match.carry = result != 0;
+    match.zero = length_b < n;
+    match.sign = length_a < n;
+    match.overflow = result & 1;
+    return match;
+}
+
+}
+
+const StringCompareKernels& string_compare_kernels(const HostIsa isa) {
+#if PIX86_X86_KERNELS
+    if (isa == HostIsa::SSE4_2 || isa == HostIsa::AVX2) {
+        return sse42_kernels;
     }
+#else
+    static_cast<void>(isa);
+#endif
+    return portable_kernels;
+}
+
+SSE::StringMatch SSE::pcmpestr(const Xmm& a, const std::int32_t length_a, const Xmm& b, const std::int32_t length_b,
+                               const std::uint8_t control) const {
+    const std::size_t n = string_elements(control);
+    return string_match(bound.explicit_length(a, length_a, b, length_b, control), explicit_length(length_a, n),
+                        explicit_length(length_b, n), control);
+}
 
+SSE::StringMatch SSE::pcmpistr(const Xmm& a, const Xmm& b, const std::uint8_t control) const {
+    return string_match(bound.implicit_length(a, b, control), implicit_length(a, control),
+                        implicit_length(b, control), control);
+}
 
-};
+std::uint32_t SSE::string_index(const StringMatch& match, const std::uint8_t control) {
+    if (match.result == 0) {
+        return std::uint32_t(string_elements(control));
+    }
+    return control & 0x40 ? std::uint32_t(15 - std::countl_zero(match.result))
+                          : std::uint32_t(std::countr_zero(match.result));
+}
 
+Xmm SSE::string_mask(const StringMatch& match, const std::uint8_t control) {
+    Xmm mask;
+    if (!(control & 0x40)) {
+        mask.access<std::uint16_t>(0) = match.result;
+    } else if (control & 1) {
+        for (std::size_t i = 0u; i < Xmm::elements<std::uint16_t>; ++i) {
+            mask.access<std::uint16_t>(i) = (match.result >> i) & 1 ? 0xFFFF : 0;
+        }
+    } else {
+        for (std::size_t i = 0u; i < Xmm::elements<std::uint8_t>; ++i) {
+            mask.access<std::uint8_t>(i) = (match.result >> i) & 1 ? 0xFF : 0;
+        }
+    }
+    return mask;
+}
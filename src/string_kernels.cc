@@ -0,0 +1,149 @@
+#include "string_kernels.hh"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIX86_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template <bool want>
+std::size_t scalar_splat(const std::uint8_t* p, const std::size_t n, const std::uint8_t value) {
+    std::size_t i = 0;
+    for (; i < n; ++i) {
+        if ((p[i] == value) == want) {
+            break;
+        }
+    }
+    return i;
+}
+
+template <bool want>
+std::size_t scalar_pair(const std::uint8_t* a, const std::uint8_t* b, const std::size_t n) {
+    std::size_t i = 0;
+    for (; i < n; ++i) {
+        if ((a[i] == b[i]) == want) {
+            break;
+        }
+    }
+    return i;
+}
+
+#if PIX86_X86_KERNELS
+// Each tier scans as many whole vectors as fit for the first lane whose
+// equality with the other side is want, then hands the tail down a tier.
+
+template <bool want>
+__attribute__((target("sse2")))
+std::size_t sse2_splat(const std::uint8_t* p, const std::size_t n, const std::uint8_t value) {
+    const __m128i splat = _mm_set1_epi8(static_cast<char>(value));
+    std::size_t i = 0;
+    for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const auto equal = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, splat)));
+        const unsigned int hits = want ? equal : ~equal & 0xFFFF;
+        if (hits) {
+            return i + std::size_t(std::countr_zero(hits));
+        }
+    }
+    return i + scalar_splat<want>(p + i, n - i, value);
+}
+
+template <bool want>
+__attribute__((target("sse2")))
+std::size_t sse2_pair(const std::uint8_t* a, const std::uint8_t* b, const std::size_t n) {
+    std::size_t i = 0;
+    for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const auto equal = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+        const unsigned int hits = want ? equal : ~equal & 0xFFFF;
+        if (hits) {
+            return i + std::size_t(std::countr_zero(hits));
+        }
+    }
+    return i + scalar_pair<want>(a + i, b + i, n - i);
+}
+
+template <bool want>
+__attribute__((target("avx2")))
+std::size_t avx2_splat(const std::uint8_t* p, const std::size_t n, const std::uint8_t value) {
+    const __m256i splat = _mm256_set1_epi8(static_cast<char>(value));
+    std::size_t i = 0;
+    for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        const auto equal = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, splat)));
+        const unsigned int hits = want ? equal : ~equal;
+        if (hits) {
+            return i + std::size_t(std::countr_zero(hits));
+        }
+    }
+    return i + sse2_splat<want>(p + i, n - i, value);
+}
+
+template <bool want>
+__attribute__((target("avx2")))
+std::size_t avx2_pair(const std::uint8_t* a, const std::uint8_t* b, const std::size_t n) {
+    std::size_t i = 0;
+    for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+        const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        const auto equal = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+        const unsigned int hits = want ? equal : ~equal;
+        if (hits) {
+            return i + std::size_t(std::countr_zero(hits));
+        }
+    }
+    return i + sse2_pair<want>(a + i, b + i, n - i);
+}
+#endif
+
+constexpr StringKernels scalar_kernels = {scalar_splat<false>, scalar_pair<false>, scalar_pair<true>};
+#if PIX86_X86_KERNELS
+constexpr StringKernels sse2_kernels = {sse2_splat<false>, sse2_pair<false>, sse2_pair<true>};
+constexpr StringKernels avx2_kernels = {avx2_splat<false>, avx2_pair<false>, avx2_pair<true>};
+#endif
+
+// Bound once during static initialisation, so a call costs one indirect
+// jump and no feature test.
+const StringKernels& bound = string_kernels(HostCpu::get().best());
+
+}
+
+const StringKernels& string_kernels(const HostIsa isa) {
+#if PIX86_X86_KERNELS
+    switch (isa) {
+        case HostIsa::SCALAR: return scalar_kernels;
+        // Nothing here needs more than SSE2 below AVX2.
+        case HostIsa::SSE2:
+        case HostIsa::SSE4_2: return sse2_kernels;
+        case HostIsa::AVX2: return avx2_kernels;
+    }
+#else
+    static_cast<void>(isa);
+#endif
+    return scalar_kernels;
+}
+
+std::size_t find_byte(const std::uint8_t* p, const std::size_t n, const std::uint8_t value) {
+    // libc's memchr already picks its own variant for the host.
+    const auto* hit = static_cast<const std::uint8_t*>(std::memchr(p, value, n));
+    return hit ? std::size_t(hit - p) : n;
+}
+
+std::size_t find_other_byte(const std::uint8_t* p, const std::size_t n, const std::uint8_t value) {
+    return bound.find_other_byte(p, n, value);
+}
+
+std::size_t find_mismatch(const std::uint8_t* a, const std::uint8_t* b, const std::size_t n) {
+    return bound.find_mismatch(a, b, n);
+}
+
+std::size_t find_match(const std::uint8_t* a, const std::uint8_t* b, const std::size_t n) {
+    return bound.find_match(a, b, n);
+}
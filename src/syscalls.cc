@@ -0,0 +1,352 @@
+#include "syscalls.hh"
+
+#include "constants.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+// i386 mmap protection and flag bits.
+constexpr std::uint32_t GUEST_PROT_READ = 0x1;
+constexpr std::uint32_t GUEST_PROT_WRITE = 0x2;
+constexpr std::uint32_t GUEST_PROT_EXEC = 0x4;
+constexpr std::uint32_t GUEST_MAP_FIXED = 0x10;
+constexpr std::uint32_t GUEST_MAP_ANONYMOUS = 0x20;
+
+constexpr address_t guest_page_mask = guest_page_size - 1;
+
+// i386 open flags, with the host flag each one stands for. The values only
+// happen to match on x86 hosts.
+constexpr struct {
+    std::uint32_t guest;
+    int host;
+} guest_open_flags[] = {
+    {00000100, O_CREAT},
+    {00000200, O_EXCL},
+    {00000400, O_NOCTTY},
+    {00001000, O_TRUNC},
+    {00002000, O_APPEND},
+    {00004000, O_NONBLOCK},
+    {00010000, O_DSYNC},
+    {00020000, O_ASYNC},
+    {00040000, O_DIRECT},
+    {00200000, O_DIRECTORY},
+    {00400000, O_NOFOLLOW},
+    {01000000, O_NOATIME},
+    {02000000, O_CLOEXEC},
+    {04010000, O_SYNC},
+    {010000000, O_PATH},
+    {020200000, O_TMPFILE},
+};
+
+// Host flags for the guest's. O_LARGEFILE and unknown bits are dropped, as
+// the kernel ignores them too.
+int host_open_flags(const std::uint32_t guest) {
+    int host = int(guest & 3); // O_RDONLY, O_WRONLY or O_RDWR
+    for (const auto& flag : guest_open_flags) {
+        if ((guest & flag.guest) == flag.guest) {
+            host |= flag.host;
+        }
+    }
+    return host;
+}
+
+// Longest path open will read out of guest memory.
+constexpr std::size_t guest_path_max = 4096;
+
+std::int32_t errno_result() {
+    return -errno;
+}
+
+// Translate a guest access and make sure it lands inside guest memory even
+// in builds whose Memory does not check, as bad syscall arguments are the
+// guest's mistake and should come back as EFAULT rather than a host fault.
+std::uint8_t* guest_ptr(Executor& ex, const address_t address, const std::uint8_t access, const std::size_t width) {
+    std::uint8_t* host = ex.cpu.mmu.translate_linear(address, access, width);
+    const Memory& mem = ex.cpu.mem;
+    if (host < mem.data() || std::size_t(host - mem.data()) + width > mem.size()) {
+        throw MEMORY_FAULT(address, mem.size());
+    }
+    return host;
+}
+
+}
+
+std::vector<iovec> LinuxSyscalls::guest_iov(Executor& ex, address_t address, std::size_t length,
+                                            const std::uint8_t access) {
+    std::vector<iovec> iov;
+    while (length) {
+        const std::size_t chunk = std::min<std::size_t>(length, guest_page_size - (address & guest_page_mask));
+        std::uint8_t* host = guest_ptr(ex, address, access, chunk);
+        if (!iov.empty() && static_cast<std::uint8_t*>(iov.back().iov_base) + iov.back().iov_len == host) {
+            iov.back().iov_len += chunk;
+        } else {
+            iov.push_back({host, chunk});
+        }
+        address += address_t(chunk);
+        length -= chunk;
+    }
+    return iov;
+}
+
+std::string LinuxSyscalls::guest_string(Executor& ex, const address_t address) {
+    std::string s;
+    for (address_t at = address; s.size() < guest_path_max; ++at) {
+        const char c = char(*guest_ptr(ex, at, MMU::READ, 1));
+        if (!c) {
+            return s;
+        }
+        s.push_back(c);
+    }
+    throw std::system_error(ENAMETOOLONG, std::generic_category());
+}
+
+std::int32_t LinuxSyscalls::sys_rw(Executor& ex, const bool write) {
+    const int fd = int(ex.cpu.R[EBX]);
+    // The guest's pages are the kernel's source or destination directly.
+    auto iov = guest_iov(ex, ex.cpu.R[ECX], ex.cpu.R[EDX], write ? MMU::READ : MMU::WRITE);
+    const int count = int(std::min<std::size_t>(iov.size(), IOV_MAX));
+    const ssize_t n = write ? writev(fd, iov.data(), count) : readv(fd, iov.data(), count);
+    return n < 0 ? errno_result() : std::int32_t(n);
+}
+
+std::int32_t LinuxSyscalls::sys_open(Executor& ex) {
+    const std::string path = guest_string(ex, ex.cpu.R[EBX]);
+    const int fd = open(path.c_str(), host_open_flags(ex.cpu.R[ECX]), mode_t(ex.cpu.R[EDX]));
+    return fd < 0 ? errno_result() : fd;
+}
+
+std::int32_t LinuxSyscalls::sys_brk(Executor& ex) {
+    const address_t want = ex.cpu.R[EBX];
+    if (want >= initial_brk_ && want <= mmap_top_) {
+        // Anything released is zero again should the break grow back over it.
+        if (want < brk_) {
+            std::fill_n(ex.cpu.mem.checked_ptr(want, brk_ - want), brk_ - want, std::uint8_t(0));
+        }
+        brk_ = want;
+    }
+    return std::int32_t(brk_);
+}
+
+std::int32_t LinuxSyscalls::sys_mmap(Executor& ex, const address_t addr, const std::uint32_t length,
+                                     const std::uint32_t prot, const std::uint32_t flags, const int fd,
+                                     const std::size_t offset) {
+    Memory& mem = ex.cpu.mem;
+    const std::size_t len = (std::size_t(length) + guest_page_mask) & ~std::size_t(guest_page_mask);
+    if (!len || (offset & guest_page_mask)) {
+        return -EINVAL;
+    }
+
+    address_t target;
+    if (flags & GUEST_MAP_FIXED) {
+        if ((addr & guest_page_mask) || addr + len > mem.size()) {
+            return -EINVAL;
+        }
+        target = addr;
+    } else {
+        if (len > mmap_top_ - brk_) {
+            return -ENOMEM;
+        }
+        target = mmap_top_ - address_t(len);
+    }
+
+    // The host maps and discards in its own pages, which may be larger.
+    const std::size_t host_page_mask = Memory::page_size() - 1;
+    const bool host_aligned = !(target & host_page_mask) && !(offset & host_page_mask);
+    if (!(flags & GUEST_MAP_ANONYMOUS) && !host_aligned) {
+        return -EINVAL;
+    }
+
+    if (!(flags & GUEST_MAP_ANONYMOUS)) {
+        mem.map_file(fd, offset, target, len);
+    } else if (host_aligned) {
+        mem.discard_pages(target, len);
+    } else {
+        std::fill_n(mem.checked_ptr(target, len), len, std::uint8_t(0));
+    }
+    // Only once the mapping is in place, so failures give nothing away.
+    if (!(flags & GUEST_MAP_FIXED)) {
+        mmap_top_ = target;
+    }
+    const std::uint8_t perms = std::uint8_t(((prot & GUEST_PROT_READ) ? Memory::PAGE_READ : 0)
+        | ((prot & GUEST_PROT_WRITE) ? Memory::PAGE_WRITE : 0)
+        | ((prot & GUEST_PROT_EXEC) ? Memory::PAGE_EXEC : 0));
+    ex.cpu.mmu.protect(target, len, perms);
+    return std::int32_t(target);
+}
+
+std::int32_t LinuxSyscalls::sys_fstat(Executor& ex, const bool stat64) {
+    struct stat st;
+    if (fstat(int(ex.cpu.R[EBX]), &st) != 0) {
+        return errno_result();
+    }
+
+    // struct stat and struct stat64 as the i386 kernel lays them out.
+    std::uint8_t out[96] = {};
+    const auto put32 = [&](std::size_t at, auto v) {mwrite<std::uint32_t>(out + at, std::uint32_t(v));};
+    const auto put64 = [&](std::size_t at, auto v) {mwrite<std::uint64_t>(out + at, std::uint64_t(v));};
+    std::size_t size;
+    if (stat64) {
+        put64(0, st.st_dev);
+        put32(12, st.st_ino);
+        put32(16, st.st_mode);
+        put32(20, st.st_nlink);
+        put32(24, st.st_uid);
+        put32(28, st.st_gid);
+        put64(32, st.st_rdev);
+        put64(44, st.st_size);
+        put32(52, st.st_blksize);
+        put64(56, st.st_blocks);
+        put32(64, st.st_atim.tv_sec);
+        put32(68, st.st_atim.tv_nsec);
+        put32(72, st.st_mtim.tv_sec);
+        put32(76, st.st_mtim.tv_nsec);
+        put32(80, st.st_ctim.tv_sec);
+        put32(84, st.st_ctim.tv_nsec);
+        put64(88, st.st_ino);
+        size = 96;
+    } else {
+        put32(0, st.st_dev);
+        put32(4, st.st_ino);
+        mwrite<std::uint16_t>(out + 8, std::uint16_t(st.st_mode));
+        mwrite<std::uint16_t>(out + 10, std::uint16_t(st.st_nlink));
+        mwrite<std::uint16_t>(out + 12, std::uint16_t(st.st_uid));
+        mwrite<std::uint16_t>(out + 14, std::uint16_t(st.st_gid));
+        put32(16, st.st_rdev);
+        put32(20, st.st_size);
+        put32(24, st.st_blksize);
+        put32(28, st.st_blocks);
+        put32(32, st.st_atim.tv_sec);
+        put32(36, st.st_atim.tv_nsec);
+        put32(40, st.st_mtim.tv_sec);
+        put32(44, st.st_mtim.tv_nsec);
+        put32(48, st.st_ctim.tv_sec);
+        put32(52, st.st_ctim.tv_nsec);
+        size = 64;
+    }
+
+    const std::uint8_t* from = out;
+    for (const auto& v : guest_iov(ex, ex.cpu.R[ECX], size, MMU::WRITE)) {
+        std::memcpy(v.iov_base, from, v.iov_len);
+        from += v.iov_len;
+    }
+    return 0;
+}
+
+std::int32_t LinuxSyscalls::sys_clock_gettime(Executor& ex, const bool time64) {
+    timespec ts;
+    if (clock_gettime(clockid_t(ex.cpu.R[EBX]), &ts) != 0) {
+        return errno_result();
+    }
+    std::uint8_t out[16] = {};
+    std::size_t size;
+    if (time64) {
+        mwrite<std::uint64_t>(out, std::uint64_t(ts.tv_sec));
+        mwrite<std::uint64_t>(out + 8, std::uint64_t(ts.tv_nsec));
+        size = 16;
+    } else {
+        mwrite<std::uint32_t>(out, std::uint32_t(ts.tv_sec));
+        mwrite<std::uint32_t>(out + 4, std::uint32_t(ts.tv_nsec));
+        size = 8;
+    }
+    const std::uint8_t* from = out;
+    for (const auto& v : guest_iov(ex, ex.cpu.R[ECX], size, MMU::WRITE)) {
+        std::memcpy(v.iov_base, from, v.iov_len);
+        from += v.iov_len;
+    }
+    return 0;
+}
+
+void LinuxSyscalls::handle(Executor& ex) {
+    auto& R = ex.cpu.R;
+    std::int32_t result = -ENOSYS;
+    try {
+        switch (R[EAX]) {
+            case SYS_EXIT:
+            case SYS_EXIT_GROUP: {
+                exited_ = true;
+                exit_status_ = int(std::int32_t(R[EBX]));
+                return;
+            }
+
+            case SYS_READ: {
+                result = sys_rw(ex, false);
+            } break;
+
+            case SYS_WRITE: {
+                result = sys_rw(ex, true);
+            } break;
+
+            case SYS_OPEN: {
+                result = sys_open(ex);
+            } break;
+
+            case SYS_CLOSE: {
+                // Closing the host's own stdio would take the emulator's
+                // output with it.
+                const int fd = int(R[EBX]);
+                result = fd <= STDERR_FILENO ? 0 : (close(fd) == 0 ? 0 : errno_result());
+            } break;
+
+            case SYS_BRK: {
+                result = sys_brk(ex);
+            } break;
+
+            case SYS_MMAP: {
+                // Old style mmap takes its six arguments in a guest struct.
+                std::uint32_t args[6];
+                for (std::size_t i = 0; i < 6; ++i) {
+                    args[i] = mread<std::uint32_t>(guest_ptr(ex, address_t(R[EBX] + 4 * i), MMU::READ,
+                                                             sizeof(std::uint32_t)));
+                }
+                result = sys_mmap(ex, args[0], args[1], args[2], args[3], int(args[4]), args[5]);
+            } break;
+
+            case SYS_MMAP2: {
+                result = sys_mmap(ex, R[EBX], R[ECX], R[EDX], R[ESI], int(R[EDI]),
+                                  std::size_t(R[EBP]) * guest_page_size);
+            } break;
+
+            case SYS_FSTAT: {
+                result = sys_fstat(ex, false);
+            } break;
+
+            case SYS_FSTAT64: {
+                result = sys_fstat(ex, true);
+            } break;
+
+            case SYS_CLOCK_GETTIME: {
+                result = sys_clock_gettime(ex, false);
+            } break;
+
+            case SYS_CLOCK_GETTIME64: {
+                result = sys_clock_gettime(ex, true);
+            } break;
+
+            default:
+                break;
+        }
+    } catch (const PAGE_FAULT&) {
+        result = -EFAULT;
+    } catch (const MEMORY_FAULT&) {
+        result = -EFAULT;
+    } catch (const std::system_error& e) {
+        result = -e.code().value();
+    }
+    R[EAX] = std::uint32_t(result);
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "executor.hh"
+
+namespace {
+
+constexpr address_t code_at = 0x100;
+constexpr address_t data_at = 0x10000;
+constexpr unsigned int copies = 1000;
+
+// Guest instructions per second retired by a block of copies of one
+// instruction, run from scratch rounds times.
+double throughput(std::initializer_list<std::uint8_t> instruction, const int rounds) {
+    std::vector<std::uint8_t> code;
+    for (unsigned int i = 0; i < copies; ++i) {
+        code.insert(code.end(), instruction);
+    }
+    // In cycle counted runs hlt just ends execute.
+    code.push_back(0xF4);
+    Executor exe(std::span<const std::uint8_t>{}, 1_mb, 64_kb);
+    exe.load(code, code_at);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        exe.pc = code_at;
+        exe.cpu.R[EAX] = 0x00F0F000;
+        exe.cpu.R[EBX] = 0x1234;
+        exe.cpu.R[ECX] = 77;
+        exe.cpu.R[ESI] = data_at;
+        exe.execute(false, true, ~0u);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return double(copies) * rounds / elapsed.count();
+}
+
+void report(const std::string& name, const double rate) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << rate / 1e6 << " Minstr/s\n";
+}
+
+}
+
+// LCOV_EXCL_START
+int main() {
+    constexpr int rounds = 2000;
+    report("bt ebx, ecx", throughput({0x0F, 0xA3, 0xCB}, rounds));
+    report("bts ebx, ecx", throughput({0x0F, 0xAB, 0xCB}, rounds));
+    report("btr ebx, ecx", throughput({0x0F, 0xB3, 0xCB}, rounds));
+    report("btc ebx, ecx", throughput({0x0F, 0xBB, 0xCB}, rounds));
+    report("bt ebx, 5", throughput({0x0F, 0xBA, 0xE3, 0x05}, rounds));
+    // The register offset picks a dword 77 / 32 = 2 above [esi].
+    report("bts [esi], ecx", throughput({0x0F, 0xAB, 0x0E}, rounds));
+    report("bsf edx, eax", throughput({0x0F, 0xBC, 0xD0}, rounds));
+    report("bsr edx, eax", throughput({0x0F, 0xBD, 0xD0}, rounds));
+    report("popcnt edx, eax", throughput({0xF3, 0x0F, 0xB8, 0xD0}, rounds));
+    report("lzcnt edx, eax", throughput({0xF3, 0x0F, 0xBD, 0xD0}, rounds));
+    report("tzcnt edx, eax", throughput({0xF3, 0x0F, 0xBC, 0xD0}, rounds));
+}
+// LCOV_EXCL_STOP
@@ -1,11 +1,11 @@
 #include <algorithm>
 #include <cstdint>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <span>
 
 #include "decoder.hh"
+#include "hex.hh"
 #include "memory.hh"
 
 constexpr bool is_8bit(const std::uint8_t opcode) noexcept {
@@ -21,12 +21,7 @@ int main([[maybe_unused]] int argc, char** argv) {
         return 1;
     }
     
-    std::ifstream reader(argv[1]);
-    std::vector<std::uint8_t> code;
-    unsigned int c;
-    while (reader >> std::hex >> c) {
-        code.push_back(std::uint8_t(c));
-    }
+    const auto code = read_hex_file(argv[1]);
 
     if (code.empty()) {
         return -1;
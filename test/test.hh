@@ -2,13 +2,26 @@
 #define TEST_HH
 
 void test_cpu();
+void test_cpuid();
 void test_executor();
+void test_executor_pool();
 void test_decoder();
 void test_flags();
 void test_fpu();
 void test_generic_reference();
+void test_hex();
+void test_host_cpu();
+void test_hle();
+void test_loader();
+void test_loop_idiom();
 void test_memory();
+void test_mmu();
+void test_mmx();
+void test_page_dedup();
+void test_sse();
 void test_stack();
+void test_string_kernels();
+void test_syscalls();
 void test_util();
 
 #endif
\ No newline at end of file
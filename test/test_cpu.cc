@@ -6,10 +6,44 @@
 #include <cstdint>
 #include <chrono>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
 
 void test_cpu_constructor() {
     CPU cpu(1024, 1024);
-    const bool t = cpu.R[ESP] == 1023;
+    bool t = cpu.R[ESP] == 1023;
+    bool t2 = false;
+    try {
+        CPU bad(1024, 2048);
+    } catch (const std::domain_error&) {
+        t2 = true;
+    }
+    t = t && t2;
+    assert(t);
+}
+
+void test_cpu_stack_limit() {
+    CPU cpu(16_kb, 8_kb);
+    cpu.R[ESP] = 8_kb + 2;
+    bool t1 = false;
+    try {
+        cpu.push32(0xDEADBEEF);
+    } catch (const STACK_FAULT& sf) {
+        t1 = sf.esp == 8_kb + 2;
+    }
+    // The default constructor reserves a bounded stack, not all of memory.
+    CPU dflt;
+    const bool t = t1 && cpu.R[ESP] == 8_kb + 2 && dflt.stack.limit() == 1_mb - default_stack_size
+        && CPU(4_kb).stack.limit() == 0;
+    assert(t);
+}
+
+void test_cpu_stack_in_memory() {
+    CPU cpu(16_kb, 8_kb);
+    cpu.push32(0xDEADBEEF);
+    const bool t = cpu.R[ESP] == 16_kb - 5
+        && mread<std::uint32_t>(&cpu.mem[cpu.R[ESP]]) == 0xDEADBEEF;
     assert(t);
 }
 
@@ -192,6 +226,40 @@ void test_arpl32() {
     assert(t);
 }
 
+void test_bt() {
+    CPU cpu;
+    cpu.bt32(0x80000000, 63);
+    const bool t1 = cpu.flags.carry;
+    const bool t2 = cpu.bts16(0x0001, 1) == 0x0003 && !cpu.flags.carry;
+    const bool t3 = cpu.btr32(0x0003, 0) == 0x0002 && cpu.flags.carry;
+    const bool t = t1 && t2 && t3 && cpu.btc16(0x8000, 15) == 0 && cpu.flags.carry;
+    assert(t);
+}
+
+void test_bit_scan() {
+    CPU cpu;
+    const bool t1 = cpu.bsf32(0xAA, 0x00F0) == 4 && !cpu.flags.zero
+        && cpu.bsr16(0xAA, 0x00F0) == 7
+        && cpu.bsr32(0xAA, 0x80000000) == 31;
+    // A zero source sets ZF and leaves the destination alone.
+    const bool t2 = cpu.bsf16(0xAA, 0) == 0xAA && cpu.flags.zero && cpu.bsr32(0xBB, 0) == 0xBB;
+    const bool t = t1 && t2;
+    assert(t);
+}
+
+void test_bit_count() {
+    CPU cpu;
+    const bool t1 = cpu.popcnt32(0, 0xF0F0F0F0) == 16 && !cpu.flags.zero && !cpu.flags.carry
+        && cpu.popcnt16(0, 0) == 0 && cpu.flags.zero;
+    const bool t2 = cpu.lzcnt32(0, 0x00010000) == 15 && !cpu.flags.carry
+        && cpu.lzcnt16(0, 0) == 16 && cpu.flags.carry && !cpu.flags.zero
+        && cpu.lzcnt32(0, 0x80000000) == 0 && cpu.flags.zero;
+    const bool t3 = cpu.tzcnt32(0, 0) == 32 && cpu.flags.carry
+        && cpu.tzcnt16(0, 0x0100) == 8 && !cpu.flags.carry;
+    const bool t = t1 && t2 && t3;
+    assert(t);
+}
+
 void test_bswap() {
     CPU cpu;
     const bool t = cpu.bswap(0xDEADBEEF) == 0xEFBEADDE;
@@ -372,6 +440,55 @@ void test_cwde() {
     assert(t2);
 }
 
+void test_div() {
+    CPU cpu;
+    bool faulted = false;
+    try {
+        cpu.div8(0x1234, 0x12);
+    } catch (DIVIDE_ERROR&) {
+        faulted = true;
+    }
+    // Remainder in the high half, quotient in the low half.
+    const bool t = cpu.div8(0x1234, 0x34) == 0x2059
+        && cpu.div16(0x00123456, 0x1234) == 0x00560100
+        && cpu.div32(0xFFFFFFFEFFFFFFFF, 0xFFFFFFFF) == 0xFFFFFFFEFFFFFFFF
+        && faulted;
+    assert(t);
+}
+
+void test_div_by_zero() {
+    CPU cpu;
+    bool faulted = false;
+    try {
+        cpu.div32(1, 0);
+    } catch (DIVIDE_ERROR&) {
+        faulted = true;
+    }
+    assert(faulted);
+}
+
+void test_idiv() {
+    CPU cpu;
+    // -7 / 2 truncates to -3 remainder -1.
+    const bool t1 = cpu.idiv8(0xFFF9, 2) == 0xFFFD
+        && cpu.idiv16(0xFFFFFFF9, 2) == 0xFFFFFFFD
+        && cpu.idiv32(0xFFFFFFFFFFFFFFF9, 2) == 0xFFFFFFFFFFFFFFFD
+        && cpu.idiv32(0x7FFFFFFF, 0xFFFFFFFF) == 0x80000001;
+    bool t = t1;
+    // -128 / 1 fits; INT32_MIN / -1 does not, nor does the host's own INT64_MIN / -1.
+    t = t && cpu.idiv8(0xFF80, 1) == 0x0080;
+    for (const std::uint64_t dividend : {std::uint64_t(0xFFFFFFFF80000000), std::uint64_t(0x8000000000000000)}) {
+        bool faulted = false;
+        try {
+            cpu.idiv32(dividend, 0xFFFFFFFF);
+        } catch (DIVIDE_ERROR&) {
+            faulted = true;
+        }
+        t = t && faulted;
+    }
+    assert(t);
+}
+
 void test_dec8() {
     CPU cpu;
     const bool t = cpu.dec8(0xAA) == 0xA9;
@@ -390,6 +507,26 @@ void test_dec32() {
     assert(t);
 }
 
+void test_imul32() {
+    CPU cpu;
+    // 0x10000 * 0x10000 overflows a signed 32 bit product.
+    const bool t = cpu.imul32(0x10000, 0x10000) == 0
+        && cpu.flags.carry && cpu.flags.overflow
+        && cpu.imul32(0xFFFFFFFF, 0xFFFFFFFF) == 1
+        && !cpu.flags.carry && !cpu.flags.overflow;
+    assert(t);
+}
+
+void test_imul_s() {
+    CPU cpu;
+    const bool t1 = cpu.imul8_s(0x80, 0xFF) == 0x0080 && cpu.flags.carry && cpu.flags.overflow;
+    const bool t2 = cpu.imul16_s(0xFFFF, 0x7FFF) == 0xFFFF8001 && !cpu.flags.carry && !cpu.flags.overflow;
+    const bool t3 = cpu.imul32_s(0x80000000, 0x80000000) == 0x4000000000000000 && cpu.flags.carry;
+    const bool t = t1 && t2 && t3
+        && cpu.imul32_s(0xFFFFFFFE, 3) == 0xFFFFFFFFFFFFFFFA && !cpu.flags.overflow;
+    assert(t);
+}
+
 void test_inc8() {
     CPU cpu;
     const bool t = cpu.inc8(0xAA) == 0xAB;
@@ -459,6 +596,32 @@ void test_mov32() {
     assert(t);
 }
 
+void test_mul() {
+    CPU cpu;
+    const bool t1 = cpu.mul8(0x10, 0x0F) == 0xF0 && !cpu.flags.carry && !cpu.flags.overflow;
+    const bool t2 = cpu.mul16(0xFFFF, 0xFFFF) == 0xFFFE0001 && cpu.flags.carry && cpu.flags.overflow;
+    const bool t = t1 && t2 && cpu.mul32(0xFFFFFFFF, 0xFFFFFFFF) == 0xFFFFFFFE00000001 && cpu.flags.carry;
+    assert(t);
+}
+
+void test_neg() {
+    CPU cpu;
+    const bool t1 = cpu.neg8(1) == 0xFF && cpu.flags.carry && cpu.flags.sign && !cpu.flags.overflow;
+    const bool t2 = cpu.neg16(0) == 0 && !cpu.flags.carry && cpu.flags.zero;
+    const bool t = t1 && t2 && cpu.neg32(0x80000000) == 0x80000000 && cpu.flags.overflow && cpu.flags.carry;
+    assert(t);
+}
+
+void test_not() {
+    CPU cpu;
+    cpu.flags.carry = true;
+    const bool t = cpu.not8(0x0F) == 0xF0
+        && cpu.not16(0x00FF) == 0xFF00
+        && cpu.not32(0xDEADBEEF) == 0x21524110
+        && cpu.flags.carry;
+    assert(t);
+}
+
 void test_or8() {
     CPU cpu;
     const bool t = cpu.or8(0xDE, 0x64) == 0xFE;
@@ -656,6 +819,111 @@ void test_sar32_u() {
     assert(t2);
 }
 
+namespace {
+
+// The SDM's one bit at a time loops for rol, ror, rcl, rcr, shl, shr and
+// sar, in that order, returning the result and updating carry.
+template <typename I>
+I reference_shift(const unsigned int op, I value, const unsigned int raw_count, bool& carry) {
+    constexpr unsigned int bits = std::numeric_limits<I>::digits;
+    const I msb = I(I(1) << (bits - 1));
+    unsigned int count = raw_count & 0x1F;
+    if (op == 0 || op == 1) {
+        count %= bits;
+        if ((raw_count & 0x1F) == 0) {
+            return value;
+        }
+    } else if (op == 2 || op == 3) {
+        count %= bits + 1;
+    }
+    for (; count > 0; --count) {
+        switch (op) {
+            case 0: value = I(value << 1 | value >> (bits - 1)); break;
+            case 1: value = I(value >> 1 | value << (bits - 1)); break;
+            case 2: {
+                const bool out = value & msb;
+                value = I(value << 1 | I(carry));
+                carry = out;
+            } break;
+            case 3: {
+                const bool out = value & 1;
+                value = I(value >> 1 | (carry ? msb : 0));
+                carry = out;
+            } break;
+            case 4: carry = value & msb; value = I(value << 1); break;
+            case 5: carry = value & 1; value = I(value >> 1); break;
+            default: carry = value & 1; value = I(value >> 1 | (value & msb)); break;
+        }
+    }
+    if (op == 0) {
+        carry = value & 1;
+    } else if (op == 1) {
+        carry = value & msb;
+    }
+    return value;
+}
+
+template <typename I>
+bool matches_reference_shifts(I(CPU::*const (&ops)[7])(I, std::uint8_t)) {
+    std::mt19937 rng(3);
+    CPU cpu;
+    bool t = true;
+    for (int round = 0; round < 4000; ++round) {
+        const auto value = I(rng());
+        const auto count = std::uint8_t(rng() % 40);
+        const unsigned int op = unsigned(round) % 7;
+        const bool carry_in = rng() & 1;
+        cpu.flags.carry = carry_in;
+        bool carry = carry_in;
+        const I expected = reference_shift(op, value, count, carry);
+        const I result = (cpu.*ops[op])(value, count);
+        t = t && result == expected && cpu.flags.carry == carry;
+    }
+    return t;
+}
+
+}
+
+void test_shift_reference() {
+    static constexpr std::uint8_t(CPU::*ops8[7])(std::uint8_t, std::uint8_t) = {
+        &CPU::rol8, &CPU::ror8, &CPU::rcl8, &CPU::rcr8, &CPU::shl8, &CPU::shr8, &CPU::sar8};
+    static constexpr std::uint16_t(CPU::*ops16[7])(std::uint16_t, std::uint8_t) = {
+        &CPU::rol16, &CPU::ror16, &CPU::rcl16, &CPU::rcr16, &CPU::shl16, &CPU::shr16, &CPU::sar16};
+    static constexpr std::uint32_t(CPU::*ops32[7])(std::uint32_t, std::uint8_t) = {
+        &CPU::rol32, &CPU::ror32, &CPU::rcl32, &CPU::rcr32, &CPU::shl32, &CPU::shr32, &CPU::sar32};
+    const bool t = matches_reference_shifts(ops8) && matches_reference_shifts(ops16) && matches_reference_shifts(ops32);
+    assert(t);
+}
+
+void test_shift_flags() {
+    CPU cpu;
+    // shl by one sets OF when the sign changes.
+    const bool t1 = cpu.shl8(0x40) == 0x80 && !cpu.flags.carry && cpu.flags.overflow && cpu.flags.sign;
+    // shr by one sets OF to the original sign.
+    const bool t2 = cpu.shr32(0x80000001) == 0x40000000 && cpu.flags.carry && cpu.flags.overflow && !cpu.flags.zero;
+    const bool t3 = cpu.sar8(0x81) == 0xC0 && cpu.flags.carry && !cpu.flags.overflow;
+    // A masked count of zero changes nothing, not even the flags.
+    cpu.flags.carry = true;
+    cpu.flags.zero = false;
+    const bool t4 = cpu.shl32(0, 32) == 0 && cpu.flags.carry && !cpu.flags.zero;
+    // Rotates leave ZF alone and ror by one sets OF from the top two bits.
+    const bool t5 = cpu.ror16(1) == 0x8000 && cpu.flags.carry && cpu.flags.overflow && !cpu.flags.zero;
+    const bool t = t1 && t2 && t3 && t4 && t5
+        && cpu.rol32(0x80000000) == 1 && cpu.flags.carry && cpu.flags.overflow;
+    assert(t);
+}
+
+void test_shld_shrd() {
+    CPU cpu;
+    const bool t1 = cpu.shld32(0x12345678, 0x9ABCDEF0, 8) == 0x3456789A && !cpu.flags.carry;
+    const bool t2 = cpu.shrd32(0x12345678, 0x9ABCDEF0, 8) == 0xF0123456 && !cpu.flags.carry;
+    const bool t3 = cpu.shld16(0x8001, 0xFFFF, 1) == 0x0003 && cpu.flags.carry && cpu.flags.overflow;
+    const bool t = t1 && t2 && t3
+        && cpu.shrd16(0x0001, 0x0000, 1) == 0 && cpu.flags.carry && cpu.flags.zero
+        && cpu.shld32(0xDEADBEEF, 0, 0) == 0xDEADBEEF;
+    assert(t);
+}
+
 void test_sbb8() {
     CPU cpu;
     cpu.flags.carry = false;
@@ -732,6 +1000,16 @@ void test_test8() {
     assert(t);
 }
 
+void test_test32() {
+    CPU cpu;
+    cpu.flags.carry = true;
+    cpu.test32(0x80000000, 0xFFFFFFFF);
+    const bool t1 = !cpu.flags.zero && cpu.flags.sign && !cpu.flags.carry;
+    cpu.test16(0x00F0, 0x0F0F);
+    const bool t = t1 && cpu.flags.zero && !cpu.flags.sign;
+    assert(t);
+}
+
 void test_xchg() {
     CPU cpu;
     cpu.R[EAX] = 0xDEADBEEF;
@@ -772,6 +1050,8 @@ void test_xor32() {
 
 void test_cpu() {
     test_cpu_constructor();
+    test_cpu_stack_in_memory();
+    test_cpu_stack_limit();
     test_regat();
     test_segregat();
     test_aaa();
@@ -789,6 +1069,9 @@ void test_cpu() {
     test_and32();
     test_arpl16();
     test_arpl32();
+    test_bt();
+    test_bit_scan();
+    test_bit_count();
     test_bswap();
     test_cbw();
     test_cdq();
@@ -808,9 +1091,14 @@ void test_cpu() {
     test_cmp32();
     test_cwd();
     test_cwde();
+    test_div();
+    test_div_by_zero();
+    test_idiv();
     test_dec8();
     test_dec16();
     test_dec32();
+    test_imul32();
+    test_imul_s();
     test_inc8();
     test_inc16();
     test_inc32();
@@ -821,6 +1109,9 @@ void test_cpu() {
     test_lahf();
     test_lea16();
     test_lea32();
+    test_mul();
+    test_neg();
+    test_not();
     test_or8();
     test_or16();
     test_or32();
@@ -834,6 +1125,9 @@ void test_cpu() {
     test_sar32();
     test_sar16_u();
     test_sar32_u();
+    test_shift_reference();
+    test_shift_flags();
+    test_shld_shrd();
     test_sbb8();
     test_sbb16();
     test_sbb32();
@@ -843,6 +1137,7 @@ void test_cpu() {
     test_sub16();
     test_sub32();
     test_test8();
+    test_test32();
     test_xchg();
     test_xlat();
     test_xor8();
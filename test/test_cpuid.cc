@@ -0,0 +1,102 @@
+#include "cpuid.hh"
+#include "executor.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+void test_cpuid_vendor() {
+    const auto [max_leaf, ebx, ecx, edx] = CpuidModel::implemented().query(0);
+    char vendor[13] = {};
+    std::memcpy(vendor, &ebx, 4);
+    std::memcpy(vendor + 4, &edx, 4);
+    std::memcpy(vendor + 8, &ecx, 4);
+    const bool t = max_leaf == 1 && std::string(vendor) == "GenuineIntel";
+    assert(t);
+}
+
+void test_cpuid_signature() {
+    CpuidModel model;
+    model.family = 6;
+    model.model = 0x3A;
+    model.stepping = 9;
+    const bool t1 = model.query(1)[0] == 0x000306A9;
+    // Family 15 and above spill into the extended family field.
+    model.family = 0x17;
+    model.model = 0x01;
+    model.stepping = 2;
+    const bool t = t1 && model.query(1)[0] == 0x00800F12;
+    assert(t);
+}
+
+void test_cpuid_features() {
+    const auto model = CpuidModel::implemented();
+    const auto leaf1 = model.query(1);
+    // Only what the executor runs.
+    const bool t = (leaf1[3] & CpuidModel::CMOV)
+        && (leaf1[3] & CpuidModel::FPU)
+        && !(leaf1[3] & CpuidModel::SSE)
+        && !(leaf1[3] & CpuidModel::SSE2)
+        && (leaf1[3] & CpuidModel::MMX)
+        && !(leaf1[2] & CpuidModel::SSE4_2)
+        && (leaf1[2] & CpuidModel::POPCNT)
+        && (model.query(0x80000001)[2] & CpuidModel::LZCNT)
+        && model.query(0x80000000)[0] == 0x80000004
+        && model.query(2) == std::array<std::uint32_t, 4>{};
+    assert(t);
+}
+
+void test_cpuid_with_simd() {
+    const auto model = CpuidModel::with_simd();
+    const auto leaf1 = model.query(1);
+    const auto implemented = CpuidModel::implemented().query(1);
+    const bool t = (leaf1[3] & CpuidModel::SSE)
+        && (leaf1[3] & CpuidModel::SSE2)
+        && (leaf1[2] & CpuidModel::SSE4_2)
+        && (leaf1[3] & ~(CpuidModel::SSE | CpuidModel::SSE2)) == implemented[3]
+        && (leaf1[2] & ~CpuidModel::SSE4_2) == implemented[2];
+    assert(t);
+}
+
+void test_cpuid_brand() {
+    CpuidModel model;
+    model.brand = "pix86 virtual processor";
+    std::string brand;
+    for (std::uint32_t leaf = 0x80000002; leaf <= 0x80000004; ++leaf) {
+        for (const std::uint32_t r : model.query(leaf)) {
+            brand.append(reinterpret_cast<const char*>(&r), 4);
+        }
+    }
+    const bool t = brand.size() == 48 && std::string(brand.c_str()) == model.brand;
+    assert(t);
+}
+
+void test_cpuid_instruction() {
+    const std::uint8_t code[] = {0xF, 0xA2, 0xF, 0xA2};
+    Executor exe(code);
+    // Hide everything to push a guest onto its generic paths.
+    exe.cpuid_model.features_ecx = 0;
+    exe.cpu.R[EAX] = 1;
+    exe.cpu.R[ECX] = 0xDEAD;
+    exe.run_single_cycle();
+    const bool t1 = exe.last_op == Opcode::CPUID && exe.pcnt() == 2
+        && exe.cpu.R[ECX] == 0
+        && exe.cpu.R[EDX] == CpuidModel::implemented().features_edx;
+    exe.cpu.R[EAX] = 0;
+    exe.run_single_cycle();
+    const bool t = t1 && exe.cpu.R[EAX] == 1 && exe.cpu.R[EBX] == 0x756E6547; // "Genu"
+    assert(t);
+}
+
+void test_cpuid() {
+    test_cpuid_vendor();
+    test_cpuid_signature();
+    test_cpuid_features();
+    test_cpuid_with_simd();
+    test_cpuid_brand();
+    test_cpuid_instruction();
+
+    std::cout << "All cpuid tests passed!" << std::endl;
+}
@@ -211,6 +211,21 @@ void test_decode_modregrm_register_to_memory_with_sib_base_and_displacement_32bi
     assert(t);
 }
 
+void test_effective_address_without_index() {
+    // [esp + 8] encodes as SIB with index 100, which is no index at all.
+    const std::uint8_t code[] = {0x1, 0x44, 0x24, 0x08};
+    Memory mem(16);
+    std::copy(std::begin(code), std::end(code), mem.begin());
+    std::uint32_t R[8] = {0, 0, 0, 0, 0x100, 0, 0, 0};
+    const auto [ops, skip] = decode_modregrm(code[1], mem, 0, false);
+    const std::uint8_t disp_only[] = {0x1, 0x05, 0x40, 0, 0, 0};
+    std::copy(std::begin(disp_only), std::end(disp_only), mem.begin());
+    const auto [bare, bare_skip] = decode_modregrm(disp_only[1], mem, 0, false);
+    const bool t = !ops.rm.has_index && effective_address(R, ops) == 0x108 && skip == 4
+        && effective_address(R, bare) == 0x40 && bare_skip == 6;
+    assert(t);
+}
+
 void test_structure_operands_register_only_32bit() {
     std::uint8_t code[] = {0x1, 0xC2}; // add    eax, ebx
     Memory mem(16);
@@ -390,6 +405,7 @@ void test_decoder() {
     test_decode_modregrm_register_to_memory_with_displacement_32bit();
     test_decode_modregrm_register_to_memory_with_sib_no_base_and_displacement_32bit();
     test_decode_modregrm_register_to_memory_with_sib_base_and_displacement_32bit();
+    test_effective_address_without_index();
     test_structure_operands_register_only_32bit();
     test_structure_operands_register_only_8bit_high();
     test_structure_operands_register_only_8bit_low();
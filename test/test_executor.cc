@@ -2,8 +2,10 @@
 
 #include <type_traits>
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <iostream>
+#include <random>
 
 void test_binary_operation_r2r_rm_dest_8bit() {
     const std::uint8_t code[] = {0x0, 0xF8}; // add al, bh
@@ -1007,6 +1009,16 @@ void test_opcode<0x61>() {
     assert(t2);
 }
 
+template <>
+void test_opcode<0x9B>() {
+    const std::uint8_t code[] = {0x9B};
+    Executor exe(code);
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::FWAIT
+        && exe.pcnt() == 1;
+    assert(t);
+}
+
 template <>
 void test_opcode<0x9E>() {
     const std::uint8_t code[] = {0x9E};
@@ -1027,6 +1039,85 @@ void test_opcode<0x9F>() {
     assert(t);
 }
 
+template <>
+void test_opcode<0xC0>() {
+    const std::uint8_t code[] = {0xC0, 0xC4, 0x04}; // rol ah, 4
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x1234;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::ROL8
+        && exe.cpu.R[EAX] == 0x2134
+        && exe.pcnt() == 3;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xC1>() {
+    // shl dword [0x40], 0x24, whose count masks to 4.
+    const std::uint8_t code[] = {0xC1, 0x25, 0x40, 0, 0, 0, 0x24};
+    Executor exe(code);
+    mwrite<std::uint32_t>(&exe.cpu.mem[0x40], 0xF0000001);
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::SHL16_32
+        && mread<std::uint32_t>(&exe.cpu.mem[0x40]) == 0x00000010
+        && exe.cpu.flags.carry
+        && exe.pcnt() == 7;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xD0>() {
+    const std::uint8_t code[] = {0xD0, 0xD8}; // rcr al, 1
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x02;
+    exe.cpu.flags.carry = true;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::RCR8
+        && exe.cpu.R[EAX] == 0x81
+        && !exe.cpu.flags.carry
+        && exe.pcnt() == 2;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xD1>() {
+    const std::uint8_t code[] = {0xD1, 0xF8}; // sar eax, 1
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x80000001;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::SAR16_32
+        && exe.cpu.R[EAX] == 0xC0000000
+        && exe.cpu.flags.carry
+        && exe.pcnt() == 2;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xD2>() {
+    const std::uint8_t code[] = {0xD2, 0xEB}; // shr bl, cl
+    Executor exe(code);
+    exe.cpu.R[EBX] = 0x80;
+    exe.cpu.R[ECX] = 7;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::SHR8
+        && exe.cpu.R[EBX] == 1
+        && exe.pcnt() == 2;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xD3>() {
+    const std::uint8_t code[] = {0x66, 0xD3, 0xC8}; // ror ax, cl
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0xDEAD0001;
+    exe.cpu.R[ECX] = 0x101;
+    exe.execute(false, true, 2);
+    const bool t = exe.last_op == Opcode::ROR16_32
+        && exe.cpu.R[EAX] == 0xDEAD8000
+        && exe.pcnt() == 3;
+    assert(t);
+}
+
 template <>
 void test_opcode<0xD4>() {
     const std::uint8_t code[] = {0xD4, 0xA};
@@ -1087,6 +1178,68 @@ void test_opcode<0xF5>() {
     assert(t);
 }
 
+template <>
+void test_opcode<0xF6>() {
+    // test bl, 0x81; neg bl; mul bl; div bl
+    const std::uint8_t code[] = {0xF6, 0xC3, 0x81, 0xF6, 0xDB, 0xF6, 0xE3, 0xF6, 0xF3};
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x12345603;
+    exe.cpu.R[EBX] = 0x02;
+    exe.execute(false, true, 1);
+    const bool t1 = exe.last_op == Opcode::TEST8 && exe.pcnt() == 3 && exe.cpu.flags.zero;
+    exe.execute(false, true, 1);
+    const bool t2 = get_low_byte(exe.cpu.R[EBX]) == 0xFE && exe.cpu.flags.carry;
+    exe.execute(false, true, 1);
+    // 3 * 0xFE = 0x2FA in ax.
+    const bool t3 = exe.last_op == Opcode::MUL8 && exe.cpu.R[EAX] == 0x123402FA && exe.cpu.flags.carry;
+    exe.execute(false, true, 1);
+    const bool t = t1 && t2 && t3 && exe.last_op == Opcode::DIV8 && exe.pcnt() == 9
+        && exe.cpu.R[EAX] == 0x12340003;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xD9>() {
+    // fldcw [0x40]; fstcw [0x44]
+    const std::uint8_t code[] = {0xD9, 0x2D, 0x40, 0, 0, 0, 0x9B, 0xD9, 0x3D, 0x44, 0, 0, 0};
+    Executor exe(code);
+    exe.cpu.mem[0x40] = 0x7F;
+    exe.cpu.mem[0x41] = 0x02;
+    exe.execute(false, true, 1);
+    const bool t1 = exe.last_op == Opcode::FLDCW && exe.pcnt() == 6
+        && exe.fpu.precision() == FPU::Precision::DOUBLE;
+    exe.execute(false, true, 2);
+    const bool t = t1 && exe.last_op == Opcode::FNSTCW && exe.pcnt() == 13
+        && exe.cpu.mem[0x44] == 0x7F && exe.cpu.mem[0x45] == 0x02;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF7>() {
+    // imul ecx; idiv ecx; not dword [0x40]; div ecx
+    const std::uint8_t code[] = {0xF7, 0xE9, 0xF7, 0xF9, 0xF7, 0x15, 0x40, 0, 0, 0, 0xF7, 0xF1};
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0xFFFFFFFE;
+    exe.cpu.R[ECX] = 0x40000000;
+    exe.execute(false, true, 1);
+    const bool t1 = exe.last_op == Opcode::IMUL16_32 && exe.cpu.R[EDX] == 0xFFFFFFFF
+        && exe.cpu.R[EAX] == 0x80000000 && !exe.cpu.flags.carry;
+    exe.execute(false, true, 1);
+    const bool t2 = exe.last_op == Opcode::IDIV16_32 && exe.cpu.R[EAX] == 0xFFFFFFFE && exe.cpu.R[EDX] == 0;
+    exe.execute(false, true, 1);
+    const bool t3 = exe.last_op == Opcode::NOT16_32 && exe.cpu.mem[0x40] == 0xFF && exe.pcnt() == 10;
+    // edx:eax / ecx does not fit in eax, so #DE with pc on the div.
+    exe.cpu.R[EDX] = 0x40000000;
+    bool faulted = false;
+    try {
+        exe.execute(false, true, 1);
+    } catch (DIVIDE_ERROR&) {
+        faulted = true;
+    }
+    const bool t = t1 && t2 && t3 && faulted && exe.pcnt() == 10 && exe.cpu.R[EAX] == 0xFFFFFFFE;
+    assert(t);
+}
+
 template <>
 void test_opcode<0xF8>() {
     const std::uint8_t code[] = {0xF8};
@@ -1157,6 +1310,108 @@ void test_opcode<0xF, 0xA0>() {
     assert(t);
 }
 
+template <>
+void test_opcode<0xF, 0xA3>() {
+    // bt [0x40], eax with a negative offset reaches the dword below.
+    const std::uint8_t code[] = {0xF, 0xA3, 0x05, 0x40, 0, 0, 0};
+    Executor exe(code);
+    exe.cpu.mem[0x3F] = 0x80;
+    exe.cpu.R[EAX] = std::uint32_t(-1);
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::BT
+        && exe.cpu.flags.carry
+        && exe.pcnt() == 7;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0xAB>() {
+    // bts [0x40], ecx sets bit 3 of the byte eight dwords up.
+    const std::uint8_t code[] = {0xF, 0xAB, 0x0D, 0x40, 0, 0, 0};
+    Executor exe(code);
+    exe.cpu.R[ECX] = 8 * 32 + 3;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::BTS
+        && exe.cpu.mem[0x60] == 0x08
+        && !exe.cpu.flags.carry
+        && exe.pcnt() == 7;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0xBA>() {
+    // btr ebx, 33 and btc dword [0x40], 35; immediates wrap in the operand.
+    const std::uint8_t code[] = {0xF, 0xBA, 0xF3, 33, 0xF, 0xBA, 0x3D, 0x40, 0, 0, 0, 35};
+    Executor exe(code);
+    exe.cpu.R[EBX] = 0x3;
+    exe.run_single_cycle();
+    const bool t1 = exe.last_op == Opcode::BTR && exe.cpu.R[EBX] == 0x1 && exe.cpu.flags.carry && exe.pcnt() == 4;
+    exe.run_single_cycle();
+    const bool t = t1 && exe.last_op == Opcode::BTC
+        && exe.cpu.mem[0x40] == 0x08
+        && exe.pcnt() == 12;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0xBC>() {
+    // bsf eax, ebx; tzcnt ecx, edx
+    const std::uint8_t code[] = {0xF, 0xBC, 0xC3, 0xF3, 0xF, 0xBC, 0xCA};
+    Executor exe(code);
+    exe.cpu.R[EBX] = 0x100;
+    exe.cpu.R[ECX] = 0xAA;
+    exe.execute(false, true, 1);
+    const bool t1 = exe.last_op == Opcode::BSF && exe.cpu.R[EAX] == 8 && exe.pcnt() == 3;
+    exe.execute(false, true, 2);
+    const bool t = t1 && exe.last_op == Opcode::TZCNT
+        && exe.cpu.R[ECX] == 32 && exe.cpu.flags.carry
+        && exe.pcnt() == 7;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0xBD>() {
+    // bsr eax, ebx; lzcnt ecx, ebx; popcnt edx, ebx
+    const std::uint8_t code[] = {0xF, 0xBD, 0xC3, 0xF3, 0xF, 0xBD, 0xCB, 0xF3, 0xF, 0xB8, 0xD3};
+    Executor exe(code);
+    exe.cpu.R[EBX] = 0x00F00000;
+    exe.execute(false, true, 5);
+    const bool t = exe.last_op == Opcode::POPCNT
+        && exe.cpu.R[EAX] == 23
+        && exe.cpu.R[ECX] == 8
+        && exe.cpu.R[EDX] == 4
+        && exe.pcnt() == 11;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0xA4>() {
+    const std::uint8_t code[] = {0xF, 0xA4, 0xD8, 0x08}; // shld eax, ebx, 8
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x12345678;
+    exe.cpu.R[EBX] = 0x9ABCDEF0;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::SHLD
+        && exe.cpu.R[EAX] == 0x3456789A
+        && exe.cpu.R[EBX] == 0x9ABCDEF0
+        && exe.pcnt() == 4;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0xAD>() {
+    const std::uint8_t code[] = {0xF, 0xAD, 0xD8}; // shrd eax, ebx, cl
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x12345678;
+    exe.cpu.R[EBX] = 0x9ABCDEF0;
+    exe.cpu.R[ECX] = 4;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::SHRD
+        && exe.cpu.R[EAX] == 0x01234567
+        && exe.pcnt() == 3;
+    assert(t);
+}
+
 template <>
 void test_opcode<0xF, 0xA8>() {
     const std::uint8_t code[] = {0xF, 0xA8};
@@ -1167,6 +1422,391 @@ void test_opcode<0xF, 0xA8>() {
     assert(t);
 }
 
+template <>
+void test_opcode<0x8E>() {
+    const std::uint8_t code[] = {0x8E, 0xE0}; // mov fs, ax
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x20;
+    exe.run_single_cycle();
+    const bool t = exe.last_op == Opcode::MOV_SREG
+        && exe.cpu.fs == 0x20
+        && exe.cpu.mmu.segment(Segment::FS).base == 0x200
+        && exe.pcnt() == 2;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xF, 0x22>() {
+    const std::uint8_t code[] = {0xF, 0x22, 0xD8, 0xF, 0x20, 0xD9}; // mov cr3, eax; mov ecx, cr3
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x5000;
+    exe.execute(false, true, 2);
+    const bool t = exe.last_op == Opcode::MOV_CR
+        && exe.cpu.mmu.cr3() == 0x5000
+        && exe.cpu.R[ECX] == 0x5000
+        && exe.pcnt() == 6;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xA4>() {
+    const std::uint8_t code[] = {0xA4, 0xF3, 0xA4}; // movsb; rep movsb
+    Executor exe(code);
+    std::memcpy(&exe.cpu.mem[0x100], "pix86 strings", 13);
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 12;
+    exe.run_single_cycle();
+    const bool t1 = exe.last_op == Opcode::MOVS8 && exe.pcnt() == 1 && exe.cpu.R[ECX] == 12
+        && exe.cpu.R[ESI] == 0x101 && exe.cpu.R[EDI] == 0x201 && exe.cpu.mem[0x200] == 'p';
+    exe.execute(false, true, 2);
+    const bool t = t1 && exe.pcnt() == 3 && exe.cpu.R[ECX] == 0 && exe.cpu.R[ESI] == 0x10D
+        && exe.cpu.R[EDI] == 0x20D && std::memcmp(&exe.cpu.mem[0x200], "pix86 strings", 13) == 0;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xA5>() {
+    const std::uint8_t code[] = {0xF3, 0xA5, 0x66, 0xA5}; // rep movsd; movsw
+    Executor exe(code);
+    for (address_t i = 0; i < 0x40; ++i) {
+        exe.cpu.mem[0x100 + i] = std::uint8_t(i);
+    }
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 8;
+    exe.execute(false, true, 4);
+    const bool t = exe.last_op == Opcode::MOVS16_32 && exe.pcnt() == 4 && exe.cpu.R[ECX] == 0
+        && exe.cpu.R[ESI] == 0x122 && exe.cpu.R[EDI] == 0x222
+        && std::memcmp(&exe.cpu.mem[0x100], &exe.cpu.mem[0x200], 0x22) == 0 && exe.cpu.mem[0x222] == 0;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xAA>() {
+    const std::uint8_t code[] = {0xF3, 0xAA, 0xAA}; // rep stosb; stosb
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0x1234;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 0x100;
+    exe.execute(false, true, 3);
+    const bool t = exe.last_op == Opcode::STOS8 && exe.pcnt() == 3 && exe.cpu.R[ECX] == 0
+        && exe.cpu.R[EDI] == 0x301 && exe.cpu.mem[0x200] == 0x34 && exe.cpu.mem[0x300] == 0x34
+        && exe.cpu.mem[0x301] == 0;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xAB>() {
+    const std::uint8_t code[] = {0xF3, 0xAB, 0xF3, 0x66, 0xAB}; // rep stosd; rep stosw
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0xDEADBEEF;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 4;
+    exe.execute(false, true, 2);
+    const bool t1 = exe.cpu.R[EDI] == 0x210 && mread<std::uint32_t>(&exe.cpu.mem[0x20C]) == 0xDEADBEEF;
+    exe.cpu.R[ECX] = 2;
+    exe.execute(false, true, 3);
+    const bool t = t1 && exe.last_op == Opcode::STOS16_32 && exe.pcnt() == 5 && exe.cpu.R[EDI] == 0x214
+        && mread<std::uint32_t>(&exe.cpu.mem[0x210]) == 0xBEEFBEEF && exe.cpu.mem[0x214] == 0;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xAC>() {
+    const std::uint8_t code[] = {0xAC, 0xF3, 0xAC}; // lodsb; rep lodsb
+    Executor exe(code);
+    std::memcpy(&exe.cpu.mem[0x100], "abcd", 4);
+    exe.cpu.R[EAX] = 0x11223344;
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[ECX] = 3;
+    exe.run_single_cycle();
+    const bool t1 = exe.cpu.R[EAX] == 0x11223361 && exe.cpu.R[ESI] == 0x101;
+    exe.execute(false, true, 2);
+    const bool t = t1 && exe.last_op == Opcode::LODS8 && exe.cpu.R[EAX] == 0x11223364
+        && exe.cpu.R[ESI] == 0x104 && exe.cpu.R[ECX] == 0;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xAD>() {
+    const std::uint8_t code[] = {0xFD, 0xAD, 0x66, 0xAD}; // std; lodsd; lodsw
+    Executor exe(code);
+    mwrite<std::uint32_t>(&exe.cpu.mem[0x100], 0xCAFEF00D);
+    exe.cpu.R[ESI] = 0x100;
+    exe.execute(false, true, 2);
+    const bool t1 = exe.cpu.R[EAX] == 0xCAFEF00D && exe.cpu.R[ESI] == 0xFC;
+    exe.cpu.R[ESI] = 0x102;
+    exe.execute(false, true, 2);
+    const bool t = t1 && exe.last_op == Opcode::LODS16_32 && exe.cpu.R[EAX] == 0xCAFECAFE && exe.cpu.R[ESI] == 0x100;
+    assert(t);
+}
+
+void test_rep_movs_element_path() {
+    // Forward onto an overlapping later destination repeats the first bytes,
+    // and DF=1 walks down, neither of which is a memmove.
+    const std::uint8_t code[] = {0xF3, 0xA4, 0xFD, 0xF3, 0xA4}; // rep movsb; std; rep movsb
+    Executor exe(code);
+    std::memcpy(&exe.cpu.mem[0x100], "abcdefgh", 8);
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[EDI] = 0x102;
+    exe.cpu.R[ECX] = 6;
+    exe.execute(false, true, 2);
+    const bool t1 = std::memcmp(&exe.cpu.mem[0x100], "abababab", 8) == 0 && exe.cpu.R[EDI] == 0x108;
+    std::memcpy(&exe.cpu.mem[0x100], "abcdefgh", 8);
+    exe.cpu.R[ESI] = 0x105;
+    exe.cpu.R[EDI] = 0x107;
+    exe.cpu.R[ECX] = 6;
+    exe.execute(false, true, 3);
+    const bool t = t1 && std::memcmp(&exe.cpu.mem[0x100], "ababcdef", 8) == 0
+        && exe.cpu.R[ESI] == 0xFF && exe.cpu.R[EDI] == 0x101 && exe.cpu.R[ECX] == 0;
+    assert(t);
+}
+
+void test_rep_stos_through_mmu() {
+    // A watchpoint takes the MMU off its direct path, so each element is
+    // translated and the store into the watched range is reported.
+    const std::uint8_t code[] = {0xF3, 0xAA}; // rep stosb
+    Executor exe(code);
+    exe.cpu.mmu.add_watchpoint(0x280, 1);
+    exe.cpu.R[EAX] = 0x5A;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 0x100;
+    const ExitReason reason = exe.execute(false, true, 2);
+    const bool t = reason == ExitReason::WATCHPOINT && exe.cpu.mmu.watch_hit->address == 0x280
+        && exe.cpu.R[ECX] == 0 && exe.cpu.R[EDI] == 0x300 && exe.cpu.mem[0x2FF] == 0x5A;
+    assert(t);
+}
+
+void test_rep_zero_count() {
+    const std::uint8_t code[] = {0xF3, 0xA4, 0xA4}; // rep movsb; movsb
+    Executor exe(code);
+    exe.cpu.mem[0x100] = 0x77;
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[EDI] = 0x200;
+    exe.execute(false, true, 2);
+    const bool t1 = exe.cpu.R[ESI] == 0x100 && exe.cpu.mem[0x200] == 0 && exe.pcnt() == 2;
+    // The prefix only applies to the instruction it precedes.
+    exe.run_single_cycle();
+    const bool t = t1 && exe.cpu.R[ESI] == 0x101 && exe.cpu.R[ECX] == 0 && exe.cpu.mem[0x200] == 0x77;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xA6>() {
+    const std::uint8_t code[] = {0xA6, 0xF3, 0xA6}; // cmpsb; repe cmpsb
+    Executor exe(code);
+    std::memcpy(&exe.cpu.mem[0x100], "pix86", 5);
+    std::memcpy(&exe.cpu.mem[0x200], "pixel", 5);
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 5;
+    exe.run_single_cycle();
+    const bool t1 = exe.last_op == Opcode::CMPS8 && exe.cpu.flags.zero && exe.cpu.R[ECX] == 5 && exe.cpu.R[ESI] == 0x101;
+    exe.execute(false, true, 2);
+    // Stops after '8' against 'e', with the flags of that compare.
+    const bool t = t1 && exe.cpu.R[ESI] == 0x104 && exe.cpu.R[EDI] == 0x204 && exe.cpu.R[ECX] == 2
+        && !exe.cpu.flags.zero && exe.cpu.flags.carry && exe.pcnt() == 3;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xA7>() {
+    const std::uint8_t code[] = {0xF3, 0xA7, 0xF2, 0x66, 0xA7}; // repe cmpsd; repne cmpsw
+    Executor exe(code);
+    mwrite<std::uint32_t>(&exe.cpu.mem[0x100], 0x11111111);
+    mwrite<std::uint32_t>(&exe.cpu.mem[0x104], 0x22222222);
+    mwrite<std::uint32_t>(&exe.cpu.mem[0x200], 0x11111111);
+    mwrite<std::uint32_t>(&exe.cpu.mem[0x204], 0x22222223);
+    exe.cpu.R[ESI] = 0x100;
+    exe.cpu.R[EDI] = 0x200;
+    exe.cpu.R[ECX] = 4;
+    exe.execute(false, true, 2);
+    const bool t1 = exe.cpu.R[ECX] == 2 && exe.cpu.R[ESI] == 0x108 && !exe.cpu.flags.zero && exe.cpu.flags.carry;
+    // Words from 0x108 on are zero on both sides, so repne stops at once.
+    exe.execute(false, true, 3);
+    const bool t = t1 && exe.last_op == Opcode::CMPS16_32 && exe.cpu.R[ECX] == 1 && exe.cpu.R[ESI] == 0x10A
+        && exe.cpu.flags.zero && exe.pcnt() == 5;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xAE>() {
+    const std::uint8_t code[] = {0xF2, 0xAE, 0xAE}; // repne scasb; scasb
+    Executor exe(code);
+    std::memcpy(&exe.cpu.mem[0x100], "strlen", 7);
+    exe.cpu.R[EDI] = 0x100;
+    exe.cpu.R[ECX] = 0xFFFFFFFF;
+    exe.execute(false, true, 2);
+    // The classic strlen: not ecx less one is the length.
+    const bool t1 = ~exe.cpu.R[ECX] - 1 == 6 && exe.cpu.R[EDI] == 0x107 && exe.cpu.flags.zero;
+    exe.run_single_cycle();
+    const bool t = t1 && exe.last_op == Opcode::SCAS8 && exe.cpu.R[EDI] == 0x108 && exe.cpu.R[ECX] == 0xFFFFFFF8;
+    assert(t);
+}
+
+template <>
+void test_opcode<0xAF>() {
+    const std::uint8_t code[] = {0xF3, 0xAF, 0xFD, 0xF3, 0x66, 0xAF}; // repe scasd; std; repe scasw
+    Executor exe(code);
+    exe.cpu.R[EAX] = 0xABCDABCD;
+    for (address_t i = 0x100; i < 0x110; i += 4) {
+        mwrite<std::uint32_t>(&exe.cpu.mem[i], 0xABCDABCD);
+    }
+    exe.cpu.R[EDI] = 0x100;
+    exe.cpu.R[ECX] = 8;
+    exe.execute(false, true, 2);
+    const bool t1 = exe.cpu.R[ECX] == 3 && exe.cpu.R[EDI] == 0x114 && !exe.cpu.flags.zero;
+    exe.cpu.R[EDI] = 0x10E;
+    exe.cpu.R[ECX] = 4;
+    exe.execute(false, true, 4);
+    const bool t = t1 && exe.last_op == Opcode::SCAS16_32 && exe.cpu.R[ECX] == 0 && exe.cpu.R[EDI] == 0x106
+        && exe.cpu.flags.zero;
+    assert(t);
+}
+
+void test_rep_scas_end_of_memory() {
+    const std::uint8_t code[] = {0xF2, 0xAE}; // repne scasb
+    // Memory ends half way through its last page, and the watchpoint takes
+    // the MMU off its direct path.
+    Executor exe(code, 0xF800, 0xF800);
+    exe.cpu.mmu.add_watchpoint(0x200, 1);
+    std::memset(&exe.cpu.mem[0xF700], 'a', 0x100);
+    exe.cpu.R[EDI] = 0xF700;
+    exe.cpu.R[ECX] = 0x1000;
+    bool t = false;
+    try {
+        // The prefix takes a cycle of its own.
+        while (exe.pcnt() < 2) exe.run_single_cycle();
+    } catch (const MEMORY_FAULT&) {
+        t = exe.cpu.R[EDI] == 0xF800 && exe.cpu.R[ECX] == 0xF00;
+    }
+    assert(t);
+}
+
+void test_rep_scas_cmps_reference() {
+    // Byte at a time against the kernels, with runs crossing guest pages.
+    std::mt19937 rng(3);
+    const std::uint8_t code[] = {0xF2, 0xAE, 0xF3, 0xAE, 0xF3, 0xA6, 0xF2, 0xA6};
+    bool t = true;
+    for (int round = 0; round < 400; ++round) {
+        const std::size_t op = 2 * std::size_t(rng() % 4);
+        const auto body = std::span<const std::uint8_t>(code).subspan(op, 2);
+        Executor exe(body);
+        for (address_t i = 0x800; i < 0x4000; ++i) {
+            exe.cpu.mem[i] = std::uint8_t(rng() % (op < 4 ? 6 : 2));
+        }
+        if (round % 8 == 0) {
+            // Long equal runs for the REPE forms.
+            std::memset(&exe.cpu.mem[0x800], 1, 0x3000);
+        }
+        exe.cpu.R[EAX] = rng() % 6;
+        exe.cpu.R[ESI] = 0x800 + rng() % 0x1000;
+        exe.cpu.R[EDI] = 0x800 + rng() % 0x1000;
+        exe.cpu.R[ECX] = rng() % 0x1800;
+        exe.cpu.flags.carry = rng() % 2;
+
+        CPU ref;
+        ref.R[EAX] = exe.cpu.R[EAX];
+        ref.R[ESI] = exe.cpu.R[ESI];
+        ref.R[EDI] = exe.cpu.R[EDI];
+        ref.R[ECX] = exe.cpu.R[ECX];
+        ref.flags.carry = exe.cpu.flags.carry;
+        const bool repne = op == 0 || op == 6;
+        while (ref.R[ECX]) {
+            if (op < 4) {
+                ref.cmp8(std::uint8_t(ref.R[EAX]), exe.cpu.mem[ref.R[EDI]]);
+            } else {
+                ref.cmp8(exe.cpu.mem[ref.R[ESI]++], exe.cpu.mem[ref.R[EDI]]);
+            }
+            ++ref.R[EDI];
+            --ref.R[ECX];
+            if (ref.flags.zero == repne) {
+                break;
+            }
+        }
+        exe.execute(false, true, 2);
+        t = t && exe.cpu.R[ECX] == ref.R[ECX] && exe.cpu.R[EDI] == ref.R[EDI] && exe.cpu.R[ESI] == ref.R[ESI]
+            && exe.cpu.flags.get_flags8() == ref.flags.get_flags8() && exe.cpu.flags.overflow == ref.flags.overflow;
+    }
+    assert(t);
+}
+
+void test_rep_cmps_page_fault() {
+    // The compare runs into a page without read permission and faults there,
+    // with the registers naming that element for a restart.
+    const std::uint8_t code[] = {0xF3, 0xA6}; // repe cmpsb
+    Executor exe(code);
+    exe.cpu.mmu.protect(0x3000, 0x1000, Memory::PAGE_WRITE);
+    exe.cpu.R[ESI] = 0x1F00;
+    exe.cpu.R[EDI] = 0x2F00;
+    exe.cpu.R[ECX] = 0x1000;
+    bool t = false;
+    try {
+        exe.execute(false, true, 2);
+    } catch (const PAGE_FAULT& pf) {
+        t = pf.address == 0x3000 && exe.cpu.R[EDI] == 0x3000 && exe.cpu.R[ESI] == 0x2000
+            && exe.cpu.R[ECX] == 0xF00 && exe.cpu.flags.zero;
+    }
+    assert(t);
+}
+
+void test_segment_override() {
+    const std::uint8_t code[] = {0x64, 0x1, 0x8, 0x1, 0x8}; // add fs:[eax], ecx; add [eax], ecx
+    Executor exe(code);
+    exe.cpu.load_segment(Segment::FS, 0x10);
+    exe.cpu.R[EAX] = 0x8;
+    exe.cpu.R[ECX] = 0x11223344;
+    exe.execute(false, true, 3);
+    const bool t = mread<std::uint32_t>(&exe.cpu.mem[0x108]) == 0x11223344
+        && mread<std::uint32_t>(&exe.cpu.mem[0x8]) == 0x11223344
+        && !exe.segment_override
+        && exe.pcnt() == 5;
+    assert(t);
+}
+
+void test_watchpoint_exit() {
+    const std::uint8_t code[] = {0x1, 0x8, 0x1, 0x18, 0x1, 0x8}; // add [eax], ecx; add [eax], ebx; add [eax], ecx
+    Executor exe(code);
+    exe.cpu.mmu.add_watchpoint(0x200, 4);
+    exe.cpu.R[EAX] = 0x200;
+    exe.cpu.R[ECX] = 0x1;
+    exe.cpu.R[EBX] = 0x10;
+    const ExitReason first = exe.execute(false, true, 3);
+    const bool t1 = first == ExitReason::WATCHPOINT && exe.pcnt() == 2
+        && exe.cpu.mmu.watch_hit->address == 0x200
+        && mread<std::uint32_t>(&exe.cpu.mem[0x200]) == 0x1;
+    // Resuming clears the hit and stops again on the next store.
+    const ExitReason second = exe.run_single_cycle();
+    const bool t = t1 && second == ExitReason::WATCHPOINT && exe.pcnt() == 4
+        && mread<std::uint32_t>(&exe.cpu.mem[0x200]) == 0x11;
+    assert(t);
+}
+
+void test_fetch_from_non_exec_page() {
+    const std::uint8_t code[] = {0x40}; // inc eax
+    Executor exe(code);
+    exe.cpu.mmu.protect(0, 1, Memory::PAGE_READ | Memory::PAGE_WRITE);
+    bool t = false;
+    try {
+        exe.execute(false, true, 1);
+    } catch (const PAGE_FAULT& pf) {
+        t = pf.address == 0 && pf.error_code == MMU::FETCH_FAULT && exe.cpu.R[EAX] == 0;
+    }
+    assert(t);
+}
+
+void test_self_modifying_store() {
+    const std::uint8_t code[] = {0x1, 0x8, 0x1, 0x8}; // add [eax], ecx; add [eax], ecx
+    Executor exe(code);
+    exe.cpu.mmu.mark_code(0, 4);
+    exe.cpu.R[EAX] = 0x2;
+    exe.cpu.R[ECX] = 0x1;
+    exe.execute(false, true, 1);
+    const bool t = exe.cpu.mem.page_generation(0) == 1 && exe.cpu.mem[2] == 0x2;
+    assert(t);
+}
+
 void test_executor() {
 
     test_binary_operation_r2r_rm_dest_8bit();
@@ -1264,16 +1904,43 @@ void test_executor() {
     test_opcode<0x61>();
 
 
+    test_opcode<0x9B>();
     test_opcode<0x9E>();
     test_opcode<0x9F>();
 
+    test_opcode<0xA4>();
+    test_opcode<0xA5>();
+    test_opcode<0xA6>();
+    test_opcode<0xA7>();
+    test_opcode<0xAA>();
+    test_opcode<0xAB>();
+    test_opcode<0xAC>();
+    test_opcode<0xAD>();
+    test_opcode<0xAE>();
+    test_opcode<0xAF>();
+    test_rep_movs_element_path();
+    test_rep_stos_through_mmu();
+    test_rep_zero_count();
+    test_rep_scas_end_of_memory();
+    test_rep_scas_cmps_reference();
+    test_rep_cmps_page_fault();
+
+    test_opcode<0xC0>();
+    test_opcode<0xC1>();
+    test_opcode<0xD0>();
+    test_opcode<0xD1>();
+    test_opcode<0xD2>();
+    test_opcode<0xD3>();
     test_opcode<0xD4>();
     test_opcode<0xD5>();
     test_opcode<0xD6>();
     test_opcode<0xD7>();
+    test_opcode<0xD9>();
 
     test_opcode<0xF4>();
     test_opcode<0xF5>();
+    test_opcode<0xF6>();
+    test_opcode<0xF7>();
     test_opcode<0xF8>();
     test_opcode<0xF9>();
     test_opcode<0xFC>();
@@ -1283,7 +1950,21 @@ void test_executor() {
     test_opcode<0xF, 0x41>();
 
     test_opcode<0xF, 0xA0>();
+    test_opcode<0xF, 0xA3>();
+    test_opcode<0xF, 0xA4>();
     test_opcode<0xF, 0xA8>();
+    test_opcode<0xF, 0xAB>();
+    test_opcode<0xF, 0xAD>();
+    test_opcode<0xF, 0xBA>();
+    test_opcode<0xF, 0xBC>();
+    test_opcode<0xF, 0xBD>();
+
+    test_opcode<0x8E>();
+    test_opcode<0xF, 0x22>();
+    test_segment_override();
+    test_watchpoint_exit();
+    test_fetch_from_non_exec_page();
+    test_self_modifying_store();
 
     std::cout << "All executor tests passed!" << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "executor_pool.hh"
+#include "util.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+
+void test_executor_pool_prefill() {
+    ExecutorPool pool(2, 64_kb, 16_kb);
+    const bool t = pool.available() == 2;
+    assert(t);
+}
+
+void test_executor_pool_acquire_empty() {
+    ExecutorPool pool(0, 64_kb, 16_kb);
+    const std::uint8_t code[] = {0x40}; // inc eax
+    auto exe = pool.acquire(code, 0x100);
+    exe.execute(false, true, 1);
+    const bool t = exe.cpu.R[EAX] == 1 && exe.pcnt() == 0x101 && exe.cpu.mem.size() == 64_kb;
+    assert(t);
+}
+
+void test_executor_pool_recycle() {
+    ExecutorPool pool(1, 64_kb, 16_kb);
+    const std::uint8_t code[] = {0x1, 0x8, 0x50}; // add [eax], ecx; push eax
+    auto first = pool.acquire(code);
+    const auto* buffer = first.cpu.mem.data();
+    first.cpu.R[EAX] = 0x2000;
+    first.cpu.R[ECX] = 0xDEADBEEF;
+    first.cpu.flags.carry = true;
+    first.execute(false, true, 2);
+    pool.release(std::move(first));
+
+    const std::uint8_t code2[] = {0x90};
+    auto second = pool.acquire(code2);
+    const bool t = pool.available() == 0
+        && second.cpu.mem.data() == buffer
+        && second.cpu.mem[0] == 0x90 && second.cpu.mem[1] == 0
+        && mread<std::uint32_t>(&second.cpu.mem[0x2000]) == 0
+        && mread<std::uint32_t>(&second.cpu.mem[64_kb - 5]) == 0
+        && second.cpu.R[EAX] == 0 && second.cpu.R[ESP] == 64_kb - 1
+        && !second.cpu.flags.carry && second.pcnt() == 0;
+    assert(t);
+}
+
+void test_executor_pool_moved_executor_runs() {
+    ExecutorPool pool(1, 64_kb, 16_kb);
+    const std::uint8_t code[] = {0x50}; // push eax
+    auto exe = pool.acquire(code);
+    auto moved = std::move(exe);
+    moved.cpu.R[EAX] = 0x1234;
+    moved.execute(false, true, 1);
+    const bool t = moved.cpu.R[ESP] == 64_kb - 5 && moved.cpu.stack.esp() == 64_kb - 5
+        && mread<std::uint32_t>(&moved.cpu.mem[64_kb - 5]) == 0x1234;
+    assert(t);
+}
+
+void test_executor_pool_release_foreign() {
+    ExecutorPool pool(0, 64_kb, 16_kb);
+    const std::uint8_t code[] = {0x90};
+    pool.release(Executor(code, 1024, 1024));
+    // Same memory, different stack region.
+    pool.release(Executor(code, 64_kb, 8_kb));
+    const bool t1 = pool.available() == 0;
+    pool.release(Executor(code, 64_kb, 16_kb));
+    const bool t = t1 && pool.available() == 1 && pool.acquire(code).cpu.stack.limit() == 48_kb;
+    assert(t);
+}
+
+void test_executor_pool() {
+    test_executor_pool_prefill();
+    test_executor_pool_acquire_empty();
+    test_executor_pool_recycle();
+    test_executor_pool_moved_executor_runs();
+    test_executor_pool_release_foreign();
+
+    std::cout << "All executor pool tests passed!" << std::endl;
+}
@@ -31,9 +31,46 @@ void test_set_flags8() {
     assert(t);
 }
 
+void test_set_inc_flags() {
+    Flags flags;
+    flags.carry = true;
+    flags.set_inc_flags(0x7FFFFFFF, 0x80000000);
+    const bool t1 = flags.overflow && flags.sign && !flags.zero && flags.adjust && flags.parity && flags.carry;
+    // inc8 of 0xFF, sign extended.
+    flags.set_inc_flags(0xFFFFFFFF, 0);
+    const bool t = t1 && flags.zero && !flags.sign && !flags.overflow && flags.adjust && flags.parity;
+    assert(t);
+}
+
+void test_set_dec_flags() {
+    Flags flags;
+    flags.set_dec_flags(1, 0);
+    const bool t1 = flags.zero && !flags.sign && !flags.overflow && !flags.adjust && flags.parity && !flags.carry;
+    // dec16 of 0x8000, sign extended.
+    flags.set_dec_flags(0xFFFF8000, 0x7FFF);
+    const bool t = t1 && flags.overflow && !flags.sign && !flags.zero && flags.adjust && flags.parity;
+    assert(t);
+}
+
+void test_set_sub_flags() {
+    Flags flags;
+    // 0x7F - 0x80 as bytes, sign extended: borrow and signed overflow.
+    flags.set_sub_flags(0x7F, 0xFFFFFF80, 0xFFFFFFFF);
+    const bool t1 = flags.carry && flags.overflow && flags.sign && !flags.zero && flags.parity && !flags.adjust;
+    flags.set_sub_flags(0x12345678, 0x12345678, 0);
+    const bool t2 = !flags.carry && !flags.overflow && !flags.sign && flags.zero && flags.parity;
+    // 0x10 - 0x01: a borrow out of bit 3.
+    flags.set_cmp_flags(0x10, 0x01, 0x0F);
+    const bool t = t1 && t2 && !flags.carry && flags.adjust && flags.parity && !flags.zero;
+    assert(t);
+}
+
 void test_flags() {
     test_get_flags8();
     test_set_flags8();
+    test_set_inc_flags();
+    test_set_dec_flags();
+    test_set_sub_flags();
 
     std::cout << "All flag tests passed!" << std::endl;
 }
\ No newline at end of file
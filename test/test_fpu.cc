@@ -3,6 +3,8 @@
 #include "types.hh"
 
 #include <cassert>
+#include <cfenv>
+#include <cmath>
 #include <iostream>
 #include <limits>
 
@@ -72,6 +74,82 @@ void test_fcom() {
     assert(t1 && t2 && t3 && t4);
 }
 
+void test_fpu_precision_control() {
+    FPU fpu(flags);
+    // 1 + 2^-60 survives the 80 bit stack but not 53 or 24 bits.
+    const long double tiny = std::ldexp(1.0L, -60);
+    fpu.fld(tiny);
+    fpu.fld1();
+    fpu.fadd(1);
+    bool t = fpu.V.value(0) == 1.0L + tiny && !fpu.V.is_double();
+    fpu.set_control(0x027F);
+    fpu.fld(tiny);
+    fpu.fld1();
+    fpu.fadd(1);
+    t = t && fpu.V.value(0) == 1.0L && fpu.precision() == FPU::Precision::DOUBLE;
+    // 1/3 rounded to single precision.
+    fpu.set_control(0x007F);
+    fpu.fld(3.0L);
+    fpu.fld1();
+    fpu.fdiv(1);
+    t = t && fpu.V.value(0) == 1.0f / 3.0f;
+    assert(t);
+}
+
+void test_fpu_double_mode() {
+    FPU fpu(flags);
+    fpu.set_double_mode(true);
+    // The default control word asks for extended precision, which keeps
+    // the 80 bit stack.
+    bool t = !fpu.V.is_double();
+    fpu.fld(2.0L);
+    // The stack changes storage on the next arithmetic instruction.
+    fpu.set_control(0x027F);
+    t = t && !fpu.V.is_double() && fpu.V.value(0) == 2.0L;
+    fpu.fld(0.5L);
+    fpu.fmul(1);
+    t = t && fpu.V.is_double();
+    fpu.fsqrt();
+    fpu.fld1();
+    fpu.fsubp(1);
+    t = t && fpu.V.top_ == 2 && fpu.V.value(0) == 0.0L && fpu.V.st<double>(1) == 2.0;
+    fpu.fld1();
+    fpu.fcom(2u);
+    t = t && fpu.c_vals() == std::tuple{1, 0, 0, 0};
+    // Back to extended precision, and the values follow the stack.
+    fpu.set_control(FPU::DEFAULT_CONTROL);
+    t = t && fpu.V.is_double();
+    fpu.fabs();
+    t = t && !fpu.V.is_double() && fpu.V.st(2) == 2.0L && fpu.V.st(0) == 1.0L;
+    assert(t);
+}
+
+void test_fpu_rounding_control() {
+    FPU fpu(flags);
+    fpu.set_double_mode(true);
+    // Round down, then up, with 53 bit precision.
+    fpu.set_control(0x067F);
+    fpu.fld(-2.5L);
+    fpu.frndint();
+    bool t = fpu.V.value(0) == -3.0L;
+    fpu.fld(3.0L);
+    fpu.fld1();
+    fpu.fdiv(1);
+    const long double down = fpu.V.value(0);
+    fpu.set_control(0x0A7F);
+    fpu.fld(3.0L);
+    fpu.fld1();
+    fpu.fdiv(1);
+    t = t && fpu.V.value(0) > down && fpu.rounding() == FE_UPWARD;
+    // The host is back to round to nearest afterwards.
+    t = t && std::fegetround() == FE_TONEAREST;
+    fpu.set_control(FPU::DEFAULT_CONTROL);
+    fpu.fld(2.5L);
+    fpu.frndint();
+    t = t && fpu.V.value(0) == 2.0L;
+    assert(t);
+}
+
 void test_fpu() {
     // test_fxam_normal();
     // test_fxam_denormal();
@@ -79,6 +157,9 @@ void test_fpu() {
     // test_fxam_NaN();
     // test_fxam_infinity();
     test_fcom();
+    test_fpu_precision_control();
+    test_fpu_double_mode();
+    test_fpu_rounding_control();
 
     std::cout << "All FPU tests passed!\n";
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "hex.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+void test_parse_hex_tokens() {
+    const auto bytes = parse_hex("0x31 0xD2\n0xB9 1 0 0X0 ff\tA\r\n");
+    const std::vector<std::uint8_t> expected = {0x31, 0xD2, 0xB9, 0x1, 0x0, 0x0, 0xFF, 0xA};
+    const bool t = bytes == expected;
+    assert(t);
+}
+
+void test_parse_hex_comments() {
+    const auto bytes = parse_hex("# header\n0x40 ; inc eax\n0x41# inc ecx\n;0x42\n0x43");
+    const std::vector<std::uint8_t> expected = {0x40, 0x41, 0x43};
+    const bool t = bytes == expected && parse_hex("").empty() && parse_hex("  # only a comment").empty();
+    assert(t);
+}
+
+void test_parse_hex_malformed() {
+    const char* bad[] = {"0x100", "0x", "zz", "0x4g", "12 345", "-1", "0xx1"};
+    bool t = true;
+    for (const auto* text : bad) {
+        bool threw = false;
+        try {
+            parse_hex(text);
+        } catch (const std::domain_error&) {
+            threw = true;
+        }
+        t = t && threw;
+    }
+    assert(t);
+}
+
+void test_parse_hex_span() {
+    std::uint8_t out[2] = {};
+    const bool t1 = parse_hex("1 2", out) == 2 && out[0] == 1 && out[1] == 2;
+    bool t2 = false;
+    try {
+        parse_hex("1 2 3", out);
+    } catch (const std::domain_error&) {
+        t2 = true;
+    }
+    const bool t = t1 && t2;
+    assert(t);
+}
+
+void test_read_hex_file() {
+    char path[] = "/tmp/pix86_hexXXXXXX";
+    const int fd = mkstemp(path);
+    const std::string text = "0xDE 0xAD # comment\n0xBE 0xEF\n";
+    [[maybe_unused]] const auto n = write(fd, text.data(), text.size());
+    close(fd);
+    const auto bytes = read_hex_file(path);
+    unlink(path);
+    const std::vector<std::uint8_t> expected = {0xDE, 0xAD, 0xBE, 0xEF};
+    const bool t = bytes == expected;
+    assert(t);
+}
+
+void test_hex() {
+    test_parse_hex_tokens();
+    test_parse_hex_comments();
+    test_parse_hex_malformed();
+    test_parse_hex_span();
+    test_read_hex_file();
+
+    std::cout << "All hex tests passed!" << std::endl;
+}
@@ -0,0 +1,172 @@
+#include "hle.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr address_t entry = 0x2000;
+constexpr address_t ret = 0x100;
+
+// Set exe up as if the code at ret had just called entry with args.
+void call(Executor& exe, std::initializer_list<std::uint32_t> args) {
+    for (auto it = std::rbegin(args); it != std::rend(args); ++it) {
+        exe.cpu.push32(*it);
+    }
+    exe.cpu.push32(ret);
+    exe.pc = entry;
+}
+
+char* str(Executor& exe, address_t at) {
+    return reinterpret_cast<char*>(&exe.cpu.mem[at]);
+}
+
+}
+
+void test_hle_hook_returns_to_caller() {
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    exe.cpu.mem[ret] = 0x41; // inc ecx
+    exe.add_hook(entry, hle_strlen);
+    std::strcpy(str(exe, 0x400), "pix86");
+    call(exe, {0x400});
+    const std::uint32_t esp = exe.cpu.R[ESP];
+    const auto reason = exe.execute(false, true, 2);
+    const bool t = reason == ExitReason::CYCLES && exe.cpu.R[EAX] == 5 && exe.cpu.R[ECX] == 1
+        && exe.pcnt() == ret + 1 && exe.cpu.R[ESP] == esp + 4;
+    assert(t);
+}
+
+void test_hle_hook_page_without_entry() {
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    exe.add_hook(entry, hle_strlen);
+    exe.cpu.mem[entry + 1] = 0x40; // inc eax
+    exe.pc = entry + 1;
+    exe.execute(false, true, 1);
+    const bool t1 = exe.cpu.R[EAX] == 1 && (exe.cpu.mem.page_flags(entry) & Memory::PAGE_HOOK);
+    exe.remove_hook(entry);
+    const bool t = t1 && !(exe.cpu.mem.page_flags(entry) & Memory::PAGE_HOOK);
+    assert(t);
+}
+
+void test_hle_memcpy_memset() {
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    exe.add_hook(entry, hle_memcpy);
+    exe.add_hook(entry + 0x10, hle_memset);
+    exe.cpu.mmu.mark_code(0x3000, 1);
+    std::strcpy(str(exe, 0x400), "abcdef");
+    call(exe, {0x3000, 0x400, 7});
+    exe.execute(false, true, 1);
+    const bool t1 = exe.cpu.R[EAX] == 0x3000 && std::strcmp(str(exe, 0x3000), "abcdef") == 0
+        && exe.cpu.mem.page_generation(0x3000) == 1;
+    call(exe, {0x3001, 'z', 3});
+    exe.pc = entry + 0x10;
+    exe.execute(false, true, 1);
+    const bool t = t1 && std::strcmp(str(exe, 0x3000), "azzzef") == 0;
+    assert(t);
+}
+
+void test_hle_strcmp() {
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    exe.add_hook(entry, hle_strcmp);
+    std::strcpy(str(exe, 0x400), "apple");
+    std::strcpy(str(exe, 0x500), "apply");
+    std::strcpy(str(exe, 0x600), "app");
+    const auto cmp = [&](address_t a, address_t b) {
+        call(exe, {a, b});
+        exe.execute(false, true, 1);
+        return std::int32_t(exe.cpu.R[EAX]);
+    };
+    const bool t = cmp(0x400, 0x500) < 0 && cmp(0x500, 0x400) > 0 && cmp(0x400, 0x400) == 0
+        && cmp(0x600, 0x400) < 0 && cmp(0x400, 0x600) > 0;
+    assert(t);
+}
+
+void test_hle_bad_pointer() {
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    exe.add_hook(entry, hle_memset);
+    call(exe, {0xFFF0, 0, 0x100});
+    bool t = false;
+    try {
+        exe.execute(false, true, 1);
+    } catch (const MEMORY_FAULT&) {
+        t = true;
+    }
+    assert(t);
+}
+
+void test_hle_through_mmu() {
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    exe.add_hook(entry, hle_memcpy);
+    exe.add_hook(entry + 0x10, hle_memset);
+    // An overlapping move up across a page boundary keeps the source intact.
+    for (std::size_t i = 0; i < 0x30; ++i) {
+        exe.cpu.mem[address_t(0x4FE0 + i)] = std::uint8_t(i);
+    }
+    call(exe, {0x4FF0, 0x4FE0, 0x30});
+    exe.execute(false, true, 1);
+    bool t1 = true;
+    for (std::size_t i = 0; i < 0x30; ++i) {
+        t1 = t1 && exe.cpu.mem[address_t(0x4FF0 + i)] == i;
+    }
+    // Stores honour watchpoints and page permissions.
+    exe.cpu.mmu.add_watchpoint(0x6010, 1);
+    call(exe, {0x6000, 'w', 0x20});
+    exe.pc = entry + 0x10;
+    exe.execute(false, true, 1);
+    const bool t2 = t1 && exe.cpu.mmu.watch_hit && exe.cpu.mem[0x6010] == 'w';
+    exe.cpu.mmu.protect(0x7000, 0x1000, Memory::PAGE_READ);
+    call(exe, {0x7000, 0, 4});
+    exe.pc = entry + 0x10;
+    bool t3 = false;
+    try {
+        exe.execute(false, true, 1);
+    } catch (const PAGE_FAULT& pf) {
+        t3 = pf.address == 0x7000;
+    }
+    const bool t = t2 && t3;
+    assert(t);
+}
+
+void test_hle_string_at_end_of_memory() {
+    // Memory ends half way through its last page.
+    Executor exe(std::span<const std::uint8_t>{}, 0xF800, 0xF800);
+    exe.add_hook(entry, hle_strlen);
+    exe.add_hook(entry + 0x10, hle_strcmp);
+    std::strcpy(str(exe, 0xF7F0), "tail");
+    std::strcpy(str(exe, 0xF7F8), "tail");
+    exe.cpu.R[ESP] = 0x8000;
+    // Off the direct path too.
+    exe.cpu.mmu.add_watchpoint(0x100, 1);
+    call(exe, {0xF7F0});
+    exe.execute(false, true, 1);
+    const bool t0 = exe.cpu.R[EAX] == 4;
+    call(exe, {0xF7F0, 0xF7F8});
+    exe.pc = entry + 0x10;
+    exe.execute(false, true, 1);
+    const bool t1 = t0 && exe.cpu.R[EAX] == 0;
+    // An unterminated string still runs into the end of memory.
+    std::memset(str(exe, 0xF7F0), 'x', 0x10);
+    call(exe, {0xF7F0});
+    bool t2 = false;
+    try {
+        exe.execute(false, true, 1);
+    } catch (const MEMORY_FAULT&) {
+        t2 = true;
+    }
+    const bool t = t1 && t2;
+    assert(t);
+}
+
+void test_hle() {
+    test_hle_hook_returns_to_caller();
+    test_hle_hook_page_without_entry();
+    test_hle_memcpy_memset();
+    test_hle_strcmp();
+    test_hle_bad_pointer();
+    test_hle_through_mmu();
+    test_hle_string_at_end_of_memory();
+
+    std::cout << "All HLE tests passed!" << std::endl;
+}
@@ -0,0 +1,39 @@
+#include "host_cpu.hh"
+
+#include <cassert>
+#include <iostream>
+
+void test_host_cpu_tiers() {
+    const HostCpu& host = HostCpu::get();
+    // Probed once and kept.
+    bool t = &host == &HostCpu::get() && host.supports(HostIsa::SCALAR) && host.supports(host.best());
+    if (host.best() == HostIsa::AVX2) {
+        t = t && host.supports(HostIsa::SSE4_2);
+    }
+#if defined(__x86_64__)
+    // SSE2 is part of x86-64, so every 64 bit host gets at least that tier.
+    t = t && host.supports(HostIsa::SSE2);
+#endif
+    HostCpu old;
+    t = t && old.best() == HostIsa::SCALAR && !old.supports(HostIsa::SSE2);
+    HostCpu sse2_only;
+    sse2_only.sse2 = true;
+    t = t && sse2_only.best() == HostIsa::SSE2 && !sse2_only.supports(HostIsa::SSE4_2);
+    HostCpu avx2_only;
+    avx2_only.sse2 = true;
+    avx2_only.avx2 = true;
+    // AVX2 kernels may use anything from the tiers below.
+    t = t && avx2_only.best() == HostIsa::SSE2;
+    HostCpu modern;
+    modern.sse2 = true;
+    modern.sse4_2 = true;
+    modern.avx2 = true;
+    t = t && modern.best() == HostIsa::AVX2;
+    assert(t);
+}
+
+void test_host_cpu() {
+    test_host_cpu_tiers();
+
+    std::cout << "All host CPU tests passed!" << std::endl;
+}
@@ -0,0 +1,247 @@
+#include "loader.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <elf.h>
+#include <unistd.h>
+
+namespace {
+
+// Write bytes to a fresh temporary file and return its path.
+std::string temp_image(const std::vector<std::uint8_t>& bytes) {
+    char path[] = "/tmp/pix86_loaderXXXXXX";
+    const int fd = mkstemp(path);
+    assert(fd >= 0);
+    [[maybe_unused]] const auto n = write(fd, bytes.data(), bytes.size());
+    close(fd);
+    return path;
+}
+
+std::vector<std::uint8_t> read_back(const std::string& path) {
+    std::vector<std::uint8_t> bytes;
+    if (auto* f = std::fopen(path.c_str(), "rb")) {
+        for (int c; (c = std::fgetc(f)) != EOF; ) {
+            bytes.push_back(std::uint8_t(c));
+        }
+        std::fclose(f);
+    }
+    return bytes;
+}
+
+// A minimal static i386 executable: a read/execute segment holding the
+// whole file and a read/write one covering just the headers plus bss.
+std::vector<std::uint8_t> tiny_elf() {
+    constexpr std::uint32_t code_offset = sizeof(Elf32_Ehdr) + 2 * sizeof(Elf32_Phdr);
+    const std::uint8_t code[] = {0x40, 0x40}; // inc eax; inc eax
+    std::vector<std::uint8_t> file(code_offset + sizeof(code));
+
+    Elf32_Ehdr eh{};
+    std::copy(ELFMAG, ELFMAG + SELFMAG, eh.e_ident);
+    eh.e_ident[EI_CLASS] = ELFCLASS32;
+    eh.e_ident[EI_DATA] = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_type = ET_EXEC;
+    eh.e_machine = EM_386;
+    eh.e_version = EV_CURRENT;
+    eh.e_entry = 0x1000 + code_offset;
+    eh.e_phoff = sizeof(Elf32_Ehdr);
+    eh.e_ehsize = sizeof(Elf32_Ehdr);
+    eh.e_phentsize = sizeof(Elf32_Phdr);
+    eh.e_phnum = 2;
+
+    Elf32_Phdr text{};
+    text.p_type = PT_LOAD;
+    text.p_vaddr = 0x1000;
+    text.p_filesz = text.p_memsz = std::uint32_t(file.size());
+    text.p_flags = PF_R | PF_X;
+
+    Elf32_Phdr data{};
+    data.p_type = PT_LOAD;
+    data.p_vaddr = 0x4000;
+    data.p_filesz = code_offset;
+    data.p_memsz = 0x200;
+    data.p_flags = PF_R | PF_W;
+
+    std::memcpy(file.data(), &eh, sizeof(eh));
+    std::memcpy(file.data() + sizeof(eh), &text, sizeof(text));
+    std::memcpy(file.data() + sizeof(eh) + sizeof(text), &data, sizeof(data));
+    std::memcpy(file.data() + code_offset, code, sizeof(code));
+    return file;
+}
+
+}
+
+void test_load_flat_binary_mapped() {
+    std::vector<std::uint8_t> image(3 * 4096 + 10);
+    for (std::size_t i = 0; i < image.size(); ++i) {
+        image[i] = std::uint8_t(i * 13);
+    }
+    const auto path = temp_image(image);
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    const auto size = load_flat_binary(exe, path, 0x4000);
+    bool t = size == image.size() && exe.pcnt() == 0x4000;
+    for (std::size_t i = 0; i < image.size(); ++i) {
+        t = t && exe.cpu.mem[address_t(0x4000 + i)] == image[i];
+    }
+    // Stores land in private copies and never reach the file.
+    exe.cpu.mem[0x4001] = 0xFF;
+    t = t && exe.cpu.mem[0x4001] == 0xFF && read_back(path) == image
+        && exe.cpu.mem[address_t(0x4000 + image.size())] == 0;
+    unlink(path.c_str());
+    assert(t);
+}
+
+void test_load_flat_binary_runs() {
+    const auto path = temp_image({0x40, 0x40}); // inc eax; inc eax
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    load_flat_binary(exe, path, 0x1000);
+    exe.execute(false, true, 2);
+    unlink(path.c_str());
+    const bool t = exe.cpu.R[EAX] == 2 && exe.pcnt() == 0x1002;
+    assert(t);
+}
+
+void test_load_flat_binary_flat_segments() {
+    // mov ax, 0x7B; mov ds, ax; mov [0x2000], al
+    const auto path = temp_image({0x66, 0xB8, 0x7B, 0x00, 0x8E, 0xD8, 0x88, 0x05, 0x00, 0x20, 0x00, 0x00});
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    load_flat_binary(exe, path, 0x1000);
+    while (exe.pcnt() < 0x100C) {
+        exe.run_single_cycle();
+    }
+    unlink(path.c_str());
+    const bool t1 = exe.cpu.ds == 0x7B && exe.cpu.mmu.segment(Segment::DS).base == 0
+        && exe.cpu.mem[0x2000] == 0x7B && exe.cpu.mem[0x27B0] == 0;
+    // A guest that clears PE gets real mode segments back.
+    exe.cpu.mmu.write_cr0(0);
+    exe.cpu.mmu.load_segment(Segment::DS, 0x7B);
+    const bool t = t1 && exe.cpu.mmu.segment(Segment::DS).base == 0x7B0;
+    assert(t);
+}
+
+void test_load_flat_binary_unaligned() {
+    const auto path = temp_image({0xDE, 0xAD, 0xBE, 0xEF});
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    load_flat_binary(exe, path, 0x1003);
+    unlink(path.c_str());
+    const bool t = mread<std::uint32_t>(&exe.cpu.mem[0x1003]) == 0xEFBEADDE && exe.pcnt() == 0x1003;
+    assert(t);
+}
+
+void test_load_flat_binary_errors() {
+    const auto path = temp_image(std::vector<std::uint8_t>(8_kb));
+    Executor exe(std::span<const std::uint8_t>{}, 8_kb, 8_kb);
+    bool t1 = false;
+    try {
+        load_flat_binary(exe, path, 0x1000);
+    } catch (const std::domain_error&) {
+        t1 = true;
+    }
+    unlink(path.c_str());
+    bool t2 = false;
+    try {
+        load_flat_binary(exe, path, 0);
+    } catch (const std::system_error&) {
+        t2 = true;
+    }
+    const bool t = t1 && t2 && flat_binary_memory_size(8_kb, 0) == 1_mb
+        && flat_binary_memory_size(2_mb, 0x1000) == 2_mb + 0x1000 + 64_kb;
+    assert(t);
+}
+
+void test_load_hex_program() {
+    char path[] = "/tmp/pix86_hexXXXXXX";
+    const int fd = mkstemp(path);
+    const std::string text = "0x40 ; inc eax\n0x40 ; inc eax\n";
+    [[maybe_unused]] const auto n = write(fd, text.data(), text.size());
+    close(fd);
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    const auto size = load_hex_program(exe, path, 0x200);
+    unlink(path);
+    exe.execute(false, true, 2);
+    const bool t = size == 2 && exe.cpu.mem[0x200] == 0x40 && exe.cpu.R[EAX] == 2 && exe.pcnt() == 0x202;
+    assert(t);
+}
+
+void test_read_elf32() {
+    const auto path = temp_image(tiny_elf());
+    const auto image = read_elf32(path);
+    const bool t = image.entry == 0x1074 && image.phdr == 0x1034 && image.phnum == 2
+        && image.segments.size() == 2 && image.segments[1].perms == (Memory::PAGE_READ | Memory::PAGE_WRITE)
+        && image.end() == 0x5000 && elf32_memory_size(image, 64_kb) == 0x5000 + 64_kb;
+    unlink(path.c_str());
+    assert(t);
+}
+
+void test_read_elf32_rejects() {
+    auto bytes = tiny_elf();
+    bytes[EI_CLASS] = ELFCLASS64;
+    const auto path = temp_image(bytes);
+    const auto not_elf = temp_image({0x7F, 'E', 'L', 'G'});
+    bool t1 = false, t2 = false;
+    try {
+        read_elf32(path);
+    } catch (const std::domain_error&) {
+        t1 = true;
+    }
+    try {
+        read_elf32(not_elf);
+    } catch (const std::domain_error&) {
+        t2 = true;
+    }
+    unlink(path.c_str());
+    unlink(not_elf.c_str());
+    const bool t = t1 && t2;
+    assert(t);
+}
+
+void test_load_elf32() {
+    const auto path = temp_image(tiny_elf());
+    Executor exe(std::span<const std::uint8_t>{}, 64_kb, 64_kb);
+    load_elf32(exe, read_elf32(path), {"prog", "-v"}, {"HOME=/"});
+    unlink(path.c_str());
+
+    auto& mem = exe.cpu.mem;
+    const bool t1 = exe.pcnt() == 0x1074 && mem[0x4001] == 'E' && mem[0x4054] == PT_LOAD && mem[0x4074] == 0
+        && mem.page_flags(0x1000) == (Memory::PAGE_READ | Memory::PAGE_EXEC)
+        && mem.page_flags(0x4000) == (Memory::PAGE_READ | Memory::PAGE_WRITE);
+
+    const address_t sp = exe.cpu.R[ESP];
+    const auto word = [&](std::size_t i) {return mread<std::uint32_t>(&mem[address_t(sp + 4 * i)]);};
+    const auto str = [&](std::uint32_t at) {return std::string(reinterpret_cast<const char*>(&mem[at]));};
+    const bool t2 = sp % 16 == 0 && word(0) == 2 && str(word(1)) == "prog" && str(word(2)) == "-v"
+        && word(3) == 0 && str(word(4)) == "HOME=/" && word(5) == 0
+        && word(6) == AT_PHDR && word(7) == 0x1034;
+
+    exe.execute(false, true, 2);
+    bool t3 = false;
+    try {
+        exe.cpu.mmu.translate_linear(0x1000, MMU::WRITE);
+    } catch (const PAGE_FAULT& pf) {
+        t3 = pf.address == 0x1000;
+    }
+    // __USER_DS, as a Linux program would load it.
+    exe.cpu.load_segment(Segment::DS, 0x7B);
+    const bool t = t1 && t2 && t3 && exe.cpu.R[EAX] == 2 && exe.cpu.mmu.segment(Segment::DS).base == 0;
+    assert(t);
+}
+
+void test_loader() {
+    test_load_flat_binary_mapped();
+    test_load_flat_binary_runs();
+    test_load_flat_binary_flat_segments();
+    test_load_flat_binary_unaligned();
+    test_load_flat_binary_errors();
+    test_load_hex_program();
+    test_read_elf32();
+    test_read_elf32_rejects();
+    test_load_elf32();
+
+    std::cout << "All loader tests passed!" << std::endl;
+}
@@ -0,0 +1,174 @@
+#include "executor.hh"
+#include "loop_idiom.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+void append_mov_imm32(std::vector<std::uint8_t>& code, const std::uint8_t reg, const std::uint32_t imm) {
+    code.push_back(std::uint8_t(0xB8 + reg));
+    for (unsigned int i = 0; i < 4; ++i) {
+        code.push_back(std::uint8_t(imm >> (8 * i)));
+    }
+}
+
+// mov eax, ecx, esi and edi into place, run body and halt.
+std::vector<std::uint8_t> program(const std::uint32_t eax, const std::uint32_t ecx, const std::uint32_t esi,
+                                  const std::uint32_t edi, std::initializer_list<std::uint8_t> body) {
+    std::vector<std::uint8_t> code;
+    append_mov_imm32(code, EAX, eax);
+    append_mov_imm32(code, ECX, ecx);
+    append_mov_imm32(code, ESI, esi);
+    append_mov_imm32(code, EDI, edi);
+    code.insert(code.end(), body);
+    code.push_back(0xF4);
+    return code;
+}
+
+// Run to the first hlt, leaving pc on it.
+void run(Executor& exe, const bool step) {
+    if (step) {
+        // A budget of one never covers a bulk loop, so this interprets.
+        while (exe.cpu.mem[address_t(exe.pcnt())] != 0xF4) {
+            exe.run_single_cycle();
+        }
+        return;
+    }
+    try {
+        exe.execute(false, false);
+    } catch (CPU_HALT&) {
+    }
+}
+
+void init(Executor& exe) {
+    for (address_t i = 0; i < 0x1000; ++i) {
+        exe.cpu.mem[0x1000 + i] = std::uint8_t(i * 7 + 3);
+    }
+}
+
+// Run code in bulk and one instruction at a time and compare the results.
+bool matches_interpreter(const std::vector<std::uint8_t>& code, const bool carry = false) {
+    Executor bulk(code, 64_kb, 64_kb);
+    Executor stepped(code, 64_kb, 64_kb);
+    init(bulk);
+    init(stepped);
+    bulk.cpu.flags.carry = carry;
+    stepped.cpu.flags.carry = carry;
+    run(bulk, false);
+    run(stepped, true);
+    const auto& a = bulk.cpu.flags;
+    const auto& b = stepped.cpu.flags;
+    return std::equal(std::begin(bulk.cpu.R), std::end(bulk.cpu.R), std::begin(stepped.cpu.R))
+        && a.get_flags8() == b.get_flags8() && a.overflow == b.overflow
+        && bulk.pcnt() == stepped.pcnt()
+        && std::equal(bulk.cpu.mem.begin(), bulk.cpu.mem.end(), stepped.cpu.mem.begin());
+}
+
+}
+
+void test_match_loop_idiom() {
+    const std::uint8_t fill8[] = {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA};
+    const std::uint8_t fill8_esi[] = {0x88, 0x06, 0x46, 0x49, 0x75, 0xFA};
+    const std::uint8_t sum8[] = {0x02, 0x06, 0x46, 0x49, 0x75, 0xFA};
+    const auto m = match_loop_idiom(fill8);
+    const auto s = match_loop_idiom(sum8);
+    const bool t = m && m->idiom == LoopIdiom::FILL8 && m->instructions == 4
+        && s && s->idiom == LoopIdiom::SUM8
+        && !match_loop_idiom(fill8_esi)
+        && !match_loop_idiom(std::span(fill8).first(5));
+    assert(t);
+}
+
+void test_loop_idiom_spin() {
+    // Interpreting 2^31 trips would take minutes.
+    const auto code = program(0, 0x80000000, 0, 0, {0x49, 0x75, 0xFD});
+    Executor exe(code, 64_kb, 64_kb);
+    run(exe, false);
+    const bool t = exe.cpu.R[ECX] == 0 && exe.cpu.flags.zero && exe.pcnt() == code.size() - 1
+        && matches_interpreter(program(0, 300, 0, 0, {0x49, 0x75, 0xFD}));
+    assert(t);
+}
+
+void test_loop_idiom_fill8() {
+    const bool t = matches_interpreter(program(0xAB, 0x300, 0, 0x1100, {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA}), true)
+        && matches_interpreter(program(0x7F, 1, 0, 0x1000, {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA}));
+    assert(t);
+}
+
+void test_loop_idiom_fill32() {
+    const bool t = matches_interpreter(program(0xDEADBEEF, 0x100, 0, 0x1004,
+                                               {0x89, 0x07, 0x81, 0xC7, 0x04, 0x00, 0x00, 0x00, 0x49, 0x75, 0xF5}));
+    assert(t);
+}
+
+void test_loop_idiom_copy8() {
+    const std::initializer_list<std::uint8_t> copy8 = {0x8A, 0x06, 0x88, 0x07, 0x46, 0x47, 0x49, 0x75, 0xF7};
+    // Disjoint, overlapping backwards and overlapping forwards, where the
+    // byte loop smears the source and has to be interpreted.
+    const bool t = matches_interpreter(program(0, 0x200, 0x1000, 0x1800, copy8))
+        && matches_interpreter(program(0, 0x200, 0x1010, 0x1000, copy8))
+        && matches_interpreter(program(0, 0x200, 0x1000, 0x1003, copy8));
+    assert(t);
+}
+
+void test_loop_idiom_sum8() {
+    const bool t = matches_interpreter(program(0x11, 0x400, 0x1000, 0, {0x02, 0x06, 0x46, 0x49, 0x75, 0xFA}))
+        && matches_interpreter(program(0x11, 0x400, 0x1000, 0, {0x02, 0x06, 0x46, 0x49, 0x75, 0xFA}), true);
+    assert(t);
+}
+
+void test_loop_idiom_out_of_bounds() {
+    // The fill runs off the end of memory, so the interpreter takes over and
+    // faults on the first store past it.
+    const auto code = program(0, 0x100, 0, 64_kb - 0x10, {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA});
+    Executor exe(code, 64_kb, 64_kb);
+    bool faulted = false;
+    try {
+        run(exe, false);
+    } catch (MEMORY_FAULT&) {
+        faulted = true;
+    }
+    const bool t = faulted && exe.cpu.R[EDI] == 64_kb && exe.cpu.mem[64_kb - 1] == 0;
+    assert(t);
+}
+
+void test_loop_idiom_code_overlap() {
+    // The fill starts just below the loop head, so the bulk path stays out
+    // and the interpreter stores a hlt over the loop's own mov.
+    const auto code = program(0xF4, 0x10, 0, 0x10, {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA});
+    Executor exe(code, 64_kb, 64_kb);
+    run(exe, false);
+    const bool t = exe.cpu.R[ECX] == 0xB && exe.pcnt() == 0x14 && matches_interpreter(code);
+    assert(t);
+}
+
+void test_loop_idiom_cycles() {
+    const auto code = program(0xAB, 0x100, 0, 0x1000, {0x88, 0x07, 0x47, 0x49, 0x75, 0xFA});
+    Executor exe(code, 64_kb, 64_kb);
+    // The four movs, one trip and a further four instructions of the next.
+    exe.execute(false, true, 4 + 4 + 4);
+    const bool t1 = exe.cpu.R[ECX] == 0xFE && exe.cpu.R[EDI] == 0x1002;
+    // Exactly enough for the rest, which then retires as a single bulk fill.
+    exe.execute(false, true, 4 * 0xFE);
+    const bool t = t1 && exe.cpu.R[ECX] == 0 && exe.cpu.R[EDI] == 0x1100 && exe.pcnt() == code.size() - 1
+        && exe.cpu.mem[0x10FF] == 0xAB && exe.cpu.mem[0x1100] != 0xAB;
+    assert(t);
+}
+
+void test_loop_idiom() {
+    test_match_loop_idiom();
+    test_loop_idiom_spin();
+    test_loop_idiom_fill8();
+    test_loop_idiom_fill32();
+    test_loop_idiom_copy8();
+    test_loop_idiom_sum8();
+    test_loop_idiom_out_of_bounds();
+    test_loop_idiom_code_overlap();
+    test_loop_idiom_cycles();
+
+    std::cout << "All loop idiom tests passed!" << std::endl;
+}
@@ -1,6 +1,7 @@
 #include "memory.hh"
 
 #include <cassert>
+#include <system_error>
 
 void test_memory_bool_operator() {
     bool t = !bool(Memory()) && bool(Memory(1));
@@ -67,7 +68,119 @@ void test_memory_begin() {
 
 void test_memory_end() {
     auto m = Memory(8);
-    const bool t = m.end() == &m[m.size()];
+    const bool t = m.end() == m.data() + m.size();
+    assert(t);
+}
+
+void test_memory_checked_access() {
+    auto m = BasicMemory<CheckedAccess>(8);
+    bool t = m.ptr(4, 4) == m.data() + 4;
+    bool t2 = false;
+    try {
+        [[maybe_unused]] auto* _ = m.ptr(5, 4);
+    } catch (const MEMORY_FAULT& mf) {
+        t2 = mf.address == 5;
+    }
+    bool t3 = false;
+    try {
+        [[maybe_unused]] auto _ = m[8];
+    } catch (const MEMORY_FAULT& mf) {
+        t3 = mf.address == 8;
+    }
+    t = t && t2 && t3;
+    assert(t);
+}
+
+void test_memory_wrap_access() {
+    auto m = BasicMemory<WrapAccess>(8);
+    const std::size_t wide = (std::size_t(1) << 32) + 4;
+    const bool t = m.ptr(wide) == m.data() + 4;
+    assert(t);
+}
+
+void test_memory_unchecked_access() {
+    auto m = BasicMemory<UncheckedAccess>(8);
+    const bool t = m.ptr(4, 4) == m.data() + 4
+        && &m[7] == m.data() + 7;
+    assert(t);
+}
+
+void test_memory_copy() {
+    auto m = Memory(8);
+    m[3] = 0x42;
+    m.set_page_flags(0, Memory::PAGE_WATCHED);
+    const Memory copy(m);
+    const bool t = copy.data() != m.data() && copy.size() == 8 && copy[3] == 0x42
+        && copy.page_flags(0) == (Memory::PAGE_RWX | Memory::PAGE_WATCHED);
+    assert(t);
+}
+
+void test_memory_move() {
+    auto m = Memory(8);
+    m[3] = 0x42;
+    const auto* buffer = m.data();
+    Memory moved(std::move(m));
+    const bool t1 = moved.data() == buffer && moved.size() == 8 && moved[3] == 0x42 && !m;
+
+    auto other = Memory(16);
+    other = std::move(moved);
+    const bool t = t1 && other.data() == buffer && other.size() == 8 && other[3] == 0x42;
+    assert(t);
+}
+
+void test_memory_zero_dirty_pages() {
+    auto m = Memory(5 * guest_page_size);
+    m[0x10] = 1;
+    m[3 * guest_page_size + 7] = 2;
+    m.set_page_flags(0x10, Memory::PAGE_WATCHED);
+    const auto* buffer = m.data();
+    m.zero_dirty_pages();
+    // The pages are released, not kept resident by a memset.
+    bool t = m.data() == buffer && m.page_flags(0x10) == Memory::PAGE_RWX && m.touched_pages().empty();
+    for (const auto b : m) {
+        t = t && b == 0;
+    }
+    assert(t);
+}
+
+void test_memory_touched_pages() {
+    const std::size_t page = Memory::page_size();
+    auto m = Memory(4 * page);
+    m[address_t(2 * page + 1)] = 5;
+    const auto touched = m.touched_pages();
+    const bool t1 = touched.size() == 1 && touched[0] == 2 * page;
+    m.discard_pages(2 * page, page);
+    bool t2 = false;
+    try {
+        m.discard_pages(page + 1, page);
+    } catch (const std::system_error&) {
+        t2 = true;
+    }
+    const bool t = t1 && t2 && m.touched_pages().empty() && m[address_t(2 * page + 1)] == 0;
+    assert(t);
+}
+
+void test_memory_page_perms() {
+    auto m = Memory(4 * guest_page_size);
+    m.set_page_perms(guest_page_size + 8, guest_page_size, Memory::PAGE_READ);
+    const bool t = m.can_execute(0) && !m.can_execute(guest_page_size) && !m.can_execute(2 * guest_page_size + 5)
+        && m.can_execute(3 * guest_page_size) && !m.can_execute(4 * guest_page_size)
+        && m.page_flags(guest_page_size) == Memory::PAGE_READ;
+    assert(t);
+}
+
+void test_memory_write_generations() {
+    auto m = Memory(3 * guest_page_size);
+    m.mark_code(guest_page_size, 1);
+    m.note_write(0x10, 4);
+    const bool t1 = m.page_generation(0) == 0 && m.page_generation(guest_page_size) == 0
+        && (m.page_flags(guest_page_size) & Memory::PAGE_CODE);
+    m.note_write(guest_page_size - 2, 4);
+    m.note_write(2 * guest_page_size + 8, 1);
+    m.note_write(3 * guest_page_size, 1);
+    const bool t2 = t1 && m.page_generation(guest_page_size) == 1 && m.page_generation(2 * guest_page_size) == 0;
+    m.zero_dirty_pages();
+    const bool t = t2 && m.page_generation(guest_page_size) == 2 && !m.any_page_flags(Memory::PAGE_CODE);
     assert(t);
 }
 
@@ -81,6 +194,15 @@ void test_memory() {
     test_memory_data();
     test_memory_begin();
     test_memory_end();
+    test_memory_checked_access();
+    test_memory_wrap_access();
+    test_memory_unchecked_access();
+    test_memory_copy();
+    test_memory_move();
+    test_memory_zero_dirty_pages();
+    test_memory_touched_pages();
+    test_memory_page_perms();
+    test_memory_write_generations();
 
     std::cout << "All memory tests passed!" << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "executor.hh"
+#include "fpu.hh"
+#include "mmx.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+Mmx words(const std::uint16_t a, const std::uint16_t b, const std::uint16_t c, const std::uint16_t d) {
+    Mmx m;
+    m.access<std::uint16_t>(0) = a;
+    m.access<std::uint16_t>(1) = b;
+    m.access<std::uint16_t>(2) = c;
+    m.access<std::uint16_t>(3) = d;
+    return m;
+}
+
+Mmx quad(const std::uint64_t value) {
+    Mmx m;
+    m.access<std::uint64_t>(0) = value;
+    return m;
+}
+
+}
+
+void test_mmx_wrapping() {
+    Mmx a = quad(0xFF7F0102030405FFull);
+    MMX::paddb(a, quad(0x0101010101010101ull));
+    bool t = a == quad(0x0080020304050600ull);
+    MMX::psubb(a, quad(0x0101010101010101ull));
+    t = t && a == quad(0xFF7F0102030405FFull);
+    // Nothing carries between lanes or past the register.
+    Mmx d = quad(0xFFFFFFFFFFFFFFFFull);
+    MMX::paddd(d, quad(0x0000000100000001ull));
+    t = t && d == quad(0);
+    Mmx w = words(0xFFFF, 1, 2, 3);
+    MMX::paddw(w, words(1, 1, 1, 1));
+    t = t && w == words(0, 2, 3, 4);
+    assert(t);
+}
+
+void test_mmx_saturating() {
+    Mmx a = quad(0x7F80FF0001020304ull);
+    MMX::paddsb(a, quad(0x01FF01FF00000000ull));
+    bool t = a == quad(0x7F8000FF01020304ull);
+    Mmx u = quad(0xFFFE000000000000ull);
+    MMX::paddusb(u, quad(0x0505000000000001ull));
+    t = t && u == quad(0xFFFF000000000001ull);
+    Mmx s = words(0x8000, 0x7FFF, 5, 0);
+    MMX::psubsw(s, words(1, 0xFFFF, 6, 0));
+    t = t && s == words(0x8000, 0x7FFF, 0xFFFF, 0);
+    Mmx us = words(3, 10, 0, 0xFFFF);
+    MMX::psubusw(us, words(5, 4, 1, 0xFFFF));
+    t = t && us == words(0, 6, 0, 0);
+    assert(t);
+}
+
+void test_mmx_multiply() {
+    Mmx lo = words(300, 0xFFFF, 0x4000, 2);
+    MMX::pmullw(lo, words(300, 0xFFFF, 4, 0x8000));
+    bool t = lo == words(std::uint16_t(90000), 1, 0, 0);
+    Mmx hi = words(300, 0xFFFF, 0x4000, 2);
+    MMX::pmulhw(hi, words(300, 3, 4, 0x8000));
+    t = t && hi == words(1, 0xFFFF, 1, 0xFFFF);
+    Mmx madd = words(2, 3, 0x8000, 0x8000);
+    MMX::pmaddwd(madd, words(10, 100, 0x8000, 0x8000));
+    t = t && madd.access<std::uint32_t>(0) == 320 && madd.access<std::uint32_t>(1) == 0x80000000u;
+    assert(t);
+}
+
+void test_mmx_pack_unpack() {
+    Mmx p = words(0x0100, 0xFF00, 0x007F, 0xFFFF);
+    MMX::packsswb(p, words(0x8000, 5, 0x0080, 0xFF80));
+    bool t = p == quad(0x807F0580FF7F807Full);
+    Mmx u = words(0x0100, 0xFF00, 0x007F, 0x0080);
+    MMX::packuswb(u, words(0, 0, 0, 0));
+    t = t && u == quad(0x00000000807F00FFull);
+    Mmx d = quad(0x0001000080000000ull);
+    MMX::packssdw(d, quad(0xFFFFFFFF00000003ull));
+    t = t && d == words(0x8000, 0x7FFF, 3, 0xFFFF);
+
+    Mmx l = quad(0x0706050403020100ull);
+    MMX::punpcklbw(l, quad(0x8786858483828180ull));
+    t = t && l == quad(0x8303820281018000ull);
+    Mmx h = quad(0x0706050403020100ull);
+    MMX::punpckhbw(h, quad(0x8786858483828180ull));
+    t = t && h == quad(0x8707860685058404ull);
+    Mmx hw = words(1, 2, 3, 4);
+    MMX::punpckhwd(hw, words(5, 6, 7, 8));
+    t = t && hw == words(3, 7, 4, 8);
+    Mmx hd = quad(0x1111111122222222ull);
+    MMX::punpckhdq(hd, quad(0x3333333344444444ull));
+    t = t && hd == quad(0x3333333311111111ull);
+    assert(t);
+}
+
+void test_mmx_aliasing() {
+    FPU_Registers regs;
+    regs.set_mm(3, quad(0x8000000000000001ull));
+    // The significand comes back as written, and the register reads as a
+    // NaN to x87 code.
+    bool t = regs.mm(3) == quad(0x8000000000000001ull);
+    regs.enter_mmx();
+    t = t && regs.top_ % 8 == 0;
+    regs.push(2.5L);
+    // TOP goes from 0 to 7, so the push lands in physical register 7,
+    // and the x87 stack writes over the same storage.
+    t = t && regs.mm(7) == quad(0xA000000000000000ull) && regs.mm(3) == quad(0x8000000000000001ull);
+    regs.push(1.0L);
+    t = t && regs.mm(6) == quad(0x8000000000000000ull) && regs.value(1) == 2.5L;
+    assert(t);
+}
+
+void test_mmx_then_x87() {
+    const std::vector<std::uint8_t> code = {
+        0x0F, 0x6E, 0xFB,                         // movd mm7, ebx
+        0xD9, 0xE8,                               // fld1, with no emms
+        0x0F, 0x7F, 0x3D, 0x00, 0x10, 0x00, 0x00, // movq [0x1000], mm7
+        0xD9, 0xEE,                               // fldz
+        0x0F, 0x7F, 0x3D, 0x08, 0x10, 0x00, 0x00, // movq [0x1008], mm7
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    exe.cpu.R[EBX] = 0x12345678;
+    while (exe.pcnt() < code.size()) {
+        exe.run_single_cycle();
+    }
+    // Each movq sets TOP back to 0, so both loads land in register 7.
+    const bool t = mread<std::uint64_t>(&exe.cpu.mem[0x1000]) == 0x8000000000000000ull
+        && mread<std::uint64_t>(&exe.cpu.mem[0x1008]) == 0
+        && exe.fpu.V.mm(7) == quad(0) && exe.fpu.V.top_ % 8 == 0;
+    assert(t);
+}
+
+void test_mmx_executor() {
+    const std::vector<std::uint8_t> code = {
+        0x0F, 0x6F, 0x05, 0x00, 0x10, 0x00, 0x00, // movq mm0, [0x1000]
+        0x0F, 0x6E, 0xCB,                         // movd mm1, ebx
+        0x0F, 0x62, 0xC9,                         // punpckldq mm1, mm1
+        0x0F, 0xDD, 0xC1,                         // paddusw mm0, mm1
+        0x0F, 0x7F, 0x05, 0x08, 0x10, 0x00, 0x00, // movq [0x1008], mm0
+        0x0F, 0x7E, 0xC0,                         // movd eax, mm0
+        0x0F, 0x77,                               // emms
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    exe.cpu.R[EBX] = 0x00020001;
+    const std::uint8_t data[] = {0x10, 0x00, 0xFF, 0xFF, 0x30, 0x00, 0x40, 0x00};
+    for (address_t i = 0; i < sizeof(data); ++i) {
+        exe.cpu.mem[0x1000 + i] = data[i];
+    }
+    while (exe.pcnt() < code.size()) {
+        exe.run_single_cycle();
+    }
+    const bool t = exe.cpu.R[EAX] == 0xFFFF0011
+        && mread<std::uint64_t>(&exe.cpu.mem[0x1008]) == 0x00420031FFFF0011ull
+        && exe.fpu.V.mm(0) == quad(0x00420031FFFF0011ull)
+        && exe.last_op == Opcode::EMMS;
+    assert(t);
+}
+
+void test_mmx_after_double_x87() {
+    const std::vector<std::uint8_t> code = {
+        0xD9, 0x2D, 0x00, 0x11, 0x00, 0x00,       // fldcw [0x1100]
+        0xD9, 0xE8,                               // fld1
+        0x0F, 0x7F, 0x3D, 0x08, 0x10, 0x00, 0x00, // movq [0x1008], mm7
+        0x0F, 0x6E, 0xC3,                         // movd mm0, ebx
+        0x0F, 0xFC, 0xC7,                         // paddb mm0, mm7
+        0x0F, 0x7F, 0x05, 0x00, 0x10, 0x00, 0x00, // movq [0x1000], mm0
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    exe.fpu.set_double_mode(true);
+    exe.cpu.R[EBX] = 0x01010101;
+    // 53 bit precision, so fld1 runs in double storage.
+    mwrite<std::uint16_t>(&exe.cpu.mem[0x1100], 0x027F);
+    while (exe.pcnt() < code.size()) {
+        exe.run_single_cycle();
+    }
+    const bool t = mread<std::uint64_t>(&exe.cpu.mem[0x1008]) == 0x8000000000000000ull
+        && mread<std::uint64_t>(&exe.cpu.mem[0x1000]) == 0x8000000001010101ull
+        && exe.fpu.V.mm(7) == quad(0x8000000000000000ull) && !exe.fpu.V.is_double();
+    assert(t);
+}
+
+void test_mmx_compare_shift() {
+    Mmx g = quad(0x7F80000105FF0000ull);
+    MMX::pcmpgtb(g, quad(0x807F0100050000FFull));
+    bool t = g == quad(0xFF0000FF000000FFull);
+    Mmx gd = quad(0xFFFFFFFF00000002ull);
+    MMX::pcmpgtd(gd, quad(0x0000000000000001ull));
+    t = t && gd == quad(0x00000000FFFFFFFFull);
+    Mmx l = words(0x8001, 0x00FF, 1, 0xFFFF);
+    MMX::psllw(l, quad(4));
+    t = t && l == words(0x0010, 0x0FF0, 0x10, 0xFFF0);
+    Mmx r = words(0x8001, 0x00FF, 1, 0xFFFF);
+    MMX::psraw(r, quad(4));
+    t = t && r == words(0xF800, 0x000F, 0, 0xFFFF);
+    // Counts past the lane width clear it, or fill it with the sign.
+    Mmx wide = words(0x8001, 0x7FFF, 1, 0xFFFF);
+    MMX::psraw(wide, quad(0x100000000ull));
+    t = t && wide == words(0xFFFF, 0, 0, 0xFFFF);
+    Mmx gone = quad(0x8000000180000001ull);
+    MMX::psrld(gone, quad(32));
+    t = t && gone == quad(0);
+    Mmx q = quad(0x8000000000000001ull);
+    MMX::psrlq(q, quad(63));
+    t = t && q == quad(1);
+    MMX::psllq(q, quad(63));
+    t = t && q == quad(0x8000000000000000ull);
+    assert(t);
+}
+
+void test_mmx_shift_executor() {
+    const std::vector<std::uint8_t> code = {
+        0x0F, 0x6F, 0x05, 0x00, 0x10, 0x00, 0x00, // movq mm0, [0x1000]
+        0x0F, 0x6F, 0xC8,                         // movq mm1, mm0
+        0x0F, 0x71, 0xE0, 0x04,                   // psraw mm0, 4
+        0x0F, 0x73, 0xD1, 0x08,                   // psrlq mm1, 8
+        0x0F, 0x6E, 0xD3,                         // movd mm2, ebx
+        0x0F, 0xF2, 0xCA,                         // pslld mm1, mm2
+        0x0F, 0x65, 0xC1,                         // pcmpgtw mm0, mm1
+        0x0F, 0x7F, 0x0D, 0x08, 0x10, 0x00, 0x00, // movq [0x1008], mm1
+        0x0F, 0x7F, 0x05, 0x10, 0x10, 0x00, 0x00, // movq [0x1010], mm0
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    exe.cpu.R[EBX] = 4;
+    mwrite<std::uint64_t>(&exe.cpu.mem[0x1000], 0x8000123400FF0010ull);
+    while (exe.pcnt() < code.size()) {
+        exe.run_single_cycle();
+    }
+    // Each dword of the quadword shifted right a byte goes left a nibble,
+    // and the sign-extended words of mm0 compare against it.
+    const bool t = mread<std::uint64_t>(&exe.cpu.mem[0x1008]) == 0x08000120400FF000ull
+        && mread<std::uint64_t>(&exe.cpu.mem[0x1010]) == 0x0000FFFF0000FFFFull;
+    assert(t);
+}
+
+void test_mmx_across_fldcw() {
+    const std::vector<std::uint8_t> code = {
+        0x0F, 0x6E, 0xC3,                         // movd mm0, ebx
+        0xD9, 0x2D, 0x00, 0x11, 0x00, 0x00,       // fldcw [0x1100]
+        0x0F, 0xFC, 0xC0,                         // paddb mm0, mm0
+        0x0F, 0x7F, 0x05, 0x00, 0x10, 0x00, 0x00, // movq [0x1000], mm0
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    exe.fpu.set_double_mode(true);
+    exe.cpu.R[EBX] = 0x01020304;
+    // 53 bit precision, which would put the stack in double storage.
+    mwrite<std::uint16_t>(&exe.cpu.mem[0x1100], 0x027F);
+    while (exe.pcnt() < code.size()) {
+        exe.run_single_cycle();
+    }
+    const bool t = mread<std::uint64_t>(&exe.cpu.mem[0x1000]) == 0x02040608ull
+        && exe.fpu.V.mm(0) == quad(0x02040608ull) && !exe.fpu.V.is_double();
+    assert(t);
+}
+
+void test_mmx() {
+    test_mmx_wrapping();
+    test_mmx_saturating();
+    test_mmx_multiply();
+    test_mmx_pack_unpack();
+    test_mmx_aliasing();
+    test_mmx_executor();
+    test_mmx_compare_shift();
+    test_mmx_shift_executor();
+    test_mmx_then_x87();
+    test_mmx_after_double_x87();
+    test_mmx_across_fldcw();
+
+    std::cout << "All MMX tests passed!" << std::endl;
+}
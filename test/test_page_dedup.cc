@@ -0,0 +1,52 @@
+#include "page_dedup.hh"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+void test_page_dedup_add_remove() {
+    Memory a(64_kb), b(64_kb);
+    PageDeduplicator dedup;
+    dedup.add(a);
+    dedup.add(a);
+    dedup.add(b);
+    const bool t1 = dedup.size() == 2;
+    dedup.remove(a);
+    const bool t = t1 && dedup.size() == 1;
+    assert(t);
+}
+
+void test_page_dedup_scan() {
+    const std::size_t page = Memory::page_size();
+    Memory a(4 * page), b(4 * page);
+    // Page 0 of each holds the same code, page 1 of a differs, page 2 of b
+    // was touched but only ever held zeros.
+    for (std::size_t i = 0; i < page; ++i) {
+        a[address_t(i)] = b[address_t(i)] = std::uint8_t(i * 7);
+    }
+    a[address_t(page)] = 1;
+    b[address_t(2 * page)] = 1;
+    b[address_t(2 * page)] = 0;
+
+    PageDeduplicator dedup;
+    dedup.add(a);
+    dedup.add(b);
+    const auto stats = dedup.scan();
+    const bool t1 = stats.pages_scanned == 4 && stats.zero_pages == 1 && stats.duplicate_pages == 1
+        && stats.bytes_saved() == page
+        && stats.potential_bytes_saved() == (stats.host_merging ? page : 0);
+
+    // Contents are unchanged and released pages take stores again.
+    b[address_t(2 * page + 3)] = 9;
+    const bool t = t1 && a[5] == 35 && b[5] == 35 && a[address_t(page)] == 1
+        && b[address_t(2 * page)] == 0 && b[address_t(2 * page + 3)] == 9;
+    assert(t);
+}
+
+void test_page_dedup() {
+    test_page_dedup_add_remove();
+    test_page_dedup_scan();
+
+    std::cout << "All page dedup tests passed!" << std::endl;
+}
@@ -12,12 +12,25 @@
 
 int main() {
     test_cpu();
+    test_cpuid();
     test_decoder();
     test_executor();
+    test_executor_pool();
     test_flags();
     test_fpu();
     test_generic_reference();
+    test_hex();
+    test_host_cpu();
+    test_hle();
+    test_loader();
+    test_loop_idiom();
     test_memory();
+    test_mmu();
+    test_mmx();
+    test_page_dedup();
+    test_sse();
     test_stack();
+    test_string_kernels();
+    test_syscalls();
     test_util();
 }
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "executor.hh"
+#include "sse.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+Xmm bytes_from(const std::uint8_t first, const std::uint8_t step) {
+    Xmm x;
+    for (std::size_t i = 0; i < Xmm::elements<std::uint8_t>; ++i) {
+        x.access<std::uint8_t>(i) = std::uint8_t(first + step * i);
+    }
+    return x;
+}
+
+Xmm text(const char* s) {
+    Xmm x;
+    std::memcpy(x.bytes(), s, std::min<std::size_t>(std::strlen(s), sizeof(Xmm)));
+    return x;
+}
+
+// Run code one instruction at a time until pc reaches its end.
+void run(Executor& exe, const std::size_t size) {
+    while (exe.pcnt() < size) {
+        exe.run_single_cycle();
+    }
+}
+
+}
+
+void test_sse_integer() {
+    SSE sse;
+    Xmm a = bytes_from(0xF0, 1);
+    const Xmm b = bytes_from(0x20, 3);
+    sse.paddb(a, b);
+    bool t = a.access<std::uint8_t>(0) == 0x10 && a.access<std::uint8_t>(15) == std::uint8_t(0xFF + 0x20 + 45);
+    sse.psubb(a, b);
+    t = t && a == bytes_from(0xF0, 1);
+
+    Xmm q;
+    q.access<std::uint64_t>(0) = ~0ull;
+    q.access<std::uint64_t>(1) = 1;
+    Xmm one;
+    one.access<std::uint64_t>(0) = 1;
+    one.access<std::uint64_t>(1) = 1;
+    sse.paddq(q, one);
+    // No carry between the quadwords.
+    t = t && q.access<std::uint64_t>(0) == 0 && q.access<std::uint64_t>(1) == 2;
+
+    Xmm w = bytes_from(0, 1);
+    sse.pminub(w, bytes_from(15, 0xFF));
+    t = t && w.access<std::uint8_t>(0) == 0 && w.access<std::uint8_t>(7) == 7 && w.access<std::uint8_t>(8) == 7
+        && w.access<std::uint8_t>(15) == 0;
+    assert(t);
+}
+
+void test_sse_compare_and_mask() {
+    SSE sse;
+    Xmm a = bytes_from(0, 1);
+    Xmm b = bytes_from(0, 1);
+    b.access<std::uint8_t>(3) = 0xAA;
+    b.access<std::uint8_t>(12) = 0xAA;
+    sse.pcmpeqb(a, b);
+    bool t = sse.pmovmskb(a) == 0xEFF7;
+    Xmm d;
+    d.access<std::uint32_t>(2) = 7;
+    Xmm zero;
+    sse.pcmpeqd(d, zero);
+    t = t && d.access<std::uint32_t>(0) == ~0u && d.access<std::uint32_t>(2) == 0;
+
+    Xmm x = bytes_from(1, 1);
+    sse.pxor(x, x);
+    t = t && x == Xmm{};
+    assert(t);
+}
+
+void test_sse_unpack_and_shuffle() {
+    SSE sse;
+    Xmm a = bytes_from(0, 1);
+    sse.punpcklbw(a, bytes_from(0x80, 1));
+    bool t = a.access<std::uint8_t>(0) == 0 && a.access<std::uint8_t>(1) == 0x80
+        && a.access<std::uint8_t>(14) == 7 && a.access<std::uint8_t>(15) == 0x87;
+    Xmm q = bytes_from(0, 1);
+    sse.punpcklqdq(q, bytes_from(0x80, 1));
+    t = t && q.access<std::uint64_t>(1) == bytes_from(0x80, 1).access<std::uint64_t>(0);
+
+    Xmm s;
+    sse.pshufd(s, bytes_from(0, 1), 0x1B);
+    t = t && s.access<std::uint32_t>(0) == bytes_from(0, 1).access<std::uint32_t>(3)
+        && s.access<std::uint32_t>(3) == bytes_from(0, 1).access<std::uint32_t>(0);
+    assert(t);
+}
+
+void test_sse_float() {
+    SSE sse;
+    Xmm a;
+    Xmm b;
+    for (std::size_t i = 0; i < Xmm::elements<float>; ++i) {
+        a.access<float>(i) = float(i) + 0.5f;
+        b.access<float>(i) = 2.0f;
+    }
+    sse.addps(a, b);
+    bool t = a.access<float>(0) == 2.5f && a.access<float>(3) == 5.5f;
+    sse.mulps(a, b);
+    t = t && a.access<float>(1) == 7.0f;
+
+    Xmm c;
+    c.access<double>(0) = 0.1;
+    c.access<double>(1) = -3.0;
+    Xmm d;
+    d.access<double>(0) = 0.2;
+    d.access<double>(1) = 1.5;
+    sse.addpd(c, d);
+    t = t && c.access<double>(0) == 0.1 + 0.2 && c.access<double>(1) == -1.5;
+    sse.divpd(c, d);
+    t = t && c.access<double>(1) == -1.0;
+    assert(t);
+}
+
+void test_sse_executor() {
+    const std::vector<std::uint8_t> code = {
+        0x66, 0x0F, 0x6F, 0x05, 0x00, 0x10, 0x00, 0x00, // movdqa xmm0, [0x1000]
+        0xF3, 0x0F, 0x6F, 0x0D, 0x11, 0x10, 0x00, 0x00, // movdqu xmm1, [0x1011]
+        0x66, 0x0F, 0x74, 0xC1,                         // pcmpeqb xmm0, xmm1
+        0x66, 0x0F, 0xD7, 0xC0,                         // pmovmskb eax, xmm0
+        0x66, 0x0F, 0xEF, 0xD2,                         // pxor xmm2, xmm2
+        0x66, 0x0F, 0x7F, 0x15, 0x20, 0x10, 0x00, 0x00, // movdqa [0x1020], xmm2
+        0x0F, 0x1F, 0x44, 0x00, 0x00,                   // nop dword [eax+eax]
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    for (address_t i = 0; i < 0x40; ++i) {
+        exe.cpu.mem[0x1000 + i] = 0xFF;
+    }
+    for (address_t i = 0; i < 0x10; ++i) {
+        exe.cpu.mem[0x1000 + i] = std::uint8_t(i);
+        exe.cpu.mem[0x1011 + i] = std::uint8_t(i & 1 ? i : 0x80);
+    }
+    run(exe, code.size());
+    bool t = exe.cpu.R[EAX] == 0xAAAA && exe.last_op == Opcode::NOP && exe.sse.reg[2] == Xmm{};
+    for (address_t i = 0; i < 0x10; ++i) {
+        t = t && exe.cpu.mem[0x1020 + i] == 0;
+    }
+    assert(t);
+}
+
+void test_sse_misaligned() {
+    // movdqa faults on an address movdqu is happy with.
+    const std::uint8_t code[] = {0x66, 0x0F, 0x6F, 0x05, 0x08, 0x10, 0x00, 0x00};
+    Executor exe(code, 64_kb, 64_kb);
+    exe.cpu.mem[0x1008] = 0x55;
+    bool faulted = false;
+    try {
+        exe.run_single_cycle();
+        exe.run_single_cycle();
+    } catch (GP_FAULT&) {
+        faulted = true;
+    }
+    const bool t = faulted && exe.sse.reg[0] == Xmm{};
+    assert(t);
+}
+
+void test_sse_packed_float_executor() {
+    const std::uint8_t code[] = {
+        0x0F, 0x28, 0xC1, // movaps xmm0, xmm1
+        0x0F, 0x58, 0xC1, // addps xmm0, xmm1
+        0x66, 0x0F, 0x59, 0xD3, // mulpd xmm2, xmm3
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    for (std::size_t i = 0; i < Xmm::elements<float>; ++i) {
+        exe.sse.reg[1].access<float>(i) = float(i);
+    }
+    exe.sse.reg[2].access<double>(0) = 1.5;
+    exe.sse.reg[3].access<double>(0) = 4.0;
+    run(exe, sizeof(code));
+    const bool t = exe.sse.reg[0].access<float>(3) == 6.0f && exe.sse.reg[2].access<double>(0) == 6.0
+        && exe.last_op == Opcode::MULPD;
+    assert(t);
+}
+
+void test_sse_string_compare() {
+    const SSE sse;
+    // strpbrk: equal any, unsigned bytes, implicit lengths.
+    auto m = sse.pcmpistr(text("lo"), text("hello"), 0x00);
+    bool t = m.result == 0x1C && m.carry && m.zero && m.sign && !m.overflow
+        && SSE::string_index(m, 0x00) == 2 && SSE::string_index(m, 0x40) == 4;
+    // Lower case letters, as ranges.
+    m = sse.pcmpistr(text("az"), text("Hi there, World!"), 0x04);
+    t = t && m.result == 0x78FA && !m.zero && m.sign && SSE::string_index(m, 0x44) == 14;
+    // strstr: equal ordered.
+    m = sse.pcmpistr(text("lo"), text("hello"), 0x0C);
+    t = t && m.result == 0x08 && SSE::string_index(m, 0x0C) == 3;
+    // strcmp: equal each, masked negative, finds the first difference.
+    m = sse.pcmpistr(text("hello"), text("help"), 0x38);
+    t = t && m.result == 0xFFE8 && SSE::string_index(m, 0x38) == 3 && m.overflow == false;
+    // Nothing found gives the element count.
+    m = sse.pcmpistr(text("q"), text("hello"), 0x01);
+    t = t && !m.carry && SSE::string_index(m, 0x01) == 8;
+
+    // Signed word ranges with explicit lengths, the negative one taken by
+    // magnitude.
+    Xmm a;
+    a.access<std::uint16_t>(0) = std::uint16_t(-5);
+    a.access<std::uint16_t>(1) = 5;
+    Xmm b;
+    b.access<std::uint16_t>(0) = std::uint16_t(-6);
+    b.access<std::uint16_t>(1) = std::uint16_t(-5);
+    b.access<std::uint16_t>(2) = 0;
+    b.access<std::uint16_t>(3) = 5;
+    b.access<std::uint16_t>(4) = 3;
+    m = sse.pcmpestr(a, 2, b, -4, 0x07);
+    const Xmm mask = SSE::string_mask(m, 0x47);
+    t = t && m.result == 0x0E && m.zero && m.sign
+        && mask.access<std::uint16_t>(0) == 0 && mask.access<std::uint16_t>(3) == 0xFFFF
+        && mask.access<std::uint16_t>(4) == 0 && SSE::string_mask(m, 0x07).access<std::uint64_t>(0) == 0x0E;
+    // Lengths saturate at the element count.
+    t = t && sse.pcmpestr(a, 100, b, 0x7FFFFFFF, 0x07).zero == false;
+    assert(t);
+}
+
+void test_sse_string_compare_tiers() {
+    // The host's instructions and the element loop agree on every control
+    // and on lengths in, at and past every bound.
+    const auto& portable = string_compare_kernels(HostIsa::SCALAR);
+    const auto& host = string_compare_kernels(HostCpu::get().best());
+    std::mt19937 rng(4);
+    const std::int32_t lengths[] = {0, 1, 7, 8, 9, 15, 16, 17, -1, -9, -16, -17, 0x7FFFFFFF, std::int32_t(0x80000000)};
+    bool t = true;
+    for (int round = 0; round < 200; ++round) {
+        Xmm a;
+        Xmm b;
+        for (std::size_t i = 0; i < Xmm::elements<std::uint8_t>; ++i) {
+            // Few values, so that matches and early zeros are common.
+            a.access<std::uint8_t>(i) = std::uint8_t(rng() % 5 == 0 ? 0 : 0x7E + rng() % 4);
+            b.access<std::uint8_t>(i) = std::uint8_t(rng() % 7 == 0 ? 0 : 0x7E + rng() % 4);
+        }
+        for (unsigned int control = 0; control < 0x80; ++control) {
+            const std::int32_t la = lengths[rng() % std::size(lengths)];
+            const std::int32_t lb = lengths[rng() % std::size(lengths)];
+            const auto c = std::uint8_t(control);
+            t = t && host.implicit_length(a, b, c) == portable.implicit_length(a, b, c)
+                && host.explicit_length(a, la, b, lb, c) == portable.explicit_length(a, la, b, lb, c);
+        }
+    }
+    assert(t);
+}
+
+void test_sse_string_compare_executor() {
+    const std::vector<std::uint8_t> code = {
+        0xF3, 0x0F, 0x6F, 0x0D, 0x00, 0x10, 0x00, 0x00,             // movdqu xmm1, [0x1000]
+        0xF3, 0x0F, 0x6F, 0x15, 0x10, 0x10, 0x00, 0x00,             // movdqu xmm2, [0x1010]
+        0x66, 0x0F, 0x3A, 0x63, 0xCA, 0x0C,                         // pcmpistri xmm1, xmm2, 0x0C
+        0x66, 0x0F, 0x3A, 0x60, 0x0D, 0x10, 0x10, 0x00, 0x00, 0x40, // pcmpestrm xmm1, [0x1010], 0x40
+    };
+    Executor exe(code, 64_kb, 64_kb);
+    std::memcpy(&exe.cpu.mem[0x1000], "lo", 2);
+    std::memcpy(&exe.cpu.mem[0x1010], "hello", 5);
+    exe.cpu.R[EAX] = 2;
+    exe.cpu.R[EDX] = 5;
+    exe.cpu.flags.parity = true;
+    run(exe, 22);
+    bool t = exe.cpu.R[ECX] == 3 && exe.cpu.flags.carry && exe.cpu.flags.zero && exe.cpu.flags.sign
+        && !exe.cpu.flags.overflow && !exe.cpu.flags.parity && exe.last_op == Opcode::PCMPISTRI;
+    run(exe, code.size());
+    t = t && exe.sse.reg[0].access<std::uint64_t>(0) == 0x000000FFFFFF0000ull
+        && exe.sse.reg[0].access<std::uint64_t>(1) == 0 && exe.last_op == Opcode::PCMPESTRM;
+    assert(t);
+}
+
+void test_sse() {
+    test_sse_integer();
+    test_sse_compare_and_mask();
+    test_sse_unpack_and_shuffle();
+    test_sse_float();
+    test_sse_executor();
+    test_sse_misaligned();
+    test_sse_packed_float_executor();
+    test_sse_string_compare();
+    test_sse_string_compare_tiers();
+    test_sse_string_compare_executor();
+
+    std::cout << "All SSE tests passed!" << std::endl;
+}
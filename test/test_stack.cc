@@ -7,7 +7,8 @@
 
 void test_stack_pop8() {
     std::uint32_t esp = sizeof(std::uint8_t);
-    Stack stack{sizeof(std::uint8_t) + 1, esp};
+    Memory mem(sizeof(std::uint8_t) + 1);
+    Stack stack{mem, esp};
     stack.push(0xAA_u8);
     const auto v = stack.pop<std::uint8_t>();
     const bool t = v == 0xAA && stack.esp() == sizeof(std::uint8_t);
@@ -16,7 +17,8 @@ void test_stack_pop8() {
 
 void test_stack_pop16() {
     std::uint32_t esp = sizeof(std::uint16_t);
-    Stack stack{sizeof(std::uint16_t) + 1, esp};
+    Memory mem(sizeof(std::uint16_t) + 1);
+    Stack stack{mem, esp};
     stack.push(0xAABB_u16);
     const auto v = stack.pop<u16>();
     const bool t = v == 0xAABB && stack.esp() == sizeof(std::uint16_t);
@@ -25,7 +27,8 @@ void test_stack_pop16() {
 
 void test_stack_pop32() {
     std::uint32_t esp = sizeof(std::uint32_t);
-    Stack stack{sizeof(std::uint32_t) + 1, esp};
+    Memory mem(sizeof(std::uint32_t) + 1);
+    Stack stack{mem, esp};
     stack.push(0xAABBCCDD_u32);
     const auto v = stack.pop<std::uint32_t>();
     const bool t = v == 0xAABBCCDD && stack.esp() == sizeof(std::uint32_t);
@@ -34,7 +37,8 @@ void test_stack_pop32() {
 
 void test_stack_push8() {
     std::uint32_t esp = 0xFFFF;
-    Stack stack{0x10000, esp};
+    Memory mem(0x10000);
+    Stack stack{mem, esp};
     stack.push(0xDE_u8);
     const bool t = *stack.mem_access(0xFFFE) == 0xDE && stack.esp() == 0xFFFE;
     assert(t);
@@ -42,7 +46,8 @@ void test_stack_push8() {
 
 void test_stack_push16() {
     std::uint32_t esp = 0xFFFF;
-    Stack stack{0x10000, esp};
+    Memory mem(0x10000);
+    Stack stack{mem, esp};
     stack.push(0xDEAD_u16);
     const std::uint8_t expected[] = {0xAD, 0xDE};
     const bool t = std::equal(stack.mem_access(0xFFFD), stack.mem_access(0xFFFF), &expected[0])
@@ -52,7 +57,8 @@ void test_stack_push16() {
 
 void test_stack_push32() {
     std::uint32_t esp = 0xFFFF;
-    Stack stack{0x10000, esp};
+    Memory mem(0x10000);
+    Stack stack{mem, esp};
     stack.push(0xDEADBEEF_u32);
     const std::uint8_t expected[] = {0xEF, 0xBE, 0xAD, 0xDE};
     const bool t = std::equal(stack.mem_access(0xFFFB), stack.mem_access(0xFFFF), &expected[0])
@@ -60,6 +66,52 @@ void test_stack_push32() {
     assert(t);
 }
 
+void test_stack_shares_memory() {
+    std::uint32_t esp = 0x100;
+    Memory mem(0x100);
+    Stack stack{mem, esp};
+    stack.push(0xDEADBEEF_u32);
+    mem[0xFC] = 0xAA;
+    const bool t = mread<std::uint32_t>(&mem[0xFC]) == 0xDEADBEAA
+        && stack.pop<std::uint32_t>() == 0xDEADBEAA;
+    assert(t);
+}
+
+void test_stack_push_bumps_code_generation() {
+    std::uint32_t esp = 0x2002;
+    Memory mem(0x3000);
+    Stack stack{mem, esp};
+    mem.mark_code(0x1000, 1);
+    stack.push(0xAA_u8);
+    const bool t1 = mem.page_generation(0x1000) == 0 && mem.page_generation(0x2000) == 0;
+    // A 32 bit push from 0x2001 straddles back into the code page.
+    stack.push(0xDEADBEEF_u32);
+    const bool t = t1 && mem.page_generation(0x1000) == 1 && mem.page_generation(0x2000) == 0;
+    assert(t);
+}
+
+void test_stack_fault_keeps_esp() {
+    std::uint32_t esp = 0x102;
+    Memory mem(0x100);
+    Stack stack{mem, esp};
+    bool t1 = false;
+    try {
+        stack.pop<std::uint32_t>();
+    } catch (const MEMORY_FAULT&) {
+        t1 = esp == 0x102;
+    }
+    // Wraps below address 0, so the checked pointer throws.
+    esp = 2;
+    bool t2 = false;
+    try {
+        stack.push(0xDEADBEEF_u32);
+    } catch (const MEMORY_FAULT&) {
+        t2 = esp == 2;
+    }
+    const bool t = t1 && t2;
+    assert(t);
+}
+
 void test_stack() {
     test_stack_pop8();
     test_stack_pop16();
@@ -67,6 +119,9 @@ void test_stack() {
     test_stack_push8();
     test_stack_push16();
     test_stack_push32();
+    test_stack_shares_memory();
+    test_stack_push_bumps_code_generation();
+    test_stack_fault_keeps_esp();
 
     std::cout << "All stack tests passed!" << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "host_cpu.hh"
+#include "string_kernels.hh"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Byte at a time versions of the kernels.
+std::size_t reference_find(const std::uint8_t* p, const std::size_t n, const std::uint8_t value, const bool equal) {
+    std::size_t i = 0;
+    while (i < n && (p[i] == value) != equal) {
+        ++i;
+    }
+    return i;
+}
+
+std::size_t reference_pair(const std::uint8_t* a, const std::uint8_t* b, const std::size_t n, const bool equal) {
+    std::size_t i = 0;
+    while (i < n && (a[i] == b[i]) != equal) {
+        ++i;
+    }
+    return i;
+}
+
+}
+
+void test_find_byte() {
+    std::mt19937 rng(1);
+    std::vector<std::uint8_t> buf(256);
+    bool t = find_byte(buf.data(), 0, 0) == 0;
+    for (int round = 0; round < 2000; ++round) {
+        // Few distinct values so hits land at every offset, including in
+        // the scalar tail and at each lane of a vector.
+        for (auto& b : buf) {
+            b = std::uint8_t(rng() % 8);
+        }
+        const std::size_t start = rng() % 32;
+        const std::size_t n = rng() % (buf.size() - start);
+        const auto value = std::uint8_t(rng() % 9);
+        t = t && find_byte(&buf[start], n, value) == reference_find(&buf[start], n, value, true)
+            && find_other_byte(&buf[start], n, value) == reference_find(&buf[start], n, value, false);
+    }
+    assert(t);
+}
+
+void test_find_other_byte_long_run() {
+    std::vector<std::uint8_t> buf(4096, 0xCC);
+    bool t = find_other_byte(buf.data(), buf.size(), 0xCC) == buf.size();
+    for (const std::size_t at : {std::size_t(0), std::size_t(15), std::size_t(16), std::size_t(4000), std::size_t(4095)}) {
+        buf[at] = 0;
+        t = t && find_other_byte(buf.data(), buf.size(), 0xCC) == at
+            // Nothing past n is looked at.
+            && find_other_byte(buf.data(), at, 0xCC) == at;
+        buf[at] = 0xCC;
+    }
+    assert(t);
+}
+
+void test_find_mismatch_and_match() {
+    std::mt19937 rng(2);
+    std::vector<std::uint8_t> a(300);
+    std::vector<std::uint8_t> b(300);
+    bool t = find_mismatch(a.data(), b.data(), 0) == 0 && find_match(a.data(), b.data(), 0) == 0;
+    for (int round = 0; round < 2000; ++round) {
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            a[i] = std::uint8_t(rng() % 4);
+            // Mostly equal, to leave long runs for the mismatch search.
+            b[i] = rng() % 16 ? a[i] : std::uint8_t(rng() % 4);
+        }
+        const std::size_t start_a = rng() % 32;
+        const std::size_t start_b = rng() % 32;
+        const std::size_t n = rng() % (a.size() - 32);
+        t = t && find_mismatch(&a[start_a], &a[start_a], n) == n
+            && find_mismatch(&a[start_a], &b[start_a], n) == reference_pair(&a[start_a], &b[start_a], n, false)
+            && find_match(&a[start_a], &b[start_b], n) == reference_pair(&a[start_a], &b[start_b], n, true);
+    }
+    assert(t);
+}
+
+void test_string_kernel_tiers() {
+    std::mt19937 rng(3);
+    std::vector<std::uint8_t> a(200);
+    std::vector<std::uint8_t> b(200);
+    bool t = true;
+    // Every tier this host can run agrees with the byte loops, whichever one
+    // the free functions were bound to.
+    for (const HostIsa isa : {HostIsa::SCALAR, HostIsa::SSE2, HostIsa::SSE4_2, HostIsa::AVX2}) {
+        if (!HostCpu::get().supports(isa)) {
+            continue;
+        }
+        const StringKernels& kernels = string_kernels(isa);
+        for (int round = 0; round < 500; ++round) {
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                a[i] = std::uint8_t(rng() % 2);
+                b[i] = rng() % 64 ? a[i] : std::uint8_t(2);
+            }
+            const std::size_t start = rng() % 40;
+            const std::size_t n = rng() % (a.size() - start);
+            t = t && kernels.find_other_byte(&a[start], n, 0) == reference_find(&a[start], n, 0, false)
+                && kernels.find_mismatch(&a[start], &b[start], n) == reference_pair(&a[start], &b[start], n, false)
+                && kernels.find_match(&a[start], &b[0], n) == reference_pair(&a[start], &b[0], n, true);
+        }
+    }
+    assert(t);
+}
+
+void test_string_kernels() {
+    test_find_byte();
+    test_find_other_byte_long_run();
+    test_find_mismatch_and_match();
+    test_string_kernel_tiers();
+
+    std::cout << "All string kernel tests passed!" << std::endl;
+}
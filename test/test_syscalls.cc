@@ -0,0 +1,160 @@
+#include "syscalls.hh"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+Executor make_executor() {
+    return Executor(std::span<const std::uint8_t>{}, 64_kb, 16_kb);
+}
+
+std::uint32_t syscall(LinuxSyscalls& sys, Executor& exe, std::uint32_t nr, std::uint32_t ebx = 0,
+                      std::uint32_t ecx = 0, std::uint32_t edx = 0) {
+    exe.cpu.R[EAX] = nr;
+    exe.cpu.R[EBX] = ebx;
+    exe.cpu.R[ECX] = ecx;
+    exe.cpu.R[EDX] = edx;
+    sys.handle(exe);
+    return exe.cpu.R[EAX];
+}
+
+}
+
+void test_syscall_int80_exit_reason() {
+    const std::uint8_t code[] = {0xCD, 0x80, 0x40}; // int 0x80; inc eax
+    Executor exe(code);
+    const auto reason = exe.execute(false, true, 2);
+    const bool t1 = reason == ExitReason::SYSCALL && exe.pcnt() == 2;
+    exe.execute(false, true, 1);
+    bool t2 = false;
+    const std::uint8_t bad[] = {0xCD, 0x21};
+    Executor exe2(bad);
+    try {
+        exe2.execute(false, true, 1);
+    } catch (const std::logic_error&) {
+        t2 = true;
+    }
+    const bool t = t1 && t2 && exe.cpu.R[EAX] == 1;
+    assert(t);
+}
+
+void test_syscall_read_write() {
+    int fds[2];
+    [[maybe_unused]] const int rc = pipe(fds);
+    auto exe = make_executor();
+    LinuxSyscalls sys(0x8000, 0xC000);
+    std::memcpy(&exe.cpu.mem[0x100], "hello", 5);
+    const bool t1 = syscall(sys, exe, LinuxSyscalls::SYS_WRITE, std::uint32_t(fds[1]), 0x100, 5) == 5;
+    const bool t2 = syscall(sys, exe, LinuxSyscalls::SYS_READ, std::uint32_t(fds[0]), 0x200, 16) == 5
+        && std::memcmp(&exe.cpu.mem[0x200], "hello", 5) == 0;
+    const bool t3 = syscall(sys, exe, LinuxSyscalls::SYS_WRITE, 12345, 0x100, 5) == std::uint32_t(-EBADF);
+    close(fds[0]);
+    close(fds[1]);
+    const bool t = t1 && t2 && t3;
+    assert(t);
+}
+
+void test_syscall_read_into_watched_page() {
+    int fds[2];
+    [[maybe_unused]] const int rc = pipe(fds);
+    [[maybe_unused]] const auto n = write(fds[1], "ab", 2);
+    auto exe = make_executor();
+    LinuxSyscalls sys(0x8000, 0xC000);
+    exe.cpu.mmu.add_watchpoint(0x301, 1);
+    syscall(sys, exe, LinuxSyscalls::SYS_READ, std::uint32_t(fds[0]), 0x300, 2);
+    close(fds[0]);
+    close(fds[1]);
+    const bool t = exe.cpu.mmu.watch_hit.has_value() && exe.cpu.mem[0x301] == 'b';
+    assert(t);
+}
+
+void test_syscall_open_fstat_close() {
+    char path[] = "/tmp/pix86_sysXXXXXX";
+    const int host_fd = mkstemp(path);
+    [[maybe_unused]] const auto n = write(host_fd, "12345678", 8);
+    close(host_fd);
+
+    auto exe = make_executor();
+    LinuxSyscalls sys(0x8000, 0xC000);
+    std::strcpy(reinterpret_cast<char*>(&exe.cpu.mem[0x100]), path);
+    const auto fd = syscall(sys, exe, LinuxSyscalls::SYS_OPEN, 0x100, O_RDONLY);
+    const bool t1 = std::int32_t(fd) > 2;
+    const bool t2 = syscall(sys, exe, LinuxSyscalls::SYS_FSTAT64, fd, 0x400) == 0
+        && mread<std::uint64_t>(&exe.cpu.mem[0x400 + 44]) == 8;
+    const bool t3 = syscall(sys, exe, LinuxSyscalls::SYS_FSTAT, fd, 0x500) == 0
+        && mread<std::uint32_t>(&exe.cpu.mem[0x500 + 20]) == 8;
+    const bool t4 = syscall(sys, exe, LinuxSyscalls::SYS_CLOSE, fd) == 0
+        && syscall(sys, exe, LinuxSyscalls::SYS_CLOSE, fd) == std::uint32_t(-EBADF);
+    // i386 O_DIRECTORY, whichever host bit that is here.
+    const bool t5 = syscall(sys, exe, LinuxSyscalls::SYS_OPEN, 0x100, 00200000) == std::uint32_t(-ENOTDIR);
+    unlink(path);
+    const bool t6 = syscall(sys, exe, LinuxSyscalls::SYS_OPEN, 0x100, O_RDONLY) == std::uint32_t(-ENOENT);
+    const bool t = t1 && t2 && t3 && t4 && t5 && t6;
+    assert(t);
+}
+
+void test_syscall_brk() {
+    auto exe = make_executor();
+    LinuxSyscalls sys(0x8000, 0xC000);
+    const bool t1 = syscall(sys, exe, LinuxSyscalls::SYS_BRK, 0) == 0x8000;
+    const bool t2 = syscall(sys, exe, LinuxSyscalls::SYS_BRK, 0x9000) == 0x9000;
+    exe.cpu.mem[0x8800] = 7;
+    syscall(sys, exe, LinuxSyscalls::SYS_BRK, 0x8000);
+    const bool t3 = exe.cpu.mem[0x8800] == 0 && syscall(sys, exe, LinuxSyscalls::SYS_BRK, 0xD000) == 0x8000;
+    const bool t = t1 && t2 && t3 && sys.program_break() == 0x8000;
+    assert(t);
+}
+
+void test_syscall_mmap2() {
+    auto exe = make_executor();
+    LinuxSyscalls sys(0x8000, 0xC000);
+    exe.cpu.R[ESI] = 0x22; // MAP_PRIVATE | MAP_ANONYMOUS
+    exe.cpu.R[EDI] = std::uint32_t(-1);
+    exe.cpu.R[EBP] = 0;
+    const auto a = syscall(sys, exe, LinuxSyscalls::SYS_MMAP2, 0, 0x1800, 0x3);
+    const auto b = syscall(sys, exe, LinuxSyscalls::SYS_MMAP2, 0, 0x1000, 0x1);
+    const bool t1 = a == 0xA000 && b == 0x9000
+        && exe.cpu.mem.page_flags(0xA000) == (Memory::PAGE_READ | Memory::PAGE_WRITE)
+        && exe.cpu.mem.page_flags(0x9000) == Memory::PAGE_READ;
+    const bool t2 = syscall(sys, exe, LinuxSyscalls::SYS_MMAP2, 0, 0x2000, 0x3) == std::uint32_t(-ENOMEM);
+    // A file mapping that fails on the host leaves the arena as it was.
+    exe.cpu.R[ESI] = 0x2; // MAP_PRIVATE
+    exe.cpu.R[EDI] = 999;
+    const bool t3 = syscall(sys, exe, LinuxSyscalls::SYS_MMAP2, 0, 0x1000, 0x1) == std::uint32_t(-EBADF);
+    exe.cpu.R[ESI] = 0x22;
+    exe.cpu.R[EDI] = std::uint32_t(-1);
+    const bool t = t1 && t2 && t3 && syscall(sys, exe, LinuxSyscalls::SYS_MMAP2, 0, 0x1000, 0x3) == 0x8000;
+    assert(t);
+}
+
+void test_syscall_clock_gettime_and_exit() {
+    auto exe = make_executor();
+    LinuxSyscalls sys(0x8000, 0xC000);
+    const bool t1 = syscall(sys, exe, LinuxSyscalls::SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, 0x100) == 0
+        && mread<std::uint32_t>(&exe.cpu.mem[0x104]) < 1000000000;
+    const bool t2 = syscall(sys, exe, LinuxSyscalls::SYS_CLOCK_GETTIME, CLOCK_REALTIME, 0xFFFF0) == std::uint32_t(-EFAULT);
+    const bool t3 = syscall(sys, exe, 9999) == std::uint32_t(-ENOSYS) && !sys.exited();
+    syscall(sys, exe, LinuxSyscalls::SYS_EXIT_GROUP, 3);
+    const bool t = t1 && t2 && t3 && sys.exited() && sys.exit_status() == 3;
+    assert(t);
+}
+
+void test_syscalls() {
+    test_syscall_int80_exit_reason();
+    test_syscall_read_write();
+    test_syscall_read_into_watched_page();
+    test_syscall_open_fstat_close();
+    test_syscall_brk();
+    test_syscall_mmap2();
+    test_syscall_clock_gettime_and_exit();
+
+    std::cout << "All syscall tests passed!" << std::endl;
+}